@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "kbd_scan.h"
+#include "kbd_matrix_sim.h"
+
+#define OUTPUT_NUM      6
+#define INPUT_NUM       17
+#define DEBOUNCE_TICKS  2
+#define TICK_NS         500000ULL
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*!< Backend that costs nothing, isolates the engine from the simulated matrix */
+static void null_set_output_level(void *ctx, uint32_t index, uint32_t level)
+{
+    (void)ctx;
+    (void)index;
+    (void)level;
+}
+
+static void null_set_outputs_level(void *ctx, uint32_t level_mask)
+{
+    (void)ctx;
+    (void)level_mask;
+}
+
+static uint32_t null_read_inputs_level(void *ctx)
+{
+    return *(volatile uint32_t *)ctx;
+}
+
+/**
+ * @brief Time every kbd_scan_tick() and print min / p50 / p99 / max in ns
+ */
+static void bench(const char *name, kbd_matrix_sim_t *sim, const kbd_matrix_hal_t *hal, uint32_t iterations)
+{
+    kbd_scan_t scan;
+    kbd_scan_init(&scan, OUTPUT_NUM, INPUT_NUM, 1, DEBOUNCE_TICKS);
+    uint64_t *samples = calloc(iterations, sizeof(uint64_t));
+    uint32_t changes = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (sim) {
+            kbd_matrix_sim_advance(sim, (uint64_t)(i + 1) * TICK_NS);
+        }
+        keyboard_btn_report_t report;
+        uint64_t start = now_ns();
+        changes += kbd_scan_tick(&scan, hal, &report) ? 1 : 0;
+        samples[i] = now_ns() - start;
+    }
+
+    qsort(samples, iterations, sizeof(uint64_t), cmp_u64);
+    printf("%-14s ticks %8u  changes %6u  min %6llu  p50 %6llu  p99 %6llu  max %8llu ns\n", name, iterations, changes,
+           (unsigned long long)samples[0],
+           (unsigned long long)samples[iterations / 2],
+           (unsigned long long)samples[(uint64_t)iterations * 99 / 100],
+           (unsigned long long)samples[iterations - 1]);
+
+    free(samples);
+    kbd_scan_deinit(&scan);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 200000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    volatile uint32_t inputs = 0;
+    kbd_matrix_hal_t null_hal = {
+        .set_output_level = null_set_output_level,
+        .set_outputs_level = null_set_outputs_level,
+        .read_inputs_level = null_read_inputs_level,
+        .ctx = (void *)&inputs,
+    };
+    bench("engine idle", NULL, &null_hal, iterations);
+
+    kbd_sim_script_t script = {0};
+    kbd_matrix_sim_t sim;
+    kbd_matrix_hal_t sim_hal;
+
+    kbd_matrix_sim_init(&sim, OUTPUT_NUM, INPUT_NUM, 1, true, &script);
+    kbd_matrix_sim_hal(&sim, &sim_hal);
+    bench("sim idle", &sim, &sim_hal, iterations);
+
+    // Ten keys held for the whole run
+    for (uint8_t k = 0; k < 10; k++) {
+        kbd_sim_script_press(&script, k % OUTPUT_NUM, (k * 3) % INPUT_NUM, 0, UINT64_MAX, NULL);
+    }
+    kbd_sim_script_sort(&script);
+    kbd_matrix_sim_init(&sim, OUTPUT_NUM, INPUT_NUM, 1, true, &script);
+    bench("sim 10 held", &sim, &sim_hal, iterations);
+    kbd_sim_script_free(&script);
+
+    // Bouncy typing at ~12 keys per second, 60 ms dwell
+    kbd_sim_bounce_t bounce = {.transitions = 3, .duration_ns = 800000, .seed = 1};
+    uint64_t end_ns = (uint64_t)iterations * TICK_NS;
+    uint32_t key = 0;
+    for (uint64_t t = 1000000; t + 60000000 < end_ns; t += 83000000, key++) {
+        kbd_sim_script_press(&script, key % OUTPUT_NUM, (key * 7) % INPUT_NUM, t, t + 60000000, &bounce);
+    }
+    kbd_sim_script_sort(&script);
+    kbd_matrix_sim_init(&sim, OUTPUT_NUM, INPUT_NUM, 1, true, &script);
+    bench("sim typing", &sim, &sim_hal, iterations);
+    kbd_sim_script_free(&script);
+
+    return EXIT_SUCCESS;
+}
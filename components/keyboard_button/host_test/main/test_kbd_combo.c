@@ -0,0 +1,236 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kbd_scan.h"
+#include "kbd_combo.h"
+#include "kbd_matrix_sim.h"
+
+#define OUTPUT_NUM      6
+#define INPUT_NUM       17
+#define DEBOUNCE_TICKS  2
+#define TICK_NS         500000ULL   // 500 us, same as the firmware
+#define TERM_TICKS      20          // 10 ms
+#define MAX_FIRES       64
+#define MS(x)           ((uint64_t)(x) * 1000000ULL)
+
+static int s_failures = 0;
+
+#define TEST_ASSERT(cond)                                                           \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("  %s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond);   \
+            s_failures++;                                                           \
+            return;                                                                 \
+        }                                                                           \
+    } while (0)
+
+typedef struct {
+    kbd_scan_t scan;
+    kbd_combo_t combo;
+    kbd_matrix_sim_t sim;
+    kbd_matrix_hal_t hal;
+    kbd_sim_script_t script;
+    uint64_t now_ns;
+    uint32_t fires[MAX_FIRES];
+    uint32_t fire_num;
+} fixture_t;
+
+static void on_fire(uint32_t combo_id, void *user_data)
+{
+    fixture_t *f = user_data;
+    if (f->fire_num < MAX_FIRES) {
+        f->fires[f->fire_num] = combo_id;
+    }
+    f->fire_num++;
+}
+
+static void fixture_init(fixture_t *f)
+{
+    memset(f, 0, sizeof(fixture_t));
+    kbd_scan_init(&f->scan, OUTPUT_NUM, INPUT_NUM, 1, DEBOUNCE_TICKS);
+    kbd_combo_init(&f->combo, OUTPUT_NUM, INPUT_NUM);
+    kbd_matrix_sim_init(&f->sim, OUTPUT_NUM, INPUT_NUM, 1, true, &f->script);
+    kbd_matrix_sim_hal(&f->sim, &f->hal);
+}
+
+static void fixture_deinit(fixture_t *f)
+{
+    kbd_scan_deinit(&f->scan);
+    kbd_combo_deinit(&f->combo);
+    kbd_sim_script_free(&f->script);
+}
+
+/**
+ * @brief Scan every TICK_NS until end_ns, feeding every tick to the combination matcher like kbd_handler()
+ */
+static void fixture_run(fixture_t *f, uint64_t end_ns)
+{
+    kbd_sim_script_sort(&f->script);
+    while (f->now_ns + TICK_NS <= end_ns) {
+        f->now_ns += TICK_NS;
+        kbd_matrix_sim_advance(&f->sim, f->now_ns);
+        keyboard_btn_report_t report;
+        if (kbd_scan_tick(&f->scan, &f->hal, &report)) {
+            kbd_combo_tick(&f->combo, &report, on_fire, f);
+        } else {
+            kbd_combo_tick(&f->combo, NULL, NULL, NULL);
+        }
+    }
+}
+
+static void test_order_insensitive(void)
+{
+    static const keyboard_btn_data_t keys[] = {{1, 1}, {2, 2}};
+    const kbd_combo_def_t defs[] = {{keys, 2, TERM_TICKS}};
+    for (int reverse = 0; reverse <= 1; reverse++) {
+        fixture_t f;
+        fixture_init(&f);
+        TEST_ASSERT(kbd_combo_set(&f.combo, defs, 1));
+        kbd_sim_script_press(&f.script, keys[reverse].output_index, keys[reverse].input_index, MS(1), MS(50), NULL);
+        kbd_sim_script_press(&f.script, keys[!reverse].output_index, keys[!reverse].input_index, MS(5), MS(50), NULL);
+        fixture_run(&f, MS(60));
+        TEST_ASSERT(f.fire_num == 1 && f.fires[0] == 0);
+        fixture_deinit(&f);
+    }
+}
+
+static void test_outside_term(void)
+{
+    static const keyboard_btn_data_t keys[] = {{1, 1}, {2, 2}};
+    const kbd_combo_def_t defs[] = {{keys, 2, TERM_TICKS}};
+    fixture_t f;
+    fixture_init(&f);
+    TEST_ASSERT(kbd_combo_set(&f.combo, defs, 1));
+    kbd_sim_script_press(&f.script, 1, 1, MS(1), MS(50), NULL);
+    kbd_sim_script_press(&f.script, 2, 2, MS(20), MS(50), NULL);
+    fixture_run(&f, MS(60));
+    TEST_ASSERT(f.fire_num == 0);
+    fixture_deinit(&f);
+}
+
+static void test_fires_once_per_completion(void)
+{
+    // Held keys do not refire, a key pressed again within the term of the other does
+    static const keyboard_btn_data_t keys[] = {{1, 1}, {2, 2}};
+    const kbd_combo_def_t defs[] = {{keys, 2, TERM_TICKS}};
+    fixture_t f;
+    fixture_init(&f);
+    TEST_ASSERT(kbd_combo_set(&f.combo, defs, 1));
+    kbd_sim_script_press(&f.script, 1, 1, MS(1), MS(100), NULL);
+    kbd_sim_script_press(&f.script, 2, 2, MS(2), MS(4), NULL);
+    kbd_sim_script_press(&f.script, 2, 2, MS(8), MS(30), NULL);
+    kbd_sim_script_press(&f.script, 2, 2, MS(60), MS(80), NULL);
+    fixture_run(&f, MS(120));
+    TEST_ASSERT(f.fire_num == 2);
+    fixture_deinit(&f);
+}
+
+static void test_other_keys_held(void)
+{
+    // A key held before the combination neither blocks it nor counts towards its term
+    static const keyboard_btn_data_t keys[] = {{3, 3}, {3, 4}};
+    const kbd_combo_def_t defs[] = {{keys, 2, TERM_TICKS}};
+    fixture_t f;
+    fixture_init(&f);
+    TEST_ASSERT(kbd_combo_set(&f.combo, defs, 1));
+    kbd_sim_script_press(&f.script, 0, 0, MS(1), MS(100), NULL);
+    kbd_sim_script_press(&f.script, 3, 4, MS(50), MS(90), NULL);
+    kbd_sim_script_press(&f.script, 3, 3, MS(52), MS(90), NULL);
+    fixture_run(&f, MS(120));
+    TEST_ASSERT(f.fire_num == 1);
+    fixture_deinit(&f);
+}
+
+static void test_overlapping_combos(void)
+{
+    // {A, B} completes on B, {A, B, C} on C, {D, E} never
+    static const keyboard_btn_data_t ab[] = {{0, 1}, {0, 2}};
+    static const keyboard_btn_data_t abc[] = {{0, 3}, {0, 2}, {0, 1}};
+    static const keyboard_btn_data_t de[] = {{4, 4}, {4, 5}};
+    const kbd_combo_def_t defs[] = {{ab, 2, TERM_TICKS}, {abc, 3, TERM_TICKS}, {de, 2, TERM_TICKS}};
+    fixture_t f;
+    fixture_init(&f);
+    TEST_ASSERT(kbd_combo_set(&f.combo, defs, 3));
+    kbd_sim_script_press(&f.script, 0, 1, MS(1), MS(50), NULL);
+    kbd_sim_script_press(&f.script, 0, 2, MS(3), MS(50), NULL);
+    kbd_sim_script_press(&f.script, 0, 3, MS(5), MS(50), NULL);
+    kbd_sim_script_press(&f.script, 4, 4, MS(6), MS(50), NULL);
+    fixture_run(&f, MS(60));
+    TEST_ASSERT(f.fire_num == 2);
+    TEST_ASSERT(f.fires[0] == 0 && f.fires[1] == 1);
+    fixture_deinit(&f);
+}
+
+static void test_many_combos(void)
+{
+    // Every pair of the first 40 positions: only the one pair pressed fires, and the index only lists
+    // the combinations of each key
+    enum { KEYS = 40, COMBOS = KEYS * (KEYS - 1) / 2 };
+    static keyboard_btn_data_t pairs[COMBOS][2];
+    static kbd_combo_def_t defs[COMBOS];
+    uint32_t n = 0;
+    for (uint32_t a = 0; a < KEYS; a++) {
+        for (uint32_t b = a + 1; b < KEYS; b++) {
+            pairs[n][0] = (keyboard_btn_data_t) {a / INPUT_NUM, a % INPUT_NUM};
+            pairs[n][1] = (keyboard_btn_data_t) {b / INPUT_NUM, b % INPUT_NUM};
+            defs[n] = (kbd_combo_def_t) {pairs[n], 2, TERM_TICKS};
+            n++;
+        }
+    }
+    fixture_t f;
+    fixture_init(&f);
+    TEST_ASSERT(kbd_combo_set(&f.combo, defs, COMBOS));
+    TEST_ASSERT(f.combo.index_start[1] - f.combo.index_start[0] == KEYS - 1);
+    TEST_ASSERT(f.combo.index_start[OUTPUT_NUM * INPUT_NUM] == COMBOS * 2);
+
+    kbd_sim_script_press(&f.script, 1, 5, MS(1), MS(50), NULL);     // position 22
+    kbd_sim_script_press(&f.script, 0, 7, MS(3), MS(50), NULL);     // position 7
+    fixture_run(&f, MS(60));
+    TEST_ASSERT(f.fire_num == 1);
+    TEST_ASSERT(defs[f.fires[0]].key_data[0].input_index == 7 && defs[f.fires[0]].key_data[1].input_index == 5);
+    fixture_deinit(&f);
+}
+
+static void test_set_rejects_bad_key(void)
+{
+    static const keyboard_btn_data_t good[] = {{1, 1}, {2, 2}};
+    static const keyboard_btn_data_t bad[] = {{1, 1}, {OUTPUT_NUM, 0}};
+    const kbd_combo_def_t defs[] = {{good, 2, TERM_TICKS}, {bad, 2, TERM_TICKS}};
+    fixture_t f;
+    fixture_init(&f);
+    TEST_ASSERT(!kbd_combo_set(&f.combo, defs, 2));
+    TEST_ASSERT(f.combo.combo_num == 0);
+    kbd_sim_script_press(&f.script, 1, 1, MS(1), MS(50), NULL);
+    kbd_sim_script_press(&f.script, 2, 2, MS(2), MS(50), NULL);
+    fixture_run(&f, MS(60));
+    TEST_ASSERT(f.fire_num == 0);
+    TEST_ASSERT(kbd_combo_set(&f.combo, defs, 1));
+    fixture_deinit(&f);
+}
+
+#define RUN_TEST(fn)                                    \
+    do {                                                \
+        int failures = s_failures;                      \
+        fn();                                           \
+        printf("%s %s\n", s_failures == failures ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+int main(void)
+{
+    RUN_TEST(test_order_insensitive);
+    RUN_TEST(test_outside_term);
+    RUN_TEST(test_fires_once_per_completion);
+    RUN_TEST(test_other_keys_held);
+    RUN_TEST(test_overlapping_combos);
+    RUN_TEST(test_many_combos);
+    RUN_TEST(test_set_rejects_bad_key);
+
+    printf("%d failure(s)\n", s_failures);
+    return s_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,278 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kbd_scan.h"
+#include "kbd_matrix_sim.h"
+
+#define OUTPUT_NUM      6
+#define INPUT_NUM       17
+#define DEBOUNCE_TICKS  2
+#define TICK_NS         500000ULL   // 500 us, same as the firmware
+#define MS(x)           ((uint64_t)(x) * 1000000ULL)
+#define US(x)           ((uint64_t)(x) * 1000ULL)
+
+static int s_failures = 0;
+
+#define TEST_ASSERT(cond)                                                           \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("  %s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond);   \
+            s_failures++;                                                           \
+            return;                                                                 \
+        }                                                                           \
+    } while (0)
+
+typedef struct {
+    kbd_scan_t scan;
+    kbd_matrix_sim_t sim;
+    kbd_matrix_hal_t hal;
+    kbd_sim_script_t script;
+    uint64_t now_ns;
+    uint32_t presses;
+    uint32_t releases;
+    uint64_t first_press_ns;
+    uint64_t last_release_ns;
+    keyboard_btn_report_t report;
+} fixture_t;
+
+static void fixture_init(fixture_t *f, uint8_t active_level, bool has_diodes)
+{
+    memset(f, 0, sizeof(fixture_t));
+    kbd_scan_init(&f->scan, OUTPUT_NUM, INPUT_NUM, active_level, DEBOUNCE_TICKS);
+    kbd_matrix_sim_init(&f->sim, OUTPUT_NUM, INPUT_NUM, active_level, has_diodes, &f->script);
+    kbd_matrix_sim_hal(&f->sim, &f->hal);
+}
+
+static void fixture_deinit(fixture_t *f)
+{
+    kbd_scan_deinit(&f->scan);
+    kbd_sim_script_free(&f->script);
+}
+
+/**
+ * @brief Scan every TICK_NS until end_ns and count the debounced presses and releases
+ */
+static void fixture_run(fixture_t *f, uint64_t end_ns)
+{
+    kbd_sim_script_sort(&f->script);
+    while (f->now_ns + TICK_NS <= end_ns) {
+        f->now_ns += TICK_NS;
+        kbd_matrix_sim_advance(&f->sim, f->now_ns);
+        keyboard_btn_report_t report;
+        if (kbd_scan_tick(&f->scan, &f->hal, &report)) {
+            uint32_t new_presses = report.key_change_num + report.key_release_num;
+            if (new_presses && f->presses == 0) {
+                f->first_press_ns = f->now_ns;
+            }
+            if (report.key_release_num) {
+                f->last_release_ns = f->now_ns;
+            }
+            f->presses += new_presses;
+            f->releases += report.key_release_num;
+            f->report = report;
+        }
+    }
+}
+
+static bool report_has_key(const keyboard_btn_report_t *report, uint8_t output_index, uint8_t input_index)
+{
+    for (uint32_t i = 0; i < report->key_pressed_num; i++) {
+        if (report->key_data[i].output_index == output_index && report->key_data[i].input_index == input_index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_clean_press_release(void)
+{
+    fixture_t f;
+    fixture_init(&f, 1, true);
+    kbd_sim_script_press(&f.script, 1, 2, MS(1), MS(10), NULL);
+
+    fixture_run(&f, MS(5));
+    TEST_ASSERT(f.presses == 1);
+    TEST_ASSERT(f.scan.key_pressed_num == 1);
+    TEST_ASSERT(report_has_key(&f.report, 1, 2));
+    // Seen at 1.0 ms, accepted on the second agreeing tick
+    TEST_ASSERT(f.first_press_ns == MS(1) + (DEBOUNCE_TICKS - 1) * TICK_NS);
+
+    fixture_run(&f, MS(20));
+    TEST_ASSERT(f.releases == 1);
+    TEST_ASSERT(f.scan.key_pressed_num == 0);
+    TEST_ASSERT(f.report.key_release_num == 1);
+    TEST_ASSERT(f.report.key_release_data[0].output_index == 1 && f.report.key_release_data[0].input_index == 2);
+    TEST_ASSERT(f.scan.settled);
+    fixture_deinit(&f);
+}
+
+static void test_active_low(void)
+{
+    fixture_t f;
+    fixture_init(&f, 0, true);
+    kbd_sim_script_press(&f.script, 5, 16, MS(1), MS(10), NULL);
+
+    fixture_run(&f, MS(5));
+    TEST_ASSERT(f.presses == 1);
+    TEST_ASSERT(report_has_key(&f.report, 5, 16));
+
+    fixture_run(&f, MS(20));
+    TEST_ASSERT(f.releases == 1);
+    TEST_ASSERT(f.scan.key_pressed_num == 0);
+    fixture_deinit(&f);
+}
+
+static void test_bounce_filtered(void)
+{
+    // Bounce shorter than the debounce window must never split a keystroke, whatever the phase
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        fixture_t f;
+        fixture_init(&f, 1, true);
+        kbd_sim_bounce_t bounce = {
+            .transitions = 5,
+            .duration_ns = (DEBOUNCE_TICKS * TICK_NS) - US(200),
+            .seed = seed,
+        };
+        uint64_t phase_ns = (seed * 7919ULL) % TICK_NS;
+        kbd_sim_script_press(&f.script, 3, 7, MS(2) + phase_ns, MS(30) + phase_ns, &bounce);
+
+        fixture_run(&f, MS(50));
+        TEST_ASSERT(f.presses == 1);
+        TEST_ASSERT(f.releases == 1);
+        TEST_ASSERT(f.scan.key_pressed_num == 0);
+        fixture_deinit(&f);
+    }
+}
+
+static void test_chatter_filtered(void)
+{
+    fixture_t f;
+    fixture_init(&f, 1, true);
+    kbd_sim_script_press(&f.script, 0, 0, MS(1), MS(40), NULL);
+    // Dropout of a held key and a spurious close of an idle key, both shorter than one tick
+    kbd_sim_script_chatter(&f.script, 0, 0, MS(10) + US(100), US(300), 0);
+    kbd_sim_script_chatter(&f.script, 2, 4, MS(20) + US(100), US(300), 1);
+
+    fixture_run(&f, MS(60));
+    TEST_ASSERT(f.presses == 1);
+    TEST_ASSERT(f.releases == 1);
+    fixture_deinit(&f);
+}
+
+static void test_chatter_longer_than_debounce(void)
+{
+    // A dropout that spans the whole debounce window is a real release
+    fixture_t f;
+    fixture_init(&f, 1, true);
+    kbd_sim_script_press(&f.script, 0, 0, MS(1), MS(40), NULL);
+    kbd_sim_script_chatter(&f.script, 0, 0, MS(10), DEBOUNCE_TICKS * TICK_NS + US(200), 0);
+
+    fixture_run(&f, MS(60));
+    TEST_ASSERT(f.presses == 2);
+    TEST_ASSERT(f.releases == 2);
+    fixture_deinit(&f);
+}
+
+static void test_ghosting(void)
+{
+    // Three corners of a rectangle held: a diode-less matrix also reports the fourth corner
+    for (int has_diodes = 0; has_diodes <= 1; has_diodes++) {
+        fixture_t f;
+        fixture_init(&f, 1, has_diodes);
+        kbd_sim_script_press(&f.script, 1, 3, MS(1), MS(20), NULL);
+        kbd_sim_script_press(&f.script, 1, 8, MS(2), MS(20), NULL);
+        kbd_sim_script_press(&f.script, 4, 3, MS(3), MS(20), NULL);
+
+        fixture_run(&f, MS(10));
+        TEST_ASSERT(report_has_key(&f.report, 1, 3));
+        TEST_ASSERT(report_has_key(&f.report, 1, 8));
+        TEST_ASSERT(report_has_key(&f.report, 4, 3));
+        if (has_diodes) {
+            TEST_ASSERT(f.scan.key_pressed_num == 3);
+            TEST_ASSERT(!report_has_key(&f.report, 4, 8));
+        } else {
+            TEST_ASSERT(f.scan.key_pressed_num == 4);
+            TEST_ASSERT(report_has_key(&f.report, 4, 8));
+        }
+
+        fixture_run(&f, MS(30));
+        TEST_ASSERT(f.scan.key_pressed_num == 0);
+        fixture_deinit(&f);
+    }
+}
+
+static void test_release_keeps_order(void)
+{
+    fixture_t f;
+    fixture_init(&f, 1, true);
+    kbd_sim_script_press(&f.script, 0, 1, MS(1), MS(30), NULL);
+    kbd_sim_script_press(&f.script, 2, 2, MS(3), MS(10), NULL);
+    kbd_sim_script_press(&f.script, 5, 0, MS(5), MS(30), NULL);
+
+    fixture_run(&f, MS(8));
+    TEST_ASSERT(f.scan.key_pressed_num == 3);
+    TEST_ASSERT(f.report.key_change_num == 1);
+
+    fixture_run(&f, MS(15));
+    TEST_ASSERT(f.scan.key_pressed_num == 2);
+    TEST_ASSERT(f.report.key_change_num == -1);
+    TEST_ASSERT(f.report.key_data[0].output_index == 0 && f.report.key_data[0].input_index == 1);
+    TEST_ASSERT(f.report.key_data[1].output_index == 5 && f.report.key_data[1].input_index == 0);
+    TEST_ASSERT(f.report.key_release_data[0].output_index == 2 && f.report.key_release_data[0].input_index == 2);
+    fixture_deinit(&f);
+}
+
+static void test_full_matrix(void)
+{
+    // Every key down, then every key up: exercises the compaction of a full pressed list
+    fixture_t f;
+    fixture_init(&f, 1, true);
+    for (uint8_t i = 0; i < OUTPUT_NUM; i++) {
+        for (uint8_t j = 0; j < INPUT_NUM; j++) {
+            kbd_sim_script_press(&f.script, i, j, MS(1), MS(10), NULL);
+        }
+    }
+
+    fixture_run(&f, MS(5));
+    TEST_ASSERT(f.scan.key_pressed_num == OUTPUT_NUM * INPUT_NUM);
+    fixture_run(&f, MS(20));
+    TEST_ASSERT(f.scan.key_pressed_num == 0);
+    TEST_ASSERT(f.releases == OUTPUT_NUM * INPUT_NUM);
+    fixture_deinit(&f);
+}
+
+static void test_init_rejects_bad_size(void)
+{
+    kbd_scan_t scan;
+    TEST_ASSERT(!kbd_scan_init(&scan, 0, INPUT_NUM, 1, DEBOUNCE_TICKS));
+    TEST_ASSERT(!kbd_scan_init(&scan, OUTPUT_NUM, 33, 1, DEBOUNCE_TICKS));
+}
+
+#define RUN_TEST(fn)                                    \
+    do {                                                \
+        int failures = s_failures;                      \
+        fn();                                           \
+        printf("%s %s\n", s_failures == failures ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+int main(void)
+{
+    RUN_TEST(test_clean_press_release);
+    RUN_TEST(test_active_low);
+    RUN_TEST(test_bounce_filtered);
+    RUN_TEST(test_chatter_filtered);
+    RUN_TEST(test_chatter_longer_than_debounce);
+    RUN_TEST(test_ghosting);
+    RUN_TEST(test_release_keeps_order);
+    RUN_TEST(test_full_matrix);
+    RUN_TEST(test_init_rejects_bad_size);
+
+    printf("%d failure(s)\n", s_failures);
+    return s_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
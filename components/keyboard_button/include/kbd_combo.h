@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard_button_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One combination: a set of keys that fires once all of them are down
+ */
+typedef struct {
+    const keyboard_btn_data_t *key_data;    /*!< Keys of the combination, in any order */
+    uint32_t key_num;                       /*!< Number of keys */
+    uint32_t term_ticks;                    /*!< Ticks allowed between the first and the last press */
+} kbd_combo_def_t;
+
+/**
+ * @brief Called for every combination completed by a press
+ *
+ * @param combo_id Index of the combination in the array given to kbd_combo_set()
+ * @param user_data User data given to kbd_combo_tick()
+ */
+typedef void (*kbd_combo_fire_t)(uint32_t combo_id, void *user_data);
+
+/**
+ * @brief Combination matching state
+ *
+ * Every combination is a bitset of matrix positions. An index from each position to the combinations that
+ * contain it means a press only looks at those combinations, however many are registered.
+ * Pure logic, no RTOS or driver dependency, so it also builds on the host (see host_test).
+ */
+typedef struct {
+    uint32_t output_num;                /*!< Number of output lines */
+    uint32_t input_num;                 /*!< Number of input lines */
+    uint32_t word_num;                  /*!< 32-bit words of one position bitset */
+    uint32_t tick;                      /*!< Ticks seen by kbd_combo_tick() */
+    /*!< Size: word_num * sizeof(uint32_t), debounced keys down */
+    uint32_t *pressed;
+    /*!< Size: output_num * input_num * sizeof(uint32_t), tick each key went down */
+    uint32_t *press_tick;
+    uint32_t combo_num;                 /*!< Number of combinations */
+    /*!< Size: combo_num * word_num * sizeof(uint32_t) */
+    uint32_t *combo_bits;
+    /*!< Size: combo_num * sizeof(uint32_t) */
+    uint32_t *combo_term;
+    /*!< Size: (output_num * input_num + 1) * sizeof(uint32_t), start of each position in index */
+    uint32_t *index_start;
+    /*!< Combination ids grouped by position */
+    uint32_t *index;
+} kbd_combo_t;
+
+/**
+ * @brief Allocate the matching state, no combination set
+ *
+ * @param combo Matching state to initialize
+ * @param output_num Number of output lines
+ * @param input_num Number of input lines
+ * @return
+ *      - true on success
+ *      - false if the size is invalid or memory could not be allocated
+ */
+bool kbd_combo_init(kbd_combo_t *combo, uint32_t output_num, uint32_t input_num);
+
+/**
+ * @brief Free the matching state
+ *
+ * @param combo Matching state initialized with kbd_combo_init()
+ */
+void kbd_combo_deinit(kbd_combo_t *combo);
+
+/**
+ * @brief Replace every combination and rebuild the index
+ *
+ * @param combo Matching state
+ * @param defs Combinations, only read during the call
+ * @param def_num Number of combinations
+ * @return
+ *      - true on success
+ *      - false if a key is outside the matrix or memory could not be allocated, no combination is left set
+ */
+bool kbd_combo_set(kbd_combo_t *combo, const kbd_combo_def_t *defs, uint32_t def_num);
+
+/**
+ * @brief Track the pressed keys of one scan tick and fire the combinations they complete
+ *
+ * A combination fires on the press that brings its last key down, when every one of its keys went down
+ * within its term. The order of the presses and other keys held at the same time do not matter.
+ *
+ * @param combo Matching state
+ * @param report Report of kbd_scan_tick(), NULL for a tick without change. Must be called on every tick,
+ *               the term is counted in calls.
+ * @param fire Called for each completed combination, may be NULL when report is NULL
+ * @param user_data Passed to fire
+ */
+void kbd_combo_tick(kbd_combo_t *combo, const keyboard_btn_report_t *report, kbd_combo_fire_t fire, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
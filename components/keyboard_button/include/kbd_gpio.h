@@ -7,6 +7,7 @@
 #pragma once
 
 #include "driver/gpio.h"
+#include "kbd_matrix_hal.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,6 +29,16 @@ typedef struct {
     bool enable_power_save;        /*!< Enable power save, only for input mode */
 } kbd_gpio_config_t;
 
+/**
+ * @brief GPIOs of a key matrix, the context of the ESP matrix backend
+ */
+typedef struct {
+    const int *output_gpios;       /*!< Array, contains output GPIO numbers */
+    uint32_t output_gpio_num;      /*!< output_gpios array size */
+    const int *input_gpios;        /*!< Array, contains input GPIO numbers */
+    uint32_t input_gpio_num;       /*!< input_gpios array size */
+} kbd_gpio_matrix_t;
+
 /**
  * @brief Init GPIOs for keyboard
  *
@@ -146,6 +157,14 @@ esp_err_t kbd_gpios_set_intr(const int *gpios, uint32_t gpio_num, gpio_int_type_
  */
 esp_err_t kbd_gpios_intr_control(const int *gpios, uint32_t gpio_num, bool enable);
 
+/**
+ * @brief Fill a matrix HAL that drives the GPIOs of a key matrix
+ *
+ * @param matrix GPIOs of the matrix, must outlive the HAL
+ * @param hal HAL to fill
+ */
+void kbd_gpio_matrix_hal(kbd_gpio_matrix_t *matrix, kbd_matrix_hal_t *hal);
+
 #ifdef __cplusplus
 }
 #endif
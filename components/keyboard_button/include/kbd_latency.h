@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Intervals between the stamps taken on the way from a scan to the host
+ *
+ * Stamps inside the scan task use the CPU cycle counter. Stamps from other tasks use esp_timer, so
+ * they stay valid across cores and light sleep.
+ */
+typedef enum {
+    KBD_LATENCY_SCAN = 0,           /*!< Scan start to the end of the handler, every tick */
+    KBD_LATENCY_DEBOUNCE,           /*!< Scan start to the debounce commit of a change */
+    KBD_LATENCY_DISPATCH,           /*!< Debounce commit to the entry of the application callback */
+    KBD_LATENCY_ENQUEUE,            /*!< Callback entry to the report handed to the transport */
+    KBD_LATENCY_TRANSPORT,          /*!< Report handed to the transport to its completion */
+    KBD_LATENCY_TOTAL,              /*!< Scan start to transport completion */
+    KBD_LATENCY_MAX,
+} kbd_latency_span_t;
+
+#define KBD_LATENCY_BUCKET_NUM      20  /*!< Bucket 0 counts < 512 ns, bucket N counts [2^(N+8), 2^(N+9)) ns, the last one everything above */
+#define KBD_LATENCY_BUCKET_SHIFT    8
+
+/**
+ * @brief Fixed-bucket histogram of one interval
+ */
+typedef struct {
+    uint32_t count;                             /*!< Number of samples */
+    uint32_t min_ns;                            /*!< Shortest sample */
+    uint32_t max_ns;                            /*!< Longest sample */
+    uint64_t sum_ns;                            /*!< Sum of the samples, for the mean */
+    uint32_t bucket[KBD_LATENCY_BUCKET_NUM];    /*!< Samples per power-of-two bucket */
+} kbd_latency_hist_t;
+
+#if CONFIG_KEYBOARD_LATENCY_STATS
+
+/**
+ * @brief Stamp the start of a scan, called by the scan task
+ */
+void kbd_latency_scan_start(void);
+
+/**
+ * @brief Stamp the debounce commit of a change, called by the scan task
+ */
+void kbd_latency_scan_commit(void);
+
+/**
+ * @brief Stamp the end of the scan handler, called by the scan task
+ */
+void kbd_latency_scan_end(void);
+
+/**
+ * @brief Stamp the entry of the application callback
+ *
+ * Only a callback that follows a debounce commit starts a measurement, callbacks made outside the
+ * scan are ignored.
+ */
+void kbd_latency_callback_entry(void);
+
+/**
+ * @brief A keyboard report was handed to the transport
+ *
+ * Every hand-off must be matched by kbd_latency_report_done() or kbd_latency_report_dropped(), in
+ * order, reports that did not come from a measured callback are tracked but not recorded.
+ */
+void kbd_latency_report_enqueue(void);
+
+/**
+ * @brief The oldest report handed to the transport was sent
+ */
+void kbd_latency_report_done(void);
+
+/**
+ * @brief The oldest report handed to the transport was discarded
+ */
+void kbd_latency_report_dropped(void);
+
+/**
+ * @brief Forget every report in flight, e.g. when the link is lost or the queue is flushed
+ */
+void kbd_latency_reports_clear(void);
+
+/**
+ * @brief Copy one histogram
+ *
+ * @param span Interval to read
+ * @param hist Filled with a consistent snapshot
+ */
+void kbd_latency_get(kbd_latency_span_t span, kbd_latency_hist_t *hist);
+
+/**
+ * @brief Clear every histogram
+ */
+void kbd_latency_reset(void);
+
+/**
+ * @brief Print every histogram to the console
+ */
+void kbd_latency_print(void);
+
+#else
+
+static inline void kbd_latency_scan_start(void) {}
+static inline void kbd_latency_scan_commit(void) {}
+static inline void kbd_latency_scan_end(void) {}
+static inline void kbd_latency_callback_entry(void) {}
+static inline void kbd_latency_report_enqueue(void) {}
+static inline void kbd_latency_report_done(void) {}
+static inline void kbd_latency_report_dropped(void) {}
+static inline void kbd_latency_reports_clear(void) {}
+static inline void kbd_latency_reset(void) {}
+static inline void kbd_latency_print(void) {}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
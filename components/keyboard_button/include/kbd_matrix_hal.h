@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Matrix access used by the scan engine
+ *
+ * The ESP backend drives real GPIOs (see kbd_gpio_matrix_hal()), the simulated backend
+ * replays scripted contact waveforms (see kbd_matrix_sim_hal()).
+ */
+typedef struct {
+    /**
+     * @brief Set the level of one output line
+     *
+     * @param ctx Backend context
+     * @param index Output index
+     * @param level Level to set (0 or 1)
+     */
+    void (*set_output_level)(void *ctx, uint32_t index, uint32_t level);
+
+    /**
+     * @brief Set the level of every output line
+     *
+     * @param ctx Backend context
+     * @param level_mask Bit N is the level of output N
+     */
+    void (*set_outputs_level)(void *ctx, uint32_t level_mask);
+
+    /**
+     * @brief Read every input line
+     *
+     * @param ctx Backend context
+     * @return Bitmask of input levels, bit N is set if input N is high
+     */
+    uint32_t (*read_inputs_level)(void *ctx);
+
+    void *ctx;                          /*!< Backend context passed to every call */
+} kbd_matrix_hal_t;
+
+#ifdef __cplusplus
+}
+#endif
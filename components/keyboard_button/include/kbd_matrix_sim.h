@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "kbd_matrix_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KBD_SIM_MAX_LINES 32
+
+/**
+ * @brief One contact change of a simulated key
+ */
+typedef struct {
+    uint64_t time_ns;                   /*!< Time of the change */
+    uint8_t output_index;               /*!< Key position's output index */
+    uint8_t input_index;                /*!< Key position's input index */
+    uint8_t closed;                     /*!< 1 if the contact closes, 0 if it opens */
+} kbd_sim_edge_t;
+
+/**
+ * @brief Contact bounce added around a press or release
+ */
+typedef struct {
+    uint32_t transitions;               /*!< Number of extra open/close pairs before the contact settles */
+    uint64_t duration_ns;               /*!< Time from the first contact change to the settled level */
+    uint32_t seed;                      /*!< Seed of the bounce timing, the same seed gives the same waveform */
+} kbd_sim_bounce_t;
+
+/**
+ * @brief Growable list of contact changes
+ */
+typedef struct {
+    kbd_sim_edge_t *edges;              /*!< Array, sorted by time after kbd_sim_script_sort() */
+    size_t edge_num;                    /*!< Number of edges */
+    size_t capacity;                    /*!< Allocated edges */
+} kbd_sim_script_t;
+
+/**
+ * @brief Simulated key matrix, the context of the simulated matrix backend
+ */
+typedef struct {
+    uint32_t output_num;                /*!< Number of output lines */
+    uint32_t input_num;                 /*!< Number of input lines */
+    uint8_t active_level;               /*!< Active level of the matrix */
+    bool has_diodes;                    /*!< false to model a diode-less matrix that ghosts */
+    const kbd_sim_script_t *script;     /*!< Waveform being replayed */
+    size_t next_edge;                   /*!< First edge not applied yet */
+    uint64_t now_ns;                    /*!< Current simulated time */
+    uint32_t output_level;              /*!< Bit N is the level driven on output N */
+    uint32_t contact[KBD_SIM_MAX_LINES];/*!< Bit N of entry M is set while key (M, N) is closed */
+} kbd_matrix_sim_t;
+
+/**
+ * @brief Free a script
+ *
+ * @param script Script to free
+ */
+void kbd_sim_script_free(kbd_sim_script_t *script);
+
+/**
+ * @brief Append one contact change
+ *
+ * @param script Script
+ * @param edge Contact change
+ * @return false if memory could not be allocated
+ */
+bool kbd_sim_script_add(kbd_sim_script_t *script, const kbd_sim_edge_t *edge);
+
+/**
+ * @brief Append a key press and release
+ *
+ * @param script Script
+ * @param output_index Key position's output index
+ * @param input_index Key position's input index
+ * @param press_ns Time the contact first closes
+ * @param release_ns Time the contact first opens
+ * @param bounce Bounce added to both edges, NULL for clean edges
+ * @return false if memory could not be allocated
+ */
+bool kbd_sim_script_press(kbd_sim_script_t *script, uint8_t output_index, uint8_t input_index,
+                          uint64_t press_ns, uint64_t release_ns, const kbd_sim_bounce_t *bounce);
+
+/**
+ * @brief Append a chatter pulse, the contact flips for a short time and returns
+ *
+ * @param script Script
+ * @param output_index Key position's output index
+ * @param input_index Key position's input index
+ * @param time_ns Start of the pulse
+ * @param width_ns Length of the pulse
+ * @param closed 1 for a spurious close of an open key, 0 for a dropout of a held key
+ * @return false if memory could not be allocated
+ */
+bool kbd_sim_script_chatter(kbd_sim_script_t *script, uint8_t output_index, uint8_t input_index,
+                            uint64_t time_ns, uint64_t width_ns, uint8_t closed);
+
+/**
+ * @brief Sort the script by time, edges at the same time keep their order
+ *
+ * @param script Script
+ */
+void kbd_sim_script_sort(kbd_sim_script_t *script);
+
+/**
+ * @brief Initialize a simulated matrix with every key open
+ *
+ * @param sim Simulated matrix
+ * @param output_num Number of output lines, at most KBD_SIM_MAX_LINES
+ * @param input_num Number of input lines, at most KBD_SIM_MAX_LINES
+ * @param active_level Active level of the matrix
+ * @param has_diodes false to model ghosting
+ * @param script Sorted waveform to replay, may be NULL
+ */
+void kbd_matrix_sim_init(kbd_matrix_sim_t *sim, uint32_t output_num, uint32_t input_num, uint8_t active_level,
+                         bool has_diodes, const kbd_sim_script_t *script);
+
+/**
+ * @brief Move the simulated time forward and apply every edge up to it
+ *
+ * @param sim Simulated matrix
+ * @param now_ns New time, must not go backwards
+ */
+void kbd_matrix_sim_advance(kbd_matrix_sim_t *sim, uint64_t now_ns);
+
+/**
+ * @brief Time of the next edge not applied yet
+ *
+ * @param sim Simulated matrix
+ * @return Time of the next edge, UINT64_MAX if the script is finished
+ */
+uint64_t kbd_matrix_sim_next_edge(const kbd_matrix_sim_t *sim);
+
+/**
+ * @brief Fill a matrix HAL backed by the simulated matrix
+ *
+ * @param sim Simulated matrix, must outlive the HAL
+ * @param hal HAL to fill
+ */
+void kbd_matrix_sim_hal(kbd_matrix_sim_t *sim, kbd_matrix_hal_t *hal);
+
+#ifdef __cplusplus
+}
+#endif
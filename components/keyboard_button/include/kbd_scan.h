@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard_button_types.h"
+#include "kbd_matrix_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KBD_SCAN_PRESSED    (1 << 0)    /*!< At least one key was pressed during the tick */
+#define KBD_SCAN_RELEASED   (1 << 1)    /*!< At least one key was released during the tick */
+
+/**
+ * @brief Matrix scan and debounce state
+ *
+ * Pure logic, no RTOS or driver dependency, so it also builds on the host (see host_test).
+ */
+typedef struct {
+    uint32_t output_num;                /*!< Number of output lines */
+    uint32_t input_num;                 /*!< Number of input lines */
+    uint8_t active_level;               /*!< Active level of the input lines */
+    uint32_t debounce_ticks;            /*!< Ticks a new level must be stable before it is accepted */
+    uint32_t key_pressed_num;           /*!< Number of debounced keys held */
+    bool settled;                       /*!< false if any key disagreed with its debounced level during the last tick */
+    /*!< Size: output_num * input_num * sizeof(uint8_t) */
+    uint8_t *button_level;
+    /*!< Size: output_num * input_num * sizeof(uint8_t) */
+    uint8_t *debounce_cnt;
+    /*!< Size: output_num * input_num * sizeof(keyboard_btn_data_t) */
+    keyboard_btn_data_t *key_data;
+    /*!< Size: output_num * input_num * sizeof(keyboard_btn_data_t) */
+    keyboard_btn_data_t *key_release_data;
+} kbd_scan_t;
+
+/**
+ * @brief Allocate the scan state
+ *
+ * @param scan Scan state to initialize
+ * @param output_num Number of output lines, at most 32
+ * @param input_num Number of input lines, at most 32
+ * @param active_level Active level of the input lines
+ * @param debounce_ticks Debounce time in ticks
+ * @return
+ *      - true on success
+ *      - false if the size is invalid or memory could not be allocated
+ */
+bool kbd_scan_init(kbd_scan_t *scan, uint32_t output_num, uint32_t input_num, uint8_t active_level, uint32_t debounce_ticks);
+
+/**
+ * @brief Free the scan state
+ *
+ * @param scan Scan state initialized with kbd_scan_init()
+ */
+void kbd_scan_deinit(kbd_scan_t *scan);
+
+/**
+ * @brief Scan the matrix once and debounce every key
+ *
+ * Drives each output active in turn, reads the inputs through the HAL and updates the pressed list.
+ *
+ * @param scan Scan state
+ * @param hal Matrix backend
+ * @param report Filled when the return value is not 0. The arrays point into the scan state and
+ *               stay valid until the next tick.
+ * @return KBD_SCAN_PRESSED and/or KBD_SCAN_RELEASED, 0 if no key changed
+ */
+uint32_t kbd_scan_tick(kbd_scan_t *scan, const kbd_matrix_hal_t *hal, keyboard_btn_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
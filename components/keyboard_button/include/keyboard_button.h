@@ -7,41 +7,13 @@
 
 #include "esp_err.h"
 #include "kbd_gpio.h"
+#include "keyboard_button_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/**
- * @brief Keyboard button event
- *
- */
-typedef enum {
-    KBD_EVENT_PRESSED = 0,            /*!< Report all currently pressed keys when a key is either pressed or released. */
-    KBD_EVENT_COMBINATION,            /*!< When the component buttons are pressed in sequence, report. */
-    KBD_EVENT_MAX,
-} keyboard_btn_event_t;
-
-/**
- * @brief keyboard button data
- *
- */
-typedef struct {
-    uint8_t output_index;             /*!< key position's output gpio number */
-    uint8_t input_index;              /*!< key position's input gpio number */
-} keyboard_btn_data_t;
-
-/**
- * @brief keyboard button report data
- *
- */
-typedef struct {
-    int key_change_num;                     /*!< Number of key changes */
-    uint32_t key_pressed_num;               /*!< Number of keys pressed */
-    uint32_t key_release_num;               /*!< Number of keys released */
-    keyboard_btn_data_t *key_data;          /*!< Array, contains key codes */
-    keyboard_btn_data_t *key_release_data;  /*!< Array, contains key codes */
-} keyboard_btn_report_t;
+#define KBD_COMBINATION_TERM_MS   50    /*!< Default time allowed between the presses of a combination */
 
 /**
  * @brief keyboard button event data
@@ -50,12 +22,13 @@ typedef struct {
 typedef union {
     /**
      * @brief combination event data
-     * eg: Set key_data = {(1,1), (2,2)} means
-     * that the button sequence is (1,1) -> (2,2)
+     * eg: Set key_data = {(1,1), (2,2)} means that
+     * (1,1) and (2,2) pressed within term_ms of each other, in either order, fire the event
      */
     struct combination_t {
         uint32_t key_num;                 /*!< Number of keys */
-        keyboard_btn_data_t *key_data;    /*!< Array, contains key codes by index. The button sequence is also provided through this */
+        keyboard_btn_data_t *key_data;    /*!< Array, contains key codes by index */
+        uint32_t term_ms;                 /*!< Time allowed between the first and the last press, 0 for KBD_COMBINATION_TERM_MS */
     } combination;                        /*!< combination event */
 } keyboard_btn_event_data_t;
 
@@ -179,6 +152,31 @@ esp_err_t keyboard_button_get_index_by_gpio(keyboard_btn_handle_t kbd_handle, ui
  */
 esp_err_t keyboard_button_get_gpio_by_index(keyboard_btn_handle_t kbd_handle, uint32_t index, kbd_gpio_mode_t gpio_mode, uint32_t *gpio_num);
 
+/**
+ * @brief Leave power save and run at least one more scan, as if a key had been pressed
+ *
+ * @note  Safe to call from any task. The keyboard task restarts the scan timer itself, the tick callbacks
+ *        then run on it again until power save is entered the next time.
+ * @param kbd_handle keyboard handle
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is invalid.
+ */
+esp_err_t keyboard_button_wake(keyboard_btn_handle_t kbd_handle);
+
+/**
+ * @brief Keep scanning with no key down, for callbacks that still have work to do on the tick event
+ *
+ * @note  Call it from a callback of the keyboard, on the keyboard task. Power save is entered again once
+ *        keep_awake is false and no key is down.
+ * @param kbd_handle keyboard handle
+ * @param keep_awake true to hold off power save
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is invalid.
+ */
+esp_err_t keyboard_button_keep_awake(keyboard_btn_handle_t kbd_handle, bool keep_awake);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Keyboard button event
+ *
+ */
+typedef enum {
+    KBD_EVENT_PRESSED = 0,            /*!< Report all currently pressed keys when a key is either pressed or released. */
+    KBD_EVENT_COMBINATION,            /*!< When the component buttons are pressed in sequence, report. */
+    KBD_EVENT_TICK,                   /*!< Report all currently pressed keys on every scan tick, changed or not. */
+    KBD_EVENT_MAX,
+} keyboard_btn_event_t;
+
+/**
+ * @brief keyboard button data
+ *
+ */
+typedef struct {
+    uint8_t output_index;             /*!< key position's output gpio number */
+    uint8_t input_index;              /*!< key position's input gpio number */
+} keyboard_btn_data_t;
+
+/**
+ * @brief keyboard button report data
+ *
+ */
+typedef struct {
+    int key_change_num;                     /*!< Number of key changes */
+    uint32_t key_pressed_num;               /*!< Number of keys pressed */
+    uint32_t key_release_num;               /*!< Number of keys released */
+    keyboard_btn_data_t *key_data;          /*!< Array, contains key codes */
+    keyboard_btn_data_t *key_release_data;  /*!< Array, contains key codes */
+} keyboard_btn_report_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -14,6 +14,9 @@
 #include "keyboard_button.h"
 #include "kbd_gpio.h"
 #include "kbd_gptimer.h"
+#include "kbd_scan.h"
+#include "kbd_combo.h"
+#include "kbd_latency.h"
 
 static const char *TAG = "keyboard_button";
 
@@ -23,6 +26,7 @@ static const char *TAG = "keyboard_button";
 #define KBD_TIMER_NOTIFY (1<<0)
 #define KBD_EXIT         (1<<1)
 #define KBD_EXIT_OK      (1<<2)
+#define KBD_WAKE         (1<<3)
 
 #define CALL_EVENT_CB(ev)                                                   \
     if (kbd->cb_info[ev]) {                                                 \
@@ -43,26 +47,24 @@ typedef struct keyboard_btn_t {
     int *output_gpios;
     int output_gpio_num;
     bool enable_power_save;
-    bool can_enter_power_save;
     EventGroupHandle_t event_group;
     gptimer_handle_t gptimer_handle;
     kbd_cb_info_t *cb_info[KBD_EVENT_MAX];
     size_t cb_size[KBD_EVENT_MAX];
     bool gptimer_start;
-    uint32_t debounce_ticks;
+    bool keep_awake;
     uint32_t ticks_interval;
-    uint32_t key_pressed_num;
-    uint8_t  active_level;
-    /*!< Size: output_gpio_num * sizeof(uint32_t) */
-    uint8_t *button_level;
-    /*!< Size: output_gpio_num * input_gpio_num * sizeof(uint8_t) */
-    uint8_t  *debounce_cnt;
-    /*!< Size: output_gpio_num * input_gpio_num * sizeof(keyboard_data_t) */
-    keyboard_btn_data_t *key_data;
-    /*!< Size: output_gpio_num * input_gpio_num * sizeof(keyboard_data_t) */
-    keyboard_btn_data_t *key_release_data;
+    kbd_gpio_matrix_t gpio_matrix;
+    kbd_matrix_hal_t hal;
+    kbd_scan_t scan;
+    kbd_combo_t combo;
 } keyboard_btn_t;
 
+typedef struct {
+    keyboard_btn_t *kbd;
+    keyboard_btn_report_t *report;
+} kbd_combo_ctx_t;
+
 static bool IRAM_ATTR kbd_gptimer_cb(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx)
 {
     keyboard_btn_t *kbd = (keyboard_btn_t *)user_ctx;
@@ -73,146 +75,105 @@ static bool IRAM_ATTR kbd_gptimer_cb(gptimer_handle_t timer, const gptimer_alarm
     return (xHigherPriorityTaskWoken == pdTRUE);
 }
 
+static void kbd_combo_fire(uint32_t combo_id, void *user_data)
+{
+    kbd_combo_ctx_t *ctx = (kbd_combo_ctx_t *)user_data;
+    kbd_cb_info_t *cb_info = &ctx->kbd->cb_info[KBD_EVENT_COMBINATION][combo_id];
+    cb_info->cb(ctx->kbd, *ctx->report, cb_info->user_data);
+}
+
 static inline void kbd_handler(keyboard_btn_t *kbd)
 {
-    bool key_change_inc_flag = false;
-    bool key_change_dec_flag = false;
-    uint32_t key_last_pressed_num = kbd->key_pressed_num;
-    uint32_t key_release_num = 0;
-    // Clear all output level
-    uint32_t output_level = kbd->active_level ? OUTPUT_MASK_LOW : OUTPUT_MASK_HIGE;
+    keyboard_btn_report_t report;
     if (kbd->enable_power_save) {
         kbd_gpios_set_hold_dis(kbd->output_gpios, kbd->output_gpio_num);
     }
-    kbd_gpios_set_level(kbd->output_gpios, kbd->output_gpio_num, output_level);
-
-    for (int i = 0; i < kbd->output_gpio_num; i++) {
-        /*!< Set the output level */
-        kbd_gpio_set_level(kbd->output_gpios[i], kbd->active_level ? 1 : 0);
-        /*!< Read the input level */
-        uint32_t input_level = kbd_gpios_read_level(kbd->input_gpios, kbd->input_gpio_num);
-        /*!< Clear the output level */
-        kbd_gpio_set_level(kbd->output_gpios[i], kbd->active_level ? 0 : 1);
-        for (int j = 0; j < kbd->input_gpio_num; j++) {
-            uint8_t currect_btn_num = i * kbd->input_gpio_num + j;
-            uint8_t read_gpio_level = (input_level >> j) & 0x01;
-            uint8_t button_level = kbd->active_level ? kbd->button_level[currect_btn_num] : !kbd->button_level[currect_btn_num];
-            if (read_gpio_level != button_level) {
-                kbd->can_enter_power_save = false;
-                if (++kbd->debounce_cnt[currect_btn_num] >= kbd->debounce_ticks) {
-                    kbd->debounce_cnt[currect_btn_num] = 0;
-                    kbd->button_level[currect_btn_num] = kbd->active_level ? read_gpio_level : !read_gpio_level;
-                    // Make a report
-                    if (kbd->button_level[currect_btn_num] == 1) {
-                        key_change_inc_flag = true;
-                        kbd->key_data[kbd->key_pressed_num].output_index = i;
-                        kbd->key_data[kbd->key_pressed_num].input_index = j;
-                        kbd->key_pressed_num++;
-                    } else {
-                        key_change_dec_flag = true;
-                        /*!< Remove kbd->key_data and move the data forward */
-                        for (int k = 0; k < kbd->key_pressed_num; k++) {
-                            if (kbd->key_data[k].output_index == i && kbd->key_data[k].input_index == j) {
-                                for (int l = k; l < kbd->key_pressed_num; l++) {
-                                    kbd->key_data[l] = kbd->key_data[l + 1];
-                                }
-                                break;
-                            }
-                        }
-                        kbd->key_pressed_num--;
-
-                        kbd->key_release_data[key_release_num].output_index = i;
-                        kbd->key_release_data[key_release_num].input_index = j;
-                        key_release_num++;
-                    }
-                }
-            } else {
-                kbd->debounce_cnt[currect_btn_num] = 0;
-            }
+    uint32_t changed = kbd_scan_tick(&kbd->scan, &kbd->hal, &report);
+    if (!changed) {
+        kbd_combo_tick(&kbd->combo, NULL, NULL, NULL);
+        /*!< Nothing changed, the tick event still counts the scan for time based consumers */
+        if (kbd->cb_info[KBD_EVENT_TICK]) {
+            report.key_change_num = 0;
+            report.key_pressed_num = kbd->scan.key_pressed_num;
+            report.key_release_num = 0;
+            report.key_data = kbd->scan.key_data;
+            report.key_release_data = kbd->scan.key_release_data;
+            CALL_EVENT_CB(KBD_EVENT_TICK);
         }
-
-    }
-
-    if (!(key_change_inc_flag || key_change_dec_flag)) {
         return;
     }
+    kbd_latency_scan_commit();
 
     /*!< Report the pressed event */
-    keyboard_btn_report_t report = {
-        .key_data = kbd->key_data,
-        .key_pressed_num = kbd->key_pressed_num,
-        .key_release_num = key_release_num,
-        .key_change_num = kbd->key_pressed_num - key_last_pressed_num,
-        .key_release_data = kbd->key_release_data
-    };
     CALL_EVENT_CB(KBD_EVENT_PRESSED);
+    CALL_EVENT_CB(KBD_EVENT_TICK);
 
-    /*!< Check the combination event */
-    if (key_change_inc_flag && kbd->cb_info[KBD_EVENT_COMBINATION]) {
-        for (int i = 0; i < kbd->cb_size[KBD_EVENT_COMBINATION]; i++) {
-            kbd_cb_info_t *cb_info = &kbd->cb_info[KBD_EVENT_COMBINATION][i];
-            keyboard_btn_data_t *combination_key_data = cb_info->event_data.combination.key_data;
-            uint8_t key_num = cb_info->event_data.combination.key_num;
-            if (key_num == kbd->key_pressed_num) {
-                uint8_t key_pressed = true;
-                for (int j = 0; j < key_num; j++) {
-                    if (combination_key_data[j].output_index != kbd->key_data[j].output_index ||
-                            combination_key_data[j].input_index != kbd->key_data[j].input_index) {
-                        key_pressed = false;
-                        break;
-                    }
-                }
+    /*!< Check the combination event, a press only looks at the combinations holding that key */
+    kbd_combo_ctx_t ctx = {
+        .kbd = kbd,
+        .report = &report,
+    };
+    kbd_combo_tick(&kbd->combo, &report, kbd_combo_fire, &ctx);
+}
 
-                if (key_pressed) {
-                    cb_info->cb(kbd, report, cb_info->user_data);
-                }
-            }
-        }
+/**
+ * @brief Rebuild the combination index from the registered combination callbacks
+ */
+static esp_err_t kbd_combo_rebuild(keyboard_btn_t *kbd)
+{
+    size_t num = kbd->cb_size[KBD_EVENT_COMBINATION];
+    kbd_combo_def_t *defs = NULL;
+    if (num) {
+        defs = calloc(num, sizeof(kbd_combo_def_t));
+        ESP_RETURN_ON_FALSE(defs, ESP_ERR_NO_MEM, TAG, "Failed to allocate memory for combination index");
     }
+    for (size_t i = 0; i < num; i++) {
+        struct combination_t *combination = &kbd->cb_info[KBD_EVENT_COMBINATION][i].event_data.combination;
+        uint32_t term_ms = combination->term_ms ? combination->term_ms : KBD_COMBINATION_TERM_MS;
+        defs[i].key_data = combination->key_data;
+        defs[i].key_num = combination->key_num;
+        defs[i].term_ticks = (term_ms * 1000 + kbd->ticks_interval - 1) / kbd->ticks_interval;
+    }
+    bool ok = kbd_combo_set(&kbd->combo, defs, num);
+    free(defs);
+    ESP_RETURN_ON_FALSE(ok, ESP_ERR_NO_MEM, TAG, "Failed to allocate memory for combination index");
+    return ESP_OK;
 }
 
-// TODO: Add to kconfig
-#define CONFIG_KEYBOARD_TEST_RUN_TIME 0
-
-#if CONFIG_KEYBOARD_TEST_RUN_TIME
-#include "esp_timer.h"
-#endif
-
 static void kbd_task(void *args)
 {
     keyboard_btn_t *kbd = (keyboard_btn_t *)args;
     EventBits_t uxBits;
     while (1) {
         /*!< Waiting for the notification */
-        uxBits = xEventGroupWaitBits(kbd->event_group, KBD_TIMER_NOTIFY | KBD_EXIT, pdTRUE, pdFALSE, portMAX_DELAY);
+        uxBits = xEventGroupWaitBits(kbd->event_group, KBD_TIMER_NOTIFY | KBD_EXIT | KBD_WAKE, pdTRUE, pdFALSE, portMAX_DELAY);
         if (uxBits & KBD_EXIT) {
             ESP_LOGI(TAG, "kbd task exit");
             break;
         }
+        if ((uxBits & KBD_WAKE) && kbd->enable_power_save) {
+            /*!< Leave power save, the interrupt is masked first so the ISR cannot start the timer as well */
+            kbd_gpios_intr_control(kbd->input_gpios, kbd->input_gpio_num, false);
+            if (!kbd->gptimer_start) {
+                ESP_LOGD(TAG, "Leave power save");
+                kbd_gptimer_start(kbd->gptimer_handle);
+                kbd->gptimer_start = true;
+            }
+        }
         if (uxBits & KBD_TIMER_NOTIFY) {
             /*!< Keyboard handler */
-#if CONFIG_KEYBOARD_TEST_RUN_TIME
-            uint64_t start_time = esp_timer_get_time();
-#endif
-            if (kbd->enable_power_save) {
-                kbd->can_enter_power_save = true;
-            }
+            kbd_latency_scan_start();
             kbd_handler(kbd);
-            if (kbd->enable_power_save && kbd->key_pressed_num == 0 && kbd->can_enter_power_save == true) {
+            kbd_latency_scan_end();
+            if (kbd->enable_power_save && kbd->scan.key_pressed_num == 0 && kbd->scan.settled && !kbd->keep_awake) {
                 /*!< Enter power save */
                 ESP_LOGD(TAG, "Enter power save");
                 kbd_gptimer_stop(kbd->gptimer_handle);
                 kbd->gptimer_start = false;
                 kbd_gpios_intr_control(kbd->input_gpios, kbd->input_gpio_num, true);
-                kbd_gpios_set_level(kbd->output_gpios, kbd->output_gpio_num, kbd->active_level ? OUTPUT_MASK_HIGE : OUTPUT_MASK_LOW);
+                kbd_gpios_set_level(kbd->output_gpios, kbd->output_gpio_num, kbd->scan.active_level ? OUTPUT_MASK_HIGE : OUTPUT_MASK_LOW);
                 kbd_gpios_set_hold_en(kbd->output_gpios, kbd->output_gpio_num);
             }
-
-#if CONFIG_KEYBOARD_TEST_RUN_TIME
-            uint64_t end_time = esp_timer_get_time();
-            uint64_t duration = end_time - start_time;
-            printf("Task duration: %llu microseconds\n", duration);
-#endif
         }
     }
     xEventGroupSetBits(kbd->event_group, KBD_EXIT_OK);
@@ -259,21 +220,18 @@ esp_err_t keyboard_button_create(keyboard_btn_config_t *kbd_cfg, keyboard_btn_ha
     kbd->input_gpio_num = kbd_cfg->input_gpio_num;
     memcpy(kbd->input_gpios, kbd_cfg->input_gpios, kbd_cfg->input_gpio_num * sizeof(int));
 
-    kbd->active_level = kbd_cfg->active_level ? 1 : 0;
-    kbd->debounce_ticks = kbd_cfg->debounce_ticks;
     kbd->ticks_interval = kbd_cfg->ticks_interval;
     kbd->enable_power_save = kbd_cfg->enable_power_save;
-    kbd->button_level = calloc(kbd->output_gpio_num * kbd->input_gpio_num, sizeof(uint8_t));
-    ESP_GOTO_ON_FALSE(kbd->button_level, ESP_ERR_NO_MEM, exit, TAG, "Failed to allocate memory for button level");
-
-    kbd->debounce_cnt = calloc(kbd->output_gpio_num * kbd->input_gpio_num, sizeof(uint8_t));
-    ESP_GOTO_ON_FALSE(kbd->debounce_cnt, ESP_ERR_NO_MEM, exit, TAG, "Failed to allocate memory for debounce count");
-
-    kbd->key_data = calloc(kbd->output_gpio_num * kbd->input_gpio_num, sizeof(keyboard_btn_data_t));
-    ESP_GOTO_ON_FALSE(kbd->key_data, ESP_ERR_NO_MEM, exit, TAG, "Failed to allocate memory for key data");
+    bool scan_ok = kbd_scan_init(&kbd->scan, kbd->output_gpio_num, kbd->input_gpio_num, kbd_cfg->active_level, kbd_cfg->debounce_ticks);
+    ESP_GOTO_ON_FALSE(scan_ok, ESP_ERR_NO_MEM, exit, TAG, "Failed to allocate memory for the scan state");
+    bool combo_ok = kbd_combo_init(&kbd->combo, kbd->output_gpio_num, kbd->input_gpio_num);
+    ESP_GOTO_ON_FALSE(combo_ok, ESP_ERR_NO_MEM, exit, TAG, "Failed to allocate memory for the combination state");
 
-    kbd->key_release_data = calloc(kbd->output_gpio_num * kbd->input_gpio_num, sizeof(keyboard_btn_data_t));
-    ESP_GOTO_ON_FALSE(kbd->key_release_data, ESP_ERR_NO_MEM, exit, TAG, "Failed to allocate memory for key release data");
+    kbd->gpio_matrix.output_gpios = kbd->output_gpios;
+    kbd->gpio_matrix.output_gpio_num = kbd->output_gpio_num;
+    kbd->gpio_matrix.input_gpios = kbd->input_gpios;
+    kbd->gpio_matrix.input_gpio_num = kbd->input_gpio_num;
+    kbd_gpio_matrix_hal(&kbd->gpio_matrix, &kbd->hal);
 
     kbd_gpio_config_t gpio_cfg = {0};
     gpio_cfg.gpios = kbd_cfg->input_gpios;
@@ -317,7 +275,7 @@ esp_err_t keyboard_button_create(keyboard_btn_config_t *kbd_cfg, keyboard_btn_ha
     }
 
     if (kbd_cfg->enable_power_save) {
-        kbd_gpios_set_intr(kbd->input_gpios, kbd->input_gpio_num, kbd->active_level == 0 ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL, kbd_power_save_isr_handler, (void *)kbd);
+        kbd_gpios_set_intr(kbd->input_gpios, kbd->input_gpio_num, kbd->scan.active_level == 0 ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL, kbd_power_save_isr_handler, (void *)kbd);
     }
 
     /*!< Create a task */
@@ -329,18 +287,8 @@ esp_err_t keyboard_button_create(keyboard_btn_config_t *kbd_cfg, keyboard_btn_ha
 
 exit:
     if (kbd) {
-        if (kbd->button_level) {
-            free(kbd->button_level);
-        }
-        if (kbd->debounce_cnt) {
-            free(kbd->debounce_cnt);
-        }
-        if (kbd->key_data) {
-            free(kbd->key_data);
-        }
-        if (kbd->key_release_data) {
-            free(kbd->key_release_data);
-        }
+        kbd_scan_deinit(&kbd->scan);
+        kbd_combo_deinit(&kbd->combo);
         if (kbd->input_gpios) {
             free(kbd->input_gpios);
         }
@@ -369,18 +317,8 @@ esp_err_t keyboard_button_delete(keyboard_btn_handle_t kbd_handle)
 
     kbd_gpio_deinit(kbd->input_gpios, kbd->input_gpio_num);
     kbd_gpio_deinit(kbd->output_gpios, kbd->output_gpio_num);
-    if (kbd->button_level) {
-        free(kbd->button_level);
-    }
-    if (kbd->debounce_cnt) {
-        free(kbd->debounce_cnt);
-    }
-    if (kbd->key_data) {
-        free(kbd->key_data);
-    }
-    if (kbd->key_release_data) {
-        free(kbd->key_release_data);
-    }
+    kbd_scan_deinit(&kbd->scan);
+    kbd_combo_deinit(&kbd->combo);
     if (kbd->input_gpios) {
         free(kbd->input_gpios);
     }
@@ -401,6 +339,24 @@ esp_err_t keyboard_button_delete(keyboard_btn_handle_t kbd_handle)
     return ESP_OK;
 }
 
+esp_err_t keyboard_button_wake(keyboard_btn_handle_t kbd_handle)
+{
+    ESP_RETURN_ON_FALSE(kbd_handle, ESP_ERR_INVALID_ARG, TAG, "Keyboard handle cannot be NULL");
+
+    keyboard_btn_t *kbd = (keyboard_btn_t *)kbd_handle;
+    xEventGroupSetBits(kbd->event_group, KBD_WAKE);
+    return ESP_OK;
+}
+
+esp_err_t keyboard_button_keep_awake(keyboard_btn_handle_t kbd_handle, bool keep_awake)
+{
+    ESP_RETURN_ON_FALSE(kbd_handle, ESP_ERR_INVALID_ARG, TAG, "Keyboard handle cannot be NULL");
+
+    keyboard_btn_t *kbd = (keyboard_btn_t *)kbd_handle;
+    kbd->keep_awake = keep_awake;
+    return ESP_OK;
+}
+
 esp_err_t keyboard_button_register_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_cb_config_t cb_cfg, keyboard_btn_cb_handle_t *rtn_cb_hdl)
 {
     ESP_RETURN_ON_FALSE(kbd_handle, ESP_ERR_INVALID_ARG, TAG, "Keyboard handle cannot be NULL");
@@ -410,6 +366,16 @@ esp_err_t keyboard_button_register_cb(keyboard_btn_handle_t kbd_handle, keyboard
     keyboard_btn_t *kbd = (keyboard_btn_t *)kbd_handle;
     keyboard_btn_event_t event = cb_cfg.event;
 
+    if (event == KBD_EVENT_COMBINATION) {
+        ESP_RETURN_ON_FALSE(cb_cfg.event_data.combination.key_num && cb_cfg.event_data.combination.key_data,
+                            ESP_ERR_INVALID_ARG, TAG, "Combination needs keys");
+        for (int i = 0; i < cb_cfg.event_data.combination.key_num; i++) {
+            keyboard_btn_data_t *key = &cb_cfg.event_data.combination.key_data[i];
+            ESP_RETURN_ON_FALSE(key->output_index < kbd->output_gpio_num && key->input_index < kbd->input_gpio_num,
+                                ESP_ERR_INVALID_ARG, TAG, "Combination key outside the matrix");
+        }
+    }
+
     /*!< Expand the event dynamic array. */
     if (!kbd->cb_info[event]) {
         kbd->cb_info[event] = calloc(1, sizeof(kbd_cb_info_t));
@@ -432,6 +398,8 @@ esp_err_t keyboard_button_register_cb(keyboard_btn_handle_t kbd_handle, keyboard
         cb_info->event_data.combination.key_data = calloc(cb_cfg.event_data.combination.key_num, sizeof(keyboard_btn_data_t));
         ESP_RETURN_ON_FALSE(cb_info->event_data.combination.key_data, ESP_ERR_NO_MEM, TAG, "Failed to allocate memory for combination key data");
         memcpy(cb_info->event_data.combination.key_data, cb_cfg.event_data.combination.key_data, cb_cfg.event_data.combination.key_num * sizeof(keyboard_btn_data_t));
+        cb_info->event_data.combination.term_ms = cb_cfg.event_data.combination.term_ms;
+        ESP_RETURN_ON_ERROR(kbd_combo_rebuild(kbd), TAG, "Failed to index the combination");
     }
 
     if (rtn_cb_hdl) {
@@ -488,6 +456,11 @@ esp_err_t keyboard_button_unregister_cb(keyboard_btn_handle_t kbd_handle, keyboa
         kbd->cb_info[event] = NULL;
         kbd->cb_size[event] = 0;
     }
+
+    if (event == KBD_EVENT_COMBINATION) {
+        /*!< Combination ids are array indexes, they moved */
+        ESP_RETURN_ON_ERROR(kbd_combo_rebuild(kbd), TAG, "Failed to index the combinations");
+    }
     return ESP_OK;
 }
 
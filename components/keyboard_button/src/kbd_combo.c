@@ -0,0 +1,184 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "kbd_combo.h"
+
+static inline uint32_t kbd_combo_pos(const kbd_combo_t *combo, const keyboard_btn_data_t *key)
+{
+    return key->output_index * combo->input_num + key->input_index;
+}
+
+static inline bool kbd_combo_in_matrix(const kbd_combo_t *combo, const keyboard_btn_data_t *key)
+{
+    return key->output_index < combo->output_num && key->input_index < combo->input_num;
+}
+
+static void kbd_combo_clear(kbd_combo_t *combo)
+{
+    free(combo->combo_bits);
+    free(combo->combo_term);
+    free(combo->index_start);
+    free(combo->index);
+    combo->combo_bits = NULL;
+    combo->combo_term = NULL;
+    combo->index_start = NULL;
+    combo->index = NULL;
+    combo->combo_num = 0;
+}
+
+bool kbd_combo_init(kbd_combo_t *combo, uint32_t output_num, uint32_t input_num)
+{
+    if (!combo || output_num == 0 || input_num == 0) {
+        return false;
+    }
+
+    memset(combo, 0, sizeof(kbd_combo_t));
+    combo->output_num = output_num;
+    combo->input_num = input_num;
+    combo->word_num = (output_num * input_num + 31) / 32;
+    combo->pressed = calloc(combo->word_num, sizeof(uint32_t));
+    combo->press_tick = calloc(output_num * input_num, sizeof(uint32_t));
+    if (!combo->pressed || !combo->press_tick) {
+        kbd_combo_deinit(combo);
+        return false;
+    }
+    return true;
+}
+
+void kbd_combo_deinit(kbd_combo_t *combo)
+{
+    kbd_combo_clear(combo);
+    free(combo->pressed);
+    free(combo->press_tick);
+    combo->pressed = NULL;
+    combo->press_tick = NULL;
+}
+
+bool kbd_combo_set(kbd_combo_t *combo, const kbd_combo_def_t *defs, uint32_t def_num)
+{
+    kbd_combo_clear(combo);
+    if (def_num == 0) {
+        return true;
+    }
+
+    uint32_t key_num = combo->output_num * combo->input_num;
+    combo->combo_bits = calloc(def_num * combo->word_num, sizeof(uint32_t));
+    combo->combo_term = calloc(def_num, sizeof(uint32_t));
+    combo->index_start = calloc(key_num + 1, sizeof(uint32_t));
+    if (!combo->combo_bits || !combo->combo_term || !combo->index_start) {
+        kbd_combo_clear(combo);
+        return false;
+    }
+
+    /*!< Bitset of every combination, a key listed twice is counted once */
+    for (uint32_t c = 0; c < def_num; c++) {
+        uint32_t *bits = &combo->combo_bits[c * combo->word_num];
+        for (uint32_t k = 0; k < defs[c].key_num; k++) {
+            if (!kbd_combo_in_matrix(combo, &defs[c].key_data[k])) {
+                kbd_combo_clear(combo);
+                return false;
+            }
+            uint32_t pos = kbd_combo_pos(combo, &defs[c].key_data[k]);
+            bits[pos / 32] |= 1u << (pos % 32);
+        }
+        combo->combo_term[c] = defs[c].term_ticks;
+    }
+
+    /*!< Count the combinations of every position, then fill the index in combination order */
+    for (uint32_t c = 0; c < def_num; c++) {
+        const uint32_t *bits = &combo->combo_bits[c * combo->word_num];
+        for (uint32_t w = 0; w < combo->word_num; w++) {
+            for (uint32_t word = bits[w]; word; word &= word - 1) {
+                combo->index_start[w * 32 + __builtin_ctz(word) + 1]++;
+            }
+        }
+    }
+    for (uint32_t pos = 0; pos < key_num; pos++) {
+        combo->index_start[pos + 1] += combo->index_start[pos];
+    }
+    combo->index = calloc(combo->index_start[key_num] ? combo->index_start[key_num] : 1, sizeof(uint32_t));
+    uint32_t *fill = calloc(key_num, sizeof(uint32_t));
+    if (!combo->index || !fill) {
+        free(fill);
+        kbd_combo_clear(combo);
+        return false;
+    }
+    for (uint32_t c = 0; c < def_num; c++) {
+        const uint32_t *bits = &combo->combo_bits[c * combo->word_num];
+        for (uint32_t w = 0; w < combo->word_num; w++) {
+            for (uint32_t word = bits[w]; word; word &= word - 1) {
+                uint32_t pos = w * 32 + __builtin_ctz(word);
+                combo->index[combo->index_start[pos] + fill[pos]++] = c;
+            }
+        }
+    }
+    free(fill);
+    combo->combo_num = def_num;
+    return true;
+}
+
+/**
+ * @brief Whether every key of a combination is down and went down within its term
+ */
+static bool kbd_combo_complete(const kbd_combo_t *combo, uint32_t combo_id)
+{
+    const uint32_t *bits = &combo->combo_bits[combo_id * combo->word_num];
+    for (uint32_t w = 0; w < combo->word_num; w++) {
+        if (bits[w] & ~combo->pressed[w]) {
+            return false;
+        }
+    }
+    uint32_t term = combo->combo_term[combo_id];
+    for (uint32_t w = 0; w < combo->word_num; w++) {
+        for (uint32_t word = bits[w]; word; word &= word - 1) {
+            uint32_t pos = w * 32 + __builtin_ctz(word);
+            if (combo->tick - combo->press_tick[pos] > term) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void kbd_combo_tick(kbd_combo_t *combo, const keyboard_btn_report_t *report, kbd_combo_fire_t fire, void *user_data)
+{
+    combo->tick++;
+    if (!report) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < report->key_release_num; i++) {
+        if (kbd_combo_in_matrix(combo, &report->key_release_data[i])) {
+            uint32_t pos = kbd_combo_pos(combo, &report->key_release_data[i]);
+            combo->pressed[pos / 32] &= ~(1u << (pos % 32));
+        }
+    }
+
+    /*!< New presses are the keys not down before, kbd_scan appends them to key_data */
+    for (uint32_t i = 0; i < report->key_pressed_num; i++) {
+        if (!kbd_combo_in_matrix(combo, &report->key_data[i])) {
+            continue;
+        }
+        uint32_t pos = kbd_combo_pos(combo, &report->key_data[i]);
+        uint32_t bit = 1u << (pos % 32);
+        if (combo->pressed[pos / 32] & bit) {
+            continue;
+        }
+        combo->pressed[pos / 32] |= bit;
+        combo->press_tick[pos] = combo->tick;
+        if (combo->combo_num == 0) {
+            continue;
+        }
+
+        for (uint32_t n = combo->index_start[pos]; n < combo->index_start[pos + 1]; n++) {
+            if (kbd_combo_complete(combo, combo->index[n])) {
+                fire(combo->index[n], user_data);
+            }
+        }
+    }
+}
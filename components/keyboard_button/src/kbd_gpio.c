@@ -130,4 +130,30 @@ esp_err_t kbd_gpios_intr_control(const int *gpios, uint32_t gpio_num, bool enabl
     return ESP_OK;
 }
 
+static void kbd_gpio_matrix_set_output_level(void *ctx, uint32_t index, uint32_t level)
+{
+    kbd_gpio_matrix_t *matrix = (kbd_gpio_matrix_t *)ctx;
+    gpio_set_level(matrix->output_gpios[index], level);
+}
+
+static void kbd_gpio_matrix_set_outputs_level(void *ctx, uint32_t level_mask)
+{
+    kbd_gpio_matrix_t *matrix = (kbd_gpio_matrix_t *)ctx;
+    kbd_gpios_set_level(matrix->output_gpios, matrix->output_gpio_num, level_mask);
+}
+
+static uint32_t kbd_gpio_matrix_read_inputs_level(void *ctx)
+{
+    kbd_gpio_matrix_t *matrix = (kbd_gpio_matrix_t *)ctx;
+    return kbd_gpios_read_level(matrix->input_gpios, matrix->input_gpio_num);
+}
+
+void kbd_gpio_matrix_hal(kbd_gpio_matrix_t *matrix, kbd_matrix_hal_t *hal)
+{
+    hal->set_output_level = kbd_gpio_matrix_set_output_level;
+    hal->set_outputs_level = kbd_gpio_matrix_set_outputs_level;
+    hal->read_inputs_level = kbd_gpio_matrix_read_inputs_level;
+    hal->ctx = matrix;
+}
+
 // TODO:  uint32_t kbd_dedicated_gpio_read_level(void *bundle)
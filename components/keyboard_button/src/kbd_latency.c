@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_KEYBOARD_LATENCY_STATS
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "kbd_latency.h"
+
+#define KBD_LATENCY_INFLIGHT_NUM    8   /*!< Reports the transports can hold at once */
+
+typedef struct {
+    bool timed;                 /*!< false for reports that did not come from a measured callback */
+    uint32_t front_ns;          /*!< Scan start to callback entry */
+    int64_t callback_us;        /*!< esp_timer at callback entry */
+    int64_t enqueue_us;         /*!< esp_timer at the hand-off */
+} kbd_latency_inflight_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static kbd_latency_hist_t s_hist[KBD_LATENCY_MAX];
+
+/*!< Written by the scan task only */
+static uint32_t s_scan_start_cycles;
+static uint32_t s_commit_cycles;
+static bool s_committed;
+
+/*!< Set at callback entry, consumed by the first hand-off */
+static bool s_pending;
+static uint32_t s_pending_front_ns;
+static int64_t s_pending_callback_us;
+
+static kbd_latency_inflight_t s_inflight[KBD_LATENCY_INFLIGHT_NUM];
+static uint32_t s_inflight_head;
+static uint32_t s_inflight_num;
+
+static const char *const s_span_names[KBD_LATENCY_MAX] = {
+    [KBD_LATENCY_SCAN] = "scan",
+    [KBD_LATENCY_DEBOUNCE] = "debounce",
+    [KBD_LATENCY_DISPATCH] = "dispatch",
+    [KBD_LATENCY_ENQUEUE] = "enqueue",
+    [KBD_LATENCY_TRANSPORT] = "transport",
+    [KBD_LATENCY_TOTAL] = "total",
+};
+
+static inline uint32_t cycles_to_ns(uint32_t cycles)
+{
+    /*!< The tick rate follows DFS, read it at the time of the sample */
+    return (uint32_t)((uint64_t)cycles * 1000 / esp_rom_get_cpu_ticks_per_us());
+}
+
+static inline uint32_t us_to_ns(int64_t us)
+{
+    return us >= UINT32_MAX / 1000 ? UINT32_MAX : (uint32_t)(us * 1000);
+}
+
+/**
+ * @brief Add a sample, must be called inside s_lock
+ */
+static void hist_add(kbd_latency_span_t span, uint32_t ns)
+{
+    kbd_latency_hist_t *hist = &s_hist[span];
+    uint32_t bucket = 0;
+    if (ns >> (KBD_LATENCY_BUCKET_SHIFT + 1)) {
+        bucket = 31 - __builtin_clz(ns) - KBD_LATENCY_BUCKET_SHIFT;
+        if (bucket >= KBD_LATENCY_BUCKET_NUM) {
+            bucket = KBD_LATENCY_BUCKET_NUM - 1;
+        }
+    }
+    hist->bucket[bucket]++;
+    if (hist->count == 0 || ns < hist->min_ns) {
+        hist->min_ns = ns;
+    }
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+    hist->sum_ns += ns;
+    hist->count++;
+}
+
+void kbd_latency_scan_start(void)
+{
+    s_scan_start_cycles = esp_cpu_get_cycle_count();
+    s_committed = false;
+}
+
+void kbd_latency_scan_commit(void)
+{
+    s_commit_cycles = esp_cpu_get_cycle_count();
+    s_committed = true;
+    taskENTER_CRITICAL(&s_lock);
+    hist_add(KBD_LATENCY_DEBOUNCE, cycles_to_ns(s_commit_cycles - s_scan_start_cycles));
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_scan_end(void)
+{
+    uint32_t ns = cycles_to_ns(esp_cpu_get_cycle_count() - s_scan_start_cycles);
+    s_committed = false;
+    taskENTER_CRITICAL(&s_lock);
+    hist_add(KBD_LATENCY_SCAN, ns);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_callback_entry(void)
+{
+    if (!s_committed) {
+        return;
+    }
+    uint32_t now_cycles = esp_cpu_get_cycle_count();
+    int64_t now_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    hist_add(KBD_LATENCY_DISPATCH, cycles_to_ns(now_cycles - s_commit_cycles));
+    s_pending = true;
+    s_pending_front_ns = cycles_to_ns(now_cycles - s_scan_start_cycles);
+    s_pending_callback_us = now_us;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_report_enqueue(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    if (s_inflight_num == KBD_LATENCY_INFLIGHT_NUM) {
+        /*!< Completions went missing, start over rather than pairing the wrong reports */
+        s_inflight_num = 0;
+    }
+    kbd_latency_inflight_t *entry = &s_inflight[(s_inflight_head + s_inflight_num) % KBD_LATENCY_INFLIGHT_NUM];
+    s_inflight_num++;
+    entry->timed = s_pending;
+    entry->front_ns = s_pending_front_ns;
+    entry->callback_us = s_pending_callback_us;
+    entry->enqueue_us = now_us;
+    if (s_pending) {
+        hist_add(KBD_LATENCY_ENQUEUE, us_to_ns(now_us - s_pending_callback_us));
+        s_pending = false;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static bool inflight_pop(kbd_latency_inflight_t *entry)
+{
+    if (s_inflight_num == 0) {
+        return false;
+    }
+    *entry = s_inflight[s_inflight_head];
+    s_inflight_head = (s_inflight_head + 1) % KBD_LATENCY_INFLIGHT_NUM;
+    s_inflight_num--;
+    return true;
+}
+
+void kbd_latency_report_done(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    kbd_latency_inflight_t entry;
+    taskENTER_CRITICAL(&s_lock);
+    if (inflight_pop(&entry) && entry.timed) {
+        hist_add(KBD_LATENCY_TRANSPORT, us_to_ns(now_us - entry.enqueue_us));
+        uint64_t total_ns = (uint64_t)entry.front_ns + us_to_ns(now_us - entry.callback_us);
+        hist_add(KBD_LATENCY_TOTAL, total_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)total_ns);
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_report_dropped(void)
+{
+    kbd_latency_inflight_t entry;
+    taskENTER_CRITICAL(&s_lock);
+    inflight_pop(&entry);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_reports_clear(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_inflight_num = 0;
+    s_pending = false;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_get(kbd_latency_span_t span, kbd_latency_hist_t *hist)
+{
+    if (span >= KBD_LATENCY_MAX || hist == NULL) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    *hist = s_hist[span];
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void kbd_latency_reset(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    memset(s_hist, 0, sizeof(s_hist));
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Upper bound of the bucket holding the given fraction of the samples
+ */
+static uint32_t hist_percentile_ns(const kbd_latency_hist_t *hist, uint32_t percent)
+{
+    uint64_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < KBD_LATENCY_BUCKET_NUM - 1; i++) {
+        seen += hist->bucket[i];
+        if (seen >= target) {
+            uint32_t bound = 1UL << (i + KBD_LATENCY_BUCKET_SHIFT + 1);
+            return bound < hist->max_ns ? bound : hist->max_ns;
+        }
+    }
+    return hist->max_ns;
+}
+
+void kbd_latency_print(void)
+{
+    printf("%-10s %8s %10s %10s %10s %10s %10s (us)\n", "span", "count", "min", "mean", "p50<=", "p99<=", "max");
+    for (int span = 0; span < KBD_LATENCY_MAX; span++) {
+        kbd_latency_hist_t hist;
+        kbd_latency_get(span, &hist);
+        if (hist.count == 0) {
+            printf("%-10s %8d\n", s_span_names[span], 0);
+            continue;
+        }
+        printf("%-10s %8lu %10.1f %10.1f %10.1f %10.1f %10.1f\n", s_span_names[span], (unsigned long)hist.count,
+               hist.min_ns / 1000.0, (double)hist.sum_ns / hist.count / 1000.0,
+               hist_percentile_ns(&hist, 50) / 1000.0, hist_percentile_ns(&hist, 99) / 1000.0,
+               hist.max_ns / 1000.0);
+    }
+
+    /*!< Raw buckets for scripts: bucket 0 is < 512 ns, bucket N is [2^(N+8), 2^(N+9)) ns */
+    for (int span = 0; span < KBD_LATENCY_MAX; span++) {
+        kbd_latency_hist_t hist;
+        kbd_latency_get(span, &hist);
+        printf("buckets,%s", s_span_names[span]);
+        for (int i = 0; i < KBD_LATENCY_BUCKET_NUM; i++) {
+            printf(",%lu", (unsigned long)hist.bucket[i]);
+        }
+        printf("\n");
+    }
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "kbd_matrix_sim.h"
+
+#define KBD_SIM_SCRIPT_MIN_CAPACITY 64
+
+void kbd_sim_script_free(kbd_sim_script_t *script)
+{
+    free(script->edges);
+    script->edges = NULL;
+    script->edge_num = 0;
+    script->capacity = 0;
+}
+
+bool kbd_sim_script_add(kbd_sim_script_t *script, const kbd_sim_edge_t *edge)
+{
+    if (script->edge_num == script->capacity) {
+        size_t capacity = script->capacity ? script->capacity * 2 : KBD_SIM_SCRIPT_MIN_CAPACITY;
+        kbd_sim_edge_t *p = realloc(script->edges, capacity * sizeof(kbd_sim_edge_t));
+        if (!p) {
+            return false;
+        }
+        script->edges = p;
+        script->capacity = capacity;
+    }
+    script->edges[script->edge_num++] = *edge;
+    return true;
+}
+
+static uint32_t kbd_sim_rand(uint32_t *state)
+{
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+/**
+ * @brief Append a contact change to `closed`, preceded by bounce if requested
+ *
+ * The contact first reaches `closed` at time_ns, flips back and forth `transitions` times
+ * and settles at time_ns + duration_ns.
+ */
+static bool kbd_sim_script_edge(kbd_sim_script_t *script, uint8_t output_index, uint8_t input_index,
+                                uint64_t time_ns, uint8_t closed, const kbd_sim_bounce_t *bounce)
+{
+    kbd_sim_edge_t edge = {
+        .time_ns = time_ns,
+        .output_index = output_index,
+        .input_index = input_index,
+        .closed = closed,
+    };
+    if (!kbd_sim_script_add(script, &edge)) {
+        return false;
+    }
+    if (!bounce || bounce->transitions == 0 || bounce->duration_ns == 0) {
+        return true;
+    }
+
+    uint32_t state = bounce->seed ^ ((uint32_t)output_index << 8) ^ input_index ^ (uint32_t)time_ns;
+    uint32_t edge_num = bounce->transitions * 2;
+    uint64_t slot_ns = bounce->duration_ns / edge_num;
+    for (uint32_t k = 1; k <= edge_num; k++) {
+        if (k == edge_num) {
+            edge.time_ns = time_ns + bounce->duration_ns;
+        } else {
+            uint64_t jitter = slot_ns ? kbd_sim_rand(&state) % slot_ns : 0;
+            edge.time_ns = time_ns + slot_ns * k + jitter;
+        }
+        edge.closed = (k & 0x01) ? !closed : closed;
+        if (!kbd_sim_script_add(script, &edge)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool kbd_sim_script_press(kbd_sim_script_t *script, uint8_t output_index, uint8_t input_index,
+                          uint64_t press_ns, uint64_t release_ns, const kbd_sim_bounce_t *bounce)
+{
+    return kbd_sim_script_edge(script, output_index, input_index, press_ns, 1, bounce) &&
+           kbd_sim_script_edge(script, output_index, input_index, release_ns, 0, bounce);
+}
+
+bool kbd_sim_script_chatter(kbd_sim_script_t *script, uint8_t output_index, uint8_t input_index,
+                            uint64_t time_ns, uint64_t width_ns, uint8_t closed)
+{
+    return kbd_sim_script_edge(script, output_index, input_index, time_ns, closed ? 1 : 0, NULL) &&
+           kbd_sim_script_edge(script, output_index, input_index, time_ns + width_ns, closed ? 0 : 1, NULL);
+}
+
+void kbd_sim_script_sort(kbd_sim_script_t *script)
+{
+    // Insertion sort: stable, and recorded traces are already almost in order
+    for (size_t i = 1; i < script->edge_num; i++) {
+        kbd_sim_edge_t edge = script->edges[i];
+        size_t j = i;
+        while (j > 0 && script->edges[j - 1].time_ns > edge.time_ns) {
+            script->edges[j] = script->edges[j - 1];
+            j--;
+        }
+        script->edges[j] = edge;
+    }
+}
+
+void kbd_matrix_sim_init(kbd_matrix_sim_t *sim, uint32_t output_num, uint32_t input_num, uint8_t active_level,
+                         bool has_diodes, const kbd_sim_script_t *script)
+{
+    memset(sim, 0, sizeof(kbd_matrix_sim_t));
+    sim->output_num = output_num > KBD_SIM_MAX_LINES ? KBD_SIM_MAX_LINES : output_num;
+    sim->input_num = input_num > KBD_SIM_MAX_LINES ? KBD_SIM_MAX_LINES : input_num;
+    sim->active_level = active_level ? 1 : 0;
+    sim->has_diodes = has_diodes;
+    sim->script = script;
+    sim->output_level = sim->active_level ? 0 : 0xFFFFFFFF;
+}
+
+void kbd_matrix_sim_advance(kbd_matrix_sim_t *sim, uint64_t now_ns)
+{
+    sim->now_ns = now_ns;
+    if (!sim->script) {
+        return;
+    }
+    while (sim->next_edge < sim->script->edge_num && sim->script->edges[sim->next_edge].time_ns <= now_ns) {
+        const kbd_sim_edge_t *edge = &sim->script->edges[sim->next_edge++];
+        if (edge->output_index >= sim->output_num || edge->input_index >= sim->input_num) {
+            continue;
+        }
+        if (edge->closed) {
+            sim->contact[edge->output_index] |= 1u << edge->input_index;
+        } else {
+            sim->contact[edge->output_index] &= ~(1u << edge->input_index);
+        }
+    }
+}
+
+uint64_t kbd_matrix_sim_next_edge(const kbd_matrix_sim_t *sim)
+{
+    if (!sim->script || sim->next_edge >= sim->script->edge_num) {
+        return UINT64_MAX;
+    }
+    return sim->script->edges[sim->next_edge].time_ns;
+}
+
+static void kbd_matrix_sim_set_output_level(void *ctx, uint32_t index, uint32_t level)
+{
+    kbd_matrix_sim_t *sim = (kbd_matrix_sim_t *)ctx;
+    if (level) {
+        sim->output_level |= 1u << index;
+    } else {
+        sim->output_level &= ~(1u << index);
+    }
+}
+
+static void kbd_matrix_sim_set_outputs_level(void *ctx, uint32_t level_mask)
+{
+    kbd_matrix_sim_t *sim = (kbd_matrix_sim_t *)ctx;
+    sim->output_level = level_mask;
+}
+
+static uint32_t kbd_matrix_sim_read_inputs_level(void *ctx)
+{
+    kbd_matrix_sim_t *sim = (kbd_matrix_sim_t *)ctx;
+    uint32_t input_mask = sim->input_num == 32 ? 0xFFFFFFFF : (1u << sim->input_num) - 1;
+
+    uint32_t active_rows = 0;
+    for (uint32_t i = 0; i < sim->output_num; i++) {
+        if (((sim->output_level >> i) & 0x01) == sim->active_level) {
+            active_rows |= 1u << i;
+        }
+    }
+
+    uint32_t active_cols = 0;
+    for (uint32_t i = 0; i < sim->output_num; i++) {
+        if (active_rows & (1u << i)) {
+            active_cols |= sim->contact[i];
+        }
+    }
+
+    if (!sim->has_diodes) {
+        /*!< Without diodes current also flows backwards through closed keys: every row that shares a
+             closed key with an active column becomes active too, until nothing changes. Idle rows
+             are treated as high impedance. */
+        uint32_t last_cols;
+        do {
+            last_cols = active_cols;
+            for (uint32_t i = 0; i < sim->output_num; i++) {
+                if (sim->contact[i] & active_cols) {
+                    active_cols |= sim->contact[i];
+                }
+            }
+        } while (active_cols != last_cols);
+    }
+
+    active_cols &= input_mask;
+    return sim->active_level ? active_cols : (~active_cols & input_mask);
+}
+
+void kbd_matrix_sim_hal(kbd_matrix_sim_t *sim, kbd_matrix_hal_t *hal)
+{
+    hal->set_output_level = kbd_matrix_sim_set_output_level;
+    hal->set_outputs_level = kbd_matrix_sim_set_outputs_level;
+    hal->read_inputs_level = kbd_matrix_sim_read_inputs_level;
+    hal->ctx = sim;
+}
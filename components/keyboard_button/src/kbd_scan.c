@@ -0,0 +1,119 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "kbd_scan.h"
+
+#define OUTPUT_MASK_HIGE 0xFFFFFFFF
+#define OUTPUT_MASK_LOW  0x00000000
+
+#define KBD_SCAN_MAX_LINES 32
+
+bool kbd_scan_init(kbd_scan_t *scan, uint32_t output_num, uint32_t input_num, uint8_t active_level, uint32_t debounce_ticks)
+{
+    if (!scan || output_num == 0 || input_num == 0 || output_num > KBD_SCAN_MAX_LINES || input_num > KBD_SCAN_MAX_LINES) {
+        return false;
+    }
+
+    memset(scan, 0, sizeof(kbd_scan_t));
+    scan->output_num = output_num;
+    scan->input_num = input_num;
+    scan->active_level = active_level ? 1 : 0;
+    scan->debounce_ticks = debounce_ticks;
+    scan->settled = true;
+
+    uint32_t key_num = output_num * input_num;
+    scan->button_level = calloc(key_num, sizeof(uint8_t));
+    scan->debounce_cnt = calloc(key_num, sizeof(uint8_t));
+    scan->key_data = calloc(key_num, sizeof(keyboard_btn_data_t));
+    scan->key_release_data = calloc(key_num, sizeof(keyboard_btn_data_t));
+    if (!scan->button_level || !scan->debounce_cnt || !scan->key_data || !scan->key_release_data) {
+        kbd_scan_deinit(scan);
+        return false;
+    }
+    return true;
+}
+
+void kbd_scan_deinit(kbd_scan_t *scan)
+{
+    free(scan->button_level);
+    free(scan->debounce_cnt);
+    free(scan->key_data);
+    free(scan->key_release_data);
+    scan->button_level = NULL;
+    scan->debounce_cnt = NULL;
+    scan->key_data = NULL;
+    scan->key_release_data = NULL;
+}
+
+uint32_t kbd_scan_tick(kbd_scan_t *scan, const kbd_matrix_hal_t *hal, keyboard_btn_report_t *report)
+{
+    uint32_t changed = 0;
+    uint32_t key_last_pressed_num = scan->key_pressed_num;
+    uint32_t key_release_num = 0;
+    scan->settled = true;
+
+    // Clear all output level
+    hal->set_outputs_level(hal->ctx, scan->active_level ? OUTPUT_MASK_LOW : OUTPUT_MASK_HIGE);
+
+    for (uint32_t i = 0; i < scan->output_num; i++) {
+        /*!< Set the output level */
+        hal->set_output_level(hal->ctx, i, scan->active_level ? 1 : 0);
+        /*!< Read the input level */
+        uint32_t input_level = hal->read_inputs_level(hal->ctx);
+        /*!< Clear the output level */
+        hal->set_output_level(hal->ctx, i, scan->active_level ? 0 : 1);
+        for (uint32_t j = 0; j < scan->input_num; j++) {
+            uint32_t currect_btn_num = i * scan->input_num + j;
+            uint8_t read_gpio_level = (input_level >> j) & 0x01;
+            uint8_t button_level = scan->active_level ? scan->button_level[currect_btn_num] : !scan->button_level[currect_btn_num];
+            if (read_gpio_level == button_level) {
+                scan->debounce_cnt[currect_btn_num] = 0;
+                continue;
+            }
+
+            scan->settled = false;
+            if (++scan->debounce_cnt[currect_btn_num] < scan->debounce_ticks) {
+                continue;
+            }
+            scan->debounce_cnt[currect_btn_num] = 0;
+            scan->button_level[currect_btn_num] = scan->active_level ? read_gpio_level : !read_gpio_level;
+            // Make a report
+            if (scan->button_level[currect_btn_num] == 1) {
+                changed |= KBD_SCAN_PRESSED;
+                scan->key_data[scan->key_pressed_num].output_index = i;
+                scan->key_data[scan->key_pressed_num].input_index = j;
+                scan->key_pressed_num++;
+            } else {
+                changed |= KBD_SCAN_RELEASED;
+                /*!< Remove scan->key_data and move the data forward */
+                for (uint32_t k = 0; k < scan->key_pressed_num; k++) {
+                    if (scan->key_data[k].output_index == i && scan->key_data[k].input_index == j) {
+                        for (uint32_t l = k; l + 1 < scan->key_pressed_num; l++) {
+                            scan->key_data[l] = scan->key_data[l + 1];
+                        }
+                        break;
+                    }
+                }
+                scan->key_pressed_num--;
+
+                scan->key_release_data[key_release_num].output_index = i;
+                scan->key_release_data[key_release_num].input_index = j;
+                key_release_num++;
+            }
+        }
+    }
+
+    if (changed) {
+        report->key_data = scan->key_data;
+        report->key_pressed_num = scan->key_pressed_num;
+        report->key_release_num = key_release_num;
+        report->key_change_num = (int)scan->key_pressed_num - (int)key_last_pressed_num;
+        report->key_release_data = scan->key_release_data;
+    }
+    return changed;
+}
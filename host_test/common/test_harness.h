@@ -0,0 +1,37 @@
+#pragma once
+
+// Assertions and runner shared by the host tests, one test executable per translation unit:
+//
+//     static void test_something(void) { TEST_ASSERT(...); }
+//
+//     int main(void)
+//     {
+//         RUN_TEST(test_something);
+//         return TEST_EXIT();
+//     }
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int s_failures = 0;
+
+// Fails the running test and returns from it, the next RUN_TEST() still runs
+#define TEST_ASSERT(cond)                                                           \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("  %s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond);   \
+            s_failures++;                                                           \
+            return;                                                                 \
+        }                                                                           \
+    } while (0)
+
+#define RUN_TEST(fn)                                    \
+    do {                                                \
+        int failures = s_failures;                      \
+        fn();                                           \
+        printf("%s %s\n", s_failures == failures ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+// Prints the failure count, the exit status of main() for ctest
+#define TEST_EXIT()                                     \
+    (printf("%d failure(s)\n", s_failures), s_failures ? EXIT_FAILURE : EXIT_SUCCESS)
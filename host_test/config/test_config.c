@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config_proto.h"
+#include "test_harness.h"
+
+static keymap_table_t s_defaults;
+static keymap_t s_keymap;
+// Keymap of a second profile
+static keymap_table_t s_other_defaults;
+static keymap_t s_other_keymap;
+static config_t s_config;
+static uint8_t s_response[CONFIG_REPORT_LEN];
+
+// What the keyboard would hold and what the commit callback was handed
+static uint8_t s_held_macro[16];
+static int s_commit_num;
+static config_status_t s_commit_status;
+static bool s_commit_keymap;
+static uint8_t s_commit_macro[MACRO_RECORD_PACK_SIZE];
+static size_t s_commit_macro_len;
+
+static size_t macro_pack(uint8_t *blob, size_t size) {
+    (void)size;
+    memcpy(blob, s_held_macro, sizeof(s_held_macro));
+    return sizeof(s_held_macro);
+}
+
+static config_status_t commit(config_t *config) {
+    s_commit_num++;
+    if (s_commit_status != CONFIG_OK) {
+        return s_commit_status;
+    }
+    s_commit_keymap = config->keymap_dirty;
+    if (config->macro_dirty) {
+        memcpy(s_commit_macro, config->macro, config->macro_len);
+        s_commit_macro_len = config->macro_len;
+    }
+    if (config->keymap_dirty) {
+        // Single threaded, no key event holds a table
+        keymap_swap(config->keymap);
+        keymap_sync(config->keymap);
+    }
+    return CONFIG_OK;
+}
+
+static void setup(void) {
+    for (int layer = 0; layer < KEYMAP_LAYER_NUM; layer++) {
+        for (int i = 0; i < KEYMAP_OUTPUT_NUM; i++) {
+            for (int j = 0; j < KEYMAP_INPUT_NUM; j++) {
+                s_defaults.layers[layer][i][j] = 0x04 + layer * 0x40 + i * KEYMAP_INPUT_NUM + j;
+            }
+        }
+    }
+    for (size_t i = 0; i < sizeof(s_held_macro); i++) {
+        s_held_macro[i] = 0xA0 + i;
+    }
+    s_commit_num = 0;
+    s_commit_status = CONFIG_OK;
+    s_commit_keymap = false;
+    s_commit_macro_len = 0;
+    keymap_init(&s_keymap, &s_defaults);
+    const uint16_t settings[CONFIG_SETTING_NUM] = {[CONFIG_SETTING_STENO_PROTOCOL] = 0, [CONFIG_SETTING_PROFILE] = 0};
+    const uint16_t setting_max[CONFIG_SETTING_NUM] = {[CONFIG_SETTING_STENO_PROTOCOL] = 2, [CONFIG_SETTING_PROFILE] = 1};
+    config_init(&s_config, &s_keymap, &s_defaults, settings, setting_max, macro_pack, commit);
+}
+
+// Status of the request, the response is in s_response
+static uint8_t request(const uint8_t *data, size_t len) {
+    memset(s_response, 0xEE, sizeof(s_response));
+    if (config_handle(&s_config, data, len, s_response) != CONFIG_REPORT_LEN || s_response[0] != data[0]) {
+        return 0xFF;
+    }
+    return s_response[1];
+}
+
+#define REQUEST(...)                                                    \
+    ({                                                                  \
+        const uint8_t data_[] = {__VA_ARGS__};                          \
+        request(data_, sizeof(data_));                                  \
+    })
+
+static uint8_t active_entry(uint8_t layer, uint8_t output_index, uint8_t input_index) {
+    const keymap_table_t *table = keymap_read_begin(&s_keymap);
+    uint8_t entry = table->layers[layer][output_index][input_index];
+    keymap_read_end(&s_keymap);
+    return entry;
+}
+
+static void test_set_is_staged_until_commit(void)
+{
+    setup();
+    uint8_t before = active_entry(KEYMAP_LAYER_FN, 2, 3);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_FN, 2, 3, 0x29) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 0x29);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, KEYMAP_LAYER_FN, 2, 3) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 0x29);
+    // The keys still see the old entry
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_FN, 2, 3) == before);
+    TEST_ASSERT(keymap_entry(&s_keymap, KEYMAP_LAYER_FN, 2, 3) == before);
+
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 1);
+    TEST_ASSERT(s_commit_keymap);
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_FN, 2, 3) == 0x29);
+    // Staging follows the new map, the neighbours were kept
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, KEYMAP_LAYER_FN, 2, 4) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == s_defaults.layers[KEYMAP_LAYER_FN][2][4]);
+
+    // Nothing left to save
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 1);
+}
+
+static void test_buffer_read_write(void)
+{
+    setup();
+    TEST_ASSERT(REQUEST(CONFIG_CMD_GET_INFO) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == CONFIG_PROTO_VERSION);
+    TEST_ASSERT(s_response[3] == KEYMAP_LAYER_NUM && s_response[4] == KEYMAP_OUTPUT_NUM);
+    TEST_ASSERT(s_response[5] == KEYMAP_INPUT_NUM);
+    TEST_ASSERT((s_response[6] | s_response[7] << 8) == MACRO_RECORD_PACK_SIZE);
+
+    // Across the end of the first row
+    uint16_t offset = KEYMAP_INPUT_NUM - 2;
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_WRITE, offset & 0xFF, offset >> 8, 4, 1, 2, 3, 4) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_READ, offset & 0xFF, offset >> 8, 4) == CONFIG_OK);
+    const uint8_t written[] = {1, 2, 3, 4};
+    TEST_ASSERT(memcmp(&s_response[2], written, sizeof(written)) == 0);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, KEYMAP_LAYER_BASE, 1, 1) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 4);
+
+    // The last bytes of the Fn layer, then one past them
+    offset = sizeof(keymap_table_t) - 2;
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_READ, offset & 0xFF, offset >> 8, 2) == CONFIG_OK);
+    TEST_ASSERT(s_response[3] == s_defaults.layers[KEYMAP_LAYER_FN][KEYMAP_OUTPUT_NUM - 1][KEYMAP_INPUT_NUM - 1]);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_READ, offset & 0xFF, offset >> 8, 3) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_READ, 0, 0, CONFIG_DATA_MAX + 1) == CONFIG_ERR_RANGE);
+}
+
+static void test_rejects_bad_requests(void)
+{
+    setup();
+    TEST_ASSERT(REQUEST(0x7F) == CONFIG_ERR_COMMAND);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, 0, 0) == CONFIG_ERR_LENGTH);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, 0, 0, 0) == CONFIG_ERR_LENGTH);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, KEYMAP_LAYER_NUM, 0, 0) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, 0, KEYMAP_OUTPUT_NUM, 0) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, 0, 0, KEYMAP_INPUT_NUM, 1) == CONFIG_ERR_RANGE);
+    // Says 4 bytes, carries 2
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_WRITE, 0, 0, 4, 1, 2) == CONFIG_ERR_LENGTH);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_GET, CONFIG_SETTING_NUM) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_SET, CONFIG_SETTING_STENO_PROTOCOL, 3, 0) == CONFIG_ERR_RANGE);
+
+    // Nothing was staged by the failures
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 0);
+
+    // An empty report has no answer
+    uint8_t empty = 0;
+    TEST_ASSERT(config_handle(&s_config, &empty, 0, s_response) == 0);
+}
+
+static void test_macro_written_in_order(void)
+{
+    setup();
+    // Before anything is written the keyboard's recording is read
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_LEN) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == sizeof(s_held_macro) && s_response[3] == 0);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_READ, 4, 0, 2) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 0xA4 && s_response[3] == 0xA5);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_READ, 15, 0, 2) == CONFIG_ERR_RANGE);
+
+    // Continuing a recording that was never started
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_WRITE, 3, 0, 1, 9) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_WRITE, 0, 0, 3, 1, 2, 3) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_WRITE, 3, 0, 2, 4, 5) == CONFIG_OK);
+    // A gap or a rewrite breaks the order
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_WRITE, 6, 0, 1, 7) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_WRITE, 2, 0, 1, 7) == CONFIG_ERR_RANGE);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_LEN) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 5);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_READ, 0, 0, 5) == CONFIG_OK);
+    const uint8_t staged[] = {1, 2, 3, 4, 5};
+    TEST_ASSERT(memcmp(&s_response[2], staged, sizeof(staged)) == 0);
+
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 1);
+    TEST_ASSERT(!s_commit_keymap);
+    TEST_ASSERT(s_commit_macro_len == sizeof(staged));
+    TEST_ASSERT(memcmp(s_commit_macro, staged, sizeof(staged)) == 0);
+}
+
+static void test_failed_commit_keeps_staging(void)
+{
+    setup();
+    uint8_t before = active_entry(KEYMAP_LAYER_BASE, 0, 0);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 0, 0, 0x3A) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_SET, CONFIG_SETTING_STENO_PROTOCOL, 2, 0) == CONFIG_OK);
+
+    s_commit_status = CONFIG_ERR_STORE;
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_ERR_STORE);
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_BASE, 0, 0) == before);
+    TEST_ASSERT(s_config.settings[CONFIG_SETTING_STENO_PROTOCOL] == 0);
+
+    // Still staged, the retry saves it
+    s_commit_status = CONFIG_OK;
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 2);
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_BASE, 0, 0) == 0x3A);
+    TEST_ASSERT(s_config.settings[CONFIG_SETTING_STENO_PROTOCOL] == 2);
+}
+
+static void test_handed_off_commit(void)
+{
+    setup();
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 0, 0, 0x3A) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_SET, CONFIG_SETTING_STENO_PROTOCOL, 2, 0) == CONFIG_OK);
+
+    // No response until the task saving it is done, everything else is refused meanwhile
+    s_commit_status = CONFIG_PENDING;
+    const uint8_t commit_request[] = {CONFIG_CMD_COMMIT};
+    TEST_ASSERT(config_handle(&s_config, commit_request, sizeof(commit_request), s_response) == 0);
+    TEST_ASSERT(config_commit_pending(&s_config));
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 0, 0, 0x3B) == CONFIG_ERR_BUSY);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_ERR_BUSY);
+    TEST_ASSERT(s_commit_num == 1);
+
+    keymap_swap(&s_keymap);
+    keymap_sync(&s_keymap);
+    TEST_ASSERT(config_commit_done(&s_config, CONFIG_OK, s_response) == CONFIG_REPORT_LEN);
+    TEST_ASSERT(s_response[0] == CONFIG_CMD_COMMIT && s_response[1] == CONFIG_OK);
+    TEST_ASSERT(!config_commit_pending(&s_config));
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_BASE, 0, 0) == 0x3A);
+    TEST_ASSERT(s_config.settings[CONFIG_SETTING_STENO_PROTOCOL] == 2);
+
+    // Clean again, a failed save keeps staging for the retry
+    s_commit_status = CONFIG_OK;
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 1);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_SET, CONFIG_SETTING_STENO_PROTOCOL, 1, 0) == CONFIG_OK);
+    s_commit_status = CONFIG_PENDING;
+    TEST_ASSERT(config_handle(&s_config, commit_request, sizeof(commit_request), s_response) == 0);
+    TEST_ASSERT(config_commit_done(&s_config, CONFIG_ERR_STORE, s_response) == CONFIG_REPORT_LEN);
+    TEST_ASSERT(s_response[1] == CONFIG_ERR_STORE);
+    TEST_ASSERT(s_config.settings[CONFIG_SETTING_STENO_PROTOCOL] == 2);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_GET, CONFIG_SETTING_STENO_PROTOCOL) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 1);
+}
+
+static void test_discard_and_reset(void)
+{
+    setup();
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 5, 6, 0x2C) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_SET, CONFIG_SETTING_STENO_PROTOCOL, 1, 0) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_WRITE, 0, 0, 1, 1) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_DISCARD) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, KEYMAP_LAYER_BASE, 5, 6) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == s_defaults.layers[KEYMAP_LAYER_BASE][5][6]);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_GET, CONFIG_SETTING_STENO_PROTOCOL) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 0);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_MACRO_LEN) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == sizeof(s_held_macro));
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 0);
+
+    // A committed edit, then back to the compiled-in map
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 5, 6, 0x2C) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_BASE, 5, 6) == 0x2C);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_RESET) == CONFIG_OK);
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_BASE, 5, 6) == 0x2C);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 2);
+    TEST_ASSERT(active_entry(KEYMAP_LAYER_BASE, 5, 6) == s_defaults.layers[KEYMAP_LAYER_BASE][5][6]);
+}
+
+static void test_swap_waits_for_the_reader(void)
+{
+    setup();
+    const keymap_table_t *old = keymap_read_begin(&s_keymap);
+    keymap_staging(&s_keymap)->layers[KEYMAP_LAYER_BASE][0][0] = 0x55;
+    keymap_swap(&s_keymap);
+    // The event in progress finishes on the table it took
+    TEST_ASSERT(keymap_reading(&s_keymap));
+    TEST_ASSERT(old->layers[KEYMAP_LAYER_BASE][0][0] == s_defaults.layers[KEYMAP_LAYER_BASE][0][0]);
+    TEST_ASSERT(keymap_entry(&s_keymap, KEYMAP_LAYER_BASE, 0, 0) == 0x55);
+    keymap_read_end(&s_keymap);
+    TEST_ASSERT(!keymap_reading(&s_keymap));
+
+    // The next event takes the new table, staging becomes a copy of it
+    keymap_sync(&s_keymap);
+    const keymap_table_t *table = keymap_read_begin(&s_keymap);
+    TEST_ASSERT(table != old);
+    TEST_ASSERT(table->layers[KEYMAP_LAYER_BASE][0][0] == 0x55);
+    keymap_read_end(&s_keymap);
+    TEST_ASSERT(keymap_staging(&s_keymap) == old);
+    TEST_ASSERT(memcmp(old, table, sizeof(keymap_table_t)) == 0);
+}
+
+static void test_mapped_keymap_until_swap(void)
+{
+    setup();
+    keymap_init_mapped(&s_other_keymap, &s_defaults);
+    // Read in place, staging holds the copy that gets edited
+    const keymap_table_t *table = keymap_read_begin(&s_other_keymap);
+    keymap_read_end(&s_other_keymap);
+    TEST_ASSERT(table == &s_defaults);
+    TEST_ASSERT(keymap_staging(&s_other_keymap) != &s_defaults);
+    TEST_ASSERT(memcmp(keymap_staging(&s_other_keymap), &s_defaults, sizeof(keymap_table_t)) == 0);
+
+    keymap_staging(&s_other_keymap)->layers[KEYMAP_LAYER_BASE][1][1] = 0x66;
+    keymap_swap(&s_other_keymap);
+    keymap_sync(&s_other_keymap);
+    TEST_ASSERT(keymap_entry(&s_other_keymap, KEYMAP_LAYER_BASE, 1, 1) == 0x66);
+    TEST_ASSERT(s_defaults.layers[KEYMAP_LAYER_BASE][1][1] != 0x66);
+    // From here on the two buffers take turns, the mapped table is never written
+    TEST_ASSERT(keymap_staging(&s_other_keymap) != &s_defaults);
+    TEST_ASSERT(keymap_staging(&s_other_keymap)->layers[KEYMAP_LAYER_BASE][1][1] == 0x66);
+}
+
+static void test_select_drops_staging(void)
+{
+    setup();
+    s_other_defaults = s_defaults;
+    s_other_defaults.layers[KEYMAP_LAYER_BASE][1][2] = 0x3B;
+    keymap_init_mapped(&s_other_keymap, &s_other_defaults);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 1, 2, 0x2B) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_SET, CONFIG_SETTING_STENO_PROTOCOL, 1, 0) == CONFIG_OK);
+
+    // The keys switched to the second profile
+    s_config.settings[CONFIG_SETTING_PROFILE] = 1;
+    config_select(&s_config, &s_other_keymap, &s_other_defaults);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_GET, KEYMAP_LAYER_BASE, 1, 2) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 0x3B);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_GET, CONFIG_SETTING_PROFILE) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 1);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_SETTING_GET, CONFIG_SETTING_STENO_PROTOCOL) == CONFIG_OK);
+    TEST_ASSERT(s_response[2] == 0);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(s_commit_num == 0);
+
+    // Edits go to the new profile only
+    TEST_ASSERT(REQUEST(CONFIG_CMD_KEYMAP_SET, KEYMAP_LAYER_BASE, 1, 2, 0x2B) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(keymap_entry(&s_other_keymap, KEYMAP_LAYER_BASE, 1, 2) == 0x2B);
+    TEST_ASSERT(keymap_entry(&s_keymap, KEYMAP_LAYER_BASE, 1, 2) == s_defaults.layers[KEYMAP_LAYER_BASE][1][2]);
+    TEST_ASSERT(s_other_defaults.layers[KEYMAP_LAYER_BASE][1][2] == 0x3B);
+
+    // Reset stages the layout of the new profile
+    TEST_ASSERT(REQUEST(CONFIG_CMD_RESET) == CONFIG_OK);
+    TEST_ASSERT(REQUEST(CONFIG_CMD_COMMIT) == CONFIG_OK);
+    TEST_ASSERT(keymap_entry(&s_other_keymap, KEYMAP_LAYER_BASE, 1, 2) == 0x3B);
+}
+
+int main(void)
+{
+    RUN_TEST(test_set_is_staged_until_commit);
+    RUN_TEST(test_buffer_read_write);
+    RUN_TEST(test_rejects_bad_requests);
+    RUN_TEST(test_macro_written_in_order);
+    RUN_TEST(test_failed_commit_keeps_staging);
+    RUN_TEST(test_handed_off_commit);
+    RUN_TEST(test_discard_and_reset);
+    RUN_TEST(test_swap_waits_for_the_reader);
+    RUN_TEST(test_mapped_keymap_until_swap);
+    RUN_TEST(test_select_drops_staging);
+
+    return TEST_EXIT();
+}
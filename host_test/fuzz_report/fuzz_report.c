@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "tinyusb.h"
+#include "descriptors.h"
+#include "hid_report.h"
+
+// Property test of hid_report_build(): every input is a keymap and a set of pressed keys, the report built from
+// them is compared byte for byte with a reference model. The report is then converted to the other format with
+// hid_report_convert(), as on a protocol switch, and checked against the model again. Built as a libFuzzer target with
+// -DFUZZ_REPORT_LIBFUZZER=ON (clang), otherwise as a driver that replays files and random inputs.
+//
+// Input layout:
+//     one byte, bit 0 selects the report format (0 boot, 1 NKRO)
+//     KEYMAP_BYTES bytes of keymap, missing bytes are HID_KEY_NONE
+//     then two bytes per pressed key, output_index and input_index. Indexes past the keymap are kept on purpose.
+
+#define KEYMAP_BYTES        (KEYMAP_OUTPUT_NUM * KEYMAP_INPUT_NUM)
+#define MAX_PRESSED         128
+
+
+typedef struct {
+    hid_report_format_t format;
+    uint8_t keymap[KEYMAP_OUTPUT_NUM][KEYMAP_INPUT_NUM];
+    keyboard_btn_data_t keys[MAX_PRESSED];
+    uint32_t key_num;
+} fuzz_input_t;
+
+
+static void decode_input(const uint8_t *data, size_t size, fuzz_input_t *input) {
+    memset(input, 0, sizeof(*input));
+    if (size == 0) {
+        return;
+    }
+    input->format = (data[0] & 1) ? HID_REPORT_FORMAT_NKRO : HID_REPORT_FORMAT_BOOT;
+    data++;
+    size--;
+    size_t keymap_len = size < KEYMAP_BYTES ? size : KEYMAP_BYTES;
+    memcpy(input->keymap, data, keymap_len);
+    data += keymap_len;
+    size -= keymap_len;
+    while (size >= 2 && input->key_num < MAX_PRESSED) {
+        input->keys[input->key_num].output_index = data[0] % (KEYMAP_OUTPUT_NUM + 2);
+        input->keys[input->key_num].input_index = data[1] % (KEYMAP_INPUT_NUM + 3);
+        input->key_num++;
+        data += 2;
+        size -= 2;
+    }
+}
+
+
+// Reference model, written from the report descriptor rather than from hid_report.c
+static bool model_is_modifier(uint8_t keycode, uint32_t output_index, uint32_t input_index) {
+    static const uint8_t usage_positions[][2] = {{0, 8}, {1, 3}, {2, 3}, {3, 1}, {4, 7}};
+    if (keycode == 0 || (keycode & (keycode - 1)) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(usage_positions) / sizeof(usage_positions[0]); i++) {
+        if (output_index == usage_positions[i][0] && input_index == usage_positions[i][1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static void model_build(const fuzz_input_t *input, hid_nkey_report_t *report, uint8_t *modifier) {
+    uint8_t keys[MAX_PRESSED];
+    uint32_t keynum = 0;
+    *modifier = 0;
+    for (uint32_t i = 0; i < input->key_num; i++) {
+        uint32_t o = input->keys[i].output_index;
+        uint32_t n = input->keys[i].input_index;
+        if (o >= KEYMAP_OUTPUT_NUM || n >= KEYMAP_INPUT_NUM) {
+            continue;
+        }
+        uint8_t keycode = input->keymap[o][n];
+        if (model_is_modifier(keycode, o, n)) {
+            *modifier |= keycode;
+        } else if (keycode != HID_KEY_NONE) {
+            keys[keynum++] = keycode;
+        }
+    }
+
+    memset(report, 0, sizeof(*report));
+    if (input->format == HID_REPORT_FORMAT_BOOT) {
+        // HID 1.11 appendix C: ErrorRollOver (usage 1) in every slot when too many keys are down
+        report->report_id = REPORT_ID_KEYBOARD;
+        report->keyboard_report.modifier = *modifier;
+        for (uint32_t i = 0; i < 6; i++) {
+            report->keyboard_report.keycode[i] = keynum > 6 ? 1 : (i < keynum ? keys[i] : 0);
+        }
+        return;
+    }
+
+    // The bitmap covers usages 4 (HID_KEY_A) to 123, one bit each
+    report->report_id = REPORT_ID_FULL_KEY_KEYBOARD;
+    report->keyboard_full_key_report.modifier = *modifier;
+    for (uint32_t i = 0; i < keynum; i++) {
+        if (keys[i] >= 4 && keys[i] <= 123) {
+            uint32_t bit = keys[i] - 4;
+            report->keyboard_full_key_report.keycode[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+}
+
+
+// What the host should see after a protocol switch: the set of keys down, in the other format
+static void model_convert(const hid_nkey_report_t *from, hid_nkey_report_t *to) {
+    uint8_t keys[128];
+    uint32_t keynum = 0;
+    memset(to, 0, sizeof(*to));
+    if (from->report_id == REPORT_ID_FULL_KEY_KEYBOARD) {
+        for (uint32_t usage = 4; usage <= 123; usage++) {
+            if (from->keyboard_full_key_report.keycode[(usage - 4) / 8] & (1 << ((usage - 4) % 8))) {
+                keys[keynum++] = usage;
+            }
+        }
+        to->report_id = REPORT_ID_KEYBOARD;
+        to->keyboard_report.modifier = from->keyboard_full_key_report.modifier;
+        for (uint32_t i = 0; i < 6; i++) {
+            to->keyboard_report.keycode[i] = keynum > 6 ? 1 : (i < keynum ? keys[i] : 0);
+        }
+        return;
+    }
+
+    // A boot report with ErrorRollOver in any slot no longer says which keys are down
+    to->report_id = REPORT_ID_FULL_KEY_KEYBOARD;
+    to->keyboard_full_key_report.modifier = from->keyboard_report.modifier;
+    if (memchr(from->keyboard_report.keycode, 1, 6) != NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+        uint8_t keycode = from->keyboard_report.keycode[i];
+        if (keycode >= 4 && keycode <= 123) {
+            to->keyboard_full_key_report.keycode[(keycode - 4) / 8] |= 1 << ((keycode - 4) % 8);
+        }
+    }
+}
+
+
+static void dump_failure(const fuzz_input_t *input, const hid_nkey_report_t *got, const hid_nkey_report_t *want) {
+    fprintf(stderr, "pressed:");
+    for (uint32_t i = 0; i < input->key_num; i++) {
+        uint32_t o = input->keys[i].output_index;
+        uint32_t n = input->keys[i].input_index;
+        int keycode = (o < KEYMAP_OUTPUT_NUM && n < KEYMAP_INPUT_NUM) ? input->keymap[o][n] : -1;
+        fprintf(stderr, " (%lu,%lu)=%d", (unsigned long)o, (unsigned long)n, keycode);
+    }
+    const uint8_t *g = (const uint8_t *)got;
+    const uint8_t *w = (const uint8_t *)want;
+    fprintf(stderr, "\ngot: ");
+    for (size_t i = 0; i < sizeof(*got); i++) {
+        fprintf(stderr, " %02x", g[i]);
+    }
+    fprintf(stderr, "\nwant:");
+    for (size_t i = 0; i < sizeof(*want); i++) {
+        fprintf(stderr, " %02x", w[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static fuzz_input_t input;
+    decode_input(data, size, &input);
+
+    // Exact-size heap copies so the sanitizers see any write past the report or the key list
+    hid_nkey_report_t *report = malloc(sizeof(*report));
+    keyboard_btn_data_t *keys = malloc(sizeof(keyboard_btn_data_t) * (input.key_num ? input.key_num : 1));
+    memcpy(keys, input.keys, sizeof(keyboard_btn_data_t) * input.key_num);
+    uint8_t modifier = hid_report_build(keys, input.key_num, (const uint8_t (*)[KEYMAP_INPUT_NUM])input.keymap,
+                                        input.format, report);
+
+    hid_nkey_report_t want;
+    uint8_t want_modifier;
+    model_build(&input, &want, &want_modifier);
+    if (modifier != want_modifier || memcmp(report, &want, sizeof(want)) != 0) {
+        dump_failure(&input, report, &want);
+        abort();
+    }
+
+    hid_nkey_report_t *converted = malloc(sizeof(*converted));
+    hid_report_format_t other = input.format == HID_REPORT_FORMAT_BOOT ? HID_REPORT_FORMAT_NKRO : HID_REPORT_FORMAT_BOOT;
+    hid_report_convert(report, other, converted);
+    hid_nkey_report_t want_converted;
+    model_convert(&want, &want_converted);
+    if (memcmp(converted, &want_converted, sizeof(want_converted)) != 0) {
+        fprintf(stderr, "after conversion\n");
+        dump_failure(&input, converted, &want_converted);
+        abort();
+    }
+
+    // Converting in place is what the GET_REPORT handler does
+    hid_report_convert(report, other, report);
+    if (memcmp(report, converted, sizeof(*report)) != 0) {
+        fprintf(stderr, "in place conversion\n");
+        dump_failure(&input, report, converted);
+        abort();
+    }
+
+    free(converted);
+    free(keys);
+    free(report);
+    return 0;
+}
+
+
+#ifndef FUZZ_REPORT_LIBFUZZER
+
+static uint32_t s_rng = 0x2545f491;
+
+static uint32_t rng_next(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+
+// Keymap entries drawn the way real layers look: mostly usages, some modifiers, gaps and consumer codes
+static uint8_t random_keycode(void) {
+    uint32_t kind = rng_next() % 8;
+    if (kind == 0) {
+        return HID_KEY_NONE;
+    } else if (kind == 1) {
+        return 1 << (rng_next() % 8);
+    } else if (kind == 2) {
+        return rng_next() & 0xff;
+    }
+    return HID_KEY_A + rng_next() % (HID_KEY_GUI_RIGHT - HID_KEY_A + 1);
+}
+
+
+static void run_random(uint32_t iterations) {
+    uint8_t data[1 + KEYMAP_BYTES + 2 * MAX_PRESSED];
+    for (uint32_t it = 0; it < iterations; it++) {
+        data[0] = rng_next() & 1;
+        for (size_t i = 0; i < KEYMAP_BYTES; i++) {
+            data[1 + i] = random_keycode();
+        }
+        // Favour small key counts around the 6 key limit of the boot report
+        uint32_t key_num = (rng_next() % 4 == 0) ? rng_next() % (MAX_PRESSED + 1) : rng_next() % 16;
+        for (uint32_t i = 0; i < key_num; i++) {
+            data[1 + KEYMAP_BYTES + 2 * i] = rng_next() % (KEYMAP_OUTPUT_NUM + 1);
+            data[1 + KEYMAP_BYTES + 2 * i + 1] = rng_next() % (KEYMAP_INPUT_NUM + 1);
+        }
+        LLVMFuzzerTestOneInput(data, 1 + KEYMAP_BYTES + 2 * key_num);
+    }
+}
+
+
+static int run_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    uint8_t data[4096];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(data, size);
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 100000;
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        char *end;
+        unsigned long value = strtoul(argv[i], &end, 10);
+        if (*end == '\0') {
+            iterations = value;
+        } else {
+            if (run_file(argv[i]) != 0) {
+                return 1;
+            }
+            files++;
+        }
+    }
+    if (files == 0) {
+        run_random(iterations);
+    }
+    printf("fuzz_report: %s passed\n", files ? "corpus" : "random inputs");
+    return 0;
+}
+
+#endif
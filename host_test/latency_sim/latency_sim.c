@@ -0,0 +1,743 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "tinyusb.h"
+#include "kbd_scan.h"
+#include "kbd_matrix_sim.h"
+#include "hid_custom.h"
+#include "hid_report.h"
+#include "tusb_main.h"
+#include "change_mode_interrupt.h"
+#include "sim_core.h"
+#include "latency_sim.h"
+
+// Replays a typing trace through the real scan engine, hid_custom.c and tusb_main.c, and measures
+// the time from the physical key edge to the first host-visible report that reflects it.
+//
+// Trace format, one edge per line, '#' starts a comment:
+//     time_us,output_index,input_index,down
+
+#define OUTPUT_NUM          6
+#define INPUT_NUM           17
+#define MAX_LIST            8
+#define RUN_TAIL_NS         1000000000ULL   // keep running after the last edge so late reports are counted
+
+sim_config_t sim_config;
+sim_stats_t sim_stats;
+bool sim_keep_awake;
+
+
+typedef struct {
+    uint64_t time_ns;
+    uint8_t output_index;
+    uint8_t input_index;
+    bool down;
+} trace_edge_t;
+
+typedef struct {
+    trace_edge_t *edges;
+    size_t num;
+    size_t cap;
+} trace_t;
+
+typedef enum {
+    STROKE_WAIT_PRESS = 0,
+    STROKE_WAIT_RELEASE,
+    STROKE_DONE,
+} stroke_state_t;
+
+// One press and release of a key, measured independently
+typedef struct {
+    uint64_t press_ns;
+    uint64_t release_ns;
+    uint64_t press_seen_ns;
+    uint64_t release_seen_ns;
+    stroke_state_t state;
+    bool masked;                // host still showed the key when it was pressed again
+    bool press_lost;
+    bool release_lost;
+} stroke_t;
+
+typedef struct {
+    uint8_t keycode;
+    bool modifier;
+    stroke_t *strokes;
+    size_t num;
+    size_t cap;
+    size_t cursor;              // first stroke not resolved yet
+} key_track_t;
+
+// Summary a child process hands back to the parent
+typedef struct {
+    uint32_t strokes;
+    uint32_t press_num;
+    uint32_t release_num;
+    uint32_t press_lost;
+    uint32_t release_lost;
+    uint64_t press_p50_ns, press_p99_ns, press_max_ns;
+    uint64_t release_p50_ns, release_p99_ns, release_max_ns;
+    sim_stats_t stats;
+} sim_result_t;
+
+
+static key_track_t s_keys[OUTPUT_NUM][INPUT_NUM];
+static uint8_t s_host_modifier;
+static bool s_host_keys[256];
+
+static kbd_scan_t s_scan;
+static kbd_matrix_sim_t s_matrix;
+static kbd_matrix_hal_t s_hal;
+static kbd_sim_script_t s_script;
+
+
+/*********** Clocks ***********/
+
+uint64_t sim_phase(uint32_t salt, uint64_t period_ns) {
+    if (period_ns == 0) {
+        return 0;
+    }
+    uint64_t x = ((uint64_t)sim_config.seed << 32) ^ (salt * 0x9E3779B97F4A7C15ULL);
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return x % period_ns;
+}
+
+
+uint64_t sim_next_tick(uint64_t time_ns, uint64_t period_ns, uint64_t phase_ns) {
+    if (period_ns == 0) {
+        return time_ns;
+    }
+    if (time_ns < phase_ns) {
+        return phase_ns;
+    }
+    return phase_ns + ((time_ns - phase_ns) / period_ns + 1) * period_ns;
+}
+
+
+/*********** Host side measurement ***********/
+
+static bool host_has_key(const key_track_t *key) {
+    if (key->modifier) {
+        return (s_host_modifier & key->keycode) != 0;
+    }
+    return s_host_keys[key->keycode];
+}
+
+
+static void key_track_update(key_track_t *key, uint64_t now_ns) {
+    bool present = host_has_key(key);
+    while (key->cursor < key->num) {
+        stroke_t *stroke = &key->strokes[key->cursor];
+        stroke_t *next = key->cursor + 1 < key->num ? &key->strokes[key->cursor + 1] : NULL;
+        bool next_started = next && next->press_ns <= now_ns;
+        if (stroke->press_ns > now_ns) {
+            break;
+        }
+
+        if (stroke->state == STROKE_WAIT_PRESS) {
+            if (stroke->masked || next_started) {
+                // Host never saw the key go up before this stroke, or no report carried the stroke
+                stroke->press_lost = true;
+                stroke->release_lost = true;
+            } else if (present) {
+                stroke->press_seen_ns = now_ns;
+                stroke->state = STROKE_WAIT_RELEASE;
+                continue;
+            } else {
+                break;
+            }
+        } else if (stroke->release_ns <= now_ns && !present) {
+            stroke->release_seen_ns = now_ns;
+        } else if (next_started) {
+            stroke->release_lost = true;
+        } else {
+            break;
+        }
+        stroke->state = STROKE_DONE;
+        key->cursor++;
+    }
+}
+
+
+void host_link_keyboard_report(uint8_t modifier, const uint8_t *keys, uint32_t key_num) {
+    s_host_modifier = modifier;
+    memset(s_host_keys, 0, sizeof(s_host_keys));
+    for (uint32_t i = 0; i < key_num; i++) {
+        if (keys[i] != 0) {
+            s_host_keys[keys[i]] = true;
+        }
+    }
+
+    for (int i = 0; i < OUTPUT_NUM; i++) {
+        for (int j = 0; j < INPUT_NUM; j++) {
+            key_track_update(&s_keys[i][j], sim_now());
+        }
+    }
+}
+
+
+// Runs at the press edge: a key the host still shows from the previous stroke cannot be measured
+static void stroke_press_edge(void *arg) {
+    key_track_t *key = arg;
+    for (size_t i = key->cursor; i < key->num; i++) {
+        stroke_t *stroke = &key->strokes[i];
+        if (stroke->press_ns == sim_now() && stroke->state == STROKE_WAIT_PRESS) {
+            stroke->masked = host_has_key(key);
+            break;
+        }
+    }
+}
+
+
+/*********** Trace ***********/
+
+static void trace_add(trace_t *trace, uint64_t time_ns, uint8_t output_index, uint8_t input_index, bool down) {
+    if (trace->num == trace->cap) {
+        trace->cap = trace->cap ? trace->cap * 2 : 256;
+        trace->edges = realloc(trace->edges, trace->cap * sizeof(trace_edge_t));
+        if (!trace->edges) {
+            abort();
+        }
+    }
+    trace->edges[trace->num++] = (trace_edge_t) {
+        .time_ns = time_ns,
+        .output_index = output_index,
+        .input_index = input_index,
+        .down = down,
+    };
+}
+
+
+static bool key_is_measurable(uint8_t output_index, uint8_t input_index) {
+    return output_index < OUTPUT_NUM && input_index < INPUT_NUM
+           && keyboard_base_keycode(output_index, input_index) != HID_KEY_NONE;
+}
+
+
+static bool trace_load(trace_t *trace, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    uint32_t line_num = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_num++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        unsigned long long time_us;
+        unsigned output_index, input_index, down;
+        int fields = sscanf(line, " %llu , %u , %u , %u", &time_us, &output_index, &input_index, &down);
+        if (fields <= 0) {
+            continue;
+        }
+        if (fields != 4 || output_index >= OUTPUT_NUM || input_index >= INPUT_NUM) {
+            fprintf(stderr, "%s:%u: expected time_us,output_index,input_index,down\n", path, line_num);
+            fclose(file);
+            return false;
+        }
+        trace_add(trace, time_us * 1000, output_index, input_index, down != 0);
+    }
+    fclose(file);
+    return true;
+}
+
+
+static uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+
+static uint32_t rand_range(uint32_t *state, uint32_t min, uint32_t max) {
+    return min + xorshift32(state) % (max - min + 1);
+}
+
+
+/**
+ * @brief   Letters, digits and punctuation at ~80 wpm with natural rollover and some shifted keys
+ * **/
+static void trace_synthetic(trace_t *trace, uint32_t strokes, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    uint64_t t_us = 100000;
+    for (uint32_t n = 0; n < strokes; n++) {
+        uint8_t output_index;
+        uint8_t input_index;
+        do {
+            output_index = rand_range(&state, 1, 4);
+            input_index = rand_range(&state, 1, 10);
+        } while (!key_is_measurable(output_index, input_index));
+
+        uint32_t dwell_us = rand_range(&state, 60000, 130000);
+        bool shifted = rand_range(&state, 0, 9) == 0;
+        if (shifted) {
+            // Left shift goes down first and comes up after the key
+            trace_add(trace, t_us * 1000, 4, 0, true);
+            t_us += rand_range(&state, 40000, 90000);
+            trace_add(trace, t_us * 1000, output_index, input_index, true);
+            trace_add(trace, (t_us + dwell_us) * 1000, output_index, input_index, false);
+            trace_add(trace, (t_us + dwell_us + rand_range(&state, 10000, 40000)) * 1000, 4, 0, false);
+            t_us += dwell_us + 60000;
+        } else {
+            trace_add(trace, t_us * 1000, output_index, input_index, true);
+            trace_add(trace, (t_us + dwell_us) * 1000, output_index, input_index, false);
+        }
+        // Inter-key gap shorter than the dwell gives rollover
+        t_us += rand_range(&state, 50000, 220000);
+    }
+}
+
+
+static int edge_cmp(const void *a, const void *b) {
+    const trace_edge_t *x = a;
+    const trace_edge_t *y = b;
+    if (x->time_ns != y->time_ns) {
+        return x->time_ns < y->time_ns ? -1 : 1;
+    }
+    // A release and a press at the same time: release first
+    return (int)x->down - (int)y->down;
+}
+
+
+/**
+ * @brief   Pair the edges of every key into strokes and build the contact waveform
+ * @return  Time of the last edge
+ * **/
+static uint64_t build_run(trace_t *trace) {
+    qsort(trace->edges, trace->num, sizeof(trace_edge_t), edge_cmp);
+
+    uint64_t press_ns[OUTPUT_NUM][INPUT_NUM];
+    bool down[OUTPUT_NUM][INPUT_NUM] = {0};
+    uint64_t last_ns = 0;
+    uint32_t bounce_seed = sim_config.seed;
+
+    for (size_t n = 0; n < trace->num; n++) {
+        const trace_edge_t *edge = &trace->edges[n];
+        uint8_t i = edge->output_index;
+        uint8_t j = edge->input_index;
+        last_ns = edge->time_ns;
+        if (edge->down == down[i][j]) {
+            continue;
+        }
+        down[i][j] = edge->down;
+        if (edge->down) {
+            press_ns[i][j] = edge->time_ns;
+            continue;
+        }
+
+        kbd_sim_bounce_t bounce = {
+            .transitions = 3,
+            .duration_ns = (uint64_t)sim_config.bounce_us * 1000,
+            .seed = ++bounce_seed,
+        };
+        kbd_sim_script_press(&s_script, i, j, press_ns[i][j], edge->time_ns, sim_config.bounce_us ? &bounce : NULL);
+
+        if (!key_is_measurable(i, j)) {
+            continue;
+        }
+        key_track_t *key = &s_keys[i][j];
+        if (key->num == key->cap) {
+            key->cap = key->cap ? key->cap * 2 : 16;
+            key->strokes = realloc(key->strokes, key->cap * sizeof(stroke_t));
+            if (!key->strokes) {
+                abort();
+            }
+        }
+        key->strokes[key->num++] = (stroke_t) {
+            .press_ns = press_ns[i][j],
+            .release_ns = edge->time_ns,
+        };
+        sim_schedule(press_ns[i][j], stroke_press_edge, key);
+    }
+    kbd_sim_script_sort(&s_script);
+
+    for (int i = 0; i < OUTPUT_NUM; i++) {
+        for (int j = 0; j < INPUT_NUM; j++) {
+            s_keys[i][j].keycode = keyboard_base_keycode(i, j);
+            s_keys[i][j].modifier = is_modifier(s_keys[i][j].keycode, i, j);
+        }
+    }
+    return last_ns;
+}
+
+
+/*********** Scan task ***********/
+
+// Time the next contact closes, only a closing contact raises the wakeup interrupt of the idle matrix
+static uint64_t next_close_edge(void) {
+    for (size_t n = s_matrix.next_edge; n < s_script.edge_num; n++) {
+        if (s_script.edges[n].closed) {
+            return s_script.edges[n].time_ns;
+        }
+    }
+    return SIM_FOREVER;
+}
+
+
+/**
+ * @brief   Stand-in for kbd_task() and its gptimer: one kbd_scan_tick() per period, then the
+ *          same KBD_EVENT_TICK callback the firmware registers
+ * **/
+static void scan_task(void *arg) {
+    (void)arg;
+    uint64_t period_ns = (uint64_t)sim_config.scan_us * 1000;
+    uint64_t next_ns = sim_next_tick(sim_now(), period_ns, sim_phase(1, period_ns));
+
+    while (1) {
+        while (sim_now() < next_ns) {
+            sim_task_block(next_ns);
+        }
+        kbd_matrix_sim_advance(&s_matrix, sim_now());
+        keyboard_btn_report_t report;
+        if (!kbd_scan_tick(&s_scan, &s_hal, &report)) {
+            report = (keyboard_btn_report_t) {
+                .key_change_num = 0,
+                .key_pressed_num = s_scan.key_pressed_num,
+                .key_release_num = 0,
+                .key_data = s_scan.key_data,
+                .key_release_data = s_scan.key_release_data,
+            };
+        }
+        keyboard_cb(NULL, report, NULL);
+
+        if (sim_config.power_save && s_scan.key_pressed_num == 0 && s_scan.settled && !sim_keep_awake) {
+            // Timer stopped, the GPIO interrupt restarts it and the first alarm is one period later
+            uint64_t wake_ns = next_close_edge();
+            if (wake_ns == SIM_FOREVER) {
+                sim_task_exit();
+            }
+            next_ns = (wake_ns > sim_now() ? wake_ns : sim_now()) + period_ns;
+        } else {
+            next_ns += period_ns;
+        }
+    }
+}
+
+
+/*********** Run ***********/
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+
+static void percentiles(uint64_t *samples, uint32_t num, uint64_t *p50, uint64_t *p99, uint64_t *max) {
+    if (num == 0) {
+        *p50 = *p99 = *max = 0;
+        return;
+    }
+    qsort(samples, num, sizeof(uint64_t), cmp_u64);
+    *p50 = samples[(num - 1) / 2];
+    *p99 = samples[((uint64_t)num * 99 + 99) / 100 - 1];
+    *max = samples[num - 1];
+}
+
+
+static void run(trace_t *trace, sim_result_t *result) {
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    sim_keep_awake = false;
+    kbd_scan_init(&s_scan, OUTPUT_NUM, INPUT_NUM, 1, sim_config.debounce_ticks);
+    uint64_t last_ns = build_run(trace);
+    kbd_matrix_sim_init(&s_matrix, OUTPUT_NUM, INPUT_NUM, 1, true, &s_script);
+    kbd_matrix_sim_hal(&s_matrix, &s_hal);
+
+    static const connection_mode_t modes[SIM_TRANSPORT_MAX] = {
+        [SIM_TRANSPORT_USB] = MODE_USB,
+        [SIM_TRANSPORT_BLE] = MODE_BLE,
+        [SIM_TRANSPORT_ESPNOW] = MODE_WIRELESS,
+    };
+    current_mode = modes[sim_config.transport];
+    keyboard_keymap_init(sim_config.scan_us);
+    if (current_mode == MODE_USB) {
+        tusb_main();
+    }
+    sim_task_create("kbd_task", scan_task, NULL);
+    sim_run(last_ns + RUN_TAIL_NS);
+
+    uint32_t capacity = 0;
+    for (int i = 0; i < OUTPUT_NUM; i++) {
+        for (int j = 0; j < INPUT_NUM; j++) {
+            capacity += s_keys[i][j].num;
+        }
+    }
+    uint64_t *press = calloc(capacity + 1, sizeof(uint64_t));
+    uint64_t *release = calloc(capacity + 1, sizeof(uint64_t));
+
+    memset(result, 0, sizeof(sim_result_t));
+    for (int i = 0; i < OUTPUT_NUM; i++) {
+        for (int j = 0; j < INPUT_NUM; j++) {
+            const key_track_t *key = &s_keys[i][j];
+            for (size_t n = 0; n < key->num; n++) {
+                const stroke_t *stroke = &key->strokes[n];
+                result->strokes++;
+                if (stroke->press_seen_ns) {
+                    press[result->press_num++] = stroke->press_seen_ns - stroke->press_ns;
+                } else {
+                    result->press_lost++;
+                }
+                if (stroke->release_seen_ns) {
+                    release[result->release_num++] = stroke->release_seen_ns - stroke->release_ns;
+                } else {
+                    result->release_lost++;
+                }
+            }
+        }
+    }
+    percentiles(press, result->press_num, &result->press_p50_ns, &result->press_p99_ns, &result->press_max_ns);
+    percentiles(release, result->release_num, &result->release_p50_ns, &result->release_p99_ns, &result->release_max_ns);
+    result->stats = sim_stats;
+    free(press);
+    free(release);
+}
+
+
+/**
+ * @brief   Each configuration runs in its own process so the firmware's static state starts clean
+ * **/
+static bool run_isolated(trace_t *trace, sim_result_t *result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        sim_result_t child_result;
+        run(trace, &child_result);
+        ssize_t written = write(fds[1], &child_result, sizeof(child_result));
+        _exit(written == sizeof(child_result) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(sim_result_t));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got == sizeof(sim_result_t) && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+
+/*********** Command line ***********/
+
+typedef struct {
+    uint32_t values[MAX_LIST];
+    uint32_t num;
+} value_list_t;
+
+
+static bool parse_list(const char *arg, value_list_t *list) {
+    list->num = 0;
+    char *copy = strdup(arg);
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        if (list->num == MAX_LIST) {
+            free(copy);
+            return false;
+        }
+        if (strcmp(tok, "usb") == 0) {
+            list->values[list->num++] = SIM_TRANSPORT_USB;
+        } else if (strcmp(tok, "ble") == 0) {
+            list->values[list->num++] = SIM_TRANSPORT_BLE;
+        } else if (strcmp(tok, "espnow") == 0) {
+            list->values[list->num++] = SIM_TRANSPORT_ESPNOW;
+        } else {
+            char *end;
+            unsigned long value = strtoul(tok, &end, 10);
+            if (*end != '\0') {
+                free(copy);
+                return false;
+            }
+            list->values[list->num++] = (uint32_t)value;
+        }
+    }
+    free(copy);
+    return list->num > 0;
+}
+
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options] [trace.csv]\n"
+            "  --synthetic N          generate N keystrokes instead of reading a trace\n"
+            "  --dump-trace           print the trace and exit\n"
+            "  --transport LIST       usb,ble,espnow                  (default all)\n"
+            "  --scan-us LIST         scan period                     (default 500)\n"
+            "  --debounce LIST        debounce ticks                  (default 2)\n"
+            "  --power-save LIST      0,1                             (default 1)\n"
+            "  --bounce-us LIST       contact bounce per edge         (default 0)\n"
+            "  --usb-poll-us LIST     HID IN polling interval         (default 1000, bInterval 1)\n"
+            "  --ble-interval-us LIST connection interval             (default 15000)\n"
+            "  --ble-stack-us N       Bluedroid send to controller    (default 1000)\n"
+            "  --espnow-air-us N      ESP-NOW send to dongle receive  (default 1000)\n"
+            "  --espnow-poll-us N     dongle HID IN polling interval  (default 1000)\n"
+            "  --seed LIST            clock phases and bounce         (default 1)\n"
+            "Lists are comma separated, every combination is simulated.\n",
+            prog);
+}
+
+
+int main(int argc, char **argv) {
+    value_list_t transports = {.values = {SIM_TRANSPORT_USB, SIM_TRANSPORT_BLE, SIM_TRANSPORT_ESPNOW}, .num = 3};
+    value_list_t scan_us = {.values = {500}, .num = 1};
+    value_list_t debounce = {.values = {2}, .num = 1};
+    value_list_t power_save = {.values = {1}, .num = 1};
+    value_list_t bounce_us = {.values = {0}, .num = 1};
+    value_list_t usb_poll_us = {.values = {1000}, .num = 1};
+    value_list_t ble_interval_us = {.values = {15000}, .num = 1};
+    value_list_t seeds = {.values = {1}, .num = 1};
+    uint32_t ble_stack_us = 1000;
+    uint32_t espnow_air_us = 1000;
+    uint32_t espnow_poll_us = 1000;
+    uint32_t synthetic = 0;
+    bool dump_trace = false;
+    const char *trace_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        bool ok = true;
+        if (strcmp(opt, "--dump-trace") == 0) {
+            dump_trace = true;
+            continue;
+        } else if (opt[0] != '-') {
+            trace_path = opt;
+            continue;
+        } else if (!val) {
+            ok = false;
+        } else if (strcmp(opt, "--synthetic") == 0) {
+            synthetic = (uint32_t)strtoul(val, NULL, 10);
+        } else if (strcmp(opt, "--transport") == 0) {
+            ok = parse_list(val, &transports);
+        } else if (strcmp(opt, "--scan-us") == 0) {
+            ok = parse_list(val, &scan_us);
+        } else if (strcmp(opt, "--debounce") == 0) {
+            ok = parse_list(val, &debounce);
+        } else if (strcmp(opt, "--power-save") == 0) {
+            ok = parse_list(val, &power_save);
+        } else if (strcmp(opt, "--bounce-us") == 0) {
+            ok = parse_list(val, &bounce_us);
+        } else if (strcmp(opt, "--usb-poll-us") == 0) {
+            ok = parse_list(val, &usb_poll_us);
+        } else if (strcmp(opt, "--ble-interval-us") == 0) {
+            ok = parse_list(val, &ble_interval_us);
+        } else if (strcmp(opt, "--seed") == 0) {
+            ok = parse_list(val, &seeds);
+        } else if (strcmp(opt, "--ble-stack-us") == 0) {
+            ble_stack_us = (uint32_t)strtoul(val, NULL, 10);
+        } else if (strcmp(opt, "--espnow-air-us") == 0) {
+            espnow_air_us = (uint32_t)strtoul(val, NULL, 10);
+        } else if (strcmp(opt, "--espnow-poll-us") == 0) {
+            espnow_poll_us = (uint32_t)strtoul(val, NULL, 10);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+
+    // Measurable keys are looked up in the keymap before the first run sets it up again
+    keyboard_keymap_init(scan_us.values[0]);
+
+    trace_t trace = {0};
+    if (trace_path) {
+        if (!trace_load(&trace, trace_path)) {
+            return EXIT_FAILURE;
+        }
+    } else if (synthetic) {
+        trace_synthetic(&trace, synthetic, seeds.values[0]);
+    } else {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (dump_trace) {
+        qsort(trace.edges, trace.num, sizeof(trace_edge_t), edge_cmp);
+        printf("# time_us,output_index,input_index,down\n");
+        for (size_t n = 0; n < trace.num; n++) {
+            printf("%llu,%u,%u,%u\n", (unsigned long long)(trace.edges[n].time_ns / 1000),
+                   trace.edges[n].output_index, trace.edges[n].input_index, trace.edges[n].down);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    static const char *transport_names[SIM_TRANSPORT_MAX] = {"usb", "ble", "espnow"};
+    printf("%-7s %5s %3s %2s %6s %6s %6s %4s | %-22s | %-22s | %9s %5s\n",
+           "link", "scan", "deb", "ps", "bounce", "poll", "conn", "seed",
+           "press p50/p99/max ms", "release p50/p99/max ms", "lost p/r", "drops");
+
+    int failures = 0;
+    for (uint32_t a = 0; a < transports.num; a++)
+    for (uint32_t b = 0; b < scan_us.num; b++)
+    for (uint32_t c = 0; c < debounce.num; c++)
+    for (uint32_t d = 0; d < power_save.num; d++)
+    for (uint32_t e = 0; e < bounce_us.num; e++)
+    for (uint32_t f = 0; f < usb_poll_us.num; f++)
+    for (uint32_t g = 0; g < ble_interval_us.num; g++)
+    for (uint32_t h = 0; h < seeds.num; h++) {
+        sim_config = (sim_config_t) {
+            .transport = (sim_transport_t)transports.values[a],
+            .scan_us = scan_us.values[b],
+            .debounce_ticks = debounce.values[c],
+            .power_save = power_save.values[d] != 0,
+            .bounce_us = bounce_us.values[e],
+            .usb_poll_us = usb_poll_us.values[f],
+            .ble_interval_us = ble_interval_us.values[g],
+            .ble_stack_us = ble_stack_us,
+            .espnow_air_us = espnow_air_us,
+            .espnow_poll_us = espnow_poll_us,
+            .seed = seeds.values[h],
+        };
+        // Axes that do not apply to a transport are not swept for it
+        if ((sim_config.transport != SIM_TRANSPORT_USB && f > 0) || (sim_config.transport != SIM_TRANSPORT_BLE && g > 0)) {
+            continue;
+        }
+        if (sim_config.transport >= SIM_TRANSPORT_MAX || sim_config.scan_us == 0) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        sim_result_t r;
+        if (!run_isolated(&trace, &r)) {
+            fprintf(stderr, "run failed: %s scan %u us\n", transport_names[sim_config.transport], sim_config.scan_us);
+            failures++;
+            continue;
+        }
+        char poll[12] = "-";
+        char conn[12] = "-";
+        if (sim_config.transport == SIM_TRANSPORT_BLE) {
+            snprintf(conn, sizeof(conn), "%u", sim_config.ble_interval_us);
+        } else {
+            snprintf(poll, sizeof(poll), "%u", sim_config.transport == SIM_TRANSPORT_USB ? sim_config.usb_poll_us : espnow_poll_us);
+        }
+        printf("%-7s %5u %3u %2u %6u %6s %6s %4u | %6.2f %6.2f %7.2f | %6.2f %6.2f %7.2f | %4u/%-4u %5u\n",
+               transport_names[sim_config.transport], sim_config.scan_us, sim_config.debounce_ticks,
+               sim_config.power_save, sim_config.bounce_us, poll, conn, sim_config.seed,
+               r.press_p50_ns / 1e6, r.press_p99_ns / 1e6, r.press_max_ns / 1e6,
+               r.release_p50_ns / 1e6, r.release_p99_ns / 1e6, r.release_max_ns / 1e6,
+               r.press_lost, r.release_lost, r.stats.usb_busy_drops);
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
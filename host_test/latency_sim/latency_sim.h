@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    SIM_TRANSPORT_USB = 0,
+    SIM_TRANSPORT_BLE,
+    SIM_TRANSPORT_ESPNOW,
+    SIM_TRANSPORT_MAX,
+} sim_transport_t;
+
+
+// One point of the parameter sweep
+typedef struct {
+    sim_transport_t transport;
+    uint32_t scan_us;               // keyboard_btn_config_t.ticks_interval
+    uint32_t debounce_ticks;        // keyboard_btn_config_t.debounce_ticks
+    bool power_save;                // keyboard_btn_config_t.enable_power_save
+    uint32_t bounce_us;             // contact bounce added to every edge of the trace
+    uint32_t usb_poll_us;           // host polling interval of the HID IN endpoint
+    uint32_t ble_interval_us;       // BLE connection interval
+    uint32_t ble_stack_us;          // Bluedroid time from the send call to the controller
+    uint32_t espnow_air_us;         // ESP-NOW send call to the dongle's receive callback
+    uint32_t espnow_poll_us;        // host polling interval of the dongle's HID IN endpoint
+    uint32_t seed;                  // phase of the scan timer, USB frames and BLE anchor
+} sim_config_t;
+
+
+extern sim_config_t sim_config;
+
+// Set by keyboard_button_keep_awake(), the scan holds off power save like kbd_task() does
+extern bool sim_keep_awake;
+
+
+/**
+ * @brief   Phase offset derived from the run seed
+ * @param   salt: Different value for every clock that needs a phase
+ * @param   period_ns: Period of the clock
+ * @return  Offset in [0, period_ns)
+ * **/
+uint64_t sim_phase(uint32_t salt, uint64_t period_ns);
+
+
+/**
+ * @brief   First tick of a periodic clock strictly after a time
+ * @param   time_ns: Reference time
+ * @param   period_ns: Clock period
+ * @param   phase_ns: Clock phase from sim_phase()
+ * @return  Time of the tick
+ * **/
+uint64_t sim_next_tick(uint64_t time_ns, uint64_t period_ns, uint64_t phase_ns);
+
+
+/**
+ * @brief   A keyboard report became visible to the host
+ * @param   modifier: Modifier byte of the report
+ * @param   keys: Keycodes in the report, HID_KEY_NONE entries are ignored
+ * @param   key_num: Number of entries in keys
+ * @return  None
+ * @note    Called by the transport mocks at the simulated time the host reads the report
+ * **/
+void host_link_keyboard_report(uint8_t modifier, const uint8_t *keys, uint32_t key_num);
+
+
+// Counters kept by the transport mocks for the current run
+typedef struct {
+    uint32_t usb_reports;           // reports read by the host
+    uint32_t usb_busy_drops;        // tud_hid_n_report() refused, the previous report was still queued
+    uint32_t ble_notifications;
+    uint32_t espnow_frames;
+} sim_stats_t;
+
+
+extern sim_stats_t sim_stats;
@@ -0,0 +1,7 @@
+#pragma once
+
+// The real header pulls in FreeRTOS, and with it the task API hid_custom.c uses
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
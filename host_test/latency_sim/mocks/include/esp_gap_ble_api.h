@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+
+typedef struct {
+    uint16_t adv_int_min;
+    uint16_t adv_int_max;
+} esp_ble_adv_params_t;
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_bt_defs.h"
+
+typedef uint8_t esp_gatt_if_t;
@@ -0,0 +1,4 @@
+#pragma once
+
+#include "esp_gatt_defs.h"
+#include "esp_err.h"
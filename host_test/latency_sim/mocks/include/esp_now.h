@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define ESP_NOW_ETH_ALEN    6
+
+typedef enum {
+    ESP_NOW_SEND_SUCCESS = 0,
+    ESP_NOW_SEND_FAIL,
+} esp_now_send_status_t;
+
+/**
+ * @brief   Mock of the ESP-NOW send, the frame reaches the receiver after the configured air time
+ * **/
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len);
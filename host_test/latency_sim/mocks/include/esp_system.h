@@ -0,0 +1,8 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * @brief   A mode change restarts the chip, the simulator ends the run instead
+ * **/
+void esp_restart(void);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Simulated time in microseconds, see mock_freertos.c
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,6 @@
+// Host build of the firmware sources, only the options they read
+#pragma once
+
+#define CONFIG_FREERTOS_HZ                  100
+#define CONFIG_BT_SMP_MAX_BONDS             15
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ     160
@@ -0,0 +1,11 @@
+// Replaces esp_tinyusb's tusb_config.h: same device configuration, no OS abstraction
+#pragma once
+
+#define CFG_TUSB_MCU                OPT_MCU_ESP32S3
+#define CFG_TUSB_OS                 OPT_OS_NONE
+#define CFG_TUSB_RHPORT0_MODE       (OPT_MODE_DEVICE | OPT_MODE_FULL_SPEED)
+#define CFG_TUSB_DEBUG              0
+#define CFG_TUD_ENDPOINT0_SIZE      64
+
+#define CFG_TUD_HID                 4
+#define CFG_TUD_HID_EP_BUFSIZE      64
@@ -0,0 +1,208 @@
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "keyboard_button.h"
+#include "change_mode_interrupt.h"
+#include "power_policy.h"
+#include "deep_sleep.h"
+#include "led_state.h"
+#include "lamp_array.h"
+#include "macro_player.h"
+#include "macro_store.h"
+#include "steno_store.h"
+#include "config_store.h"
+#include "layout.h"
+#include "defer_log.h"
+#include "esp_system.h"
+#include "sim_core.h"
+#include "latency_sim.h"
+
+// Firmware modules hid_custom.c calls into that play no part in the latency of a report
+
+
+connection_mode_t current_mode = MODE_USB;
+QueueHandle_t gpio_evt_queue = NULL;
+
+
+void save_mode(connection_mode_t mode) {
+    (void)mode;
+}
+
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() requested by a mode change, run stopped\n");
+    sim_stop();
+    sim_task_block(SIM_FOREVER);
+}
+
+
+void defer_log_write(esp_log_level_t level, const char *tag, const char *format, const uint32_t *args, uint32_t arg_num) {
+    (void)level;
+    (void)tag;
+    (void)format;
+    (void)args;
+    (void)arg_num;
+}
+
+
+void led_state_set(connection_mode_t source, uint8_t leds) {
+    (void)source;
+    (void)leds;
+}
+
+
+void lamp_array_init(void) {
+}
+
+
+uint16_t lamp_array_get_report(uint8_t report_id, uint8_t *buffer, uint16_t reqlen) {
+    (void)report_id;
+    (void)buffer;
+    (void)reqlen;
+    return 0;
+}
+
+
+void lamp_array_set_report(uint8_t report_id, const uint8_t *buffer, uint16_t len) {
+    (void)report_id;
+    (void)buffer;
+    (void)len;
+}
+
+
+void lamp_array_set_autonomous_color(uint8_t red, uint8_t green, uint8_t blue) {
+    (void)red;
+    (void)green;
+    (void)blue;
+}
+
+
+void macro_player_init(macro_send_t send) {
+    (void)send;
+}
+
+
+// No player task in the simulation, change_mode() restarts straight away
+bool macro_player_play(const uint8_t *bytecode, macro_done_t done) {
+    (void)bytecode;
+    (void)done;
+    return false;
+}
+
+
+void macro_player_ready(void) {
+}
+
+
+bool macro_player_busy(void) {
+    return false;
+}
+
+
+esp_err_t save_recording_to_nvs(const macro_record_t *record) {
+    (void)record;
+    return ESP_OK;
+}
+
+
+esp_err_t load_recording_from_nvs(macro_record_t *record) {
+    (void)record;
+    return ESP_ERR_NOT_FOUND;
+}
+
+
+esp_err_t save_steno_protocol_to_nvs(steno_protocol_t protocol) {
+    (void)protocol;
+    return ESP_OK;
+}
+
+
+// The simulation measures the HID path, steno mode stays off
+steno_protocol_t load_steno_protocol_from_nvs(void) {
+    return STENO_PROTOCOL_NONE;
+}
+
+
+esp_err_t save_config_to_nvs(uint8_t profile, const keymap_table_t *keymap, const uint8_t *macro, size_t macro_len,
+                             const uint16_t *settings) {
+    (void)profile;
+    (void)keymap;
+    (void)macro;
+    (void)macro_len;
+    (void)settings;
+    return ESP_OK;
+}
+
+
+// Runs on the keymaps of the layout
+esp_err_t load_keymap_from_nvs(uint8_t profile, keymap_table_t *keymap) {
+    (void)profile;
+    (void)keymap;
+    return ESP_ERR_NOT_FOUND;
+}
+
+
+esp_err_t save_profile_to_nvs(uint8_t profile) {
+    (void)profile;
+    return ESP_OK;
+}
+
+
+// The first profile, the one the traces were typed on
+uint8_t load_profile_from_nvs(void) {
+    return 0;
+}
+
+
+// No flash to map, the layout built into the firmware
+const layout_image_t *layout_get(void) {
+    return &layout_default;
+}
+
+
+void power_policy_set_key_down(bool key_down) {
+    (void)key_down;
+}
+
+
+void deep_sleep_wake_key_seen(const keyboard_btn_report_t *kbd_report) {
+    (void)kbd_report;
+}
+
+
+void deep_sleep_report_sent(void) {
+}
+
+
+bool deep_sleep_take_wake_key(keyboard_btn_data_t *key) {
+    (void)key;
+    return false;
+}
+
+
+esp_err_t keyboard_button_create(keyboard_btn_config_t *kbd_cfg, keyboard_btn_handle_t *kbd_handle) {
+    (void)kbd_cfg;
+    (void)kbd_handle;
+    return ESP_OK;
+}
+
+
+esp_err_t keyboard_button_wake(keyboard_btn_handle_t kbd_handle) {
+    (void)kbd_handle;
+    return ESP_OK;
+}
+
+
+esp_err_t keyboard_button_keep_awake(keyboard_btn_handle_t kbd_handle, bool keep_awake) {
+    (void)kbd_handle;
+    sim_keep_awake = keep_awake;
+    return ESP_OK;
+}
+
+
+esp_err_t keyboard_button_register_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_cb_config_t cb_cfg, keyboard_btn_cb_handle_t *rtn_cb_hdl) {
+    (void)kbd_handle;
+    (void)cb_cfg;
+    (void)rtn_cb_hdl;
+    return ESP_OK;
+}
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_hidd_prf_api.h"
+#include "ble_main.h"
+#include "bond_cache.h"
+#include "sim_core.h"
+#include "latency_sim.h"
+
+// Notifications leave on the next connection event after the stack has handled them, the host
+// replaces its keyboard state with the content of every input report
+
+
+typedef struct {
+    uint8_t modifier;
+    uint8_t key_num;
+    uint8_t keys[6];
+} ble_notification_t;
+
+
+esp_ble_adv_params_t hidd_adv_params;
+int32_t current_ble_idx = 1;
+bool is_new_connection = false;
+bool is_change_to_paired_device = false;
+bt_host_info_t host_to_be_connected;
+bt_host_info_t empty_host;
+
+
+static void ble_connection_event(void *arg) {
+    ble_notification_t *notification = arg;
+    host_link_keyboard_report(notification->modifier, notification->keys, notification->key_num);
+    sim_stats.ble_notifications++;
+    free(notification);
+}
+
+
+void esp_hidd_send_keyboard_value(uint16_t conn_id, key_mask_t special_key_mask, uint8_t *keyboard_cmd, uint8_t num_key) {
+    (void)conn_id;
+    if (num_key > sizeof(((ble_notification_t *)0)->keys)) {
+        return;
+    }
+
+    ble_notification_t *notification = calloc(1, sizeof(ble_notification_t));
+    notification->modifier = special_key_mask;
+    notification->key_num = num_key;
+    memcpy(notification->keys, keyboard_cmd, num_key);
+
+    uint64_t interval_ns = (uint64_t)sim_config.ble_interval_us * 1000;
+    uint64_t ready_ns = sim_now() + (uint64_t)sim_config.ble_stack_us * 1000;
+    sim_schedule(sim_next_tick(ready_ns, interval_ns, sim_phase(3, interval_ns)), ble_connection_event, notification);
+}
+
+
+void esp_hidd_send_consumer_value(uint16_t conn_id, uint8_t key_cmd, bool key_pressed) {
+    (void)conn_id;
+    (void)key_cmd;
+    (void)key_pressed;
+}
+
+
+void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y, int8_t wheel) {
+    (void)conn_id;
+    (void)mouse_button;
+    (void)mickeys_x;
+    (void)mickeys_y;
+    (void)wheel;
+}
+
+
+void esp_hidd_macro_report(bool consumer) {
+    (void)consumer;
+}
+
+
+void esp_hidd_send_vendor_value(uint16_t conn_id, const uint8_t *data, uint8_t len) {
+    (void)conn_id;
+    (void)data;
+    (void)len;
+}
+
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params) {
+    (void)adv_params;
+    return ESP_OK;
+}
+
+
+void show_bonded_devices(void) {
+}
+
+
+void disconnect_all_bonded_devices(void) {
+}
+
+
+void remove_all_bonded_devices(void) {
+}
+
+
+esp_err_t delete_host_from_nvs(int index) {
+    (void)index;
+    return ESP_OK;
+}
+
+
+int bond_cache_bond_num(void) {
+    return 0;
+}
+
+
+void bond_cache_get_host(int index, bt_host_info_t *host) {
+    (void)index;
+    memset(host, 0, sizeof(bt_host_info_t));
+}
+
+
+void bond_cache_take_snapshot(void) {
+}
@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_now.h"
+#include "esp_now_main.h"
+#include "sim_core.h"
+#include "latency_sim.h"
+
+// The dongle receives the frame after the air time and forwards it on its own HID IN endpoint.
+// Payload from get_espnow_send_data(): [0] modifier, [1] fn flag, [2..7] keycode as ASCII decimal
+
+
+uint8_t peer_mac[ESP_NOW_ETH_ALEN];
+
+
+typedef struct {
+    uint8_t modifier;
+    uint8_t keycode;
+} espnow_frame_t;
+
+
+static void dongle_usb_in_complete(void *arg) {
+    espnow_frame_t *frame = arg;
+    host_link_keyboard_report(frame->modifier, &frame->keycode, 1);
+    free(frame);
+}
+
+
+static void dongle_recv(void *arg) {
+    uint64_t period_ns = (uint64_t)sim_config.espnow_poll_us * 1000;
+    sim_schedule(sim_next_tick(sim_now(), period_ns, sim_phase(4, period_ns)), dongle_usb_in_complete, arg);
+}
+
+
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len) {
+    (void)peer_addr;
+    if (len < 8) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char digits[7] = {0};
+    memcpy(digits, &data[2], 6);
+
+    espnow_frame_t *frame = calloc(1, sizeof(espnow_frame_t));
+    frame->modifier = data[0];
+    frame->keycode = (uint8_t)atoi(digits);
+    sim_stats.espnow_frames++;
+    sim_schedule(sim_now() + (uint64_t)sim_config.espnow_air_us * 1000, dongle_recv, frame);
+    return ESP_OK;
+}
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "sim_core.h"
+
+// Every blocking call below re-checks its condition after waking, a task may be woken for another reason
+
+#define TICK_NS     (1000000000ULL / configTICK_RATE_HZ)
+
+
+struct sim_queue {
+    uint8_t *buf;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    sim_task_t *receiver;
+};
+
+
+/**
+ * @brief   Absolute time a timeout of `ticks` expires, timeouts end on a tick interrupt like on the chip
+ * **/
+static uint64_t tick_deadline(TickType_t ticks) {
+    if (ticks == portMAX_DELAY) {
+        return SIM_FOREVER;
+    }
+    return ((uint64_t)xTaskGetTickCount() + ticks) * TICK_NS;
+}
+
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id) {
+    (void)stack_depth;
+    (void)priority;
+    (void)core_id;
+    sim_task_t *task = sim_task_create(name, fn, arg);
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+
+void vTaskDelay(TickType_t ticks) {
+    uint64_t deadline = tick_deadline(ticks);
+    while (sim_now() < deadline) {
+        sim_task_block(deadline);
+    }
+}
+
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == sim_task_current()) {
+        sim_task_exit();
+    }
+}
+
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(sim_now() / TICK_NS);
+}
+
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t)(sim_now() / 1000);
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return sim_task_current();
+}
+
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    (*sim_task_notify_value(task))++;
+    sim_task_wake(task);
+    return pdPASS;
+}
+
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    uint32_t *notify = sim_task_notify_value(sim_task_current());
+    uint64_t deadline = tick_deadline(ticks_to_wait);
+    while (*notify == 0 && ticks_to_wait != 0 && sim_now() < deadline) {
+        sim_task_block(deadline);
+    }
+
+    uint32_t value = *notify;
+    if (value) {
+        *notify = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct sim_queue *queue = calloc(1, sizeof(struct sim_queue));
+    queue->buf = calloc(length, item_size);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    // The firmware only sends with a zero timeout
+    (void)ticks_to_wait;
+    if (queue->count == queue->length) {
+        return errQUEUE_FULL;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->buf + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    sim_task_wake(queue->receiver);
+    return pdPASS;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+    uint64_t deadline = tick_deadline(ticks_to_wait);
+    while (queue->count == 0) {
+        if (ticks_to_wait == 0 || sim_now() >= deadline) {
+            return pdFALSE;
+        }
+        queue->receiver = sim_task_current();
+        sim_task_block(deadline);
+        queue->receiver = NULL;
+    }
+
+    memcpy(item, queue->buf + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+    // The firmware only peeks with a zero timeout
+    (void)ticks_to_wait;
+    if (queue->count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->buf + queue->head * queue->item_size, queue->item_size);
+    return pdTRUE;
+}
+
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    queue->head = 0;
+    queue->count = 0;
+    return pdPASS;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return queue->count;
+}
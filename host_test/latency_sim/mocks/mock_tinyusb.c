@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include "tinyusb.h"
+#include "descriptors.h"
+#include "sim_core.h"
+#include "latency_sim.h"
+
+// One HID IN endpoint per interface of tusb_main.c, each polled by the host every usb_poll_us
+
+
+typedef struct {
+    bool busy;
+    uint8_t report_id;
+    uint8_t data[CFG_TUD_HID_EP_BUFSIZE];
+    uint16_t len;
+} usb_in_endpoint_t;
+
+// Keys the host currently sees on one interface, the OS merges the keyboards
+typedef struct {
+    uint8_t modifier;
+    uint8_t keys[128];
+    uint32_t key_num;
+} host_keyboard_t;
+
+static usb_in_endpoint_t s_ep[CFG_TUD_HID];
+static host_keyboard_t s_host[CFG_TUD_HID];
+
+
+/**
+ * @brief   Host side decoding of the keyboard reports in the report descriptors of tusb_main.c
+ * **/
+static void host_decode_report(uint8_t instance, uint8_t report_id, const uint8_t *data, uint16_t len) {
+    host_keyboard_t *host = &s_host[instance];
+
+    if (instance == ITF_NUM_KEYBOARD && len >= 2) {
+        host->modifier = data[0];
+        host->key_num = 0;
+        for (uint16_t i = 2; i < len; i++) {
+            host->keys[host->key_num++] = data[i];
+        }
+    } else if (instance == ITF_NUM_NKRO && report_id == REPORT_ID_FULL_KEY_KEYBOARD && len >= 2) {
+        // Bit N of the bitmap is usage 4 + N
+        host->modifier = data[0];
+        host->key_num = 0;
+        for (uint16_t i = 2; i < len; i++) {
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                if (data[i] & (1 << bit)) {
+                    host->keys[host->key_num++] = (uint8_t)(4 + (i - 2) * 8 + bit);
+                }
+            }
+        }
+    } else {
+        // Consumer and vendor reports are not measured
+        return;
+    }
+
+    uint8_t modifier = 0;
+    uint8_t keys[CFG_TUD_HID * 128];
+    uint32_t key_num = 0;
+    for (int i = 0; i < CFG_TUD_HID; i++) {
+        modifier |= s_host[i].modifier;
+        memcpy(&keys[key_num], s_host[i].keys, s_host[i].key_num);
+        key_num += s_host[i].key_num;
+    }
+    host_link_keyboard_report(modifier, keys, key_num);
+}
+
+
+static void usb_in_complete(void *arg) {
+    uint8_t instance = (uint8_t)(uintptr_t)arg;
+    usb_in_endpoint_t *ep = &s_ep[instance];
+    host_decode_report(instance, ep->report_id, ep->data, ep->len);
+    ep->busy = false;
+    sim_stats.usb_reports++;
+
+    if (tud_hid_report_complete_cb) {
+        // Same buffer as the stack hands back: the report ID is only there when it was sent
+        uint8_t report[CFG_TUD_HID_EP_BUFSIZE + 1];
+        uint16_t len = 0;
+        if (ep->report_id) {
+            report[len++] = ep->report_id;
+        }
+        memcpy(&report[len], ep->data, ep->len);
+        tud_hid_report_complete_cb(instance, report, len + ep->len);
+    }
+}
+
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len) {
+    if (instance >= CFG_TUD_HID) {
+        return false;
+    }
+    usb_in_endpoint_t *ep = &s_ep[instance];
+    // Same as the stack: a report offered while the previous one waits for the host is refused
+    if (ep->busy || len > sizeof(ep->data)) {
+        sim_stats.usb_busy_drops++;
+        return false;
+    }
+
+    ep->busy = true;
+    ep->report_id = report_id;
+    ep->len = len;
+    memcpy(ep->data, report, len);
+
+    uint64_t period_ns = (uint64_t)sim_config.usb_poll_us * 1000;
+    sim_schedule(sim_next_tick(sim_now(), period_ns, sim_phase(2, period_ns)), usb_in_complete,
+                 (void *)(uintptr_t)instance);
+    return true;
+}
+
+
+bool tud_hid_n_ready(uint8_t instance) {
+    return instance < CFG_TUD_HID && !s_ep[instance].busy;
+}
+
+
+uint8_t tud_hid_n_get_protocol(uint8_t instance) {
+    (void)instance;
+    // No host in the simulation sends SET_PROTOCOL
+    return HID_PROTOCOL_REPORT;
+}
+
+
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, uint8_t keycode[6]) {
+    hid_keyboard_report_t report = {
+        .modifier = modifier,
+    };
+    if (keycode) {
+        memcpy(report.keycode, keycode, sizeof(report.keycode));
+    }
+    return tud_hid_n_report(instance, report_id, &report, sizeof(report));
+}
+
+
+bool tud_suspended(void) {
+    return false;
+}
+
+
+bool tud_remote_wakeup(void) {
+    return true;
+}
+
+
+void tud_task_ext(uint32_t timeout_ms, bool in_isr) {
+    (void)timeout_ms;
+    (void)in_isr;
+    // Transfers complete from scheduler events, the device task has nothing to do
+    sim_task_block(SIM_FOREVER);
+}
+
+
+esp_err_t tinyusb_driver_install(const tinyusb_config_t *config) {
+    (void)config;
+    memset(s_ep, 0, sizeof(s_ep));
+    memset(s_host, 0, sizeof(s_host));
+    return ESP_OK;
+}
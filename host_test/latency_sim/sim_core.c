@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "sim_core.h"
+
+#define SIM_TASK_STACK_SIZE     (256 * 1024)
+
+
+struct sim_task {
+    const char *name;
+    void (*fn)(void *);
+    void *arg;
+    ucontext_t ctx;
+    void *stack;
+    uint32_t block_token;       // bumped on every block, stale wake-ups carry an old token
+    bool blocked;
+    bool woken;
+    bool done;
+    uint32_t notify;
+};
+
+typedef struct {
+    uint64_t time_ns;
+    uint64_t seq;
+    sim_event_cb_t cb;
+    void *arg;
+    sim_task_t *task;           // set for task resumes
+    uint32_t token;
+} sim_event_t;
+
+
+static sim_event_t *s_heap = NULL;
+static size_t s_heap_num = 0;
+static size_t s_heap_cap = 0;
+static uint64_t s_seq = 0;
+
+static uint64_t s_now = 0;
+static bool s_stop = false;
+static ucontext_t s_scheduler_ctx;
+static sim_task_t *s_current = NULL;
+
+
+static bool event_before(const sim_event_t *a, const sim_event_t *b) {
+    return a->time_ns < b->time_ns || (a->time_ns == b->time_ns && a->seq < b->seq);
+}
+
+
+static void heap_push(sim_event_t ev) {
+    if (s_heap_num == s_heap_cap) {
+        s_heap_cap = s_heap_cap ? s_heap_cap * 2 : 256;
+        s_heap = realloc(s_heap, s_heap_cap * sizeof(sim_event_t));
+        if (!s_heap) {
+            abort();
+        }
+    }
+    ev.seq = s_seq++;
+    size_t i = s_heap_num++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!event_before(&ev, &s_heap[parent])) {
+            break;
+        }
+        s_heap[i] = s_heap[parent];
+        i = parent;
+    }
+    s_heap[i] = ev;
+}
+
+
+static sim_event_t heap_pop(void) {
+    sim_event_t top = s_heap[0];
+    sim_event_t last = s_heap[--s_heap_num];
+    size_t i = 0;
+    while (1) {
+        size_t child = i * 2 + 1;
+        if (child >= s_heap_num) {
+            break;
+        }
+        if (child + 1 < s_heap_num && event_before(&s_heap[child + 1], &s_heap[child])) {
+            child++;
+        }
+        if (!event_before(&s_heap[child], &last)) {
+            break;
+        }
+        s_heap[i] = s_heap[child];
+        i = child;
+    }
+    if (s_heap_num > 0) {
+        s_heap[i] = last;
+    }
+    return top;
+}
+
+
+uint64_t sim_now(void) {
+    return s_now;
+}
+
+
+void sim_schedule(uint64_t time_ns, sim_event_cb_t cb, void *arg) {
+    sim_event_t ev = {
+        .time_ns = time_ns < s_now ? s_now : time_ns,
+        .cb = cb,
+        .arg = arg,
+    };
+    heap_push(ev);
+}
+
+
+static void schedule_resume(sim_task_t *task, uint64_t time_ns) {
+    sim_event_t ev = {
+        .time_ns = time_ns,
+        .task = task,
+        .token = task->block_token,
+    };
+    heap_push(ev);
+}
+
+
+static void task_entry(void) {
+    sim_task_t *task = s_current;
+    task->fn(task->arg);
+    sim_task_exit();
+}
+
+
+sim_task_t *sim_task_create(const char *name, void (*fn)(void *), void *arg) {
+    sim_task_t *task = calloc(1, sizeof(sim_task_t));
+    if (!task) {
+        abort();
+    }
+    task->name = name;
+    task->fn = fn;
+    task->arg = arg;
+    task->stack = malloc(SIM_TASK_STACK_SIZE);
+    if (!task->stack) {
+        abort();
+    }
+
+    getcontext(&task->ctx);
+    task->ctx.uc_stack.ss_sp = task->stack;
+    task->ctx.uc_stack.ss_size = SIM_TASK_STACK_SIZE;
+    task->ctx.uc_link = &s_scheduler_ctx;
+    makecontext(&task->ctx, task_entry, 0);
+
+    // A new task is blocked until its first resume
+    task->blocked = true;
+    schedule_resume(task, s_now);
+    return task;
+}
+
+
+sim_task_t *sim_task_current(void) {
+    return s_current;
+}
+
+
+bool sim_task_block(uint64_t deadline_ns) {
+    sim_task_t *task = s_current;
+    if (!task) {
+        fprintf(stderr, "sim_task_block() called outside a task\n");
+        abort();
+    }
+
+    task->block_token++;
+    task->blocked = true;
+    task->woken = false;
+    if (deadline_ns != SIM_FOREVER) {
+        schedule_resume(task, deadline_ns);
+    }
+    swapcontext(&task->ctx, &s_scheduler_ctx);
+    return task->woken;
+}
+
+
+void sim_task_wake(sim_task_t *task) {
+    if (!task || !task->blocked || task->done) {
+        return;
+    }
+    task->woken = true;
+    schedule_resume(task, s_now);
+}
+
+
+uint32_t *sim_task_notify_value(sim_task_t *task) {
+    return &task->notify;
+}
+
+
+void sim_task_exit(void) {
+    sim_task_t *task = s_current;
+    task->done = true;
+    swapcontext(&task->ctx, &s_scheduler_ctx);
+    // Never resumed
+    abort();
+}
+
+
+static void resume(sim_task_t *task, uint32_t token) {
+    if (task->done || !task->blocked || task->block_token != token) {
+        return;
+    }
+    task->blocked = false;
+    s_current = task;
+    swapcontext(&s_scheduler_ctx, &task->ctx);
+    s_current = NULL;
+}
+
+
+void sim_run(uint64_t end_ns) {
+    s_stop = false;
+    while (s_heap_num > 0 && !s_stop) {
+        if (s_heap[0].time_ns > end_ns) {
+            break;
+        }
+        sim_event_t ev = heap_pop();
+        s_now = ev.time_ns;
+        if (ev.task) {
+            resume(ev.task, ev.token);
+        } else {
+            ev.cb(ev.arg);
+        }
+    }
+}
+
+
+void sim_stop(void) {
+    s_stop = true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_FOREVER     UINT64_MAX
+
+typedef struct sim_task sim_task_t;
+
+typedef void (*sim_event_cb_t)(void *arg);
+
+
+/**
+ * @brief   Current simulated time
+ * @return  Time in ns since the start of the run
+ * **/
+uint64_t sim_now(void);
+
+
+/**
+ * @brief   Run a callback at a simulated time
+ * @param   time_ns: Absolute time, events at the same time run in the order they were scheduled
+ * @param   cb: Callback, runs on the scheduler, must not block
+ * @param   arg: Callback argument
+ * @return  None
+ * **/
+void sim_schedule(uint64_t time_ns, sim_event_cb_t cb, void *arg);
+
+
+/**
+ * @brief   Create a cooperative task that starts at the current time
+ * @param   name: Task name, kept for debugging
+ * @param   fn: Task body, may block through sim_task_block()
+ * @param   arg: Task argument
+ * @return  Task handle
+ * **/
+sim_task_t *sim_task_create(const char *name, void (*fn)(void *), void *arg);
+
+
+/**
+ * @brief   Task running now
+ * @return  Task handle, NULL when called from the scheduler
+ * **/
+sim_task_t *sim_task_current(void);
+
+
+/**
+ * @brief   Block the current task until sim_task_wake() or a deadline
+ * @param   deadline_ns: Absolute time to give up, SIM_FOREVER to wait for a wake only
+ * @return  true if woken, false if the deadline passed
+ * @note    Code runs in zero simulated time, only blocking lets the clock move
+ * **/
+bool sim_task_block(uint64_t deadline_ns);
+
+
+/**
+ * @brief   Make a blocked task runnable at the current time
+ * @param   task: Task to wake, ignored if it is not blocked
+ * @return  None
+ * **/
+void sim_task_wake(sim_task_t *task);
+
+
+/**
+ * @brief   Notification counter of a task, used by the FreeRTOS mock
+ * @param   task: Task handle
+ * @return  Pointer to the counter
+ * **/
+uint32_t *sim_task_notify_value(sim_task_t *task);
+
+
+/**
+ * @brief   Finish the current task, it is never scheduled again
+ * @return  Does not return
+ * **/
+void sim_task_exit(void);
+
+
+/**
+ * @brief   Process events until the queue is empty or the time limit is reached
+ * @param   end_ns: Time limit
+ * @return  None
+ * **/
+void sim_run(uint64_t end_ns);
+
+
+/**
+ * @brief   Stop sim_run() after the current event
+ * @return  None
+ * **/
+void sim_stop(void);
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "layout_image.h"
+#include "macro.h"
+#include "test_harness.h"
+
+static layout_image_t s_image;
+
+static void test_default_is_valid(void)
+{
+    TEST_ASSERT(layout_image_check(&layout_default, sizeof(layout_default)));
+    // Fn is the leader key, every sequence is typed on the base layer
+    TEST_ASSERT(layout_default.profiles[0].leader_num > 0);
+    for (int p = 0; p < LAYOUT_PROFILE_NUM; p++) {
+        const layout_profile_t *profile = &layout_default.profiles[p];
+        for (int i = 0; i < profile->leader_num; i++) {
+            TEST_ASSERT(profile->leaders[i].key_num > 0);
+        }
+        // The lamps tell the profiles apart
+        for (int q = 0; q < p; q++) {
+            TEST_ASSERT(memcmp(&profile->color, &layout_default.profiles[q].color, sizeof(layout_color_t)) != 0);
+        }
+    }
+    // Every lamp sits under a key of its own
+    for (int i = 0; i < LAYOUT_LAMP_NUM; i++) {
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT(layout_default.lamps[i].row != layout_default.lamps[j].row
+                        || layout_default.lamps[i].col != layout_default.lamps[j].col);
+        }
+    }
+}
+
+static void test_built_image_matches(void)
+{
+    // The bytes the build writes to the partition are the table the firmware links
+    FILE *file = fopen(LAYOUT_IMAGE_PATH, "rb");
+    TEST_ASSERT(file != NULL);
+    size_t len = fread(&s_image, 1, sizeof(s_image), file);
+    int extra = fgetc(file);
+    fclose(file);
+    TEST_ASSERT(len == sizeof(layout_image_t));
+    TEST_ASSERT(extra == EOF);
+    TEST_ASSERT(memcmp(&s_image, &layout_default, sizeof(layout_image_t)) == 0);
+    TEST_ASSERT(layout_image_check(&s_image, len));
+}
+
+static void test_rejects_other_formats(void)
+{
+    s_image = layout_default;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image) - 1));
+
+    // An erased partition
+    memset(&s_image, 0xFF, sizeof(s_image));
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    s_image = layout_default;
+    s_image.header.version = LAYOUT_IMAGE_VERSION + 1;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    s_image = layout_default;
+    s_image.header.image_size = sizeof(layout_image_t) + 2;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    s_image = layout_default;
+    s_image.header.input_num = KEYMAP_INPUT_NUM + 1;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    s_image = layout_default;
+    s_image.header.profile_num = LAYOUT_PROFILE_NUM - 1;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+}
+
+static void test_rejects_bad_entries(void)
+{
+    s_image = layout_default;
+    s_image.lamps[LAYOUT_LAMP_NUM - 1].col = KEYMAP_INPUT_NUM;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    // Every profile is checked, not only the one active at boot
+    s_image = layout_default;
+    s_image.profiles[LAYOUT_PROFILE_NUM - 1].leader_num = LAYOUT_LEADER_NUM + 1;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    s_image = layout_default;
+    s_image.profiles[0].leaders[0].key_num = LAYOUT_LEADER_KEYS + 1;
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    // A macro without its end would run into the next entry
+    s_image = layout_default;
+    layout_leader_t *leader = &s_image.profiles[0].leaders[0];
+    memset(leader->macro, MACRO_OP_RELEASE_ALL, sizeof(leader->macro));
+    TEST_ASSERT(!layout_image_check(&s_image, sizeof(s_image)));
+
+    // Unused entries are not looked at
+    s_image = layout_default;
+    s_image.profiles[0].leaders[LAYOUT_LEADER_NUM - 1].key_num = 0xFF;
+    TEST_ASSERT(layout_image_check(&s_image, sizeof(s_image)));
+}
+
+int main(void)
+{
+    RUN_TEST(test_default_is_valid);
+    RUN_TEST(test_built_image_matches);
+    RUN_TEST(test_rejects_other_formats);
+    RUN_TEST(test_rejects_bad_entries);
+
+    return TEST_EXIT();
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "leader.h"
+#include "test_harness.h"
+
+// HID usages, spelled out so the test needs no TinyUSB headers
+#define KEY_A           0x04
+#define KEY_G           0x0A
+#define KEY_P           0x13
+#define KEY_S           0x16
+#define KEY_X           0x1B
+
+// Stand-ins for macros, only their addresses are compared
+static const uint8_t MACRO_PUSH[1];
+static const uint8_t MACRO_STATUS[1];
+static const uint8_t MACRO_SHORT[1];
+
+static leader_t s_leader;
+
+static void test_shared_prefix(void)
+{
+    const leader_seq_t seqs[] = {
+        LEADER_SEQ(MACRO_STATUS, KEY_G, KEY_S),
+        LEADER_SEQ(MACRO_PUSH, KEY_G, KEY_P),
+    };
+    TEST_ASSERT(leader_init(&s_leader, seqs, 2));
+    TEST_ASSERT(s_leader.node_num == 4);
+
+    const uint8_t *macro;
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 0, &macro) == LEADER_IDLE);
+    leader_start(&s_leader, 0);
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 100, &macro) == LEADER_NEXT);
+    TEST_ASSERT(leader_key(&s_leader, KEY_P, 200, &macro) == LEADER_DONE && macro == MACRO_PUSH);
+    TEST_ASSERT(!leader_active(&s_leader));
+
+    leader_start(&s_leader, 1000);
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 1100, &macro) == LEADER_NEXT);
+    TEST_ASSERT(leader_key(&s_leader, KEY_S, 1200, &macro) == LEADER_DONE && macro == MACRO_STATUS);
+}
+
+static void test_no_match(void)
+{
+    const leader_seq_t seqs[] = {LEADER_SEQ(MACRO_PUSH, KEY_G, KEY_P)};
+    TEST_ASSERT(leader_init(&s_leader, seqs, 1));
+    const uint8_t *macro;
+    leader_start(&s_leader, 0);
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 10, &macro) == LEADER_NEXT);
+    TEST_ASSERT(leader_key(&s_leader, KEY_X, 20, &macro) == LEADER_DONE && macro == NULL);
+    TEST_ASSERT(!leader_active(&s_leader));
+}
+
+static void test_timeout_per_key(void)
+{
+    const leader_seq_t seqs[] = {LEADER_SEQ(MACRO_PUSH, KEY_G, KEY_P)};
+    TEST_ASSERT(leader_init(&s_leader, seqs, 1));
+    const uint8_t *macro;
+    leader_start(&s_leader, 0);
+    TEST_ASSERT(leader_tick(&s_leader, LEADER_TIMEOUT_MS - 1) == NULL && leader_active(&s_leader));
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, LEADER_TIMEOUT_MS - 1, &macro) == LEADER_NEXT);
+    // The next key restarted the timeout
+    TEST_ASSERT(leader_tick(&s_leader, 2 * LEADER_TIMEOUT_MS - 2) == NULL && leader_active(&s_leader));
+    TEST_ASSERT(leader_tick(&s_leader, 2 * LEADER_TIMEOUT_MS - 1) == NULL && !leader_active(&s_leader));
+    TEST_ASSERT(leader_key(&s_leader, KEY_P, 2 * LEADER_TIMEOUT_MS, &macro) == LEADER_IDLE);
+}
+
+static void test_prefix_completes_on_timeout(void)
+{
+    const leader_seq_t seqs[] = {
+        LEADER_SEQ(MACRO_PUSH, KEY_G, KEY_P),
+        LEADER_SEQ(MACRO_SHORT, KEY_G),
+    };
+    TEST_ASSERT(leader_init(&s_leader, seqs, 2));
+    const uint8_t *macro;
+    leader_start(&s_leader, 0);
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 10, &macro) == LEADER_NEXT);
+    TEST_ASSERT(leader_tick(&s_leader, 10 + LEADER_TIMEOUT_MS) == MACRO_SHORT);
+
+    leader_start(&s_leader, 5000);
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 5010, &macro) == LEADER_NEXT);
+    TEST_ASSERT(leader_key(&s_leader, KEY_P, 5020, &macro) == LEADER_DONE && macro == MACRO_PUSH);
+
+    // A cancelled sequence never completes, not even on its timeout
+    leader_start(&s_leader, 9000);
+    TEST_ASSERT(leader_key(&s_leader, KEY_G, 9010, &macro) == LEADER_NEXT);
+    leader_cancel(&s_leader);
+    TEST_ASSERT(!leader_active(&s_leader));
+    TEST_ASSERT(leader_tick(&s_leader, 9010 + LEADER_TIMEOUT_MS) == NULL);
+}
+
+static void test_equal_sequences_first_wins(void)
+{
+    const leader_seq_t seqs[] = {
+        LEADER_SEQ(MACRO_PUSH, KEY_A, KEY_S),
+        LEADER_SEQ(MACRO_STATUS, KEY_A, KEY_S),
+    };
+    TEST_ASSERT(leader_init(&s_leader, seqs, 2));
+    const uint8_t *macro;
+    leader_start(&s_leader, 0);
+    leader_key(&s_leader, KEY_A, 1, &macro);
+    TEST_ASSERT(leader_key(&s_leader, KEY_S, 2, &macro) == LEADER_DONE && macro == MACRO_PUSH);
+}
+
+static void test_wide_node(void)
+{
+    // 26 one-key sequences under the root, every one found by the binary search
+    static uint8_t keys[26];
+    static uint8_t macros[26];
+    leader_seq_t seqs[26];
+    for (int i = 0; i < 26; i++) {
+        keys[i] = KEY_A + 25 - i;
+        seqs[i] = (leader_seq_t) {.keys = &keys[i], .key_num = 1, .macro = &macros[i]};
+    }
+    TEST_ASSERT(leader_init(&s_leader, seqs, 26));
+    TEST_ASSERT(s_leader.nodes[0].child_num == 26);
+    for (int i = 0; i < 26; i++) {
+        const uint8_t *macro;
+        leader_start(&s_leader, 0);
+        TEST_ASSERT(leader_key(&s_leader, keys[i], 1, &macro) == LEADER_DONE && macro == &macros[i]);
+    }
+}
+
+static void test_init_rejects(void)
+{
+    static uint8_t long_keys[LEADER_MAX_NODES];
+    memset(long_keys, KEY_A, sizeof(long_keys));
+    const leader_seq_t too_long[] = {{.keys = long_keys, .key_num = LEADER_MAX_NODES, .macro = MACRO_PUSH}};
+    TEST_ASSERT(!leader_init(&s_leader, too_long, 1));
+    TEST_ASSERT(s_leader.node_num == 1 && s_leader.nodes[0].child_num == 0);
+
+    const leader_seq_t empty[] = {{.keys = long_keys, .key_num = 0, .macro = MACRO_PUSH}};
+    TEST_ASSERT(!leader_init(&s_leader, empty, 1));
+
+    const uint8_t *macro;
+    leader_start(&s_leader, 0);
+    TEST_ASSERT(leader_key(&s_leader, KEY_A, 1, &macro) == LEADER_DONE && macro == NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_shared_prefix);
+    RUN_TEST(test_no_match);
+    RUN_TEST(test_timeout_per_key);
+    RUN_TEST(test_prefix_completes_on_timeout);
+    RUN_TEST(test_equal_sequences_first_wins);
+    RUN_TEST(test_wide_node);
+    RUN_TEST(test_init_rejects);
+
+    return TEST_EXIT();
+}
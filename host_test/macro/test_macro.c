@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "macro_record.h"
+#include "test_harness.h"
+
+// HID usages, spelled out so the test needs no TinyUSB headers
+#define KEY_A           0x04
+#define KEY_B           0x05
+#define KEY_R           0x15
+#define KEY_C           0x06
+#define KEY_CTRL_LEFT   0xE0
+#define KEY_SHIFT_LEFT  0xE1
+#define USAGE_MUTE      0xE2
+#define MAX_REPORTS     16
+
+/**
+ * @brief Step a macro to its end and collect every report
+ */
+static uint32_t play(const uint8_t *bytecode, macro_report_t *reports, macro_t *macro)
+{
+    uint32_t num = 0;
+    macro_start(macro, bytecode);
+    while (num < MAX_REPORTS && macro_step(macro, &reports[num])) {
+        num++;
+    }
+    return num;
+}
+
+static bool has_key(const macro_report_t *report, uint8_t keycode)
+{
+    return memchr(report->keycode, keycode, MACRO_REPORT_KEYS) != NULL;
+}
+
+static void test_tap_is_two_reports(void)
+{
+    static const uint8_t bytecode[] = {MACRO_TAP(KEY_A), MACRO_TAP(KEY_A), MACRO_END()};
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 4);
+    TEST_ASSERT(has_key(&reports[0], KEY_A) && !has_key(&reports[1], KEY_A));
+    TEST_ASSERT(has_key(&reports[2], KEY_A) && !has_key(&reports[3], KEY_A));
+    TEST_ASSERT(!macro_holds_keys(&macro));
+}
+
+static void test_modifiers_are_bits(void)
+{
+    static const uint8_t bytecode[] = {
+        MACRO_DOWN(KEY_CTRL_LEFT), MACRO_TAP(KEY_C), MACRO_UP(KEY_CTRL_LEFT), MACRO_END(),
+    };
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 4);
+    TEST_ASSERT(reports[0].modifier == 0x01 && !has_key(&reports[0], KEY_CTRL_LEFT));
+    TEST_ASSERT(reports[1].modifier == 0x01 && has_key(&reports[1], KEY_C));
+    TEST_ASSERT(reports[2].modifier == 0x01 && !has_key(&reports[2], KEY_C));
+    TEST_ASSERT(reports[3].modifier == 0);
+}
+
+static void test_release_all_and_consumer(void)
+{
+    static const uint8_t bytecode[] = {
+        MACRO_DOWN(KEY_SHIFT_LEFT), MACRO_DOWN(KEY_A), MACRO_CONSUMER(USAGE_MUTE), MACRO_RELEASE_ALL(), MACRO_CONSUMER(0),
+        MACRO_END(),
+    };
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 5);
+    TEST_ASSERT(reports[1].type == MACRO_REPORT_KEYBOARD && reports[1].modifier == 0x02 && has_key(&reports[1], KEY_A));
+    TEST_ASSERT(reports[2].type == MACRO_REPORT_CONSUMER && reports[2].usage == USAGE_MUTE);
+    TEST_ASSERT(reports[3].type == MACRO_REPORT_KEYBOARD && reports[3].modifier == 0 && !has_key(&reports[3], KEY_A));
+    TEST_ASSERT(reports[4].type == MACRO_REPORT_CONSUMER && reports[4].usage == 0);
+}
+
+static void test_held_keys_and_rollover(void)
+{
+    // A macro may end with keys down, the player releases them; a seventh key is dropped
+    static const uint8_t bytecode[] = {
+        MACRO_DOWN(0x04), MACRO_DOWN(0x05), MACRO_DOWN(0x06), MACRO_DOWN(0x07), MACRO_DOWN(0x08), MACRO_DOWN(0x09),
+        MACRO_DOWN(0x0A), MACRO_END(),
+    };
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 7);
+    TEST_ASSERT(has_key(&reports[6], 0x09) && !has_key(&reports[6], 0x0A));
+    TEST_ASSERT(macro_holds_keys(&macro));
+}
+
+static void test_unknown_opcode_ends(void)
+{
+    static const uint8_t bytecode[] = {MACRO_TAP(KEY_A), 0xFF, MACRO_TAP(KEY_A), MACRO_END()};
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 2);
+}
+
+static void test_wait_is_a_pause(void)
+{
+    static const uint8_t bytecode[] = {MACRO_TAP(KEY_A), MACRO_WAIT(300), MACRO_TAP(KEY_A), MACRO_END()};
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 5);
+    TEST_ASSERT(reports[2].type == MACRO_REPORT_WAIT && reports[2].wait_ms == 300);
+    TEST_ASSERT(reports[3].type == MACRO_REPORT_KEYBOARD && has_key(&reports[3], KEY_A));
+}
+
+static void test_length_checks_bounds(void)
+{
+    static const uint8_t bytecode[] = {MACRO_TAP(KEY_A), MACRO_WAIT(300), MACRO_RELEASE_ALL(), MACRO_END()};
+    TEST_ASSERT(macro_length(bytecode, sizeof(bytecode)) == sizeof(bytecode));
+    // Bytes after the end are not part of it
+    static const uint8_t slot[16] = {MACRO_TAP(KEY_A), MACRO_END(), 0xFF};
+    TEST_ASSERT(macro_length(slot, sizeof(slot)) == 3);
+    // The end, or the operand of the wait, past size
+    TEST_ASSERT(macro_length(bytecode, sizeof(bytecode) - 1) == 0);
+    TEST_ASSERT(macro_length(bytecode, 4) == 0);
+    static const uint8_t unknown[] = {MACRO_TAP(KEY_A), 0xFF, MACRO_END()};
+    TEST_ASSERT(macro_length(unknown, sizeof(unknown)) == 0);
+    TEST_ASSERT(macro_length(unknown, 0) == 0);
+}
+
+static void report(macro_record_t *record, uint8_t modifier, uint8_t key0, uint8_t key1, uint32_t now_ms)
+{
+    const uint8_t keycode[MACRO_REPORT_KEYS] = {key0, key1};
+    macro_record_report(record, modifier, keycode, now_ms);
+}
+
+/**
+ * @brief Fn + R held at the start, then Shift + A, B typed 100 ms later
+ */
+static void record_sample(macro_record_t *record)
+{
+    const uint8_t start[MACRO_REPORT_KEYS] = {KEY_R};
+    macro_record_start(record, 0, start, 1000);
+    report(record, 0, KEY_R, 0, 1010);              // Fn released, R still down
+    report(record, 0, 0, 0, 1020);                  // R released
+    report(record, 0x02, 0, 0, 1100);
+    report(record, 0x02, KEY_A, 0, 1150);
+    report(record, 0x02, 0x01, 0x01, 1160);         // rollover, skipped
+    report(record, 0, 0, 0, 1200);                  // A and Shift at once
+    report(record, 0, KEY_B, 0, 1300);
+    report(record, 0, 0, 0, 1340);
+    macro_record_stop(record);
+    report(record, 0, KEY_A, 0, 1400);              // not recording
+}
+
+static void test_record_diffs(void)
+{
+    static macro_record_t record;
+    record_sample(&record);
+    TEST_ASSERT(record.event_num == 6);
+
+    uint8_t bytecode[MACRO_RECORD_BYTECODE_SIZE];
+    TEST_ASSERT(macro_record_compile(&record, false, bytecode, sizeof(bytecode)) == 6 * 2 + 1);
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    TEST_ASSERT(play(bytecode, reports, &macro) == 6);
+    TEST_ASSERT(reports[0].modifier == 0x02 && !has_key(&reports[0], KEY_R));
+    TEST_ASSERT(reports[1].modifier == 0x02 && has_key(&reports[1], KEY_A));
+    TEST_ASSERT(reports[3].modifier == 0 && !has_key(&reports[3], KEY_A));
+    TEST_ASSERT(has_key(&reports[4], KEY_B) && !has_key(&reports[5], KEY_B));
+    TEST_ASSERT(!macro_holds_keys(&macro));
+}
+
+static void test_record_timed(void)
+{
+    // The pause before the first key is left out, the others are kept
+    static macro_record_t record;
+    record_sample(&record);
+    uint8_t bytecode[MACRO_RECORD_BYTECODE_SIZE];
+    TEST_ASSERT(macro_record_compile(&record, true, bytecode, sizeof(bytecode)) > 0);
+    macro_report_t reports[MAX_REPORTS];
+    macro_t macro;
+    uint32_t num = play(bytecode, reports, &macro);
+    uint32_t waits[MAX_REPORTS];
+    uint32_t wait_num = 0;
+    for (uint32_t i = 0; i < num; i++) {
+        if (reports[i].type == MACRO_REPORT_WAIT) {
+            waits[wait_num++] = reports[i].wait_ms;
+        }
+    }
+    TEST_ASSERT(reports[0].type == MACRO_REPORT_KEYBOARD);
+    TEST_ASSERT(wait_num == 4);
+    TEST_ASSERT(waits[0] == 50 && waits[1] == 50 && waits[2] == 100 && waits[3] == 40);
+    TEST_ASSERT(macro_record_compile(&record, true, bytecode, 8) == 0);
+}
+
+static void test_record_ring_keeps_newest(void)
+{
+    static macro_record_t record;
+    const uint8_t none[MACRO_REPORT_KEYS] = {0};
+    macro_record_start(&record, 0, none, 0);
+    for (uint32_t i = 0; i < MACRO_RECORD_EVENTS; i++) {
+        report(&record, 0, KEY_A + (i % 20), 0, i * 10);
+        report(&record, 0, 0, 0, i * 10 + 5);
+    }
+    TEST_ASSERT(record.event_num == MACRO_RECORD_EVENTS);
+    uint8_t bytecode[MACRO_RECORD_BYTECODE_SIZE];
+    TEST_ASSERT(macro_record_compile(&record, true, bytecode, sizeof(bytecode)) > 0);
+    // The second half of the presses is left: the first event is the press of i = 128
+    TEST_ASSERT(bytecode[0] == MACRO_OP_DOWN && bytecode[1] == KEY_A + (MACRO_RECORD_EVENTS / 2) % 20);
+}
+
+static void test_pack_round_trip(void)
+{
+    static macro_record_t record;
+    static macro_record_t loaded;
+    record_sample(&record);
+    record.events[(record.head + 5) % MACRO_RECORD_EVENTS].wait_ms = 0xFFFF;
+
+    uint8_t blob[MACRO_RECORD_PACK_SIZE];
+    size_t len = macro_record_pack(&record, blob, sizeof(blob));
+    TEST_ASSERT(len > 0 && len < 1 + record.event_num * sizeof(macro_record_event_t));
+    TEST_ASSERT(macro_record_unpack(&loaded, blob, len));
+    TEST_ASSERT(loaded.event_num == record.event_num && !loaded.recording);
+    for (uint32_t i = 0; i < record.event_num; i++) {
+        const macro_record_event_t *a = &record.events[(record.head + i) % MACRO_RECORD_EVENTS];
+        TEST_ASSERT(memcmp(a, &loaded.events[i], sizeof(macro_record_event_t)) == 0);
+    }
+
+    TEST_ASSERT(!macro_record_unpack(&loaded, blob, len - 1));
+    TEST_ASSERT(loaded.event_num == 0);
+    blob[0] = MACRO_RECORD_PACK_VERSION + 1;
+    TEST_ASSERT(!macro_record_unpack(&loaded, blob, len));
+}
+
+int main(void)
+{
+    RUN_TEST(test_tap_is_two_reports);
+    RUN_TEST(test_modifiers_are_bits);
+    RUN_TEST(test_release_all_and_consumer);
+    RUN_TEST(test_held_keys_and_rollover);
+    RUN_TEST(test_unknown_opcode_ends);
+    RUN_TEST(test_wait_is_a_pause);
+    RUN_TEST(test_length_checks_bounds);
+    RUN_TEST(test_record_diffs);
+    RUN_TEST(test_record_timed);
+    RUN_TEST(test_record_ring_keeps_newest);
+    RUN_TEST(test_pack_round_trip);
+
+    return TEST_EXIT();
+}
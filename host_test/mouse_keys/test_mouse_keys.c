@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mouse_keys.h"
+#include "test_harness.h"
+
+#define TICK_US         500         // same as the firmware
+#define TICKS(ms)       ((ms) * 1000 / TICK_US)
+
+static const mouse_keys_point_t FLAT[] = {{0, 100}};
+static const mouse_keys_point_t RAMP[] = {{0, 100}, {100, 100}, {1100, 1100}};
+static const mouse_keys_curve_t FLAT_CURVE = {FLAT, 1};
+static const mouse_keys_curve_t RAMP_CURVE = {RAMP, 3};
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t wheel;
+    uint32_t reports;
+    uint8_t buttons;
+} totals_t;
+
+/**
+ * @brief Run ticks, taking a report every take_every ticks like a transport polling at that rate
+ */
+static void run(mouse_keys_t *mk, uint32_t ticks, uint32_t take_every, totals_t *totals)
+{
+    for (uint32_t i = 1; i <= ticks; i++) {
+        mouse_keys_tick(mk);
+        mouse_keys_report_t report;
+        if (i % take_every == 0 && mouse_keys_take(mk, &report)) {
+            totals->x += report.x;
+            totals->y += report.y;
+            totals->wheel += report.wheel;
+            totals->buttons = report.buttons;
+            totals->reports++;
+        }
+    }
+}
+
+static void test_tap_moves_at_once(void)
+{
+    mouse_keys_t mk;
+    mouse_keys_init(&mk, &FLAT_CURVE, &FLAT_CURVE, TICK_US);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_LEFT));
+    mouse_keys_report_t report;
+    TEST_ASSERT(mouse_keys_take(&mk, &report) && report.x == -1 && report.y == 0);
+    mouse_keys_set(&mk, 0);
+    TEST_ASSERT(!mouse_keys_take(&mk, &report));
+    TEST_ASSERT(!mouse_keys_busy(&mk));
+}
+
+static void test_speed_independent_of_report_rate(void)
+{
+    // 100 counts/s for one second is 100 counts plus the first one, whether taken every tick or every 8 ms
+    const uint32_t rates[] = {1, 2, 16};
+    for (uint32_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        mouse_keys_t mk;
+        totals_t totals = {0};
+        mouse_keys_init(&mk, &FLAT_CURVE, &FLAT_CURVE, TICK_US);
+        mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_DOWN));
+        run(&mk, TICKS(1000), rates[r], &totals);
+        TEST_ASSERT(totals.y >= 100 && totals.y <= 101);
+        TEST_ASSERT(totals.x == 0);
+    }
+}
+
+static void test_acceleration_curve(void)
+{
+    mouse_keys_t mk;
+    totals_t totals = {0};
+    mouse_keys_init(&mk, &RAMP_CURVE, &FLAT_CURVE, TICK_US);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_RIGHT));
+    run(&mk, TICKS(100), 1, &totals);
+    TEST_ASSERT(totals.x >= 10 && totals.x <= 11);
+
+    // Halfway up the ramp, 600 counts/s
+    totals = (totals_t) {0};
+    run(&mk, TICKS(500), 1, &totals);
+    run(&mk, TICKS(100), 1, &(totals_t) {0});
+    totals = (totals_t) {0};
+    run(&mk, TICKS(10), 1, &totals);
+    TEST_ASSERT(totals.x >= 6 && totals.x <= 8);
+
+    // Past the last point, its speed holds
+    run(&mk, TICKS(1000), 1, &(totals_t) {0});
+    totals = (totals_t) {0};
+    run(&mk, TICKS(100), 1, &totals);
+    TEST_ASSERT(totals.x >= 109 && totals.x <= 111);
+
+    // Releasing starts over from the first point
+    mouse_keys_set(&mk, 0);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_RIGHT));
+    totals = (totals_t) {0};
+    run(&mk, TICKS(100), 1, &totals);
+    TEST_ASSERT(totals.x >= 10 && totals.x <= 11);
+}
+
+static void test_diagonal(void)
+{
+    mouse_keys_t mk;
+    totals_t totals = {0};
+    mouse_keys_init(&mk, &FLAT_CURVE, &FLAT_CURVE, TICK_US);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_UP) | MOUSE_KEY_BIT(MOUSE_KEY_LEFT));
+    run(&mk, TICKS(1000), 1, &totals);
+    TEST_ASSERT(totals.x == totals.y);
+    TEST_ASSERT(totals.x <= -70 && totals.x >= -72);
+}
+
+static void test_report_limit_keeps_rest(void)
+{
+    // A link that takes no report for a while gets the counts in steps of 127, up to the limit
+    static const mouse_keys_point_t fast[] = {{0, 60000}};
+    const mouse_keys_curve_t fast_curve = {fast, 1};
+    mouse_keys_t mk;
+    mouse_keys_init(&mk, &fast_curve, &FLAT_CURVE, TICK_US);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_RIGHT));
+    for (int i = 0; i < TICKS(100); i++) {
+        mouse_keys_tick(&mk);
+    }
+    mouse_keys_set(&mk, 0);
+    int32_t total = 0;
+    mouse_keys_report_t report;
+    while (mouse_keys_take(&mk, &report)) {
+        TEST_ASSERT(report.x <= 127);
+        total += report.x;
+    }
+    TEST_ASSERT(total == MOUSE_KEYS_ACC_LIMIT);
+}
+
+static void test_buttons_and_wheel(void)
+{
+    mouse_keys_t mk;
+    mouse_keys_init(&mk, &FLAT_CURVE, &FLAT_CURVE, TICK_US);
+    mouse_keys_report_t report;
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_BUTTON_1) | MOUSE_KEY_BIT(MOUSE_KEY_BUTTON_3));
+    TEST_ASSERT(mouse_keys_take(&mk, &report) && report.buttons == 0x05 && report.x == 0);
+    TEST_ASSERT(!mouse_keys_take(&mk, &report));
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_WHEEL_UP));
+    TEST_ASSERT(mouse_keys_take(&mk, &report) && report.buttons == 0 && report.wheel == 1);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_WHEEL_DOWN));
+    TEST_ASSERT(mouse_keys_take(&mk, &report) && report.wheel == -1);
+}
+
+static void test_fraction_cleared_on_release(void)
+{
+    mouse_keys_t mk;
+    mouse_keys_init(&mk, &FLAT_CURVE, &FLAT_CURVE, TICK_US);
+    mouse_keys_set(&mk, MOUSE_KEY_BIT(MOUSE_KEY_RIGHT));
+    mouse_keys_report_t report;
+    mouse_keys_take(&mk, &report);
+    for (int i = 0; i < TICKS(9); i++) {
+        mouse_keys_tick(&mk);
+    }
+    TEST_ASSERT(!mouse_keys_take(&mk, &report));
+    mouse_keys_set(&mk, 0);
+    TEST_ASSERT(mk.acc_x == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_tap_moves_at_once);
+    RUN_TEST(test_speed_independent_of_report_rate);
+    RUN_TEST(test_acceleration_curve);
+    RUN_TEST(test_diagonal);
+    RUN_TEST(test_report_limit_keeps_rest);
+    RUN_TEST(test_buttons_and_wheel);
+    RUN_TEST(test_fraction_cleared_on_release);
+
+    return TEST_EXIT();
+}
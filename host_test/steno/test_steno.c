@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "steno.h"
+#include "test_harness.h"
+
+#define BIT(key)        STENO_KEY_BIT(STENO_KEY_##key)
+
+static steno_t s_steno;
+
+static void test_rolled_chord_is_one_stroke(void)
+{
+    steno_init(&s_steno);
+    uint64_t stroke = 0;
+    // K, A and -T go down and come up one at a time, overlapping
+    TEST_ASSERT(!steno_set(&s_steno, BIT(KL), &stroke));
+    TEST_ASSERT(!steno_set(&s_steno, BIT(KL) | BIT(A), &stroke));
+    TEST_ASSERT(!steno_set(&s_steno, BIT(A), &stroke));
+    TEST_ASSERT(!steno_set(&s_steno, BIT(A) | BIT(TR), &stroke));
+    TEST_ASSERT(!steno_set(&s_steno, BIT(TR), &stroke));
+    TEST_ASSERT(steno_set(&s_steno, 0, &stroke));
+    TEST_ASSERT(stroke == (BIT(KL) | BIT(A) | BIT(TR)));
+
+    // The next stroke starts empty
+    TEST_ASSERT(!steno_set(&s_steno, BIT(S1), &stroke));
+    TEST_ASSERT(steno_set(&s_steno, 0, &stroke));
+    TEST_ASSERT(stroke == BIT(S1));
+}
+
+static void test_no_stroke_without_keys(void)
+{
+    steno_init(&s_steno);
+    uint64_t stroke = 0x1234;
+    TEST_ASSERT(!steno_set(&s_steno, 0, &stroke));
+    // Keys outside the steno layout are STENO_KEY_NONE
+    TEST_ASSERT(!steno_set(&s_steno, BIT(NONE), &stroke));
+    TEST_ASSERT(!steno_set(&s_steno, 0, &stroke));
+    TEST_ASSERT(stroke == 0x1234);
+}
+
+static void test_gemini_packet(void)
+{
+    uint8_t packet[STENO_PACKET_MAX];
+    TEST_ASSERT(steno_pack(BIT(S1), STENO_PROTOCOL_GEMINI, packet) == STENO_GEMINI_LEN);
+    const uint8_t s1[] = {0x80, 0x40, 0x00, 0x00, 0x00, 0x00};
+    TEST_ASSERT(memcmp(packet, s1, sizeof(s1)) == 0);
+
+    // Fn is the first key of the first byte, -Z the last key of the last one
+    TEST_ASSERT(steno_pack(BIT(FN) | BIT(ZR), STENO_PROTOCOL_GEMINI, packet) == STENO_GEMINI_LEN);
+    const uint8_t fn_z[] = {0xC0, 0x00, 0x00, 0x00, 0x00, 0x01};
+    TEST_ASSERT(memcmp(packet, fn_z, sizeof(fn_z)) == 0);
+
+    // KAT
+    TEST_ASSERT(steno_pack(BIT(KL) | BIT(A) | BIT(TR), STENO_PROTOCOL_GEMINI, packet) == STENO_GEMINI_LEN);
+    const uint8_t kat[] = {0x80, 0x08, 0x20, 0x00, 0x04, 0x00};
+    TEST_ASSERT(memcmp(packet, kat, sizeof(kat)) == 0);
+}
+
+static void test_gemini_every_key_once(void)
+{
+    uint8_t packet[STENO_PACKET_MAX];
+    uint8_t seen[STENO_GEMINI_LEN] = {0};
+    for (int key = STENO_KEY_FN; key < STENO_KEY_NUM; key++) {
+        TEST_ASSERT(steno_pack(STENO_KEY_BIT(key), STENO_PROTOCOL_GEMINI, packet) == STENO_GEMINI_LEN);
+        int bits = 0;
+        for (int i = 0; i < STENO_GEMINI_LEN; i++) {
+            uint8_t data = i == 0 ? packet[i] & 0x7F : packet[i];
+            TEST_ASSERT(!(packet[i] & 0x80) == (i != 0));
+            TEST_ASSERT(!(seen[i] & data));
+            seen[i] |= data;
+            bits += __builtin_popcount(data);
+        }
+        TEST_ASSERT(bits == 1);
+    }
+    for (int i = 0; i < STENO_GEMINI_LEN; i++) {
+        TEST_ASSERT(seen[i] == 0x7F);
+    }
+}
+
+static void test_txbolt_groups(void)
+{
+    uint8_t packet[STENO_PACKET_MAX];
+    // KAT: one byte for each group with keys, the last group ends the stroke
+    TEST_ASSERT(steno_pack(BIT(KL) | BIT(A) | BIT(TR), STENO_PROTOCOL_TXBOLT, packet) == 3);
+    const uint8_t kat[] = {0x04, 0x42, 0xC1};
+    TEST_ASSERT(memcmp(packet, kat, sizeof(kat)) == 0);
+
+    // Without the last group an empty byte ends the stroke
+    TEST_ASSERT(steno_pack(BIT(S2) | BIT(GR), STENO_PROTOCOL_TXBOLT, packet) == 3);
+    const uint8_t sg[] = {0x01, 0xA0, 0x00};
+    TEST_ASSERT(memcmp(packet, sg, sizeof(sg)) == 0);
+
+    // All four groups
+    uint64_t all = BIT(HL) | BIT(U) | BIT(FR) | BIT(ZR);
+    TEST_ASSERT(steno_pack(all, STENO_PROTOCOL_TXBOLT, packet) == 4);
+    const uint8_t groups[] = {0x20, 0x60, 0x81, 0xC8};
+    TEST_ASSERT(memcmp(packet, groups, sizeof(groups)) == 0);
+}
+
+static void test_txbolt_merges_keys(void)
+{
+    uint8_t packet[STENO_PACKET_MAX];
+    // Four stars and twelve number keys are one star and one number bar
+    TEST_ASSERT(steno_pack(BIT(ST1) | BIT(ST4) | BIT(N1) | BIT(NC), STENO_PROTOCOL_TXBOLT, packet) == 2);
+    const uint8_t star_num[] = {0x48, 0xD0};
+    TEST_ASSERT(memcmp(packet, star_num, sizeof(star_num)) == 0);
+
+    // Keys without a TX Bolt bit alone make no packet
+    TEST_ASSERT(steno_pack(BIT(FN) | BIT(PWR) | BIT(RES1), STENO_PROTOCOL_TXBOLT, packet) == 0);
+}
+
+static void test_pack_rejects(void)
+{
+    uint8_t packet[STENO_PACKET_MAX];
+    TEST_ASSERT(steno_pack(0, STENO_PROTOCOL_GEMINI, packet) == 0);
+    TEST_ASSERT(steno_pack(BIT(NONE), STENO_PROTOCOL_GEMINI, packet) == 0);
+    TEST_ASSERT(steno_pack(BIT(A), STENO_PROTOCOL_NONE, packet) == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_rolled_chord_is_one_stroke);
+    RUN_TEST(test_no_stroke_without_keys);
+    RUN_TEST(test_gemini_packet);
+    RUN_TEST(test_gemini_every_key_once);
+    RUN_TEST(test_txbolt_groups);
+    RUN_TEST(test_txbolt_merges_keys);
+    RUN_TEST(test_pack_rejects);
+
+    return TEST_EXIT();
+}
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tap_hold.h"
+#include "test_harness.h"
+
+#define TICK_US         1000
+#define TERM_MS         10          // 10 ticks
+#define MAX_EMITS       16
+#define MAX_KEYS        8
+
+static const keyboard_btn_data_t KEY_LT = {5, 11};
+static const keyboard_btn_data_t KEY_MT = {3, 1};
+static const keyboard_btn_data_t KEY_A = {3, 2};
+
+typedef struct {
+    uint32_t tick;
+    int change;
+    uint32_t key_num;
+    keyboard_btn_data_t keys[MAX_KEYS];
+    uint8_t hold_modifier;
+    uint8_t layer_mask;
+} emit_record_t;
+
+typedef struct {
+    tap_hold_t th;
+    tap_hold_key_t keys[2];
+    keyboard_btn_data_t pressed[MAX_KEYS];      // debounced matrix, press order like kbd_scan
+    uint32_t pressed_num;
+    keyboard_btn_data_t released[MAX_KEYS];
+    uint32_t released_num;
+    uint32_t tick;
+    emit_record_t emits[MAX_EMITS];
+    uint32_t emit_num;
+} fixture_t;
+
+static void on_emit(const tap_hold_output_t *output, void *user_data)
+{
+    fixture_t *f = user_data;
+    if (f->emit_num == MAX_EMITS) {
+        return;
+    }
+    emit_record_t *record = &f->emits[f->emit_num++];
+    record->tick = f->tick;
+    record->change = output->report.key_change_num;
+    record->key_num = output->report.key_pressed_num < MAX_KEYS ? output->report.key_pressed_num : MAX_KEYS;
+    memcpy(record->keys, output->report.key_data, record->key_num * sizeof(keyboard_btn_data_t));
+    record->hold_modifier = output->hold_modifier;
+    record->layer_mask = output->layer_mask;
+}
+
+/**
+ * @brief Layer-tap on KEY_LT (layer 1) and mod-tap on KEY_MT (left shift), both with the given flags
+ */
+static void fixture_init(fixture_t *f, uint8_t flags, uint16_t term_ms)
+{
+    memset(f, 0, sizeof(fixture_t));
+    f->keys[0] = (tap_hold_key_t) {KEY_LT.output_index, KEY_LT.input_index, TAP_HOLD_LAYER_TAP, 1, flags, term_ms};
+    f->keys[1] = (tap_hold_key_t) {KEY_MT.output_index, KEY_MT.input_index, TAP_HOLD_MOD_TAP, 0x02, flags, term_ms};
+    tap_hold_init(&f->th, f->keys, 2, TICK_US, on_emit, f);
+}
+
+static void fixture_press(fixture_t *f, keyboard_btn_data_t key)
+{
+    f->pressed[f->pressed_num++] = key;
+}
+
+static void fixture_release(fixture_t *f, keyboard_btn_data_t key)
+{
+    for (uint32_t i = 0; i < f->pressed_num; i++) {
+        if (f->pressed[i].output_index == key.output_index && f->pressed[i].input_index == key.input_index) {
+            memmove(&f->pressed[i], &f->pressed[i + 1], (f->pressed_num - i - 1) * sizeof(keyboard_btn_data_t));
+            f->pressed_num--;
+            f->released[f->released_num++] = key;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Run ticks scan ticks, the staged presses and releases land on the first one
+ */
+static void fixture_run(fixture_t *f, uint32_t ticks)
+{
+    for (uint32_t i = 0; i < ticks; i++) {
+        f->tick++;
+        keyboard_btn_report_t report = {
+            .key_change_num = 0,
+            .key_pressed_num = f->pressed_num,
+            .key_release_num = f->released_num,
+            .key_data = f->pressed,
+            .key_release_data = f->released,
+        };
+        tap_hold_tick(&f->th, &report);
+        f->released_num = 0;
+    }
+}
+
+static bool same_key(keyboard_btn_data_t a, keyboard_btn_data_t b)
+{
+    return a.output_index == b.output_index && a.input_index == b.input_index;
+}
+
+static void test_tap(void)
+{
+    // Pressed and released inside the term: the key itself, on release
+    fixture_t f;
+    fixture_init(&f, 0, TERM_MS);
+    fixture_press(&f, KEY_LT);
+    fixture_run(&f, 5);
+    TEST_ASSERT(f.emit_num == 0);
+    TEST_ASSERT(tap_hold_pending(&f.th));
+    fixture_release(&f, KEY_LT);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 2);
+    TEST_ASSERT(f.emits[0].change == 1 && f.emits[0].key_num == 1 && same_key(f.emits[0].keys[0], KEY_LT));
+    TEST_ASSERT(f.emits[1].change == -1 && f.emits[1].key_num == 0);
+    TEST_ASSERT(f.emits[0].layer_mask == 0 && f.emits[1].layer_mask == 0);
+    TEST_ASSERT(!tap_hold_pending(&f.th));
+}
+
+static void test_hold_on_term(void)
+{
+    // Held alone: hold on the tick the term ends, not one tick earlier or later
+    fixture_t f;
+    fixture_init(&f, 0, TERM_MS);
+    fixture_press(&f, KEY_MT);
+    fixture_run(&f, 10);
+    TEST_ASSERT(f.emit_num == 0);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 1);
+    TEST_ASSERT(f.emits[0].tick == 1 + TERM_MS * 1000 / TICK_US);
+    TEST_ASSERT(f.emits[0].change == 1 && f.emits[0].key_num == 0 && f.emits[0].hold_modifier == 0x02);
+    fixture_release(&f, KEY_MT);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 2);
+    TEST_ASSERT(f.emits[1].change == -1 && f.emits[1].hold_modifier == 0);
+}
+
+static void test_hold_past_wheel_round(void)
+{
+    // The default term is longer than one turn of the wheel
+    fixture_t f;
+    fixture_init(&f, 0, 0);
+    fixture_press(&f, KEY_LT);
+    fixture_run(&f, TAP_HOLD_TAPPING_TERM_MS * 1000 / TICK_US + 1);
+    TEST_ASSERT(f.emit_num == 1);
+    TEST_ASSERT(f.emits[0].tick == 1 + TAP_HOLD_TAPPING_TERM_MS * 1000 / TICK_US);
+    TEST_ASSERT(f.emits[0].change == 0 && f.emits[0].layer_mask == 0x02);
+}
+
+static void test_hold_replays_keys(void)
+{
+    // A key pressed during the term waits and comes out after the hold, on the same tick
+    fixture_t f;
+    fixture_init(&f, 0, TERM_MS);
+    fixture_press(&f, KEY_MT);
+    fixture_run(&f, 3);
+    fixture_press(&f, KEY_A);
+    fixture_run(&f, 7);
+    TEST_ASSERT(f.emit_num == 0);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 2);
+    TEST_ASSERT(f.emits[0].hold_modifier == 0x02 && f.emits[0].key_num == 0);
+    TEST_ASSERT(f.emits[1].change == 1 && f.emits[1].key_num == 1 && same_key(f.emits[1].keys[0], KEY_A));
+    TEST_ASSERT(f.emits[1].hold_modifier == 0x02 && f.emits[1].tick == f.emits[0].tick);
+}
+
+static void test_hold_on_other_key_press(void)
+{
+    // Fn + key: the layer is on before the key is looked up, without waiting for the term
+    fixture_t f;
+    fixture_init(&f, TAP_HOLD_HOLD_ON_OTHER_KEY_PRESS, TERM_MS);
+    fixture_press(&f, KEY_LT);
+    fixture_run(&f, 2);
+    fixture_press(&f, KEY_A);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 2);
+    TEST_ASSERT(f.emits[0].tick == 3 && f.emits[0].change == 0 && f.emits[0].layer_mask == 0x02);
+    TEST_ASSERT(f.emits[1].change == 1 && same_key(f.emits[1].keys[0], KEY_A) && f.emits[1].layer_mask == 0x02);
+    fixture_release(&f, KEY_A);
+    fixture_release(&f, KEY_LT);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 4);
+    TEST_ASSERT(f.emits[3].key_num == 0 && f.emits[3].layer_mask == 0);
+}
+
+static void test_permissive_hold(void)
+{
+    // A key tapped entirely inside the term makes the mod-tap a hold, decided on that release
+    fixture_t f;
+    fixture_init(&f, TAP_HOLD_PERMISSIVE_HOLD, TERM_MS);
+    fixture_press(&f, KEY_MT);
+    fixture_run(&f, 2);
+    fixture_press(&f, KEY_A);
+    fixture_run(&f, 2);
+    TEST_ASSERT(f.emit_num == 0);
+    fixture_release(&f, KEY_A);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 3);
+    TEST_ASSERT(f.emits[0].hold_modifier == 0x02);
+    TEST_ASSERT(f.emits[1].change == 1 && same_key(f.emits[1].keys[0], KEY_A) && f.emits[1].hold_modifier == 0x02);
+    TEST_ASSERT(f.emits[2].change == -1 && f.emits[2].key_num == 0 && f.emits[2].hold_modifier == 0x02);
+}
+
+static void test_rolling_tap(void)
+{
+    // Mod-tap released before the key rolled onto it: both taps, in press order
+    fixture_t f;
+    fixture_init(&f, TAP_HOLD_PERMISSIVE_HOLD, TERM_MS);
+    fixture_press(&f, KEY_MT);
+    fixture_run(&f, 2);
+    fixture_press(&f, KEY_A);
+    fixture_run(&f, 2);
+    fixture_release(&f, KEY_MT);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 3);
+    TEST_ASSERT(f.emits[0].change == 1 && same_key(f.emits[0].keys[0], KEY_MT));
+    TEST_ASSERT(f.emits[1].change == 1 && f.emits[1].key_num == 2 && same_key(f.emits[1].keys[1], KEY_A));
+    TEST_ASSERT(f.emits[2].change == -1 && f.emits[2].key_num == 1 && same_key(f.emits[2].keys[0], KEY_A));
+    TEST_ASSERT(f.emits[2].hold_modifier == 0);
+    fixture_release(&f, KEY_A);
+    fixture_run(&f, 1);
+    TEST_ASSERT(f.emit_num == 4 && f.emits[3].key_num == 0);
+}
+
+static void test_full_buffer(void)
+{
+    // More held back events than fit: the pending key is forced to hold and nothing is lost
+    static const keyboard_btn_data_t row[] = {{1, 1}, {1, 2}, {1, 3}, {1, 4}, {1, 5}, {1, 6}, {1, 7}};
+    fixture_t f;
+    fixture_init(&f, 0, 0);
+    fixture_press(&f, KEY_MT);
+    fixture_run(&f, 1);
+    uint32_t taps = 0;
+    while (taps * 2 <= TAP_HOLD_MAX_EVENTS) {
+        keyboard_btn_data_t key = row[taps % 7];
+        fixture_press(&f, key);
+        fixture_run(&f, 1);
+        fixture_release(&f, key);
+        fixture_run(&f, 1);
+        taps++;
+    }
+    TEST_ASSERT(f.emit_num >= 1 && f.emits[0].hold_modifier == 0x02);
+    TEST_ASSERT(!tap_hold_pending(&f.th));
+}
+
+int main(void)
+{
+    RUN_TEST(test_tap);
+    RUN_TEST(test_hold_on_term);
+    RUN_TEST(test_hold_past_wheel_round);
+    RUN_TEST(test_hold_replays_keys);
+    RUN_TEST(test_hold_on_other_key_press);
+    RUN_TEST(test_permissive_hold);
+    RUN_TEST(test_rolling_tap);
+    RUN_TEST(test_full_buffer);
+
+    return TEST_EXIT();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_adc/adc_oneshot.h"
+
+#define BATTERY_ADC_UNIT            ADC_UNIT_1
+#define BATTERY_ADC_CHANNEL         ADC_CHANNEL_9   // GPIO10, ADC1 keeps working while the radio is on
+#define BATTERY_ADC_ATTEN           ADC_ATTEN_DB_12
+#define BATTERY_DIVIDER_RATIO       2               // 100k / 100k divider between the cell and the pin
+
+#define BATTERY_SAMPLE_COUNT        16
+#define BATTERY_SAMPLE_PERIOD_MS    (60 * 1000)
+#define BATTERY_NOTIFY_STEP         10              // percent
+#define BATTERY_NOTIFY_HYSTERESIS   2               // percent
+
+#define BATTERY_TASK_CORE           1               // keyboard scan task runs on core 0 (cfg.core_id)
+#define BATTERY_TASK_PRIORITY       1
+
+
+/**
+ * @brief   Convert a cell voltage to a battery level
+ * @param   voltage_mv: Cell voltage in mV, after the divider is compensated
+ * @return  Battery level in percent
+ * @note    Linear interpolation over a single cell LiPo discharge curve
+ * **/
+uint8_t battery_voltage_to_level(int voltage_mv);
+
+
+/**
+ * @brief   Last sampled battery level
+ * @return  Battery level in percent
+ * **/
+uint8_t battery_get_level(void);
+
+
+/**
+ * @brief   Start the battery monitor task
+ * @return  None
+ * @note    The task samples BATTERY_SAMPLE_COUNT times every BATTERY_SAMPLE_PERIOD_MS and sleeps in between.
+ *          The BAS characteristic is notified only when the level crosses a BATTERY_NOTIFY_STEP boundary.
+ * **/
+void battery_main(void);
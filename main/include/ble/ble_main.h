@@ -1,3 +1,5 @@
+#pragma once
+
 #include "esp_bt_defs.h"
 #include "esp_gap_ble_api.h"
 
@@ -11,8 +13,18 @@ typedef struct {
     char name[MAX_BT_DEVICENAME_LENGTH + 1];
 } bt_host_info_t;
 
+// Link parameters negotiated with the connected host
+typedef struct {
+    uint8_t tx_phy;         // ESP_BLE_GAP_PHY_1M / 2M / CODED
+    uint8_t rx_phy;
+    uint16_t tx_octets;     // LL payload size, 27 ~ 251
+    uint16_t rx_octets;
+} ble_link_info_t;
+
 extern esp_ble_adv_params_t hidd_adv_params;
 
+extern esp_bd_addr_t current_bda;
+
 extern int32_t current_ble_idx;
 
 extern bool is_new_connection;
@@ -25,6 +37,8 @@ extern bt_host_info_t host_to_be_connected;
 
 extern bt_host_info_t empty_host;
 
+extern ble_link_info_t ble_link_info;
+
 void show_bonded_devices(void);
 
 char *bda_to_string(esp_bd_addr_t bda, char *str, size_t size);
@@ -49,4 +63,6 @@ esp_err_t load_host_from_nvs(int index, bt_host_info_t *host);
 
 esp_err_t delete_host_from_nvs(int index);
 
+void ble_send_battery_level(uint8_t level);
+
 void ble_main(void);
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_bt_defs.h"
+#include "ble_main.h"
+
+#define BOND_CACHE_MAX_BONDS    CONFIG_BT_SMP_MAX_BONDS
+#define BOND_CACHE_HOST_SLOTS   3
+
+
+/**
+ * @brief   Load the bond list from the stack and the host slots from NVS into RAM
+ * @return  None
+ * @note    Must be called after esp_bluedroid_enable(). This is the only place the cache allocates memory.
+ * **/
+void bond_cache_init(void);
+
+
+/**
+ * @brief   Add a bonded peer to the cache (ESP_GAP_BLE_AUTH_CMPL_EVT)
+ * @param   bda: Address of the peer
+ * @return  None
+ * @note    Adding a peer that is already cached does nothing
+ * **/
+void bond_cache_add_bond(const esp_bd_addr_t bda);
+
+
+/**
+ * @brief   Remove a bonded peer from the cache (ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT)
+ * @param   bda: Address of the peer
+ * @return  None
+ * **/
+void bond_cache_remove_bond(const esp_bd_addr_t bda);
+
+
+/**
+ * @brief   Drop every cached bond (ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT)
+ * @return  None
+ * **/
+void bond_cache_clear_bonds(void);
+
+
+/**
+ * @brief   Copy the cached bond addresses
+ * @param   bonds: Array to fill, at least max entries
+ * @param   max: Capacity of bonds
+ * @return  Number of addresses copied
+ * @note    The copy lets callers issue GAP requests without holding the cache lock
+ * **/
+int bond_cache_get_bonds(esp_bd_addr_t *bonds, int max);
+
+
+/**
+ * @brief   Number of cached bonds
+ * **/
+int bond_cache_bond_num(void);
+
+
+/**
+ * @brief   Check whether a peer is bonded
+ * **/
+bool bond_cache_has_bond(const esp_bd_addr_t bda);
+
+
+/**
+ * @brief   Read a host slot
+ * @param   index: Slot index, 1 ~ BOND_CACHE_HOST_SLOTS
+ * @param   host: Filled with the slot content, or empty_host when index is out of range
+ * @return  None
+ * **/
+void bond_cache_get_host(int index, bt_host_info_t *host);
+
+
+/**
+ * @brief   Update a host slot, called by save_host_to_nvs() and delete_host_from_nvs()
+ * @param   index: Slot index, 1 ~ BOND_CACHE_HOST_SLOTS
+ * @param   host: New content of the slot
+ * @return  None
+ * **/
+void bond_cache_set_host(int index, const bt_host_info_t *host);
+
+
+/**
+ * @brief   Find the host slot holding an address
+ * @param   bda: Address of the peer
+ * @return  Slot index 1 ~ BOND_CACHE_HOST_SLOTS, or 0 if the peer is not saved in any slot
+ * **/
+int bond_cache_host_index(const esp_bd_addr_t bda);
+
+
+/**
+ * @brief   Remember the current bond list before pairing with a new host
+ * @return  None
+ * @note    Replaces the heap copy that connect_new_ble_with_saving() used to keep
+ * **/
+void bond_cache_take_snapshot(void);
+
+
+/**
+ * @brief   Check whether a peer was bonded when bond_cache_take_snapshot() was called
+ * **/
+bool bond_cache_in_snapshot(const esp_bd_addr_t bda);
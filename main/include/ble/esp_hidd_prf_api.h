@@ -160,7 +160,24 @@ void esp_hidd_send_consumer_value(uint16_t conn_id, uint8_t key_cmd, bool key_pr
 
 void esp_hidd_send_keyboard_value(uint16_t conn_id, key_mask_t special_key_mask, uint8_t *keyboard_cmd, uint8_t num_key);
 
-void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y);
+void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y, int8_t wheel);
+
+// The macro player's next report is a consumer usage (true) or keys (false), only its confirmation paces the player
+void esp_hidd_macro_report(bool consumer);
+
+// Vendor input report of the configuration channel, shorter data is padded with zeros
+void esp_hidd_send_vendor_value(uint16_t conn_id, const uint8_t *data, uint8_t len);
+
+/**
+ *
+ * @brief           Update the battery level characteristic
+ *
+ * @param[in]       conn_id: connection to notify
+ * @param[in]       level: battery level in percent
+ * @param[in]       notify: send a notification if the host enabled them, otherwise only update the value
+ *
+ */
+void esp_hidd_send_battery_level(uint16_t conn_id, uint8_t level, bool notify);
 
 #ifdef __cplusplus
 }
@@ -15,7 +15,7 @@
 #include "esp_gap_ble_api.h"
 #include "hid_dev.h"
 
-#define SUPPORT_REPORT_VENDOR                 false
+#define SUPPORT_REPORT_VENDOR                 true    // raw HID configuration channel
 //HID BLE profile log tag
 #define HID_LE_PRF_TAG                        "HID_LE_PRF"
 
@@ -40,6 +40,7 @@
 #define HID_RPT_ID_KEY_IN        2   // Keyboard input report ID
 #define HID_RPT_ID_CC_IN         3   //Consumer Control input report ID
 #define HID_RPT_ID_VENDOR_OUT    4   // Vendor output report ID
+#define HID_RPT_ID_VENDOR_IN     5   // Vendor input report ID
 #define HID_RPT_ID_LED_OUT       2  // LED output report ID
 #define HID_RPT_ID_FEATURE       0  // Feature report ID
 
@@ -140,6 +141,11 @@ enum {
     HIDD_LE_IDX_REPORT_VENDOR_OUT_CHAR,
     HIDD_LE_IDX_REPORT_VENDOR_OUT_VAL,
     HIDD_LE_IDX_REPORT_VENDOR_OUT_REP_REF,
+
+    HIDD_LE_IDX_REPORT_VENDOR_IN_CHAR,
+    HIDD_LE_IDX_REPORT_VENDOR_IN_VAL,
+    HIDD_LE_IDX_REPORT_VENDOR_IN_CCC,
+    HIDD_LE_IDX_REPORT_VENDOR_IN_REP_REF,
 #endif
     HIDD_LE_IDX_REPORT_CC_IN_CHAR,
     HIDD_LE_IDX_REPORT_CC_IN_VAL,
@@ -313,6 +319,9 @@ typedef struct {
     hidd_inst_t                  hidd_inst;
     esp_hidd_event_cb_t          hidd_cb;
     uint8_t                      inst_id;
+    uint16_t                     bat_lvl_handle;       /* battery level value, 0 until the BAS table is created */
+    uint16_t                     bat_ntf_cfg_handle;   /* battery level CCCD */
+    uint16_t                     macro_handle;         /* report the macro player last wrote, one 16-bit store */
 } hidd_le_env_t;
 
 extern hidd_le_env_t hidd_le_env;
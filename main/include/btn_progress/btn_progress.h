@@ -1,3 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
 typedef struct {
     uint32_t report_id;    // Report identifier
     union {
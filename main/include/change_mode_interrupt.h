@@ -1,3 +1,5 @@
+#pragma once
+
 #include "freertos/queue.h"
 #include "esp_attr.h"
 #include "mode_gpio.h"
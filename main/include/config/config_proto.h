@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "keymap.h"
+#include "macro_record.h"
+
+#define CONFIG_PROTO_VERSION    1
+#define CONFIG_REPORT_LEN       32      // request and response, fits a BLE notification at the usual MTUs
+#define CONFIG_HEADER_LEN       4       // command, status or offset, length
+#define CONFIG_DATA_MAX         (CONFIG_REPORT_LEN - CONFIG_HEADER_LEN)
+
+
+/**
+ * Requests are [command, args...], responses [command, status, data...]. Offsets and values are little endian.
+ * Writes go to staging, nothing changes for the keys until CONFIG_CMD_COMMIT.
+ */
+typedef enum {
+    CONFIG_CMD_GET_INFO = 0x01,     // -> version, layers, outputs, inputs, macro size (u16)
+    CONFIG_CMD_KEYMAP_GET,          // layer, output, input -> entry
+    CONFIG_CMD_KEYMAP_SET,          // layer, output, input, entry
+    CONFIG_CMD_KEYMAP_READ,         // offset (u16), len -> len bytes of the layers, layer by layer, row by row
+    CONFIG_CMD_KEYMAP_WRITE,        // offset (u16), len, data
+    CONFIG_CMD_MACRO_READ,          // offset (u16), len -> len bytes of the recording as macro_record_pack() packs it
+    CONFIG_CMD_MACRO_WRITE,         // offset (u16), len, data, offset 0 starts a new recording
+    CONFIG_CMD_MACRO_LEN,           // -> length (u16) of the recording
+    CONFIG_CMD_SETTING_GET,         // setting -> value (u16)
+    CONFIG_CMD_SETTING_SET,         // setting, value (u16)
+    CONFIG_CMD_COMMIT,              // apply staging and save it with one NVS commit
+    CONFIG_CMD_DISCARD,             // drop staging
+    CONFIG_CMD_RESET,               // stage the keymap of the layout
+} config_cmd_t;
+
+
+typedef enum {
+    CONFIG_OK = 0,
+    CONFIG_ERR_COMMAND,             // unknown command
+    CONFIG_ERR_LENGTH,              // request too short for its arguments
+    CONFIG_ERR_RANGE,               // position, offset or value out of range
+    CONFIG_ERR_MACRO,               // the written recording does not unpack
+    CONFIG_ERR_STORE,               // NVS write failed, nothing was applied
+    CONFIG_ERR_BUSY,                // a recording or playback is running, or a commit is being saved, retry later
+    CONFIG_PENDING,                 // never sent, the commit callback handed the save to another task
+} config_status_t;
+
+
+typedef enum {
+    CONFIG_SETTING_STENO_PROTOCOL = 0,  // steno_protocol_t, takes effect at the next restart
+    CONFIG_SETTING_PROFILE,             // active profile of the layout, the keymap requests edit it
+    CONFIG_SETTING_NUM,
+} config_setting_t;
+
+
+typedef struct config config_t;
+
+// Packs the recording the keyboard holds now
+typedef size_t (*config_macro_pack_t)(uint8_t *blob, size_t size);
+
+/**
+ * Saves the dirty parts of staging in one NVS commit, then applies them. Runs in the task of the transport, so it
+ * either finishes at once or returns CONFIG_PENDING and lets another task finish with config_commit_done().
+ */
+typedef config_status_t (*config_commit_t)(config_t *config);
+
+
+// Staging of the configuration channel, edited by one transport task at a time
+struct config {
+    keymap_t *keymap;
+    const keymap_table_t *defaults;
+    config_macro_pack_t macro_pack;
+    config_commit_t commit;
+
+    uint16_t settings[CONFIG_SETTING_NUM];          // values in use
+    uint16_t staged_settings[CONFIG_SETTING_NUM];
+    uint16_t setting_max[CONFIG_SETTING_NUM];
+    uint8_t macro[MACRO_RECORD_PACK_SIZE];          // staged recording while macro_dirty, else the last one read
+    size_t macro_len;
+    bool keymap_dirty;
+    bool macro_dirty;
+    bool settings_dirty;
+    atomic_bool commit_pending;                     // staging belongs to the task finishing the commit
+};
+
+
+/**
+ * @brief   Set up the channel, nothing staged
+ * @param   config: Channel
+ * @param   keymap: Keymap edited through keymap_staging()
+ * @param   defaults: Keymap of the layout for CONFIG_CMD_RESET
+ * @param   settings: Values in use, CONFIG_SETTING_NUM entries
+ * @param   setting_max: Largest value of each setting
+ * @param   macro_pack: Packs the current recording
+ * @param   commit: Saves and applies staging
+ * @return  None
+ * **/
+void config_init(config_t *config, keymap_t *keymap, const keymap_table_t *defaults, const uint16_t *settings,
+                 const uint16_t *setting_max, config_macro_pack_t macro_pack, config_commit_t commit);
+
+
+/**
+ * @brief   Point the channel at the keymap of another profile, staging is dropped
+ * @param   config: Channel
+ * @param   keymap: Keymap edited from now on
+ * @param   defaults: Its keymap in the layout, for CONFIG_CMD_RESET
+ * @return  None
+ * @note    Runs in the transport task like config_handle(), set settings[CONFIG_SETTING_PROFILE] first
+ * **/
+void config_select(config_t *config, keymap_t *keymap, const keymap_table_t *defaults);
+
+
+/**
+ * @brief   Whether a commit the callback handed off is still being saved
+ * @param   config: Channel
+ * @return  True while config_handle() answers CONFIG_ERR_BUSY, staging must not be touched
+ * **/
+bool config_commit_pending(config_t *config);
+
+
+/**
+ * @brief   Handle one request
+ * @param   config: Channel
+ * @param   request: Report from the host, shorter reports are zero padded by the transport
+ * @param   len: Bytes in request
+ * @param   response: CONFIG_REPORT_LEN bytes, zero padded
+ * @return  Bytes of the response to send, 0 for none, also when config_commit_done() answers the commit
+ * @note    A commit the callback accepted leaves staging clean and equal to what is in use
+ * **/
+size_t config_handle(config_t *config, const uint8_t *request, size_t len, uint8_t *response);
+
+
+/**
+ * @brief   Finish a commit the callback answered with CONFIG_PENDING
+ * @param   config: Channel
+ * @param   status: Outcome of the save, CONFIG_OK applies staging like a commit done at once
+ * @param   response: CONFIG_REPORT_LEN bytes, zero padded
+ * @return  Bytes of the CONFIG_CMD_COMMIT response to send
+ * @note    Runs in the task that saved, the channel takes requests again once it returns
+ * **/
+size_t config_commit_done(config_t *config, config_status_t status, uint8_t *response);
+
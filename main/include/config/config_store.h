@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "keymap.h"
+
+#define CONFIG_STORE_KEYMAP_NVS_KEY     "keymap%u"  // keymap_table_t blob of a profile and the CRC of its layout keymap
+#define CONFIG_STORE_PROFILE_NVS_KEY    "profile"   // u8 index of the active profile
+
+
+/**
+ * @brief   Save what the configuration channel changed with a single NVS commit
+ * @param   profile: Profile the keymap belongs to
+ * @param   keymap: Layers to save, NULL to keep the saved ones
+ * @param   macro: Recording as macro_record_pack() packs it, NULL to keep the saved one
+ * @param   macro_len: Bytes in macro
+ * @param   settings: CONFIG_SETTING_NUM values, NULL to keep the saved ones
+ * @return  ESP_OK, or the NVS error. Nothing is committed on an error.
+ * @note    The recording and the steno protocol use the keys of macro_store and steno_store
+ * **/
+esp_err_t save_config_to_nvs(uint8_t profile, const keymap_table_t *keymap, const uint8_t *macro, size_t macro_len,
+                             const uint16_t *settings);
+
+
+/**
+ * @brief   Load the layers saved by save_config_to_nvs()
+ * @param   profile: Profile the keymap belongs to
+ * @param   keymap: Filled on success, untouched otherwise
+ * @return  ESP_OK, ESP_ERR_NVS_NOT_FOUND when nothing was saved, ESP_ERR_INVALID_SIZE for a keymap of another
+ *          format, ESP_ERR_INVALID_VERSION when another layout was flashed since the save
+ * @note    Stale keymaps are erased, the keymap of the layout in use takes over. Call it after layout_init().
+ * **/
+esp_err_t load_keymap_from_nvs(uint8_t profile, keymap_table_t *keymap);
+
+
+/**
+ * @brief   Save the profile the keyboard starts with
+ * @param   profile: Index in the layout
+ * @return  ESP_OK, or the NVS error
+ * @note    The same key CONFIG_SETTING_PROFILE is saved to
+ * **/
+esp_err_t save_profile_to_nvs(uint8_t profile);
+
+
+/**
+ * @brief   Load the profile saved by save_profile_to_nvs() or save_config_to_nvs()
+ * @return  The saved profile, 0 when nothing or nothing valid was saved
+ * **/
+uint8_t load_profile_from_nvs(void);
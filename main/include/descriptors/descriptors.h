@@ -1,5 +1,16 @@
+#pragma once
+
+// USB HID interfaces, each one has its own IN endpoint
+enum {
+    ITF_NUM_KEYBOARD = 0,   // boot protocol 6KRO keyboard, no report ID
+    ITF_NUM_NKRO,           // N-key rollover bitmap
+    ITF_NUM_CONSUMER,       // consumer control and mouse
+    ITF_NUM_VENDOR,         // raw HID, IN and OUT endpoints
+    ITF_NUM_TOTAL
+};
+
 enum {
-    REPORT_ID_KEYBOARD = 1,
+    REPORT_ID_KEYBOARD = 1, // internal tag of ITF_NUM_KEYBOARD reports, never sent
     REPORT_ID_FULL_KEY_KEYBOARD, // 2
     REPORT_ID_CONSUMER, // 3
     REPORT_ID_LIGHTING_LAMP_ARRAY_ATTRIBUTES, // 4
@@ -8,6 +19,7 @@ enum {
     REPORT_ID_LIGHTING_LAMP_MULTI_UPDATE, // 7
     REPORT_ID_LIGHTING_LAMP_RANGE_UPDATE, // 8
     REPORT_ID_LIGHTING_LAMP_ARRAY_CONTROL, // 9
+    REPORT_ID_MOUSE, // 10
     REPORT_ID_COUNT
 };
 
@@ -51,4 +63,195 @@ enum {
       HID_REPORT_COUNT ( 120                                    )  ,\
       HID_REPORT_SIZE  ( 1                                      )  ,\
       HID_INPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE )  ,\
-  HID_COLLECTION_END \
+  HID_COLLECTION_END
+
+// HID Usage Tables 1.4, Lighting And Illumination page
+#define HID_USAGE_PAGE_LIGHTING_AND_ILLUMINATION        0x59
+
+enum {
+    HID_USAGE_LIGHTING_LAMP_ARRAY                           = 0x01,
+    HID_USAGE_LIGHTING_LAMP_ARRAY_ATTRIBUTES_REPORT         = 0x02,
+    HID_USAGE_LIGHTING_LAMP_COUNT                           = 0x03,
+    HID_USAGE_LIGHTING_BOUNDING_BOX_WIDTH_IN_MICROMETERS    = 0x04,
+    HID_USAGE_LIGHTING_BOUNDING_BOX_HEIGHT_IN_MICROMETERS   = 0x05,
+    HID_USAGE_LIGHTING_BOUNDING_BOX_DEPTH_IN_MICROMETERS    = 0x06,
+    HID_USAGE_LIGHTING_LAMP_ARRAY_KIND                      = 0x07,
+    HID_USAGE_LIGHTING_MIN_UPDATE_INTERVAL_IN_MICROSECONDS  = 0x08,
+    HID_USAGE_LIGHTING_LAMP_ATTRIBUTES_REQUEST_REPORT       = 0x20,
+    HID_USAGE_LIGHTING_LAMP_ID                              = 0x21,
+    HID_USAGE_LIGHTING_LAMP_ATTRIBUTES_RESPONSE_REPORT      = 0x22,
+    HID_USAGE_LIGHTING_POSITION_X_IN_MICROMETERS            = 0x23,
+    HID_USAGE_LIGHTING_POSITION_Y_IN_MICROMETERS            = 0x24,
+    HID_USAGE_LIGHTING_POSITION_Z_IN_MICROMETERS            = 0x25,
+    HID_USAGE_LIGHTING_LAMP_PURPOSES                        = 0x26,
+    HID_USAGE_LIGHTING_UPDATE_LATENCY_IN_MICROSECONDS       = 0x27,
+    HID_USAGE_LIGHTING_RED_LEVEL_COUNT                      = 0x28,
+    HID_USAGE_LIGHTING_GREEN_LEVEL_COUNT                    = 0x29,
+    HID_USAGE_LIGHTING_BLUE_LEVEL_COUNT                     = 0x2A,
+    HID_USAGE_LIGHTING_INTENSITY_LEVEL_COUNT                = 0x2B,
+    HID_USAGE_LIGHTING_IS_PROGRAMMABLE                      = 0x2C,
+    HID_USAGE_LIGHTING_INPUT_BINDING                        = 0x2D,
+    HID_USAGE_LIGHTING_LAMP_MULTI_UPDATE_REPORT             = 0x50,
+    HID_USAGE_LIGHTING_RED_UPDATE_CHANNEL                   = 0x51,
+    HID_USAGE_LIGHTING_GREEN_UPDATE_CHANNEL                 = 0x52,
+    HID_USAGE_LIGHTING_BLUE_UPDATE_CHANNEL                  = 0x53,
+    HID_USAGE_LIGHTING_INTENSITY_UPDATE_CHANNEL             = 0x54,
+    HID_USAGE_LIGHTING_LAMP_UPDATE_FLAGS                    = 0x55,
+    HID_USAGE_LIGHTING_LAMP_RANGE_UPDATE_REPORT             = 0x60,
+    HID_USAGE_LIGHTING_LAMP_ID_START                        = 0x61,
+    HID_USAGE_LIGHTING_LAMP_ID_END                          = 0x62,
+    HID_USAGE_LIGHTING_LAMP_ARRAY_CONTROL_REPORT            = 0x70,
+    HID_USAGE_LIGHTING_AUTONOMOUS_MODE                      = 0x71,
+};
+
+#define LAMP_MULTI_UPDATE_LAMP_COUNT    8   // lamps per LampMultiUpdateReport
+
+#define TUD_HID_LAMP_RGBI_USAGES \
+    HID_USAGE ( HID_USAGE_LIGHTING_RED_UPDATE_CHANNEL       ),\
+    HID_USAGE ( HID_USAGE_LIGHTING_GREEN_UPDATE_CHANNEL     ),\
+    HID_USAGE ( HID_USAGE_LIGHTING_BLUE_UPDATE_CHANNEL      ),\
+    HID_USAGE ( HID_USAGE_LIGHTING_INTENSITY_UPDATE_CHANNEL )
+
+// LampArray Report Descriptor Template, uses report_id to report_id + 5, all of them feature reports
+#define TUD_HID_REPORT_DESC_LAMP_ARRAY(report_id) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_LIGHTING_AND_ILLUMINATION )                       ,\
+  HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_ARRAY            )                       ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION               )                       ,\
+    /* LampArrayAttributesReport */ \
+    HID_REPORT_ID  ( report_id                                      ) \
+    HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_ARRAY_ATTRIBUTES_REPORT )              ,\
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL                          )              ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_COUNT                           ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 65535, 3                                                ) ,\
+      HID_REPORT_SIZE   ( 16                                                      ) ,\
+      HID_REPORT_COUNT  ( 1                                                       ) ,\
+      HID_FEATURE       ( HID_CONSTANT | HID_VARIABLE | HID_ABSOLUTE              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_BOUNDING_BOX_WIDTH_IN_MICROMETERS    ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_BOUNDING_BOX_HEIGHT_IN_MICROMETERS   ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_BOUNDING_BOX_DEPTH_IN_MICROMETERS    ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ARRAY_KIND                      ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_MIN_UPDATE_INTERVAL_IN_MICROSECONDS  ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 2147483647, 3                                           ) ,\
+      HID_REPORT_SIZE   ( 32                                                      ) ,\
+      HID_REPORT_COUNT  ( 5                                                       ) ,\
+      HID_FEATURE       ( HID_CONSTANT | HID_VARIABLE | HID_ABSOLUTE              ) ,\
+    HID_COLLECTION_END                                                              ,\
+    /* LampAttributesRequestReport */ \
+    HID_REPORT_ID  ( report_id + 1                                     ) \
+    HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_ATTRIBUTES_REQUEST_REPORT )            ,\
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL                            )            ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 65535, 3                                                ) ,\
+      HID_REPORT_SIZE   ( 16                                                      ) ,\
+      HID_REPORT_COUNT  ( 1                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+    HID_COLLECTION_END                                                              ,\
+    /* LampAttributesResponseReport */ \
+    HID_REPORT_ID  ( report_id + 2                                      ) \
+    HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_ATTRIBUTES_RESPONSE_REPORT )           ,\
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL                             )           ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 65535, 3                                                ) ,\
+      HID_REPORT_SIZE   ( 16                                                      ) ,\
+      HID_REPORT_COUNT  ( 1                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_POSITION_X_IN_MICROMETERS            ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_POSITION_Y_IN_MICROMETERS            ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_POSITION_Z_IN_MICROMETERS            ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_UPDATE_LATENCY_IN_MICROSECONDS       ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_PURPOSES                        ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 2147483647, 3                                           ) ,\
+      HID_REPORT_SIZE   ( 32                                                      ) ,\
+      HID_REPORT_COUNT  ( 5                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_RED_LEVEL_COUNT                      ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_GREEN_LEVEL_COUNT                    ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_BLUE_LEVEL_COUNT                     ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_INTENSITY_LEVEL_COUNT                ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_IS_PROGRAMMABLE                      ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_INPUT_BINDING                        ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 255, 2                                                  ) ,\
+      HID_REPORT_SIZE   ( 8                                                       ) ,\
+      HID_REPORT_COUNT  ( 6                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+    HID_COLLECTION_END                                                              ,\
+    /* LampMultiUpdateReport */ \
+    HID_REPORT_ID  ( report_id + 3                               ) \
+    HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_MULTI_UPDATE_REPORT )                  ,\
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL                      )                  ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_COUNT                           ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_UPDATE_FLAGS                    ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX   ( LAMP_MULTI_UPDATE_LAMP_COUNT                            ) ,\
+      HID_REPORT_SIZE   ( 8                                                       ) ,\
+      HID_REPORT_COUNT  ( 2                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID                              ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 65535, 3                                                ) ,\
+      HID_REPORT_SIZE   ( 16                                                      ) ,\
+      HID_REPORT_COUNT  ( LAMP_MULTI_UPDATE_LAMP_COUNT                            ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 255, 2                                                  ) ,\
+      HID_REPORT_SIZE   ( 8                                                       ) ,\
+      HID_REPORT_COUNT  ( 4 * LAMP_MULTI_UPDATE_LAMP_COUNT                        ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+    HID_COLLECTION_END                                                              ,\
+    /* LampRangeUpdateReport */ \
+    HID_REPORT_ID  ( report_id + 4                               ) \
+    HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_RANGE_UPDATE_REPORT )                  ,\
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL                      )                  ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_UPDATE_FLAGS                    ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX   ( 8                                                       ) ,\
+      HID_REPORT_SIZE   ( 8                                                       ) ,\
+      HID_REPORT_COUNT  ( 1                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID_START                        ) ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_LAMP_ID_END                          ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 65535, 3                                                ) ,\
+      HID_REPORT_SIZE   ( 16                                                      ) ,\
+      HID_REPORT_COUNT  ( 2                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+      TUD_HID_LAMP_RGBI_USAGES                                                      ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX_N ( 255, 2                                                  ) ,\
+      HID_REPORT_SIZE   ( 8                                                       ) ,\
+      HID_REPORT_COUNT  ( 4                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+    HID_COLLECTION_END                                                              ,\
+    /* LampArrayControlReport */ \
+    HID_REPORT_ID  ( report_id + 5                                ) \
+    HID_USAGE      ( HID_USAGE_LIGHTING_LAMP_ARRAY_CONTROL_REPORT )                 ,\
+    HID_COLLECTION ( HID_COLLECTION_LOGICAL                       )                 ,\
+      HID_USAGE         ( HID_USAGE_LIGHTING_AUTONOMOUS_MODE                      ) ,\
+      HID_LOGICAL_MIN   ( 0                                                       ) ,\
+      HID_LOGICAL_MAX   ( 1                                                       ) ,\
+      HID_REPORT_SIZE   ( 8                                                       ) ,\
+      HID_REPORT_COUNT  ( 1                                                       ) ,\
+      HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE                  ) ,\
+    HID_COLLECTION_END                                                              ,\
+  HID_COLLECTION_END
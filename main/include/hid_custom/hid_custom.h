@@ -1,11 +1,32 @@
 #include "esp_gap_ble_api.h"
 #include "keyboard_button.h"
+#include "hid_report.h"
+#include "steno.h"
 
 
-extern esp_ble_bond_dev_t * dev_list_before_new_connection;
+extern keyboard_btn_config_t cfg;
 
-extern int dev_num_before_new_connection;
+extern keyboard_btn_handle_t kbd_handle;
 
+// Base layer entry of the active profile, also the input binding of every lamp. Any task.
+uint8_t keyboard_base_keycode(uint8_t output_index, uint8_t input_index);
+
+// A transport is up, the scan task sends the key that woke the keyboard if it was released unseen. Any task.
+void deliver_wake_key(void);
+
+// Registered on KBD_EVENT_TICK, the tap-hold timers count every scan
 void keyboard_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_report_t kbd_report, void *user_data);
 
+// Profiles built from the layout and the first one active, tap-hold engine reset, tick_us is the scan period
+void keyboard_keymap_init(uint32_t tick_us);
+
+// The BLE mouse notification went out, mouse keys send the motion integrated since with the next one
+void keyboard_mouse_ready(void);
+
+// Protocol of steno mode loaded at boot, STENO_PROTOCOL_NONE for a keyboard, USB exposes a CDC port instead of HID
+steno_protocol_t keyboard_steno_protocol(void);
+
+// Request of the raw HID configuration channel, answered on the transport in use (see config_proto.h)
+void keyboard_config_rx(const uint8_t *data, uint16_t len);
+
 void keyboard_task(void);
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "keyboard_button.h"
+#include "btn_progress.h"
+
+#define KEYMAP_OUTPUT_NUM       6
+#define KEYMAP_INPUT_NUM        17
+
+#define HID_REPORT_6KRO_KEYS    6
+#define HID_REPORT_ERROR_ROLLOVER   0x01    // fills every slot of a boot report when more than 6 keys are down
+#define HID_REPORT_NKRO_FIRST   4       // HID_KEY_A, bit 0 of the NKRO bitmap
+#define HID_REPORT_NKRO_BITS    (8 * sizeof(((hid_nkey_report_t *)0)->keyboard_full_key_report.keycode))
+
+
+typedef enum {
+    HID_REPORT_FORMAT_BOOT = 0,     // REPORT_ID_KEYBOARD, boot protocol 6KRO
+    HID_REPORT_FORMAT_NKRO,         // REPORT_ID_FULL_KEY_KEYBOARD bitmap
+} hid_report_format_t;
+
+
+/**
+ * @brief   Check whether a keymap entry is a modifier bit rather than a keyboard usage
+ * @param   keycode: Keymap entry
+ * @param   output_index: Matrix output of the key
+ * @param   input_index: Matrix input of the key
+ * @return  true for a modifier
+ * @note    Some usages share their value with a modifier bit (HID_KEY_F7 is KEYBOARD_MODIFIER_RIGHTALT), these
+ *          are told apart by their position in the matrix
+ * **/
+bool is_modifier(uint8_t keycode, uint8_t output_index, uint8_t input_index);
+
+
+/**
+ * @brief   Build the keyboard report for the keys that are down
+ * @param   key_data: Pressed keys, in press order
+ * @param   key_num: Number of entries in key_data
+ * @param   keymap: Layer the keys are looked up in
+ * @param   format: Report to build, the same format is used however many keys are down
+ * @param   report: Filled with the report
+ * @return  Modifier byte of the report
+ * @note    Pure function, keys outside the keymap are skipped. A boot report with more than 6 keys reports
+ *          HID_REPORT_ERROR_ROLLOVER in every slot, usages outside the NKRO bitmap are left out of an NKRO report.
+ *          host_test/fuzz_report checks it against a reference model.
+ * **/
+uint8_t hid_report_build(const keyboard_btn_data_t *key_data, uint32_t key_num,
+                         const uint8_t keymap[KEYMAP_OUTPUT_NUM][KEYMAP_INPUT_NUM], hid_report_format_t format,
+                         hid_nkey_report_t *report);
+
+
+/**
+ * @brief   Rewrite a keyboard report in the other format
+ * @param   from: REPORT_ID_KEYBOARD or REPORT_ID_FULL_KEY_KEYBOARD report
+ * @param   format: Format of the result
+ * @param   to: Filled with the same keys and modifiers, may be the same as from
+ * @return  None
+ * @note    Used when the host switches protocol while keys are down. Keys of an NKRO report land in a boot report
+ *          in usage order, HID_REPORT_ERROR_ROLLOVER when more than 6 are down. A boot report holding
+ *          HID_REPORT_ERROR_ROLLOVER converts to an NKRO report with the modifiers only.
+ * **/
+void hid_report_convert(const hid_nkey_report_t *from, hid_report_format_t format, hid_nkey_report_t *to);
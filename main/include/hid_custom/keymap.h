@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "hid_report.h"
+
+#define KEYMAP_LAYER_BASE       0
+#define KEYMAP_LAYER_FN         1
+#define KEYMAP_LAYER_NUM        2
+
+
+// Entries as the compile-time keymap holds them: HID usages, modifier bits on the modifier positions (see
+// is_modifier()), consumer usages on the Fn layer
+typedef struct {
+    uint8_t layers[KEYMAP_LAYER_NUM][KEYMAP_OUTPUT_NUM][KEYMAP_INPUT_NUM];
+} keymap_table_t;
+
+
+// Two tables, the scan reads the active one while the configuration channel edits the other. Set up with
+// keymap_init_mapped(), the active table is outside until the first swap.
+typedef struct {
+    keymap_table_t tables[2];
+    _Atomic(const keymap_table_t *) active;
+    atomic_bool reading;        // the scan holds a pointer to a table
+} keymap_t;
+
+
+/**
+ * @brief   Set up both tables with the same map
+ * @param   keymap: Double-buffered keymap
+ * @param   table: Initial map, copied
+ * @return  None
+ * **/
+void keymap_init(keymap_t *keymap, const keymap_table_t *table);
+
+
+/**
+ * @brief   Set up the keymap to read a table in place
+ * @param   keymap: Double-buffered keymap
+ * @param   table: Initial map, must stay valid until the first keymap_swap(). Only staging gets a copy.
+ * @return  None
+ * @note    Saves no DRAM, keymap_t holds both tables either way and staging starts as a copy of table. Until the
+ *          first commit the scan reads table itself, in flash for a mapped layout.
+ * **/
+void keymap_init_mapped(keymap_t *keymap, const keymap_table_t *table);
+
+
+/**
+ * @brief   Take the active table for one key event
+ * @param   keymap: Double-buffered keymap
+ * @return  Active table, valid until keymap_read_end()
+ * @note    Scan task only, one reader at a time
+ * **/
+const keymap_table_t *keymap_read_begin(keymap_t *keymap);
+
+
+/**
+ * @brief   Drop the table taken with keymap_read_begin()
+ * @param   keymap: Double-buffered keymap
+ * @return  None
+ * **/
+void keymap_read_end(keymap_t *keymap);
+
+
+/**
+ * @brief   Table the next map is written to, the scan never reads it
+ * @param   keymap: Double-buffered keymap
+ * @return  Inactive table, a copy of the active one until edited
+ * @note    Writer task only
+ * **/
+keymap_table_t *keymap_staging(keymap_t *keymap);
+
+
+/**
+ * @brief   Make the staging table the active one
+ * @param   keymap: Double-buffered keymap
+ * @return  None
+ * @note    One atomic pointer store, the scan sees the old map or the new one and never a mix. Call
+ *          keymap_sync() before writing staging again.
+ * **/
+void keymap_swap(keymap_t *keymap);
+
+
+/**
+ * @brief   Whether the scan still holds a table
+ * @param   keymap: Double-buffered keymap
+ * @return  true while a key event taken before keymap_swap() may still read the old table
+ * **/
+bool keymap_reading(keymap_t *keymap);
+
+
+/**
+ * @brief   Copy the active table to staging once the scan let go of it
+ * @param   keymap: Double-buffered keymap
+ * @return  None
+ * @note    The writer waits for keymap_reading() to turn false after keymap_swap() first
+ * **/
+void keymap_sync(keymap_t *keymap);
+
+
+/**
+ * @brief   One entry of the active table, for readers outside the scan task
+ * @param   keymap: Double-buffered keymap
+ * @param   layer: KEYMAP_LAYER_BASE or KEYMAP_LAYER_FN
+ * @param   output_index: Row
+ * @param   input_index: Column
+ * @return  The entry, from the old map or the new one while a swap is in progress
+ * **/
+uint8_t keymap_entry(keymap_t *keymap, uint8_t layer, uint8_t output_index, uint8_t input_index);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LEADER_TIMEOUT_MS       1000    // per key, the sequence ends when the next key takes longer
+#define LEADER_MAX_NODES        64      // trie nodes of all sequences, the root included
+#define LEADER_NO_NODE          0xFF
+
+
+// A key sequence typed after the leader key and the macro it plays, see macro.h
+typedef struct {
+    const uint8_t *keys;        // HID_KEY_* of the base layer
+    uint8_t key_num;
+    const uint8_t *macro;
+} leader_seq_t;
+
+#define LEADER_SEQ(macro_, ...)                                         \
+    {                                                                   \
+        .keys = (const uint8_t[]) {__VA_ARGS__},                        \
+        .key_num = sizeof((const uint8_t[]) {__VA_ARGS__}),             \
+        .macro = (macro_),                                              \
+    }
+
+
+typedef enum {
+    LEADER_IDLE = 0,            // no sequence is being typed, the key is the keymap's
+    LEADER_NEXT,                // the key continues a sequence
+    LEADER_DONE,                // the key ended the sequence, with a macro or without a match
+} leader_result_t;
+
+
+// The children of a node are contiguous and sorted by keycode
+typedef struct {
+    uint8_t keycode;
+    uint8_t child_num;
+    uint8_t first_child;
+    const uint8_t *macro;       // NULL when no sequence ends here
+} leader_node_t;
+
+
+// All state is inline, the engine never allocates
+typedef struct {
+    leader_node_t nodes[LEADER_MAX_NODES];
+    uint32_t node_num;
+
+    uint8_t current;            // node of the keys typed so far, LEADER_NO_NODE while idle
+    uint32_t deadline_ms;
+} leader_t;
+
+
+/**
+ * @brief   Build the trie of the sequences
+ * @param   leader: Engine
+ * @param   seqs: Sequences, the table and its macros must stay valid
+ * @param   seq_num: Number of entries in seqs
+ * @return  false when the sequences do not fit in LEADER_MAX_NODES or one is empty, the trie is empty then
+ * @note    Runs once at boot, so matching never walks the sequence table. The first of two equal sequences wins.
+ * **/
+bool leader_init(leader_t *leader, const leader_seq_t *seqs, uint32_t seq_num);
+
+
+/**
+ * @brief   The leader key was tapped, start matching
+ * @param   leader: Engine
+ * @param   now_ms: Current time
+ * @return  None
+ * **/
+void leader_start(leader_t *leader, uint32_t now_ms);
+
+
+/**
+ * @brief   Whether a sequence is being typed
+ * @param   leader: Engine
+ * @return  true between leader_start() and the end of the sequence
+ * **/
+bool leader_active(const leader_t *leader);
+
+
+/**
+ * @brief   Feed the next key of a sequence
+ * @param   leader: Engine
+ * @param   keycode: Base layer keycode of the pressed key
+ * @param   now_ms: Time of the press
+ * @param   macro: Set to the macro of the completed sequence for LEADER_DONE, NULL when nothing matched
+ * @return  What became of the key
+ * @note    One node transition, a binary search among the children of the current node. A sequence that is also
+ *          the prefix of a longer one is completed by leader_tick() once no further key follows.
+ * **/
+leader_result_t leader_key(leader_t *leader, uint8_t keycode, uint32_t now_ms, const uint8_t **macro);
+
+
+/**
+ * @brief   End the sequence once the timeout passed
+ * @param   leader: Engine
+ * @param   now_ms: Current time
+ * @return  Macro of the sequence typed so far when it timed out on a complete one, NULL otherwise
+ * @note    Called on every scan tick and before every key
+ * **/
+const uint8_t *leader_tick(leader_t *leader, uint32_t now_ms);
+
+
+/**
+ * @brief   Drop the sequence being typed, no macro plays
+ * @param   leader: Engine
+ * @return  None
+ * @note    For a switch to the sequences of another profile
+ * **/
+void leader_cancel(leader_t *leader);
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOUSE_KEYS_MAX_POINTS       8       // points of an acceleration curve
+#define MOUSE_KEYS_ACC_LIMIT        512     // counts kept back while the link does not take reports
+#define MOUSE_KEYS_DIAGONAL_Q8      181     // 1 / sqrt(2) in Q8, diagonal speed equals straight speed
+
+
+typedef enum {
+    MOUSE_KEY_NONE = 0,
+    MOUSE_KEY_UP,
+    MOUSE_KEY_DOWN,
+    MOUSE_KEY_LEFT,
+    MOUSE_KEY_RIGHT,
+    MOUSE_KEY_WHEEL_UP,
+    MOUSE_KEY_WHEEL_DOWN,
+    MOUSE_KEY_BUTTON_1,
+    MOUSE_KEY_BUTTON_2,
+    MOUSE_KEY_BUTTON_3,
+} mouse_key_t;
+
+#define MOUSE_KEY_BIT(key)      (1u << (key))
+
+
+// Speed a given time after the first key of the group went down, in counts (or wheel detents) per second
+typedef struct {
+    uint16_t time_ms;
+    uint16_t speed;
+} mouse_keys_point_t;
+
+
+// Piecewise linear, points in rising time_ms. Before the first point its speed applies, after the last point its.
+typedef struct {
+    const mouse_keys_point_t *points;
+    uint8_t point_num;
+} mouse_keys_curve_t;
+
+
+// A relative mouse report, every transport carries this layout
+typedef struct {
+    uint8_t buttons;
+    int8_t x;
+    int8_t y;
+    int8_t wheel;
+} mouse_keys_report_t;
+
+
+// Cursor or wheel keys, the acceleration of a group starts with its first key
+typedef struct {
+    uint32_t held_us;           // since the first key of the group went down
+    bool active;
+} mouse_keys_group_t;
+
+
+// All state is inline, the engine never allocates
+typedef struct {
+    mouse_keys_curve_t move_curve;
+    mouse_keys_curve_t wheel_curve;
+    uint32_t tick_us;
+
+    uint32_t held;              // MOUSE_KEY_BIT() of the keys down
+    mouse_keys_group_t move;
+    mouse_keys_group_t wheel;
+    int32_t acc_x;              // Q16.16 counts integrated and not yet taken, the fraction carries over
+    int32_t acc_y;
+    int32_t acc_wheel;
+    uint8_t buttons;
+    uint8_t sent_buttons;
+} mouse_keys_t;
+
+
+/**
+ * @brief   Set up the engine, nothing held
+ * @param   mk: Engine
+ * @param   move_curve: Cursor speed over time, copied by reference
+ * @param   wheel_curve: Wheel speed over time, copied by reference
+ * @param   tick_us: Scan period, mouse_keys_tick() integrates one of them
+ * @return  None
+ * **/
+void mouse_keys_init(mouse_keys_t *mk, const mouse_keys_curve_t *move_curve, const mouse_keys_curve_t *wheel_curve,
+                     uint32_t tick_us);
+
+
+/**
+ * @brief   Set the mouse keys that are down
+ * @param   mk: Engine
+ * @param   held: MOUSE_KEY_BIT() of every mouse key down
+ * @return  None
+ * @note    A direction key moves one count as it goes down, so a tap always moves
+ * **/
+void mouse_keys_set(mouse_keys_t *mk, uint32_t held);
+
+
+/**
+ * @brief   Integrate one scan tick of motion
+ * @param   mk: Engine
+ * @return  None
+ * @note    Called on every scan tick whatever the report rate, so the speed does not depend on the transport
+ * **/
+void mouse_keys_tick(mouse_keys_t *mk);
+
+
+/**
+ * @brief   Take the whole counts integrated so far and the buttons
+ * @param   mk: Engine
+ * @param   report: Filled when the return value is true, at most 127 counts per axis, the rest stays for later
+ * @return  false when there is no motion and the buttons did not change
+ * @note    Called as often as the transport takes reports, fractions of a count stay in the engine
+ * **/
+bool mouse_keys_take(mouse_keys_t *mk, mouse_keys_report_t *report);
+
+
+/**
+ * @brief   Whether a mouse key is down or counts are waiting
+ * @param   mk: Engine
+ * @return  true while mouse_keys_tick() has work
+ * **/
+bool mouse_keys_busy(const mouse_keys_t *mk);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define STENO_GEMINI_LEN        6       // every GeminiPR stroke, the first byte has bit 7 set
+#define STENO_TXBOLT_MAX_LEN    5       // four key groups and the byte that ends a stroke without the last group
+#define STENO_PACKET_MAX        6
+
+
+// Steno keys in GeminiPR bit order, seven per byte from bit 6 down
+typedef enum {
+    STENO_KEY_NONE = 0,
+    STENO_KEY_FN,
+    STENO_KEY_N1, STENO_KEY_N2, STENO_KEY_N3, STENO_KEY_N4, STENO_KEY_N5, STENO_KEY_N6,
+    STENO_KEY_S1, STENO_KEY_S2, STENO_KEY_TL, STENO_KEY_KL, STENO_KEY_PL, STENO_KEY_WL, STENO_KEY_HL,
+    STENO_KEY_RL, STENO_KEY_A, STENO_KEY_O, STENO_KEY_ST1, STENO_KEY_ST2, STENO_KEY_RES1, STENO_KEY_RES2,
+    STENO_KEY_PWR, STENO_KEY_ST3, STENO_KEY_ST4, STENO_KEY_E, STENO_KEY_U, STENO_KEY_FR, STENO_KEY_RR,
+    STENO_KEY_PR, STENO_KEY_BR, STENO_KEY_LR, STENO_KEY_GR, STENO_KEY_TR, STENO_KEY_SR, STENO_KEY_DR,
+    STENO_KEY_N7, STENO_KEY_N8, STENO_KEY_N9, STENO_KEY_NA, STENO_KEY_NB, STENO_KEY_NC, STENO_KEY_ZR,
+    STENO_KEY_NUM,
+} steno_key_t;
+
+#define STENO_KEY_BIT(key)      (1ull << (key))
+
+
+// Serial protocol of the strokes, NONE is a keyboard that types
+typedef enum {
+    STENO_PROTOCOL_NONE = 0,
+    STENO_PROTOCOL_GEMINI,
+    STENO_PROTOCOL_TXBOLT,
+} steno_protocol_t;
+
+
+typedef struct {
+    uint64_t chord;             // STENO_KEY_BIT() of every key pressed since the last stroke
+} steno_t;
+
+
+/**
+ * @brief   Set up the engine, no chord started
+ * @param   steno: Engine
+ * @return  None
+ * **/
+void steno_init(steno_t *steno);
+
+
+/**
+ * @brief   Set the steno keys that are down
+ * @param   steno: Engine
+ * @param   held: STENO_KEY_BIT() of every steno key down
+ * @param   stroke: Set to the chord when the return value is true
+ * @return  true once the last key of a chord went up
+ * @note    The chord is every key pressed while any was down, so keys rolled off one by one still make one stroke
+ * **/
+bool steno_set(steno_t *steno, uint64_t held, uint64_t *stroke);
+
+
+/**
+ * @brief   Encode a stroke for the host
+ * @param   stroke: STENO_KEY_BIT() of the keys of the stroke
+ * @param   protocol: STENO_PROTOCOL_GEMINI or STENO_PROTOCOL_TXBOLT
+ * @param   packet: At least STENO_PACKET_MAX bytes
+ * @return  Length of the packet, 0 for an empty stroke or STENO_PROTOCOL_NONE
+ * @note    TX Bolt has one star and one number key, the GeminiPR ones are merged. Fn, power and the reserved
+ *          keys have no TX Bolt bit and are left out.
+ * **/
+size_t steno_pack(uint64_t stroke, steno_protocol_t protocol, uint8_t *packet);
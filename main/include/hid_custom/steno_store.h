@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esp_err.h"
+#include "steno.h"
+
+#define STENO_STORE_NVS_KEY     "steno"         // u8 steno_protocol_t in the "storage" namespace
+
+
+/**
+ * @brief   Save the steno protocol the keyboard starts with
+ * @param   protocol: STENO_PROTOCOL_NONE for a keyboard that types
+ * @return  ESP_OK, or the NVS error
+ * @note    Read once at boot, the USB interfaces of steno mode only take effect after a restart
+ * **/
+esp_err_t save_steno_protocol_to_nvs(steno_protocol_t protocol);
+
+
+/**
+ * @brief   Load the protocol saved by save_steno_protocol_to_nvs()
+ * @return  The saved protocol, STENO_PROTOCOL_NONE when nothing or nothing valid was saved
+ * **/
+steno_protocol_t load_steno_protocol_from_nvs(void);
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard_button_types.h"
+#include "hid_report.h"
+
+#define TAP_HOLD_TAPPING_TERM_MS    200     // default for keys that leave tapping_term_ms at 0
+#define TAP_HOLD_MAX_KEYS           8       // entries of the tap-hold table
+#define TAP_HOLD_MAX_EVENTS         32      // key events held back while a decision is pending
+#define TAP_HOLD_WHEEL_SLOTS        64      // power of two, a timer further out waits for its round
+#define TAP_HOLD_POS_NUM            (KEYMAP_OUTPUT_NUM * KEYMAP_INPUT_NUM)
+
+// Decide hold as soon as another key is pressed and released inside the tapping term
+#define TAP_HOLD_PERMISSIVE_HOLD            (1 << 0)
+// Decide hold as soon as another key is pressed inside the tapping term
+#define TAP_HOLD_HOLD_ON_OTHER_KEY_PRESS    (1 << 1)
+
+
+typedef enum {
+    TAP_HOLD_MOD_TAP = 0,       // tap: the keymap entry, hold: modifier bits
+    TAP_HOLD_LAYER_TAP,         // tap: the keymap entry, hold: a layer
+} tap_hold_kind_t;
+
+
+typedef struct {
+    uint8_t output_index;
+    uint8_t input_index;
+    tap_hold_kind_t kind;
+    uint8_t hold;               // modifier bits for TAP_HOLD_MOD_TAP, layer number (< 8) for TAP_HOLD_LAYER_TAP
+    uint8_t flags;              // TAP_HOLD_PERMISSIVE_HOLD, TAP_HOLD_HOLD_ON_OTHER_KEY_PRESS
+    uint16_t tapping_term_ms;   // 0 for TAP_HOLD_TAPPING_TERM_MS
+} tap_hold_key_t;
+
+
+// Keys as the keymap should see them, after tap-hold decisions
+typedef struct {
+    keyboard_btn_report_t report;   // key_data in press order, key_release_data holds the key just released
+    uint8_t hold_modifier;          // modifiers of the mod-tap keys decided as hold
+    uint8_t layer_mask;             // bit n set while a layer-tap key of layer n is held
+} tap_hold_output_t;
+
+
+typedef void (*tap_hold_emit_t)(const tap_hold_output_t *output, void *user_data);
+
+
+typedef struct {
+    bool armed;
+    uint8_t next;               // next timer in the same slot, TAP_HOLD_MAX_KEYS ends the list
+    uint32_t deadline;          // tick the tapping term of the physical press ends
+} tap_hold_timer_t;
+
+
+typedef struct {
+    uint8_t pos;                // output_index * KEYMAP_INPUT_NUM + input_index
+    bool pressed;
+    uint32_t tick;
+} tap_hold_event_t;
+
+
+// All state is inline, the engine never allocates
+typedef struct {
+    const tap_hold_key_t *keys;
+    uint32_t key_num;
+    uint32_t term_ticks[TAP_HOLD_MAX_KEYS];
+    int8_t key_index[TAP_HOLD_POS_NUM];         // position to tap-hold table index, -1 for plain keys
+    uint8_t state[TAP_HOLD_MAX_KEYS];
+
+    uint32_t tick;
+    bool down[TAP_HOLD_POS_NUM];                // debounced matrix state seen by the last tick
+
+    int8_t pending;                             // undecided key all later events wait for, -1 for none
+    uint32_t pending_deadline;
+    tap_hold_event_t events[TAP_HOLD_MAX_EVENTS];
+    uint32_t event_num;
+    uint32_t scanned;                           // events already checked against the pending key
+
+    uint8_t wheel[TAP_HOLD_WHEEL_SLOTS];        // first timer of every slot
+    tap_hold_timer_t timers[TAP_HOLD_MAX_KEYS];
+
+    keyboard_btn_data_t out[TAP_HOLD_POS_NUM];
+    uint32_t out_num;
+    keyboard_btn_data_t released;
+    uint8_t hold_modifier;
+    uint8_t layer_mask;
+
+    tap_hold_emit_t emit;
+    void *user_data;
+} tap_hold_t;
+
+
+/**
+ * @brief   Set up the engine
+ * @param   th: Engine state
+ * @param   keys: Tap-hold table, must outlive the engine
+ * @param   key_num: Entries in keys, at most TAP_HOLD_MAX_KEYS
+ * @param   tick_us: Scan period, the tapping terms are rounded up to whole ticks
+ * @param   emit: Called with the new output every time it changes, possibly several times in one tick
+ * @param   user_data: Passed to emit
+ * @return  None
+ * **/
+void tap_hold_init(tap_hold_t *th, const tap_hold_key_t *keys, uint32_t key_num, uint32_t tick_us,
+                   tap_hold_emit_t emit, void *user_data);
+
+
+/**
+ * @brief   Advance the engine by one scan tick
+ * @param   th: Engine state
+ * @param   report: Debounced matrix state of this tick, key_change_num and key_release_num are 0 when nothing
+ *                  changed
+ * @return  None
+ * @note    Must be called on every scan tick, not only on changes, the timer wheel counts these calls. A decision
+ *          that times out is taken on the tick its tapping term ends, at most one tick after the term.
+ * **/
+void tap_hold_tick(tap_hold_t *th, const keyboard_btn_report_t *report);
+
+
+/**
+ * @brief   Whether a decision is still open
+ * @param   th: Engine state
+ * @return  true while a tap-hold key is undecided and later keys are held back
+ * **/
+bool tap_hold_pending(const tap_hold_t *th);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "layout_image.h"
+
+
+/**
+ * @brief   Map the image of the layout partition
+ * @return  None
+ * @note    Called once from app_main() before any task reads the layout. Without a layout partition, or with an
+ *          image this firmware does not accept, layout_default stays in use.
+ * **/
+void layout_init(void);
+
+
+/**
+ * @brief   Layout in use
+ * @return  Image mapped from the layout partition, or layout_default
+ * @note    Stays mapped for the whole run, any task may read it
+ * **/
+const layout_image_t *layout_get(void);
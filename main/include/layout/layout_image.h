@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "keymap.h"
+
+#define LAYOUT_IMAGE_MAGIC          0x5459414C  // "LAYT"
+#define LAYOUT_IMAGE_VERSION        2           // bump with every change to layout_image_t
+#define LAYOUT_LAMP_NUM             86          // WS2812 chain, one lamp per key
+#define LAYOUT_PROFILE_NUM          4           // Fn + F3 ~ F6
+#define LAYOUT_LEADER_NUM           16          // per profile
+#define LAYOUT_LEADER_KEYS          7
+#define LAYOUT_LEADER_MACRO_SIZE    56
+
+#define LAYOUT_PARTITION_LABEL      "layout"
+#define LAYOUT_PARTITION_SUBTYPE    0x40        // first custom data subtype, see partitions.csv
+
+
+/**
+ * Everything about the keys that is data rather than code, in one flat image. The firmware maps the image of the
+ * layout partition straight from flash, only the keymaps are copied to DRAM (see keymap_t). No pointers, only
+ * fixed arrays, so the image the build cuts out of layout_default.c is valid wherever it is mapped.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // LAYOUT_IMAGE_MAGIC
+    uint16_t version;           // LAYOUT_IMAGE_VERSION
+    uint16_t header_size;       // sizeof(layout_header_t)
+    uint32_t image_size;        // sizeof(layout_image_t)
+    uint8_t layer_num;          // KEYMAP_LAYER_NUM
+    uint8_t output_num;         // KEYMAP_OUTPUT_NUM
+    uint8_t input_num;          // KEYMAP_INPUT_NUM
+    uint8_t lamp_num;           // LAYOUT_LAMP_NUM
+    uint8_t profile_num;        // LAYOUT_PROFILE_NUM
+    uint8_t reserved[3];
+} layout_header_t;
+
+
+// Key under a lamp, the lamp ID is the index in the lamp table
+typedef struct __attribute__((packed)) {
+    uint8_t row;                // output_index
+    uint8_t col;                // input_index
+} layout_lamp_t;
+
+
+// A leader sequence and its macro, see leader.h and macro.h
+typedef struct __attribute__((packed)) {
+    uint8_t key_num;
+    uint8_t keys[LAYOUT_LEADER_KEYS];               // HID_KEY_* of the base layer
+    uint8_t macro[LAYOUT_LEADER_MACRO_SIZE];        // bytecode, ends with MACRO_OP_END
+} layout_leader_t;
+
+
+typedef struct __attribute__((packed)) {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+} layout_color_t;
+
+
+// Index of the settings of a transport, connection_mode_t - MODE_USB
+typedef enum {
+    LAYOUT_TRANSPORT_USB = 0,
+    LAYOUT_TRANSPORT_BLE,
+    LAYOUT_TRANSPORT_WIRELESS,
+    LAYOUT_TRANSPORT_NUM,
+} layout_transport_t;
+
+#define LAYOUT_TRANSPORT_LEADER         (1 << 0)    // a tap of Fn starts a leader sequence
+#define LAYOUT_TRANSPORT_MOUSE_KEYS     (1 << 1)    // mouse keys on when the profile is activated, not over ESP-NOW
+
+
+// One complete set of keys, the keyboard switches between them without a restart
+typedef struct __attribute__((packed)) {
+    keymap_table_t keymap;
+    layout_color_t color;                               // lamps while the host does not drive them
+    uint8_t transport_flags[LAYOUT_TRANSPORT_NUM];      // LAYOUT_TRANSPORT_* bits
+    uint8_t leader_num;                                 // used entries of leaders
+    layout_leader_t leaders[LAYOUT_LEADER_NUM];
+} layout_profile_t;
+
+
+typedef struct __attribute__((packed)) {
+    layout_header_t header;
+    layout_lamp_t lamps[LAYOUT_LAMP_NUM];
+    layout_profile_t profiles[LAYOUT_PROFILE_NUM];
+} layout_image_t;
+
+
+// Built into the firmware, used when the layout partition holds no valid image
+extern const layout_image_t layout_default;
+
+
+/**
+ * @brief   Check an image before anything reads it
+ * @param   image: Image, at least size bytes readable
+ * @param   size: Bytes readable at image
+ * @return  true when the header matches this firmware and every entry stays inside its table
+ * @note    Pure function, host_test/layout runs it on layout_default and on broken copies
+ * **/
+bool layout_image_check(const layout_image_t *image, size_t size);
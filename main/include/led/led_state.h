@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mode_gpio.h"
+
+// Bits of the HID keyboard LED output report, the same on USB and BLE
+#define LED_STATE_NUM_LOCK          0x01
+#define LED_STATE_CAPS_LOCK         0x02
+#define LED_STATE_SCROLL_LOCK       0x04
+#define LED_STATE_COMPOSE           0x08
+#define LED_STATE_KANA              0x10
+
+#define LED_STATE_GPIO_NUM_LOCK     18
+#define LED_STATE_GPIO_CAPS_LOCK    17
+#define LED_STATE_GPIO_SCROLL_LOCK  8
+#define LED_STATE_ACTIVE_LEVEL      1
+
+
+/**
+ * @brief   Configure the indicator GPIOs, all indicators off
+ * @return  None
+ * **/
+void led_state_init(void);
+
+
+/**
+ * @brief   Record the lock state a host sent
+ * @param   source: Transport the output report came in on
+ * @param   leds: LED output report byte, LED_STATE_* bits
+ * @return  None
+ * @note    Called straight from the transport callbacks. The indicators only follow the transport of current_mode,
+ *          and only pins whose state changed are written, so the call never blocks.
+ * **/
+void led_state_set(connection_mode_t source, uint8_t leds);
+
+
+/**
+ * @brief   Lock state of the host the keyboard is talking to
+ * @return  LED_STATE_* bits, 0 until that host sent an output report
+ * @note    For the keymap, e.g. a layer that only applies while Caps Lock is on
+ * **/
+uint8_t led_state_get(void);
+
+
+/**
+ * @brief   Whether the current host has Caps Lock on
+ * @return  true when LED_STATE_CAPS_LOCK is set
+ * **/
+bool led_state_caps_lock(void);
+
+
+/**
+ * @brief   Show the lock state of a transport after a mode change
+ * @param   mode: New current_mode
+ * @return  None
+ * **/
+void led_state_apply_mode(connection_mode_t mode);
+
+
+/**
+ * @brief   Turn every indicator off, e.g. before the pins are held for deep sleep
+ * @return  None
+ * **/
+void led_state_off(void);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#define LAMP_ARRAY_GPIO                     9           // data line of the WS2812 chain, one lamp per key
+#define LAMP_ARRAY_RMT_RESOLUTION_HZ        10000000    // 0.1 us per tick
+#define LAMP_ARRAY_RMT_DMA_SYMBOLS          1024        // DMA buffer, the encoder refills it while the chain is sent
+#define LAMP_ARRAY_RESET_US                 300         // WS2812B latches after 280 us low
+
+#define LAMP_ARRAY_KEY_PITCH_UM             19050       // 1u key
+#define LAMP_ARRAY_DEPTH_UM                 30000
+#define LAMP_ARRAY_KIND_KEYBOARD            1
+#define LAMP_ARRAY_MIN_UPDATE_INTERVAL_US   10000
+#define LAMP_ARRAY_UPDATE_LATENCY_US        4000        // one frame on the wire, 86 lamps * 30 us + reset
+#define LAMP_PURPOSE_CONTROL                0x01
+
+#define LAMP_UPDATE_FLAG_COMPLETE           0x01        // LampUpdateFlags, last report of a frame
+
+#define LAMP_ARRAY_AUTONOMOUS_LEVEL         32          // dim white until a profile sets its color
+
+#define LAMP_ARRAY_TASK_CORE                1           // keyboard scan task runs on core 0 (cfg.core_id)
+#define LAMP_ARRAY_TASK_PRIORITY            2
+
+
+/**
+ * @brief   Set up the RMT channel and start the LED task, lamps in autonomous mode
+ * @return  None
+ * @note    Called from tusb_main(), the LampArray reports only exist on USB
+ * **/
+void lamp_array_init(void);
+
+
+/**
+ * @brief   Color of every lamp while the host does not drive them
+ * @param   red: Level of the red LED
+ * @param   green: Level of the green LED
+ * @param   blue: Level of the blue LED
+ * @return  None
+ * @note    Called by the keyboard task as a profile is activated, may run before lamp_array_init(). In autonomous
+ *          mode the lamps change with the next frame.
+ * **/
+void lamp_array_set_autonomous_color(uint8_t red, uint8_t green, uint8_t blue);
+
+
+/**
+ * @brief   Answer a GET_REPORT for a LampArray feature report
+ * @param   report_id: REPORT_ID_LIGHTING_LAMP_ARRAY_ATTRIBUTES or REPORT_ID_LIGHTING_LAMP_ATTRIBUTES_RESPONSE
+ * @param   buffer: Filled with the report, without the report ID
+ * @param   reqlen: Size of buffer
+ * @return  Length written, 0 to stall the request
+ * @note    Every response advances the lamp the next one describes, the host walks the table this way
+ * **/
+uint16_t lamp_array_get_report(uint8_t report_id, uint8_t *buffer, uint16_t reqlen);
+
+
+/**
+ * @brief   Apply a SET_REPORT for a LampArray feature report
+ * @param   report_id: Attributes request, multi update, range update or control report ID
+ * @param   buffer: Report without the report ID
+ * @param   len: Length of buffer
+ * @return  None
+ * @note    Updates collect in the frame being built. The report carrying LAMP_UPDATE_FLAG_COMPLETE hands the
+ *          frame to the LED task, which encodes it while the previous frame is still going out over DMA.
+ * **/
+void lamp_array_set_report(uint8_t report_id, const uint8_t *buffer, uint16_t len);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_log.h"
+
+#define DEFER_LOG_RING_LEN          64      // records per core, must be a power of two
+#define DEFER_LOG_MAX_ARGS          6
+#define DEFER_LOG_LINE_LEN          128     // longest formatted message, longer ones are cut
+#define DEFER_LOG_TASK_PRIORITY     1
+#define DEFER_LOG_TASK_STACK        (1024 * 3)
+
+
+/**
+ * @brief   Start the task that formats and prints the deferred records
+ * @return  None
+ * @note    Records written before this call are kept and printed once the task runs
+ * **/
+void defer_log_init(void);
+
+
+/**
+ * @brief   Store a record in the ring of the calling core
+ * @param   level: Log level of the record
+ * @param   tag: Tag of the record, must stay valid until it is printed (string literal)
+ * @param   format: printf format, must stay valid until it is printed (string literal)
+ * @param   args: Raw arguments, every conversion of the format takes one 32-bit value
+ * @param   arg_num: Number of entries in args, at most DEFER_LOG_MAX_ARGS
+ * @return  None
+ * @note    Safe from tasks and ISRs. Only interrupts of the calling core are masked while the record is copied,
+ *          nothing is formatted and no lock is shared with the other core. When the ring is full the record is
+ *          dropped and counted.
+ * **/
+void defer_log_write(esp_log_level_t level, const char *tag, const char *format, const uint32_t *args, uint32_t arg_num);
+
+
+/**
+ * @brief   Number of records dropped because a ring was full
+ * @return  Total over both cores since boot
+ * **/
+uint32_t defer_log_dropped(void);
+
+
+// The format string is the record id: only its address is stored. Arguments are cast to uint32_t, so %s only
+// works with strings that outlive the record and %lld/%f are not supported.
+#define DEFER_LOG_ARGS_(...)    ((const uint32_t[]){ 0, ##__VA_ARGS__ } + 1)
+#define DEFER_LOG_NARGS_(...)   (sizeof((const uint32_t[]){ 0, ##__VA_ARGS__ }) / sizeof(uint32_t) - 1)
+
+#define DEFER_LOG_LEVEL(level, tag, format, ...) do {                                                   \
+        if (LOG_LOCAL_LEVEL >= (level)) {                                                               \
+            _Static_assert(DEFER_LOG_NARGS_(__VA_ARGS__) <= DEFER_LOG_MAX_ARGS, "too many arguments");  \
+            defer_log_write((level), (tag), (format), DEFER_LOG_ARGS_(__VA_ARGS__),                     \
+                            DEFER_LOG_NARGS_(__VA_ARGS__));                                             \
+        }                                                                                               \
+    } while (0)
+
+#define DLOGE(tag, format, ...)     DEFER_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define DLOGW(tag, format, ...)     DEFER_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define DLOGI(tag, format, ...)     DEFER_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define DLOGD(tag, format, ...)     DEFER_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MACRO_REPORT_KEYS       6       // keys held at once, the boot keyboard layout every transport carries
+
+/**
+ * Bytecode of a macro: an opcode byte, then its operand. Every opcode except MACRO_OP_END makes one report,
+ * MACRO_OP_TAP makes two, MACRO_OP_WAIT makes a pause instead. Macros are const arrays, so they stay in flash:
+ *
+ *     static const uint8_t macro_copy[] = {MACRO_DOWN(HID_KEY_CONTROL_LEFT), MACRO_TAP(HID_KEY_C),
+ *                                          MACRO_UP(HID_KEY_CONTROL_LEFT), MACRO_END()};
+ */
+typedef enum {
+    MACRO_OP_END = 0x00,
+    MACRO_OP_DOWN,              // keycode: press, HID_KEY_CONTROL_LEFT..HID_KEY_GUI_RIGHT set the modifier bits
+    MACRO_OP_UP,                // keycode: release
+    MACRO_OP_TAP,               // keycode: press, release in the next report
+    MACRO_OP_CONSUMER,          // usage: consumer control usage, 0 releases
+    MACRO_OP_RELEASE_ALL,       // no operand: release every key and modifier the macro holds
+    MACRO_OP_WAIT,              // ms, little endian 16 bit: pause before the next report, for recorded timing
+} macro_op_t;
+
+#define MACRO_DOWN(keycode)     MACRO_OP_DOWN, (keycode)
+#define MACRO_UP(keycode)       MACRO_OP_UP, (keycode)
+#define MACRO_TAP(keycode)      MACRO_OP_TAP, (keycode)
+#define MACRO_CONSUMER(usage)   MACRO_OP_CONSUMER, (usage)
+#define MACRO_RELEASE_ALL()     MACRO_OP_RELEASE_ALL
+#define MACRO_WAIT(ms)          MACRO_OP_WAIT, ((ms) & 0xFF), (((ms) >> 8) & 0xFF)
+#define MACRO_END()             MACRO_OP_END
+
+
+typedef enum {
+    MACRO_REPORT_KEYBOARD = 0,
+    MACRO_REPORT_CONSUMER,
+    MACRO_REPORT_WAIT,          // nothing to send, pause for wait_ms
+} macro_report_type_t;
+
+
+// One report of a macro, the transport turns it into its own format
+typedef struct {
+    macro_report_type_t type;
+    uint8_t modifier;                       // MACRO_REPORT_KEYBOARD
+    uint8_t keycode[MACRO_REPORT_KEYS];     // MACRO_REPORT_KEYBOARD, 0 for an empty slot
+    uint8_t usage;                          // MACRO_REPORT_CONSUMER
+    uint16_t wait_ms;                       // MACRO_REPORT_WAIT
+} macro_report_t;
+
+
+// Playback position, the keys the macro holds and a tap still to be released
+typedef struct {
+    const uint8_t *pc;
+    uint8_t modifier;
+    uint8_t keycode[MACRO_REPORT_KEYS];
+    uint8_t tap_release;
+} macro_t;
+
+
+/**
+ * @brief   Start playing a macro, nothing held
+ * @param   macro: Playback state
+ * @param   bytecode: Macro, must stay valid until playback ends
+ * @return  None
+ * **/
+void macro_start(macro_t *macro, const uint8_t *bytecode);
+
+
+/**
+ * @brief   Run the macro up to its next report
+ * @param   macro: Playback state
+ * @param   report: Filled when the return value is true
+ * @return  false at MACRO_OP_END or an unknown opcode, the macro is done
+ * @note    Pure and O(1) per call, the caller decides when the link can take the next report
+ * **/
+bool macro_step(macro_t *macro, macro_report_t *report);
+
+
+/**
+ * @brief   Whether the macro still holds a key or modifier
+ * @param   macro: Playback state
+ * @return  true when a release is owed to the host
+ * **/
+bool macro_holds_keys(const macro_t *macro);
+
+
+/**
+ * @brief   Length of a macro that did not come with the firmware
+ * @param   bytecode: Macro to check
+ * @param   size: Bytes readable at bytecode
+ * @return  Bytes up to and including MACRO_OP_END, 0 when an opcode is unknown or the macro runs past size
+ * @note    A macro this accepts is safe to hand to macro_start(), macro_step() stays inside it
+ * **/
+size_t macro_length(const uint8_t *bytecode, size_t size);
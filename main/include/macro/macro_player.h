@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "macro.h"
+
+#define MACRO_PLAYER_QUEUE_LEN          4       // macros waiting behind the one playing
+#define MACRO_PLAYER_READY_TIMEOUT_MS   50      // a report the link never confirms does not stall playback
+
+#define MACRO_PLAYER_TASK_CORE          1       // keyboard scan task runs on core 0 (cfg.core_id)
+#define MACRO_PLAYER_TASK_PRIORITY      3
+
+
+// Hands one macro report to the current transport, called from the player task
+typedef void (*macro_send_t)(const macro_report_t *report);
+
+// Called from the player task once the last report of a macro went out
+typedef void (*macro_done_t)(void);
+
+
+/**
+ * @brief   Start the player task
+ * @param   send: Transport for the macro reports
+ * @return  None
+ * **/
+void macro_player_init(macro_send_t send);
+
+
+/**
+ * @brief   Queue a macro for playback
+ * @param   bytecode: Macro in flash, see macro.h
+ * @param   done: Called after its last report, NULL for none
+ * @return  false when the player is not running or the queue is full
+ * @note    Never blocks, safe from the scan task and the transport callbacks
+ * **/
+bool macro_player_play(const uint8_t *bytecode, macro_done_t done);
+
+
+/**
+ * @brief   The link took the previous report and is ready for another one
+ * @return  None
+ * @note    Called from the transport completions: USB report complete, BLE notification confirmed and ESP-NOW
+ *          send callback. The player sends one report per call, so a macro types as fast as the link accepts,
+ *          one report per USB polling frame or BLE connection event.
+ * **/
+void macro_player_ready(void);
+
+
+/**
+ * @brief   Whether a macro is playing or queued
+ * @return  true while the player has reports left to send
+ * **/
+bool macro_player_busy(void);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "macro.h"
+
+#define MACRO_RECORD_EVENTS         256     // key changes kept, the oldest are dropped once the ring is full
+#define MACRO_RECORD_USAGE_WORDS    (256 / 32)
+
+// Bytecode of a full ring: every event a key opcode and a wait, then MACRO_OP_END
+#define MACRO_RECORD_BYTECODE_SIZE  (MACRO_RECORD_EVENTS * 5 + 1)
+// Packed blob of a full ring: the version byte, then at most 3 varint bytes and the usage per event
+#define MACRO_RECORD_PACK_SIZE      (1 + MACRO_RECORD_EVENTS * 4)
+#define MACRO_RECORD_PACK_VERSION   1
+
+
+// One key change of the host report, modifiers are recorded as HID_KEY_CONTROL_LEFT..HID_KEY_GUI_RIGHT
+typedef struct {
+    uint16_t wait_ms;           // since the previous event, saturated
+    uint8_t keycode;
+    uint8_t down;
+} macro_record_event_t;
+
+
+// All state is inline, recording never allocates
+typedef struct {
+    macro_record_event_t events[MACRO_RECORD_EVENTS];
+    uint32_t head;                              // oldest event
+    uint32_t event_num;
+
+    bool recording;
+    uint32_t last_ms;                           // time of the previous event, or of the start
+    uint32_t held[MACRO_RECORD_USAGE_WORDS];    // usages down in the last recorded report
+    uint32_t ignore[MACRO_RECORD_USAGE_WORDS];  // usages already down at the start, left out until released
+} macro_record_t;
+
+
+/**
+ * @brief   Drop the recording and start a new one
+ * @param   record: Recorder
+ * @param   modifier: Modifier byte of the report the host holds now
+ * @param   keycode: Keys of that report, MACRO_REPORT_KEYS of them
+ * @param   now_ms: Current time
+ * @return  None
+ * @note    Keys down at the start belong to the command that started the recording, they are not recorded
+ * **/
+void macro_record_start(macro_record_t *record, uint8_t modifier, const uint8_t *keycode, uint32_t now_ms);
+
+
+/**
+ * @brief   Stop recording, the events stay for replay
+ * @param   record: Recorder
+ * @return  None
+ * **/
+void macro_record_stop(macro_record_t *record);
+
+
+/**
+ * @brief   Record the changes of a boot keyboard report against the previous one
+ * @param   record: Recorder, nothing happens unless it is recording
+ * @param   modifier: Modifier byte of the report
+ * @param   keycode: Keys of the report, MACRO_REPORT_KEYS of them
+ * @param   now_ms: Time the report was built
+ * @return  None
+ * @note    O(1): the report and the held keys are compared as 256 bit usage sets. A report in
+ *          HID_REPORT_ERROR_ROLLOVER is skipped, the host keeps the previous keys as well.
+ * **/
+void macro_record_report(macro_record_t *record, uint8_t modifier, const uint8_t *keycode, uint32_t now_ms);
+
+
+/**
+ * @brief   Turn the recording into macro bytecode
+ * @param   record: Recorder
+ * @param   timed: true to keep the recorded pauses, false to play as fast as the link takes reports
+ * @param   bytecode: Filled with the macro, ends with MACRO_OP_END
+ * @param   size: Size of bytecode, MACRO_RECORD_BYTECODE_SIZE always fits
+ * @return  Bytes written, 0 when bytecode is too small
+ * @note    The pause before the first event is left out, replay starts at once
+ * **/
+size_t macro_record_compile(const macro_record_t *record, bool timed, uint8_t *bytecode, size_t size);
+
+
+/**
+ * @brief   Pack the events into a blob for storage
+ * @param   record: Recorder
+ * @param   blob: Filled with the version byte, then per event a varint of (wait_ms << 1 | down) and the usage
+ * @param   size: Size of blob, MACRO_RECORD_PACK_SIZE always fits
+ * @return  Bytes written, 0 when blob is too small
+ * @note    Typing pauses below 64 ms take one byte, so most events pack into 2 bytes instead of 4
+ * **/
+size_t macro_record_pack(const macro_record_t *record, uint8_t *blob, size_t size);
+
+
+/**
+ * @brief   Replace the events with a blob of macro_record_pack()
+ * @param   record: Recorder, stopped
+ * @param   blob: Packed events
+ * @param   len: Length of blob
+ * @return  false for a blob of another version or a truncated one, the recording is empty then
+ * **/
+bool macro_record_unpack(macro_record_t *record, const uint8_t *blob, size_t len);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "esp_err.h"
+#include "macro_record.h"
+
+#define MACRO_STORE_NVS_KEY     "macro_rec"     // blob in the "storage" namespace
+
+
+/**
+ * @brief   Save a recording to NVS as one packed blob
+ * @param   record: Stopped recorder
+ * @return  ESP_OK, or the NVS error
+ * @note    Writes flash, call it on a user command and not for every recording, and not from the scan task
+ * **/
+esp_err_t save_recording_to_nvs(const macro_record_t *record);
+
+
+/**
+ * @brief   Load the recording saved by save_recording_to_nvs()
+ * @param   record: Recorder, replaced by the saved events
+ * @return  ESP_OK, ESP_ERR_NVS_NOT_FOUND when nothing was saved, ESP_ERR_INVALID_VERSION for an unreadable blob
+ * **/
+esp_err_t load_recording_from_nvs(macro_record_t *record);
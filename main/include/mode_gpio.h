@@ -1,3 +1,5 @@
+#pragma once
+
 typedef enum {
     MODE_USB = 1,
     MODE_BLE = 2,
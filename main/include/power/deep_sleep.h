@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_bt_defs.h"
+#include "keyboard_button.h"
+#include "mode_gpio.h"
+
+#define DEEP_SLEEP_IDLE_MS          (10 * 60 * 1000)
+#define DEEP_SLEEP_CHECK_PERIOD_MS  (60 * 1000)
+#define DEEP_SLEEP_RTC_MAGIC        0x4B424453      // "KBDS"
+
+#define DEEP_SLEEP_TASK_CORE        1               // keyboard scan task runs on core 0 (cfg.core_id)
+#define DEEP_SLEEP_TASK_PRIORITY    1
+
+/*
+ * Wake set. Every row is driven active during sleep and EXT1 watches the columns, but EXT1 only
+ * reaches RTC GPIOs. With the default matrix that is columns 0, 1, 13, 14, 15 and 16
+ * (GPIO 1, 2, 21, 14, 13 and 12), so only these keys wake the keyboard:
+ *   column 0:  Esc, `, Tab, Caps Lock, Left Shift, Left Ctrl
+ *   column 1:  1, Q, A, Z, Left GUI
+ *   column 13: F12, Backspace, \, Enter, Right Shift, Right Ctrl
+ *   column 14: Print Screen, Insert, Delete, Left
+ *   column 15: Scroll Lock, Home, End, Up, Down
+ *   column 16: Pause, Page Up, Page Down, Right
+ * A matrix with no column on an RTC GPIO never enters deep sleep.
+ */
+
+
+// Transport state kept in RTC slow memory across deep sleep
+typedef struct {
+    uint32_t magic;
+    connection_mode_t mode;
+    int32_t ble_idx;
+    esp_bd_addr_t last_host;
+} deep_sleep_rtc_state_t;
+
+
+/**
+ * @brief   Restore the state saved before deep sleep and latch the key that woke the keyboard
+ * @return  None
+ * @note    Must be called at the top of app_main(), before the matrix is created, so the wake key is read
+ *          while it is most likely still held
+ * **/
+void deep_sleep_restore(void);
+
+
+/**
+ * @brief   Get the transport state saved before deep sleep
+ * @param   state: Filled with the saved state
+ * @return  true if the chip woke from deep sleep and the saved state is valid
+ * **/
+bool deep_sleep_get_rtc_state(deep_sleep_rtc_state_t *state);
+
+
+/**
+ * @brief   Take the key that woke the keyboard, if it has not been reported yet
+ * @param   key: Filled with the matrix position of the wake key
+ * @return  true if a wake key is pending. The key is cleared, a second call returns false.
+ * @note    Scan task only, like deep_sleep_wake_key_seen()
+ * **/
+bool deep_sleep_take_wake_key(keyboard_btn_data_t *key);
+
+
+/**
+ * @brief   Drop the pending wake key once the matrix scan reports it by itself
+ * @param   kbd_report: Report from the keyboard callback
+ * @return  None
+ * **/
+void deep_sleep_wake_key_seen(const keyboard_btn_report_t *kbd_report);
+
+
+/**
+ * @brief   Print the resume time the first time a report is sent after waking from deep sleep
+ * @return  None
+ * **/
+void deep_sleep_report_sent(void);
+
+
+/**
+ * @brief   Find the columns that can wake the keyboard and start the task polling deep_sleep_check_idle()
+ * @return  None
+ * @note    Starts no task if no column is an RTC GPIO, the keyboard then never enters deep sleep
+ * **/
+void deep_sleep_init(void);
+
+
+/**
+ * @brief   Enter deep sleep if the keyboard has been idle for DEEP_SLEEP_IDLE_MS or the battery is critical
+ * @return  None, does not return when the keyboard goes to sleep
+ * @note    Never sleeps in MODE_USB, the host powers the keyboard, nor before deep_sleep_init() found a wake column
+ * **/
+void deep_sleep_check_idle(void);
+
+
+/**
+ * @brief   Save the transport state, drive every row active, arm the columns as EXT1 sources and sleep
+ * @return  None, only returns if no column can wake the chip or deep_sleep_init() was not called
+ * **/
+void deep_sleep_enter(void);
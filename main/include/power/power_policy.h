@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mode_gpio.h"
+
+#define POWER_BATTERY_LOW_PERCENT       20
+#define POWER_BATTERY_CRITICAL_PERCENT  5
+
+#define POWER_CPU_MAX_FREQ_MHZ          CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define POWER_CPU_LOW_BATTERY_FREQ_MHZ  80
+#define POWER_CPU_MIN_FREQ_MHZ          40      // XTAL
+
+// Rough ESP32-S3 current draw per state in uA, used only for the logged estimate
+#define POWER_ESTIMATE_ACTIVE_UA        38000   // CPU at max frequency, matrix scanning
+#define POWER_ESTIMATE_REPORT_UA        24000   // radio busy, light sleep blocked
+#define POWER_ESTIMATE_IDLE_UA          12000   // DFS at XTAL, no light sleep
+#define POWER_ESTIMATE_SLEEP_UA         1800    // auto light sleep between BLE connection events
+
+
+typedef enum {
+    POWER_BATTERY_NORMAL = 0,
+    POWER_BATTERY_LOW,
+    POWER_BATTERY_CRITICAL,
+} power_battery_state_t;
+
+
+typedef enum {
+    POWER_STATE_ACTIVE = 0,     // a key is down
+    POWER_STATE_REPORT,         // no key down, a report is still in flight
+    POWER_STATE_IDLE,           // no lock held
+    POWER_STATE_MAX,
+} power_state_t;
+
+
+/**
+ * @brief   Configure DFS and automatic light sleep for a connection mode
+ * @param   mode: Current connection mode
+ * @return  None
+ * @note    Light sleep is only enabled in MODE_BLE. USB needs the clocks running and ESP-NOW keeps Wi-Fi awake,
+ *          so these modes only scale the CPU frequency (USB not even that).
+ * **/
+void power_policy_apply_mode(connection_mode_t mode);
+
+
+/**
+ * @brief   Hold the CPU at full speed and block light sleep while any key is down
+ * @param   key_down: true when at least one key is pressed
+ * @return  None
+ * @note    Called from the keyboard callback with every report, repeated values are ignored
+ * **/
+void power_policy_set_key_down(bool key_down);
+
+
+/**
+ * @brief   Block light sleep until a report has left the stack
+ * @return  None
+ * @note    Every call must be matched by power_policy_report_end()
+ * **/
+void power_policy_report_begin(void);
+
+
+/**
+ * @brief   Release one report started with power_policy_report_begin()
+ * @return  None
+ * **/
+void power_policy_report_end(void);
+
+
+/**
+ * @brief   Release every report still in flight, used when the link drops
+ * @return  None
+ * **/
+void power_policy_reports_clear(void);
+
+
+/**
+ * @brief   Time since the last key press or release
+ * @return  Idle time in us, 0 while a key is down
+ * **/
+int64_t power_policy_get_idle_us(void);
+
+
+/**
+ * @brief   Log the time spent in each power state and the estimated average current since the last call
+ * @return  None
+ * **/
+void power_policy_log_estimate(void);
+
+
+/**
+ * @brief   Feed a new battery level into the power policy
+ * @param   level: Battery level in percent
+ * @return  None
+ * @note    Called by the battery monitor after every sample. A low battery lowers the maximum CPU frequency.
+ * **/
+void power_policy_set_battery_level(uint8_t level);
+
+
+/**
+ * @brief   Last battery level seen by the policy
+ * @return  Battery level in percent, 100 until the first sample
+ * **/
+uint8_t power_policy_get_battery_level(void);
+
+
+/**
+ * @brief   Battery state derived from the last level
+ * @return  POWER_BATTERY_NORMAL, POWER_BATTERY_LOW or POWER_BATTERY_CRITICAL
+ * **/
+power_battery_state_t power_policy_get_battery_state(void);
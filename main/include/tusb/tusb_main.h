@@ -1,6 +1,34 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include "btn_progress.h"
 
+#define TINYUSB_VENDOR_REPORT_LEN   64      // raw HID report, both directions
+
+typedef void (*tinyusb_vendor_rx_cb_t)(const uint8_t *data, uint16_t len);
+
+
+// true while the host reads keys from the NKRO interface, false after it switched the keyboard to boot protocol
+bool tinyusb_hid_keyboard_nkro(void);
 
 void tinyusb_hid_keyboard_report(hid_nkey_report_t report);
 
+// Queue a consumer control usage on its own endpoint, 0 releases
+bool tinyusb_hid_consumer_report(uint16_t usage);
+
+// The macro player's next report is a consumer usage (true) or keys (false), only that interface paces the player
+void tinyusb_hid_macro_interface(bool consumer);
+
+// Add relative motion to the next mouse report, sent with the consumer interface every frame while it moves
+void tinyusb_hid_mouse_report(uint8_t buttons, int8_t x, int8_t y, int8_t wheel);
+
+// Queue a raw HID report on the vendor endpoint, shorter data is padded with zeros
+bool tinyusb_hid_vendor_report(const uint8_t *data, uint16_t len);
+
+// Called from the TinyUSB task with every report the host writes to the vendor interface
+void tinyusb_hid_vendor_register_rx(tinyusb_vendor_rx_cb_t cb);
+
+// Write one steno packet to the CDC port of steno mode, false while the port is closed or outside steno mode
+bool tinyusb_steno_write(const uint8_t *data, size_t len);
+
 void tusb_main(void);
\ No newline at end of file
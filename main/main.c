@@ -6,9 +6,19 @@
 
 #include "mode_gpio.h"
 #include "tusb_main.h"
+#include "battery.h"
+#include "deep_sleep.h"
+#include "defer_log.h"
+#include "led_state.h"
+#include "layout.h"
 
 
 void app_main() {
+    // Read the wake key before anything else, the user may release it any moment
+    deep_sleep_restore();
+    defer_log_init();
+    led_state_init();
+
     connection_mode_t *mode = malloc(sizeof(connection_mode_t));
 
     // Initialize NVS
@@ -18,5 +28,11 @@ void app_main() {
       ret = nvs_flash_init();
     }
 
+    // Before any task looks up a key or a lamp
+    layout_init();
+
     setup_mode_gpio(mode);
+    battery_main();
+    // Not tied to the battery task, the idle timeout applies even when the ADC is missing
+    deep_sleep_init();
 }
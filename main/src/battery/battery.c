@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+
+#include "battery.h"
+#include "power_policy.h"
+#include "change_mode_interrupt.h"
+#include "ble_main.h"
+
+static const char *TAG = "battery";
+
+
+typedef struct {
+    int voltage_mv;
+    uint8_t level;
+} battery_curve_point_t;
+
+// Single cell LiPo under light load, ordered by voltage
+static const battery_curve_point_t battery_curve[] = {
+    {3300, 0},
+    {3600, 5},
+    {3700, 20},
+    {3750, 40},
+    {3800, 55},
+    {3900, 70},
+    {4000, 85},
+    {4100, 95},
+    {4200, 100},
+};
+
+#define BATTERY_CURVE_SIZE  (sizeof(battery_curve) / sizeof(battery_curve[0]))
+
+
+static adc_oneshot_unit_handle_t s_adc_handle = NULL;
+static adc_cali_handle_t s_cali_handle = NULL;
+static uint8_t s_level = 100;
+
+
+uint8_t battery_voltage_to_level(int voltage_mv) {
+    if (voltage_mv <= battery_curve[0].voltage_mv) {
+        return battery_curve[0].level;
+    }
+
+    for (int i = 1; i < BATTERY_CURVE_SIZE; i++) {
+        if (voltage_mv < battery_curve[i].voltage_mv) {
+            const battery_curve_point_t *lo = &battery_curve[i - 1];
+            const battery_curve_point_t *hi = &battery_curve[i];
+            return lo->level + (voltage_mv - lo->voltage_mv) * (hi->level - lo->level) / (hi->voltage_mv - lo->voltage_mv);
+        }
+    }
+    return battery_curve[BATTERY_CURVE_SIZE - 1].level;
+}
+
+
+uint8_t battery_get_level(void) {
+    return s_level;
+}
+
+
+static esp_err_t battery_adc_init(void) {
+    adc_oneshot_unit_init_cfg_t unit_cfg = {
+        .unit_id = BATTERY_ADC_UNIT,
+        .ulp_mode = ADC_ULP_MODE_DISABLE,
+    };
+    esp_err_t ret = adc_oneshot_new_unit(&unit_cfg, &s_adc_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    adc_oneshot_chan_cfg_t chan_cfg = {
+        .atten = BATTERY_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    ret = adc_oneshot_config_channel(s_adc_handle, BATTERY_ADC_CHANNEL, &chan_cfg);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    adc_cali_curve_fitting_config_t cali_cfg = {
+        .unit_id = BATTERY_ADC_UNIT,
+        .chan = BATTERY_ADC_CHANNEL,
+        .atten = BATTERY_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    if (adc_cali_create_scheme_curve_fitting(&cali_cfg, &s_cali_handle) != ESP_OK) {
+        // Without eFuse calibration the raw reading is still usable, only less accurate
+        ESP_LOGW(TAG, "ADC calibration not available");
+        s_cali_handle = NULL;
+    }
+    return ESP_OK;
+}
+
+
+/**
+ * @brief   Sample the cell BATTERY_SAMPLE_COUNT times and average the result
+ * @param   voltage_mv: Averaged cell voltage in mV
+ * @return  ESP_OK on success
+ * **/
+static esp_err_t battery_sample(int *voltage_mv) {
+    int sum = 0;
+    int count = 0;
+
+    for (int i = 0; i < BATTERY_SAMPLE_COUNT; i++) {
+        int raw = 0;
+        if (adc_oneshot_read(s_adc_handle, BATTERY_ADC_CHANNEL, &raw) != ESP_OK) {
+            continue;
+        }
+        sum += raw;
+        count++;
+    }
+    if (count == 0) {
+        return ESP_FAIL;
+    }
+
+    int raw_avg = sum / count;
+    int pin_mv = 0;
+    if (s_cali_handle) {
+        adc_cali_raw_to_voltage(s_cali_handle, raw_avg, &pin_mv);
+    } else {
+        pin_mv = raw_avg * 3100 / 4095;
+    }
+    *voltage_mv = pin_mv * BATTERY_DIVIDER_RATIO;
+    return ESP_OK;
+}
+
+
+static void battery_task(void *arg) {
+    bool has_reported = false;
+    uint8_t reported_level = 0;
+
+    while (1) {
+        int voltage_mv = 0;
+        if (battery_sample(&voltage_mv) == ESP_OK) {
+            s_level = battery_voltage_to_level(voltage_mv);
+            power_policy_set_battery_level(s_level);
+
+            // Notify only when a step boundary is crossed, small ripples around a boundary are ignored
+            bool crossed = (s_level / BATTERY_NOTIFY_STEP) != (reported_level / BATTERY_NOTIFY_STEP)
+                           && abs(s_level - reported_level) >= BATTERY_NOTIFY_HYSTERESIS;
+            if (!has_reported || crossed) {
+                ESP_LOGI(TAG, "Battery %d mV, %d%%", voltage_mv, s_level);
+                if (current_mode == MODE_BLE) {
+                    ble_send_battery_level(s_level);
+                }
+                reported_level = s_level;
+                has_reported = true;
+            }
+        }
+        power_policy_log_estimate();
+
+        vTaskDelay(BATTERY_SAMPLE_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+}
+
+
+void battery_main(void) {
+    if (battery_adc_init() != ESP_OK) {
+        ESP_LOGE(TAG, "ADC init failed, battery level stays at %d%%", s_level);
+        return;
+    }
+
+    xTaskCreatePinnedToCore(battery_task, "battery_task", 1024 * 3, NULL, BATTERY_TASK_PRIORITY, NULL, BATTERY_TASK_CORE);
+}
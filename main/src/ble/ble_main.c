@@ -22,18 +22,27 @@
 #include "esp_gap_ble_api.h"
 #include "esp_gatts_api.h"
 #include "esp_gatt_defs.h"
+#include "esp_gatt_common_api.h"
 #include "esp_bt_main.h"
 #include "esp_bt_device.h"
 #include "driver/gpio.h"
 #include "hid_dev.h"
 #include "hid_custom.h"
 #include "ble_main.h"
+#include "bond_cache.h"
+#include "battery.h"
+#include "power_policy.h"
+#include "deep_sleep.h"
+#include "kbd_latency.h"
+#include "defer_log.h"
+#include "led_state.h"
 #include "esp_mac.h"
 
 
 /**
  * Note:
- * 1. Win10 does not support vendor report , So SUPPORT_REPORT_VENDOR is always set to FALSE, it defines in hidd_le_prf_int.h
+ * 1. SUPPORT_REPORT_VENDOR in hidd_le_prf_int.h is on for the configuration channel. Win10 does not expose vendor
+ * reports of a BLE keyboard, configure the keyboard over USB there.
  * 2. Update connection parameters are not allowed during iPhone HID encryption, slave turns
  * off the ability to automatically update connection parameters during encryption.
  * 3. After our HID device is connected, the iPhones write 1 to the Report Characteristic Configuration Descriptor,
@@ -46,6 +55,17 @@
 
 
 static uint16_t hid_conn_id = 0;
+
+#define BLE_LINK_DEFAULT_OCTETS     27
+#define BLE_LINK_MAX_OCTETS         251
+#define BLE_LOCAL_MTU               247
+
+ble_link_info_t ble_link_info = {
+    .tx_phy = ESP_BLE_GAP_PHY_1M,
+    .rx_phy = ESP_BLE_GAP_PHY_1M,
+    .tx_octets = BLE_LINK_DEFAULT_OCTETS,
+    .rx_octets = BLE_LINK_DEFAULT_OCTETS,
+};
 static bool sec_conn = false;
 #define CHAR_DECLARATION_SIZE   (sizeof(uint8_t))
 
@@ -144,183 +164,136 @@ void show_bonded_devices(void)
     ESP_LOGI(HID_DEMO_TAG, "current ble_idx: %ld", current_ble_idx);
 
     bt_host_info_t host;
-    load_host_from_nvs(1, &host);
-    ESP_LOGI(HID_DEMO_TAG, "index 1 - Saved addr!!!: %02x:%02x:%02x:%02x:%02x:%02x",
-                     host.bda[0], host.bda[1], host.bda[2], host.bda[3], host.bda[4], host.bda[5]);
-    load_host_from_nvs(2, &host);
-    ESP_LOGI(HID_DEMO_TAG, "index 2 - Saved addr!!!: %02x:%02x:%02x:%02x:%02x:%02x",
-                     host.bda[0], host.bda[1], host.bda[2], host.bda[3], host.bda[4], host.bda[5]);
-    load_host_from_nvs(3, &host);
-    ESP_LOGI(HID_DEMO_TAG, "index 3 - Saved addr!!!: %02x:%02x:%02x:%02x:%02x:%02x",
-                     host.bda[0], host.bda[1], host.bda[2], host.bda[3], host.bda[4], host.bda[5]);
-
-    int dev_num = esp_ble_get_bond_device_num();
-    if (dev_num == 0) {
-        ESP_LOGI(__func__, "Bonded devices number zero\n");
-        return;
+    for (int i = 1; i <= BOND_CACHE_HOST_SLOTS; i++) {
+        bond_cache_get_host(i, &host);
+        ESP_LOGI(HID_DEMO_TAG, "index %d - Saved addr!!!: %02x:%02x:%02x:%02x:%02x:%02x", i,
+                         host.bda[0], host.bda[1], host.bda[2], host.bda[3], host.bda[4], host.bda[5]);
     }
 
-    esp_ble_bond_dev_t *dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
-    if (!dev_list) {
-        ESP_LOGE(__func__, "malloc failed, return\n");
+    esp_bd_addr_t dev_list[BOND_CACHE_MAX_BONDS];
+    int dev_num = bond_cache_get_bonds(dev_list, BOND_CACHE_MAX_BONDS);
+    if (dev_num == 0) {
+        ESP_LOGI(__func__, "Bonded devices number zero\n");
         return;
     }
 
-    esp_ble_get_bond_device_list(&dev_num, dev_list);
     ESP_LOGI(__func__, "Bonded devices list : %d", dev_num);
     for (int i = 0; i < dev_num; i++) {
-        ESP_LOG_BUFFER_HEX(__func__, (void *)dev_list[i].bd_addr, sizeof(esp_bd_addr_t));
+        ESP_LOG_BUFFER_HEX(__func__, (void *)dev_list[i], sizeof(esp_bd_addr_t));
     }
-
-    free(dev_list);
 }
 
 
 void disconnect_all_bonded_devices(void) {
-    int dev_num = esp_ble_get_bond_device_num();
+    esp_bd_addr_t dev_list[BOND_CACHE_MAX_BONDS];
+    int dev_num = bond_cache_get_bonds(dev_list, BOND_CACHE_MAX_BONDS);
     if (dev_num == 0) {
         ESP_LOGI(__func__, "Bonded devices number zero\n");
         return;
     }
 
-    esp_ble_bond_dev_t *dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
-    if (!dev_list) {
-        ESP_LOGE(__func__, "malloc failed, return\n");
-        return;
-    }
-
-    esp_ble_get_bond_device_list(&dev_num, dev_list);
     for (int i = 0; i < dev_num; i++) {
-        esp_ble_gap_disconnect(dev_list[i].bd_addr);
+        esp_ble_gap_disconnect(dev_list[i]);
     }
-
-    free(dev_list);
 }
 
 
 void remove_all_bonded_devices(void)
 {
-    int dev_num = esp_ble_get_bond_device_num();
+    esp_bd_addr_t dev_list[BOND_CACHE_MAX_BONDS];
+    int dev_num = bond_cache_get_bonds(dev_list, BOND_CACHE_MAX_BONDS);
 
-    esp_ble_bond_dev_t *dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
-    if (!dev_list) {
-        ESP_LOGE(__func__, "malloc failed, return\n");
-        return;
-    }
-    esp_ble_get_bond_device_list(&dev_num, dev_list);
+    // The cache drops each entry on ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT
     for (int i = 0; i < dev_num; i++) {
-        esp_ble_remove_bond_device(dev_list[i].bd_addr);
+        esp_ble_remove_bond_device(dev_list[i]);
     }
-
-    free(dev_list);
 }
 
 
 void remove_unsaved_pairing_device(void) {
-    int dev_num = esp_ble_get_bond_device_num();
+    esp_bd_addr_t dev_list[BOND_CACHE_MAX_BONDS];
+    int dev_num = bond_cache_get_bonds(dev_list, BOND_CACHE_MAX_BONDS);
     if (dev_num == 0) {
         ESP_LOGI(__func__, "Bonded devices number zero\n");
         return;
     }
 
-    esp_ble_bond_dev_t *dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
-    if (!dev_list) {
-        ESP_LOGE(__func__, "malloc failed, return\n");
-        return;
-    }
-
-    bt_host_info_t host_index_1;
-    bt_host_info_t host_index_2;
-    bt_host_info_t host_index_3;
-    load_host_from_nvs(1, &host_index_1);
-    load_host_from_nvs(2, &host_index_2);
-    load_host_from_nvs(3, &host_index_3);
-
-    esp_ble_get_bond_device_list(&dev_num, dev_list);
     for (int i = 0; i < dev_num; i++) {
-        if (memcmp(dev_list[i].bd_addr, host_index_1.bda, sizeof(esp_bd_addr_t)) != 0 &&
-            memcmp(dev_list[i].bd_addr, host_index_2.bda, sizeof(esp_bd_addr_t)) != 0 &&
-            memcmp(dev_list[i].bd_addr, host_index_3.bda, sizeof(esp_bd_addr_t)) != 0) {
-            esp_ble_remove_bond_device(dev_list[i].bd_addr);
+        if (bond_cache_host_index(dev_list[i]) == 0) {
+            esp_ble_remove_bond_device(dev_list[i]);
         }
     }
-
-    free(dev_list);
 }
 
 void remove_unpaired_devices(void) {
-    int dev_num = esp_ble_get_bond_device_num();
-    if (dev_num == 0) {
+    if (bond_cache_bond_num() == 0) {
         ESP_LOGI(__func__, "Bonded devices number zero\n");
         return;
     }
 
-    esp_ble_bond_dev_t *dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
-    if (!dev_list) {
-        ESP_LOGE(__func__, "malloc failed, return\n");
-        return;
-    }
-
-    bt_host_info_t host_index_1;
-    bt_host_info_t host_index_2;
-    bt_host_info_t host_index_3;
-    load_host_from_nvs(1, &host_index_1);
-    load_host_from_nvs(2, &host_index_2);
-    load_host_from_nvs(3, &host_index_3);
-    bool host_1_exist = false;
-    bool host_2_exist = false;
-    bool host_3_exist = false;
-
-    esp_ble_get_bond_device_list(&dev_num, dev_list);
-
-    for (int i = 0; i < dev_num; i++) {
-        if (memcmp(dev_list[i].bd_addr, host_index_1.bda, sizeof(esp_bd_addr_t)) == 0) {
-            host_1_exist = true;
-        } else if (memcmp(dev_list[i].bd_addr, host_index_2.bda, sizeof(esp_bd_addr_t)) == 0) {
-            host_2_exist = true;
-        } else if (memcmp(dev_list[i].bd_addr, host_index_3.bda, sizeof(esp_bd_addr_t)) == 0) {
-            host_3_exist = true;
+    bt_host_info_t host;
+    for (int i = 1; i <= BOND_CACHE_HOST_SLOTS; i++) {
+        bond_cache_get_host(i, &host);
+        // Empty slots are skipped so advertising does not rewrite NVS every time
+        if (memcmp(host.bda, empty_host.bda, sizeof(esp_bd_addr_t)) == 0) {
+            continue;
+        }
+        if (!bond_cache_has_bond(host.bda)) {
+            delete_host_from_nvs(i);
         }
     }
-
-    if (host_1_exist == false) {
-        delete_host_from_nvs(1);
-    }
-
-    if (host_2_exist == false) {
-        delete_host_from_nvs(2);
-    }
-
-    if (host_3_exist == false) {
-        delete_host_from_nvs(3);
-    }
-
-    free(dev_list);
 }
 
 void connect_allowed_device(esp_bd_addr_t allowed_bda) {
-    int dev_num = esp_ble_get_bond_device_num();
+    esp_bd_addr_t dev_list[BOND_CACHE_MAX_BONDS];
+    int dev_num = bond_cache_get_bonds(dev_list, BOND_CACHE_MAX_BONDS);
     if (dev_num == 0) {
         ESP_LOGI(__func__, "Bonded devices number zero\n");
         return;
     }
 
-    esp_ble_bond_dev_t *dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
-    if (!dev_list) {
-        ESP_LOGE(__func__, "malloc failed, return\n");
-        return;
-    }
-
-    esp_ble_get_bond_device_list(&dev_num, dev_list);
     for (int i = 0; i < dev_num; i++) {
-        if (memcmp(dev_list[i].bd_addr, allowed_bda, ESP_BD_ADDR_LEN) == 0) {
+        if (memcmp(dev_list[i], allowed_bda, ESP_BD_ADDR_LEN) == 0) {
             continue;
         } else {
-            esp_ble_gap_disconnect(dev_list[i].bd_addr);
+            esp_ble_gap_disconnect(dev_list[i]);
         }
     }
+}
+
+
+// A string literal, DLOGI() prints it after the event returned
+static const char *phy_name(esp_ble_gap_phy_t phy) {
+    switch (phy) {
+    case ESP_BLE_GAP_PHY_1M:
+        return "1M";
+    case ESP_BLE_GAP_PHY_2M:
+        return "2M";
+    case ESP_BLE_GAP_PHY_CODED:
+        return "Coded";
+    default:
+        return "unknown";
+    }
+}
+
 
-    free(dev_list);
+static void request_fast_link(esp_bd_addr_t remote_bda) {
+    // Hosts without 2M PHY or DLE simply reject the request and the link stays on the defaults
+    esp_ble_gap_set_pkt_data_len(remote_bda, BLE_LINK_MAX_OCTETS);
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    esp_ble_gap_set_preferred_phy(
+        remote_bda,
+        ESP_BLE_GAP_NO_PREFER_TRANSMIT_PHY | ESP_BLE_GAP_NO_PREFER_RECEIVE_PHY,
+        ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+        ESP_BLE_GAP_PHY_OPTIONS_NO_PREF
+    );
+#endif
+}
+
+
+void ble_send_battery_level(uint8_t level) {
+    // Before encryption the host has not subscribed yet, only refresh the readable value
+    esp_hidd_send_battery_level(hid_conn_id, level, sec_conn);
 }
 
 
@@ -335,7 +308,7 @@ static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *
 {
     switch(event) {
         case ESP_HIDD_EVENT_REG_FINISH: {
-            ESP_LOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_REG_FINISH");
+            DLOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_REG_FINISH");
             if (param->init_finish.state == ESP_HIDD_INIT_OK) {
                 esp_ble_gap_set_device_name(HIDD_DEVICE_NAME);
                 esp_ble_gap_config_adv_data(&hidd_adv_data);
@@ -344,34 +317,48 @@ static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *
             break;
         }
         case ESP_BAT_EVENT_REG: {
-            ESP_LOGI(HID_DEMO_TAG, "ESP_BAT_EVENT_REG");
+            DLOGI(HID_DEMO_TAG, "ESP_BAT_EVENT_REG");
             break;
         }
         case ESP_HIDD_EVENT_DEINIT_FINISH:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_DEINIT_FINISH");
+            DLOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_DEINIT_FINISH");
 	        break;
 		case ESP_HIDD_EVENT_BLE_CONNECT: {
             hid_conn_id = param->connect.conn_id;
-            ESP_LOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_CONNECT, remote_bda %02x:%02x:%02x:%02x:%02x:%02x",
+            DLOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_CONNECT, remote_bda %02x:%02x:%02x:%02x:%02x:%02x",
                      param->connect.remote_bda[0], param->connect.remote_bda[1], param->connect.remote_bda[2],
                      param->connect.remote_bda[3], param->connect.remote_bda[4], param->connect.remote_bda[5]);
+            request_fast_link(param->connect.remote_bda);
+            ble_send_battery_level(battery_get_level());
             break;
         }
         case ESP_HIDD_EVENT_BLE_DISCONNECT: {
-            ESP_LOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_DISCONNECT");
+            DLOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_DISCONNECT");
             sec_conn = false;
+            power_policy_reports_clear();
+            kbd_latency_reports_clear();
+            // The next host has its own lock state, it sends it after connecting
+            led_state_set(MODE_BLE, 0);
+            ble_link_info.tx_phy = ESP_BLE_GAP_PHY_1M;
+            ble_link_info.rx_phy = ESP_BLE_GAP_PHY_1M;
+            ble_link_info.tx_octets = BLE_LINK_DEFAULT_OCTETS;
+            ble_link_info.rx_octets = BLE_LINK_DEFAULT_OCTETS;
             memset(hidd_adv_params.peer_addr, 0, sizeof(hidd_adv_params.peer_addr));
             esp_ble_gap_start_advertising(&hidd_adv_params);
             break;
         }
         case ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT: {
-            ESP_LOGI(HID_DEMO_TAG, "%s, ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT", __func__);
-            ESP_LOG_BUFFER_HEX(HID_DEMO_TAG, param->vendor_write.data, param->vendor_write.length);
+            DLOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT, len %d", param->vendor_write.length);
+            ESP_LOG_BUFFER_HEX_LEVEL(HID_DEMO_TAG, param->vendor_write.data, param->vendor_write.length, ESP_LOG_DEBUG);
+            keyboard_config_rx(param->vendor_write.data, param->vendor_write.length);
             break;
         }
         case ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT: {
-            ESP_LOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT");
-            ESP_LOG_BUFFER_HEX(HID_DEMO_TAG, param->led_write.data, param->led_write.length);
+            DLOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT, len %d", param->led_write.length);
+            ESP_LOG_BUFFER_HEX_LEVEL(HID_DEMO_TAG, param->led_write.data, param->led_write.length, ESP_LOG_DEBUG);
+            if (param->led_write.length >= 1) {
+                led_state_set(MODE_BLE, param->led_write.data[0]);
+            }
             break;
         }
         default:
@@ -396,6 +383,9 @@ esp_err_t save_host_to_nvs(int index, bt_host_info_t *host) {
     if (err == ESP_OK) {
         err = nvs_commit(nvs_handle);
     }
+    if (err == ESP_OK) {
+        bond_cache_set_host(index, host);
+    }
     
     ESP_LOGI(__func__, "Saved host bda %02x:%02x:%02x:%02x:%02x:%02x",
              host->bda[0], host->bda[1], host->bda[2], host->bda[3], host->bda[4], host->bda[5]);
@@ -441,6 +431,9 @@ esp_err_t delete_host_from_nvs(int index) {
     if (err == ESP_OK) {
         err = nvs_commit(nvs_handle);
     }
+    if (err == ESP_OK) {
+        bond_cache_set_host(index, &empty_host);
+    }
 
     if (err == ESP_OK) {
         ESP_LOGI(__func__, "Successfully deleted host info at index %d", index);
@@ -469,37 +462,34 @@ char *bda_to_string(esp_bd_addr_t bda, char *str, size_t size) {
 
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
 {
-    bt_host_info_t loaded_host;
-
     switch (event) {
         case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT");
-            load_host_from_nvs(0, &loaded_host);
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT");
             esp_ble_gap_start_advertising(&hidd_adv_params);
             break;
         case ESP_GAP_BLE_SEC_REQ_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SEC_REQ_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SEC_REQ_EVT");
             for(int i = 0; i < ESP_BD_ADDR_LEN; i++) {
-                ESP_LOGD(HID_DEMO_TAG, "%x:",param->ble_security.ble_req.bd_addr[i]);
+                DLOGD(HID_DEMO_TAG, "%x:",param->ble_security.ble_req.bd_addr[i]);
             }
             esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
             break;
         case ESP_GAP_BLE_AUTH_CMPL_EVT:
             sec_conn = true;
-            ESP_LOGI(
-                "ESP_GAP_BLE_AUTH_CMPL_EVT", "peer_addr: %s",
-                bda_to_string(param->ble_security.auth_cmpl.bd_addr, bda_str, sizeof(bda_str))
-            );
-            ESP_LOGI(HID_DEMO_TAG, "key_present = %d",param->ble_security.auth_cmpl.key_present);
-            ESP_LOGI(HID_DEMO_TAG, "address type = %d", param->ble_security.auth_cmpl.addr_type);
-            ESP_LOGI(HID_DEMO_TAG, "pair status = %s",param->ble_security.auth_cmpl.success ? "success" : "fail");
-            ESP_LOGI(HID_DEMO_TAG, "key_type = %d",param->ble_security.auth_cmpl.key_type);
-            ESP_LOGI(HID_DEMO_TAG, "dev_type = %d",param->ble_security.auth_cmpl.dev_type);
-            ESP_LOGI(HID_DEMO_TAG, "auth_mode = %d",param->ble_security.auth_cmpl.auth_mode);
+            DLOGI("ESP_GAP_BLE_AUTH_CMPL_EVT", "peer_addr: %02x:%02x:%02x:%02x:%02x:%02x",
+                  param->ble_security.auth_cmpl.bd_addr[0], param->ble_security.auth_cmpl.bd_addr[1],
+                  param->ble_security.auth_cmpl.bd_addr[2], param->ble_security.auth_cmpl.bd_addr[3],
+                  param->ble_security.auth_cmpl.bd_addr[4], param->ble_security.auth_cmpl.bd_addr[5]);
+            DLOGI(HID_DEMO_TAG, "key_present = %d",param->ble_security.auth_cmpl.key_present);
+            DLOGI(HID_DEMO_TAG, "address type = %d", param->ble_security.auth_cmpl.addr_type);
+            DLOGI(HID_DEMO_TAG, "pair status = %s", (uint32_t)(param->ble_security.auth_cmpl.success ? "success" : "fail"));
+            DLOGI(HID_DEMO_TAG, "key_type = %d",param->ble_security.auth_cmpl.key_type);
+            DLOGI(HID_DEMO_TAG, "dev_type = %d",param->ble_security.auth_cmpl.dev_type);
+            DLOGI(HID_DEMO_TAG, "auth_mode = %d",param->ble_security.auth_cmpl.auth_mode);
             if(!param->ble_security.auth_cmpl.success) {
-                ESP_LOGE(HID_DEMO_TAG, "fail reason = 0x%x",param->ble_security.auth_cmpl.fail_reason);
+                DLOGE(HID_DEMO_TAG, "fail reason = 0x%x",param->ble_security.auth_cmpl.fail_reason);
             } else {
-                ESP_LOGI(HID_DEMO_TAG, "success");
+                DLOGI(HID_DEMO_TAG, "success");
                 char host_name[20];
                 snprintf(host_name, sizeof(host_name), "Host_%ld", current_ble_idx);
                 bt_host_info_t connected_host;
@@ -507,29 +497,24 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
                 strncpy(connected_host.name, host_name, MAX_BT_DEVICENAME_LENGTH);
                 connected_host.name[MAX_BT_DEVICENAME_LENGTH] = '\0';
 
+                bond_cache_add_bond(connected_host.bda);
                 save_ble_idx(current_ble_idx);
 
-                bool is_new_host = true;
                 if (is_new_connection) {
-                    for (int i = 0; i < dev_num_before_new_connection; i++) {
-                        if (memcmp(dev_list_before_new_connection[i].bd_addr, connected_host.bda, ESP_BD_ADDR_LEN) == 0) {
-                            esp_ble_gap_disconnect(dev_list_before_new_connection[i].bd_addr);
-                            esp_ble_gap_start_advertising(&hidd_adv_params);
-                            is_new_host = false;
-                        }
-                    }
-
-                    if (!is_new_host) {
-                        is_new_host = true;
+                    // A host that was already bonded before pairing started is not a new host
+                    if (bond_cache_in_snapshot(connected_host.bda)) {
+                        esp_ble_gap_disconnect(connected_host.bda);
+                        esp_ble_gap_start_advertising(&hidd_adv_params);
                         break;
                     }
 
-                    free(dev_list_before_new_connection);
                     save_host_to_nvs(current_ble_idx, &connected_host);
                 }
 
+                deliver_wake_key();
+
                 if (is_change_to_paired_device) {
-                    ESP_LOGI(__func__, "connect_allowed_device!!!!!!!!!!!");
+                    DLOGI(__func__, "connect_allowed_device!!!!!!!!!!!");
                     connect_allowed_device(host_to_be_connected.bda);
                     return;
                 }
@@ -543,22 +528,22 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             memcpy(current_bda, param->ble_security.auth_cmpl.bd_addr, sizeof(current_bda));
             break;
         case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SCAN_RESULT_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_RESULT_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_RESULT_EVT");
             break;
         case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_START_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_START_COMPLETE_EVT");
             remove_unsaved_pairing_device();
             remove_unpaired_devices();
             if (is_bonded_addr_removed) {
@@ -566,112 +551,132 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             }
             break;
         case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_START_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_START_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_KEY_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_KEY_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_KEY_EVT");
             break;
         case ESP_GAP_BLE_PASSKEY_NOTIF_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_PASSKEY_NOTIF_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_PASSKEY_NOTIF_EVT");
             break;
         case ESP_GAP_BLE_PASSKEY_REQ_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_PASSKEY_REQ_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_PASSKEY_REQ_EVT");
             break;
         case ESP_GAP_BLE_OOB_REQ_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_OOB_REQ_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_OOB_REQ_EVT");
             break;
         case ESP_GAP_BLE_LOCAL_IR_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_LOCAL_IR_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_LOCAL_IR_EVT");
             break;
         case ESP_GAP_BLE_LOCAL_ER_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_LOCAL_ER_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_LOCAL_ER_EVT");
             break;
         case ESP_GAP_BLE_NC_REQ_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_NC_REQ_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_NC_REQ_EVT");
             break;
         case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SET_STATIC_RAND_ADDR_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_STATIC_RAND_ADDR_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_STATIC_RAND_ADDR_EVT");
             break;
         case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT");
             break;
         case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT");
+            if (param->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                ble_link_info.tx_octets = param->pkt_data_length_cmpl.params.tx_len;
+                ble_link_info.rx_octets = param->pkt_data_length_cmpl.params.rx_len;
+                DLOGI(HID_DEMO_TAG, "Data length tx %d, rx %d octets",
+                         ble_link_info.tx_octets, ble_link_info.rx_octets);
+            } else {
+                DLOGW(HID_DEMO_TAG, "Data length extension rejected, status %d", param->pkt_data_length_cmpl.status);
+            }
             break;
         case ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT");
+            if (param->remove_bond_dev_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                bond_cache_remove_bond(param->remove_bond_dev_cmpl.bd_addr);
+            }
             break;
         case ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT");
+            if (param->clear_bond_dev_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+                bond_cache_clear_bonds();
+            }
             break;
         case ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_UPDATE_DUPLICATE_EXCEPTIONAL_LIST_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_UPDATE_DUPLICATE_EXCEPTIONAL_LIST_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_UPDATE_DUPLICATE_EXCEPTIONAL_LIST_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SET_CHANNELS_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_CHANNELS_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_CHANNELS_EVT");
             break;
         case ESP_GAP_BLE_READ_PHY_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_READ_PHY_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_READ_PHY_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SET_PREFERRED_DEFAULT_PHY_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PREFERRED_DEFAULT_PHY_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PREFERRED_DEFAULT_PHY_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SET_PREFERRED_PHY_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PREFERRED_PHY_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PREFERRED_PHY_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT");
+            if (param->phy_update.status == ESP_BT_STATUS_SUCCESS) {
+                ble_link_info.tx_phy = param->phy_update.tx_phy;
+                ble_link_info.rx_phy = param->phy_update.rx_phy;
+                DLOGI(HID_DEMO_TAG, "PHY tx %s, rx %s", (uint32_t)(uintptr_t)phy_name(ble_link_info.tx_phy),
+                      (uint32_t)(uintptr_t)phy_name(ble_link_info.rx_phy));
+            }
             break;
         case ESP_GAP_BLE_SCAN_TIMEOUT_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_TIMEOUT_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_TIMEOUT_EVT");
             break;
         case ESP_GAP_BLE_ADV_TERMINATED_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_TERMINATED_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_TERMINATED_EVT");
             break;
         case ESP_GAP_BLE_SCAN_REQ_RECEIVED_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_REQ_RECEIVED_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SCAN_REQ_RECEIVED_EVT");
             break;
         case ESP_GAP_BLE_CHANNEL_SELECT_ALGORITHM_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_CHANNEL_SELECT_ALGORITHM_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_CHANNEL_SELECT_ALGORITHM_EVT");
             break;
         case ESP_GAP_BLE_SC_OOB_REQ_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SC_OOB_REQ_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SC_OOB_REQ_EVT");
             break;
         case ESP_GAP_BLE_SC_CR_LOC_OOB_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SC_CR_LOC_OOB_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SC_CR_LOC_OOB_EVT");
             break;
         case ESP_GAP_BLE_GET_DEV_NAME_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_GET_DEV_NAME_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_GET_DEV_NAME_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_SET_PAST_PARAMS_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PAST_PARAMS_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_SET_PAST_PARAMS_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_DTM_TEST_UPDATE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_DTM_TEST_UPDATE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_DTM_TEST_UPDATE_EVT");
             break;
         case ESP_GAP_BLE_ADV_CLEAR_COMPLETE_EVT:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_CLEAR_COMPLETE_EVT");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_ADV_CLEAR_COMPLETE_EVT");
             break;
         case ESP_GAP_BLE_EVT_MAX:
-            ESP_LOGI(HID_DEMO_TAG, "ESP_GAP_BLE_EVT_MAX");
+            DLOGI(HID_DEMO_TAG, "ESP_GAP_BLE_EVT_MAX");
             break;
         default:
             break;
@@ -728,6 +733,18 @@ void ble_main(void)
         return;
     }
 
+    bond_cache_init();
+
+    deep_sleep_rtc_state_t rtc_state;
+    if (deep_sleep_get_rtc_state(&rtc_state) && rtc_state.mode == MODE_BLE) {
+        current_ble_idx = rtc_state.ble_idx;
+        bond_cache_get_host(current_ble_idx, &host_to_be_connected);
+        if (memcmp(host_to_be_connected.bda, rtc_state.last_host, ESP_BD_ADDR_LEN) == 0) {
+            // Only the host the keyboard slept on may take the link back
+            is_change_to_paired_device = true;
+        }
+    }
+
     if((ret = esp_hidd_profile_init()) != ESP_OK) {
         ESP_LOGE(HID_DEMO_TAG, "%s init bluedroid failed", __func__);
     }
@@ -736,6 +753,15 @@ void ble_main(void)
     esp_ble_gap_register_callback(gap_event_handler);
     esp_hidd_register_callbacks(hidd_event_callback);
 
+    // Let reports larger than 20 bytes go out in a single notification
+    esp_ble_gatt_set_local_mtu(BLE_LOCAL_MTU);
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    esp_ble_gap_set_preferred_default_phy(
+        ESP_BLE_GAP_PHY_1M_PREF_MASK | ESP_BLE_GAP_PHY_2M_PREF_MASK,
+        ESP_BLE_GAP_PHY_1M_PREF_MASK | ESP_BLE_GAP_PHY_2M_PREF_MASK
+    );
+#endif
+
     /* set the security iocap & auth_req & key size & init key response key parameters to the stack*/
     esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
     esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;           //set the IO capability to No output No input
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_gap_ble_api.h"
+
+#include "ble_main.h"
+#include "bond_cache.h"
+
+static const char *TAG = "bond_cache";
+
+
+typedef struct {
+    esp_bd_addr_t bonds[BOND_CACHE_MAX_BONDS];
+    int bond_num;
+    esp_bd_addr_t snapshot[BOND_CACHE_MAX_BONDS];
+    int snapshot_num;
+    bt_host_info_t hosts[BOND_CACHE_HOST_SLOTS + 1];    // index 0 is unused, slots start from 1
+} bond_cache_t;
+
+static bond_cache_t s_cache;
+
+// GAP callbacks run in the BTC task while the keyboard task also queries the cache
+static portMUX_TYPE s_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+static int find_addr(const esp_bd_addr_t *list, int num, const esp_bd_addr_t bda) {
+    for (int i = 0; i < num; i++) {
+        if (memcmp(list[i], bda, ESP_BD_ADDR_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+void bond_cache_init(void) {
+    int dev_num = esp_ble_get_bond_device_num();
+    if (dev_num > BOND_CACHE_MAX_BONDS) {
+        ESP_LOGW(TAG, "Stack reports %d bonds, caching the first %d", dev_num, BOND_CACHE_MAX_BONDS);
+        dev_num = BOND_CACHE_MAX_BONDS;
+    }
+
+    esp_ble_bond_dev_t *dev_list = NULL;
+    if (dev_num > 0) {
+        dev_list = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num);
+        if (!dev_list) {
+            ESP_LOGE(TAG, "malloc failed, bond cache starts empty");
+            dev_num = 0;
+        } else {
+            esp_ble_get_bond_device_list(&dev_num, dev_list);
+        }
+    }
+
+    bt_host_info_t hosts[BOND_CACHE_HOST_SLOTS + 1] = {0};
+    for (int i = 1; i <= BOND_CACHE_HOST_SLOTS; i++) {
+        if (load_host_from_nvs(i, &hosts[i]) != ESP_OK) {
+            hosts[i] = empty_host;
+        }
+    }
+
+    taskENTER_CRITICAL(&s_cache_lock);
+    memset(&s_cache, 0, sizeof(s_cache));
+    for (int i = 0; i < dev_num; i++) {
+        memcpy(s_cache.bonds[i], dev_list[i].bd_addr, ESP_BD_ADDR_LEN);
+    }
+    s_cache.bond_num = dev_num;
+    memcpy(s_cache.hosts, hosts, sizeof(hosts));
+    taskEXIT_CRITICAL(&s_cache_lock);
+
+    free(dev_list);
+    ESP_LOGI(TAG, "Cached %d bonds", dev_num);
+}
+
+
+void bond_cache_add_bond(const esp_bd_addr_t bda) {
+    bool is_full = false;
+
+    taskENTER_CRITICAL(&s_cache_lock);
+    if (find_addr(s_cache.bonds, s_cache.bond_num, bda) < 0) {
+        if (s_cache.bond_num < BOND_CACHE_MAX_BONDS) {
+            memcpy(s_cache.bonds[s_cache.bond_num++], bda, ESP_BD_ADDR_LEN);
+        } else {
+            is_full = true;
+        }
+    }
+    taskEXIT_CRITICAL(&s_cache_lock);
+
+    if (is_full) {
+        ESP_LOGW(TAG, "Bond cache full, peer not cached");
+    }
+}
+
+
+void bond_cache_remove_bond(const esp_bd_addr_t bda) {
+    taskENTER_CRITICAL(&s_cache_lock);
+    int idx = find_addr(s_cache.bonds, s_cache.bond_num, bda);
+    if (idx >= 0) {
+        // Order does not matter, move the last entry into the hole
+        s_cache.bond_num--;
+        memcpy(s_cache.bonds[idx], s_cache.bonds[s_cache.bond_num], ESP_BD_ADDR_LEN);
+    }
+    taskEXIT_CRITICAL(&s_cache_lock);
+}
+
+
+void bond_cache_clear_bonds(void) {
+    taskENTER_CRITICAL(&s_cache_lock);
+    s_cache.bond_num = 0;
+    taskEXIT_CRITICAL(&s_cache_lock);
+}
+
+
+int bond_cache_get_bonds(esp_bd_addr_t *bonds, int max) {
+    taskENTER_CRITICAL(&s_cache_lock);
+    int num = s_cache.bond_num < max ? s_cache.bond_num : max;
+    memcpy(bonds, s_cache.bonds, num * sizeof(esp_bd_addr_t));
+    taskEXIT_CRITICAL(&s_cache_lock);
+    return num;
+}
+
+
+int bond_cache_bond_num(void) {
+    return s_cache.bond_num;
+}
+
+
+bool bond_cache_has_bond(const esp_bd_addr_t bda) {
+    taskENTER_CRITICAL(&s_cache_lock);
+    bool found = find_addr(s_cache.bonds, s_cache.bond_num, bda) >= 0;
+    taskEXIT_CRITICAL(&s_cache_lock);
+    return found;
+}
+
+
+void bond_cache_get_host(int index, bt_host_info_t *host) {
+    if (index < 1 || index > BOND_CACHE_HOST_SLOTS) {
+        *host = empty_host;
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_cache_lock);
+    *host = s_cache.hosts[index];
+    taskEXIT_CRITICAL(&s_cache_lock);
+}
+
+
+void bond_cache_set_host(int index, const bt_host_info_t *host) {
+    if (index < 1 || index > BOND_CACHE_HOST_SLOTS) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_cache_lock);
+    s_cache.hosts[index] = *host;
+    taskEXIT_CRITICAL(&s_cache_lock);
+}
+
+
+int bond_cache_host_index(const esp_bd_addr_t bda) {
+    int index = 0;
+
+    taskENTER_CRITICAL(&s_cache_lock);
+    for (int i = 1; i <= BOND_CACHE_HOST_SLOTS; i++) {
+        if (memcmp(s_cache.hosts[i].bda, bda, ESP_BD_ADDR_LEN) == 0) {
+            index = i;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_cache_lock);
+    return index;
+}
+
+
+void bond_cache_take_snapshot(void) {
+    taskENTER_CRITICAL(&s_cache_lock);
+    memcpy(s_cache.snapshot, s_cache.bonds, s_cache.bond_num * sizeof(esp_bd_addr_t));
+    s_cache.snapshot_num = s_cache.bond_num;
+    taskEXIT_CRITICAL(&s_cache_lock);
+}
+
+
+bool bond_cache_in_snapshot(const esp_bd_addr_t bda) {
+    taskENTER_CRITICAL(&s_cache_lock);
+    bool found = find_addr(s_cache.snapshot, s_cache.snapshot_num, bda) >= 0;
+    taskEXIT_CRITICAL(&s_cache_lock);
+    return found;
+}
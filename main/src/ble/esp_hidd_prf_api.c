@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "esp_log.h"
+#include "power_policy.h"
 
 // HID keyboard input report length
 #define HID_KEYBOARD_IN_RPT_LEN     8
@@ -17,11 +18,12 @@
 // HID LED output report length
 #define HID_LED_OUT_RPT_LEN         1
 
-// HID mouse input report length
-#define HID_MOUSE_IN_RPT_LEN        5
+// HID mouse input report length, buttons, X, Y and wheel as in hidReportMap
+#define HID_MOUSE_IN_RPT_LEN        4
 
 // HID consumer control input report length
 #define HID_CC_IN_RPT_LEN           2
+#define HID_VENDOR_IN_RPT_LEN       32
 
 
 esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks)
@@ -125,17 +127,66 @@ void esp_hidd_send_keyboard_value(uint16_t conn_id, key_mask_t special_key_mask,
 }
 
 
-void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y)
+void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y, int8_t wheel)
 {
     uint8_t buffer[HID_MOUSE_IN_RPT_LEN];
 
     buffer[0] = mouse_button;   // Buttons
     buffer[1] = mickeys_x;           // X
     buffer[2] = mickeys_y;           // Y
-    buffer[3] = 0;           // Wheel
-    buffer[4] = 0;           // AC Pan
+    buffer[3] = wheel;       // Wheel
 
     hid_dev_send_report(hidd_le_env.gatt_if, conn_id,
                         HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT_KEYBOARD, HID_MOUSE_IN_RPT_LEN, buffer);
     return;
 }
+
+
+void esp_hidd_macro_report(bool consumer)
+{
+    hidd_le_env.macro_handle = hidd_le_env.hidd_inst.att_tbl[consumer ? HIDD_LE_IDX_REPORT_CC_IN_VAL
+                                                                      : HIDD_LE_IDX_REPORT_KEY_IN_VAL];
+}
+
+
+void esp_hidd_send_vendor_value(uint16_t conn_id, const uint8_t *data, uint8_t len)
+{
+    uint8_t buffer[HID_VENDOR_IN_RPT_LEN] = {0};
+    if (len > sizeof(buffer)) {
+        ESP_LOGE(HID_LE_PRF_TAG, "%s(), the report should not be more than %d bytes", __func__, HID_VENDOR_IN_RPT_LEN);
+        return;
+    }
+    memcpy(buffer, data, len);
+
+    hid_dev_send_report(hidd_le_env.gatt_if, conn_id,
+                        HID_RPT_ID_VENDOR_IN, HID_REPORT_TYPE_INPUT_KEYBOARD, HID_VENDOR_IN_RPT_LEN, buffer);
+    return;
+}
+
+
+void esp_hidd_send_battery_level(uint16_t conn_id, uint8_t level, bool notify)
+{
+    if (hidd_le_env.bat_lvl_handle == 0) {
+        return;
+    }
+
+    // Keep the value current for reads even when nothing is sent
+    esp_ble_gatts_set_attr_value(hidd_le_env.bat_lvl_handle, sizeof(level), &level);
+    if (!notify) {
+        return;
+    }
+
+    uint16_t length = 0;
+    const uint8_t *ccc = NULL;
+    if (esp_ble_gatts_get_attr_value(hidd_le_env.bat_ntf_cfg_handle, &length, &ccc) != ESP_OK ||
+        length < 2 || !(ccc[0] & 0x01)) {
+        return;
+    }
+
+    power_policy_report_begin();
+    if (esp_ble_gatts_send_indicate(hidd_le_env.gatt_if, conn_id, hidd_le_env.bat_lvl_handle,
+                                    sizeof(level), &level, false) != ESP_OK) {
+        power_policy_report_end();
+    }
+    return;
+}
@@ -10,6 +10,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include "esp_log.h"
+#include "power_policy.h"
+#include "kbd_latency.h"
 
 static hid_report_map_t *hid_dev_rpt_tbl;
 static uint8_t hid_dev_rpt_tbl_Len;
@@ -46,7 +48,13 @@ void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
     if ((p_rpt = hid_dev_rpt_by_id(id, type)) != NULL) {
         // if notifications are enabled
         ESP_LOGD(HID_LE_PRF_TAG, "%s(), send the report, handle = %d", __func__, p_rpt->handle);
-        esp_ble_gatts_send_indicate(gatts_if, conn_id, p_rpt->handle, length, data, false);
+        // Light sleep stays blocked until ESP_GATTS_CONF_EVT reports the notification as sent
+        power_policy_report_begin();
+        if (esp_ble_gatts_send_indicate(gatts_if, conn_id, p_rpt->handle, length, data, false) != ESP_OK) {
+            power_policy_report_end();
+        } else if (id == HID_RPT_ID_KEY_IN) {
+            kbd_latency_report_enqueue();
+        }
     }
 
     return;
@@ -8,6 +8,10 @@
 #include <string.h>
 #include "esp_log.h"
 #include "ble_main.h"
+#include "power_policy.h"
+#include "kbd_latency.h"
+#include "macro_player.h"
+#include "hid_custom.h"
 
 
 /// characteristic presentation information
@@ -168,9 +172,15 @@ static const uint8_t hidReportMap[] = {
     0x85, 0x04,   // Report Id (4)
     0x09, 0xA6,   // Usage(Vendor defined)
     0x09, 0xA9,   // Usage(Vendor defined)
+    0x15, 0x00,   // Logical Min (0)
+    0x26, 0xFF, 0x00, // Logical Max (255)
     0x75, 0x08,   // Report Size
-    0x95, 0x7F,   // Report Count = 127 Btyes
+    0x95, 0x20,   // Report Count = 32 Bytes, CONFIG_REPORT_LEN
     0x91, 0x02,   // Output(Data, Variable, Absolute)
+    0x85, 0x05,   // Report Id (5)
+    0x09, 0xA7,   // Usage(Vendor defined)
+    0x95, 0x20,   // Report Count = 32 Bytes
+    0x81, 0x02,   // Input(Data, Variable, Absolute)
     0xC0,         // End Collection
 #endif
 
@@ -246,6 +256,10 @@ static uint8_t hidReportRefLedOut[HID_REPORT_REF_LEN] =
 
 static uint8_t hidReportRefVendorOut[HID_REPORT_REF_LEN] =
              {HID_RPT_ID_VENDOR_OUT, HID_REPORT_TYPE_OUTPUT_KEYBOARD};
+
+// HID Report Reference characteristic descriptor, vendor input, answers of the configuration channel
+static uint8_t hidReportRefVendorIn[HID_REPORT_REF_LEN] =
+             {HID_RPT_ID_VENDOR_IN, HID_REPORT_TYPE_INPUT_KEYBOARD};
 #endif
 
 
@@ -462,6 +476,26 @@ static esp_gatts_attr_db_t hidd_le_gatt_db[HIDD_LE_IDX_NB] =
                                                                        ESP_GATT_PERM_READ,
                                                                        sizeof(hidReportRefVendorOut), sizeof(hidReportRefVendorOut),
                                                                        hidReportRefVendorOut}},
+    // Report Characteristic Declaration
+    [HIDD_LE_IDX_REPORT_VENDOR_IN_CHAR]         = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
+                                                                         ESP_GATT_PERM_READ,
+                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
+                                                                         (uint8_t *)&char_prop_read_notify}},
+    // Report Characteristic Value
+    [HIDD_LE_IDX_REPORT_VENDOR_IN_VAL]          = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
+                                                                       ESP_GATT_PERM_READ,
+                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
+                                                                       NULL}},
+    // Report VENDOR INPUT Characteristic - Client Characteristic Configuration Descriptor
+    [HIDD_LE_IDX_REPORT_VENDOR_IN_CCC]          = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                                                                      (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE_ENCRYPTED),
+                                                                      sizeof(uint16_t), 0,
+                                                                      NULL}},
+    // Report Characteristic - Report Reference Descriptor
+    [HIDD_LE_IDX_REPORT_VENDOR_IN_REP_REF]      = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
+                                                                       ESP_GATT_PERM_READ,
+                                                                       sizeof(hidReportRefVendorIn), sizeof(hidReportRefVendorIn),
+                                                                       hidReportRefVendorIn}},
 #endif
     // Report Characteristic Declaration
     [HIDD_LE_IDX_REPORT_CC_IN_CHAR]         = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
@@ -576,6 +610,22 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
         }
         case ESP_GATTS_CONF_EVT: {
             // ESP_LOGI(HID_LE_PRF_TAG, "ESP_GATTS_CONF_EVT");
+            power_policy_report_end();
+            if (param->conf.handle == hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_KEY_IN_VAL]) {
+                if (param->conf.status == ESP_GATT_OK) {
+                    kbd_latency_report_done();
+                } else {
+                    kbd_latency_report_dropped();
+                }
+            }
+            if (param->conf.handle == hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_MOUSE_IN_VAL]) {
+                keyboard_mouse_ready();
+            }
+            // The macro report left with a connection event, the next one can go. Mouse, battery, vendor and
+            // scan reports are confirmed on their own handles.
+            if (param->conf.handle == hidd_le_env.macro_handle) {
+                macro_player_ready();
+            }
             break;
         }
         case ESP_GATTS_CREATE_EVT:
@@ -609,7 +659,9 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
         case ESP_GATTS_WRITE_EVT: {
             ESP_LOGI(HID_LE_PRF_TAG, "ESP_GATTS_WRITE_EVT");
             esp_hidd_cb_param_t cb_param = {0};
-            if (param->write.handle == hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_LED_OUT_VAL]) {
+            // Hosts in boot protocol mode write the lock state to the boot keyboard output report instead
+            if (param->write.handle == hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_LED_OUT_VAL] ||
+                param->write.handle == hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_BOOT_KB_OUT_REPORT_VAL]) {
                 cb_param.led_write.conn_id = param->write.conn_id;
                 cb_param.led_write.report_id = HID_RPT_ID_LED_OUT;
                 cb_param.led_write.length = param->write.len;
@@ -635,6 +687,8 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                 param->add_attr_tab.status == ESP_GATT_OK) {
                 incl_svc.start_hdl = param->add_attr_tab.handles[BAS_IDX_SVC];
                 incl_svc.end_hdl = incl_svc.start_hdl + BAS_IDX_NB -1;
+                hidd_le_env.bat_lvl_handle = param->add_attr_tab.handles[BAS_IDX_BATT_LVL_VAL];
+                hidd_le_env.bat_ntf_cfg_handle = param->add_attr_tab.handles[BAS_IDX_BATT_LVL_NTF_CFG];
                 ESP_LOGI(HID_LE_PRF_TAG, "%s(), start added the hid service to the stack database. incl_handle = %d",
                            __func__, incl_svc.start_hdl);
                 esp_ble_gatts_create_attr_tab(hidd_le_gatt_db, gatts_if, HIDD_LE_IDX_NB, 0);
@@ -841,6 +895,15 @@ static void hid_add_id_tbl(void)
       hid_rpt_map[7].cccdHandle = 0;
       hid_rpt_map[7].mode = HID_PROTOCOL_MODE_REPORT;
 
+#if (SUPPORT_REPORT_VENDOR == true)
+      // Vendor input report
+      hid_rpt_map[8].id = hidReportRefVendorIn[0];
+      hid_rpt_map[8].type = hidReportRefVendorIn[1];
+      hid_rpt_map[8].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_VENDOR_IN_VAL];
+      hid_rpt_map[8].cccdHandle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_VENDOR_IN_CCC];
+      hid_rpt_map[8].mode = HID_PROTOCOL_MODE_REPORT;
+#endif
+
 
   // Setup report ID map
   hid_dev_register_reports(HID_NUM_REPORTS, hid_rpt_map);
@@ -0,0 +1,260 @@
+#include <string.h>
+#include "config_proto.h"
+
+#define CONFIG_KEYMAP_SIZE      sizeof(keymap_table_t)
+
+
+static uint16_t get_u16(const uint8_t *data) {
+    return data[0] | (data[1] << 8);
+}
+
+
+static void put_u16(uint8_t *data, uint16_t value) {
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+
+/**
+ * @brief   Offset and length of a buffer request, checked against the request and the buffer
+ * @return  CONFIG_OK when [offset, offset + len) is inside size and a write carries len bytes
+ * **/
+static config_status_t buffer_args(const uint8_t *request, size_t len, bool write, size_t size,
+                                   uint16_t *offset, uint8_t *data_len) {
+    if (len < CONFIG_HEADER_LEN) {
+        return CONFIG_ERR_LENGTH;
+    }
+    *offset = get_u16(&request[1]);
+    *data_len = request[3];
+    if (*data_len > CONFIG_DATA_MAX || *offset + *data_len > size) {
+        return CONFIG_ERR_RANGE;
+    }
+    if (write && len < CONFIG_HEADER_LEN + (size_t)*data_len) {
+        return CONFIG_ERR_LENGTH;
+    }
+    return CONFIG_OK;
+}
+
+
+static uint8_t *staged_entry(config_t *config, const uint8_t *request) {
+    uint8_t layer = request[1];
+    uint8_t output_index = request[2];
+    uint8_t input_index = request[3];
+    if (layer >= KEYMAP_LAYER_NUM || output_index >= KEYMAP_OUTPUT_NUM || input_index >= KEYMAP_INPUT_NUM) {
+        return NULL;
+    }
+    return &keymap_staging(config->keymap)->layers[layer][output_index][input_index];
+}
+
+
+// The staged recording, or the one the keyboard holds when none was written
+static void macro_current(config_t *config) {
+    if (!config->macro_dirty) {
+        config->macro_len = config->macro_pack(config->macro, sizeof(config->macro));
+    }
+}
+
+
+static void discard(config_t *config) {
+    // Staging is never read by the scan, it is safe to overwrite whenever no swap is pending
+    keymap_sync(config->keymap);
+    memcpy(config->staged_settings, config->settings, sizeof(config->settings));
+    config->keymap_dirty = false;
+    config->macro_dirty = false;
+    config->settings_dirty = false;
+}
+
+
+// Staging is in use and equal to what is in use
+static void commit_applied(config_t *config) {
+    memcpy(config->settings, config->staged_settings, sizeof(config->settings));
+    config->keymap_dirty = false;
+    config->macro_dirty = false;
+    config->settings_dirty = false;
+}
+
+
+static config_status_t handle(config_t *config, const uint8_t *request, size_t len, uint8_t *data) {
+    uint16_t offset;
+    uint8_t data_len;
+    config_status_t status;
+
+    switch (request[0]) {
+    case CONFIG_CMD_GET_INFO:
+        data[0] = CONFIG_PROTO_VERSION;
+        data[1] = KEYMAP_LAYER_NUM;
+        data[2] = KEYMAP_OUTPUT_NUM;
+        data[3] = KEYMAP_INPUT_NUM;
+        put_u16(&data[4], MACRO_RECORD_PACK_SIZE);
+        return CONFIG_OK;
+
+    case CONFIG_CMD_KEYMAP_GET:
+    case CONFIG_CMD_KEYMAP_SET: {
+        bool set = request[0] == CONFIG_CMD_KEYMAP_SET;
+        if (len < (set ? 5u : 4u)) {
+            return CONFIG_ERR_LENGTH;
+        }
+        uint8_t *entry = staged_entry(config, request);
+        if (entry == NULL) {
+            return CONFIG_ERR_RANGE;
+        }
+        if (set) {
+            *entry = request[4];
+            config->keymap_dirty = true;
+        }
+        data[0] = *entry;
+        return CONFIG_OK;
+    }
+
+    case CONFIG_CMD_KEYMAP_READ:
+    case CONFIG_CMD_KEYMAP_WRITE: {
+        bool write = request[0] == CONFIG_CMD_KEYMAP_WRITE;
+        status = buffer_args(request, len, write, CONFIG_KEYMAP_SIZE, &offset, &data_len);
+        if (status != CONFIG_OK) {
+            return status;
+        }
+        uint8_t *table = (uint8_t *)keymap_staging(config->keymap);
+        if (write) {
+            memcpy(&table[offset], &request[CONFIG_HEADER_LEN], data_len);
+            config->keymap_dirty = true;
+        } else {
+            memcpy(data, &table[offset], data_len);
+        }
+        return CONFIG_OK;
+    }
+
+    case CONFIG_CMD_MACRO_READ:
+        macro_current(config);
+        status = buffer_args(request, len, false, config->macro_len, &offset, &data_len);
+        if (status == CONFIG_OK) {
+            memcpy(data, &config->macro[offset], data_len);
+        }
+        return status;
+
+    case CONFIG_CMD_MACRO_WRITE:
+        status = buffer_args(request, len, true, MACRO_RECORD_PACK_SIZE, &offset, &data_len);
+        if (status != CONFIG_OK) {
+            return status;
+        }
+        if (offset == 0) {
+            config->macro_len = 0;
+            config->macro_dirty = true;
+        }
+        // In order, so the length is where the host stopped
+        if (!config->macro_dirty || offset != config->macro_len) {
+            return CONFIG_ERR_RANGE;
+        }
+        memcpy(&config->macro[offset], &request[CONFIG_HEADER_LEN], data_len);
+        config->macro_len += data_len;
+        return CONFIG_OK;
+
+    case CONFIG_CMD_MACRO_LEN:
+        macro_current(config);
+        put_u16(data, config->macro_len);
+        return CONFIG_OK;
+
+    case CONFIG_CMD_SETTING_GET:
+    case CONFIG_CMD_SETTING_SET: {
+        bool set = request[0] == CONFIG_CMD_SETTING_SET;
+        if (len < (set ? 4u : 2u)) {
+            return CONFIG_ERR_LENGTH;
+        }
+        uint8_t setting = request[1];
+        if (setting >= CONFIG_SETTING_NUM) {
+            return CONFIG_ERR_RANGE;
+        }
+        if (set) {
+            uint16_t value = get_u16(&request[2]);
+            if (value > config->setting_max[setting]) {
+                return CONFIG_ERR_RANGE;
+            }
+            config->staged_settings[setting] = value;
+            config->settings_dirty = true;
+        }
+        put_u16(data, config->staged_settings[setting]);
+        return CONFIG_OK;
+    }
+
+    case CONFIG_CMD_COMMIT:
+        if (!config->keymap_dirty && !config->macro_dirty && !config->settings_dirty) {
+            return CONFIG_OK;
+        }
+        // Set first, the task finishing a handed off commit may be done before the callback returns
+        atomic_store(&config->commit_pending, true);
+        status = config->commit(config);
+        if (status == CONFIG_PENDING) {
+            return status;
+        }
+        atomic_store(&config->commit_pending, false);
+        if (status == CONFIG_OK) {
+            commit_applied(config);
+        }
+        return status;
+
+    case CONFIG_CMD_DISCARD:
+        discard(config);
+        return CONFIG_OK;
+
+    case CONFIG_CMD_RESET:
+        *keymap_staging(config->keymap) = *config->defaults;
+        config->keymap_dirty = true;
+        return CONFIG_OK;
+
+    default:
+        return CONFIG_ERR_COMMAND;
+    }
+}
+
+
+void config_init(config_t *config, keymap_t *keymap, const keymap_table_t *defaults, const uint16_t *settings,
+                 const uint16_t *setting_max, config_macro_pack_t macro_pack, config_commit_t commit) {
+    memset(config, 0, sizeof(config_t));
+    config->keymap = keymap;
+    config->defaults = defaults;
+    config->macro_pack = macro_pack;
+    config->commit = commit;
+    memcpy(config->settings, settings, sizeof(config->settings));
+    memcpy(config->setting_max, setting_max, sizeof(config->setting_max));
+    memcpy(config->staged_settings, settings, sizeof(config->settings));
+    atomic_init(&config->commit_pending, false);
+}
+
+
+void config_select(config_t *config, keymap_t *keymap, const keymap_table_t *defaults) {
+    config->keymap = keymap;
+    config->defaults = defaults;
+    discard(config);
+}
+
+
+bool config_commit_pending(config_t *config) {
+    return atomic_load(&config->commit_pending);
+}
+
+
+size_t config_handle(config_t *config, const uint8_t *request, size_t len, uint8_t *response) {
+    memset(response, 0, CONFIG_REPORT_LEN);
+    if (len < 1) {
+        return 0;
+    }
+    response[0] = request[0];
+    if (atomic_load(&config->commit_pending)) {
+        response[1] = CONFIG_ERR_BUSY;
+        return CONFIG_REPORT_LEN;
+    }
+    response[1] = handle(config, request, len, &response[2]);
+    return response[1] == CONFIG_PENDING ? 0 : CONFIG_REPORT_LEN;
+}
+
+
+size_t config_commit_done(config_t *config, config_status_t status, uint8_t *response) {
+    if (status == CONFIG_OK) {
+        commit_applied(config);
+    }
+    memset(response, 0, CONFIG_REPORT_LEN);
+    response[0] = CONFIG_CMD_COMMIT;
+    response[1] = status;
+    // Last, the transport task reads staging again from here on
+    atomic_store(&config->commit_pending, false);
+    return CONFIG_REPORT_LEN;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "config_store.h"
+#include "config_proto.h"
+#include "layout.h"
+#include "macro_store.h"
+#include "steno_store.h"
+
+static const char *TAG = "config_store";
+
+// Saved layers and the keymap of the layout they were edited from. A layout flashed since makes them stale.
+typedef struct {
+    uint32_t layout_crc;        // layout_keymap_crc() when they were saved
+    keymap_table_t table;
+} config_store_keymap_t;
+
+// The keyboard task loads at boot, the channel saves afterwards, one buffer keeps the blob off their stacks
+static config_store_keymap_t s_blob;
+
+
+static void keymap_key(uint8_t profile, char *key, size_t size) {
+    snprintf(key, size, CONFIG_STORE_KEYMAP_NVS_KEY, profile);
+}
+
+
+static uint32_t layout_keymap_crc(uint8_t profile) {
+    const keymap_table_t *keymap = &layout_get()->profiles[profile].keymap;
+    return esp_rom_crc32_le(0, (const uint8_t *)keymap, sizeof(keymap_table_t));
+}
+
+
+esp_err_t save_config_to_nvs(uint8_t profile, const keymap_table_t *keymap, const uint8_t *macro, size_t macro_len,
+                             const uint16_t *settings) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    if (keymap != NULL) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        keymap_key(profile, key, sizeof(key));
+        s_blob.layout_crc = layout_keymap_crc(profile);
+        s_blob.table = *keymap;
+        err = nvs_set_blob(nvs_handle, key, &s_blob, sizeof(s_blob));
+    }
+    if (err == ESP_OK && macro != NULL) {
+        err = nvs_set_blob(nvs_handle, MACRO_STORE_NVS_KEY, macro, macro_len);
+    }
+    if (err == ESP_OK && settings != NULL) {
+        err = nvs_set_u8(nvs_handle, STENO_STORE_NVS_KEY, settings[CONFIG_SETTING_STENO_PROTOCOL]);
+    }
+    if (err == ESP_OK && settings != NULL) {
+        err = nvs_set_u8(nvs_handle, CONFIG_STORE_PROFILE_NVS_KEY, settings[CONFIG_SETTING_PROFILE]);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "Saved%s%s%s of profile %u: %s", keymap ? " keymap" : "", macro ? " macro" : "", settings ? " settings" : "",
+             profile, esp_err_to_name(err));
+    return err;
+}
+
+
+esp_err_t load_keymap_from_nvs(uint8_t profile, keymap_table_t *keymap) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    keymap_key(profile, key, sizeof(key));
+    size_t len = sizeof(s_blob);
+    err = nvs_get_blob(nvs_handle, key, &s_blob, &len);
+    // A longer blob does not fit and reports its length, a shorter one is read
+    if (err == ESP_ERR_NVS_INVALID_LENGTH || (err == ESP_OK && len != sizeof(s_blob))) {
+        ESP_LOGW(TAG, "Saved keymap of profile %u has %u bytes, expected %u, dropped", profile, len, sizeof(s_blob));
+        err = ESP_ERR_INVALID_SIZE;
+    } else if (err == ESP_OK && s_blob.layout_crc != layout_keymap_crc(profile)) {
+        // Edits of the old layout would hide the one just flashed
+        ESP_LOGW(TAG, "Saved keymap of profile %u was edited from another layout, dropped", profile);
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    if (err == ESP_ERR_INVALID_SIZE || err == ESP_ERR_INVALID_VERSION) {
+        nvs_erase_key(nvs_handle, key);
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) return err;
+
+    *keymap = s_blob.table;
+    ESP_LOGI(TAG, "Loaded keymap of profile %u", profile);
+    return ESP_OK;
+}
+
+
+esp_err_t save_profile_to_nvs(uint8_t profile) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_u8(nvs_handle, CONFIG_STORE_PROFILE_NVS_KEY, profile);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "Saved profile %u: %s", profile, esp_err_to_name(err));
+    return err;
+}
+
+
+uint8_t load_profile_from_nvs(void) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return 0;
+    }
+
+    uint8_t profile = 0;
+    esp_err_t err = nvs_get_u8(nvs_handle, CONFIG_STORE_PROFILE_NVS_KEY, &profile);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK || profile >= LAYOUT_PROFILE_NUM) {
+        return 0;
+    }
+    return profile;
+}
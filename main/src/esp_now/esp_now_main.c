@@ -11,6 +11,10 @@
 #include "esp_log.h"
 #include "tinyusb.h"
 #include "hid_custom.h"
+#include "kbd_latency.h"
+#include "macro_player.h"
+#include "descriptors.h"
+#include "defer_log.h"
 
 #define ESP_CHANNEL         1
 #define LED_STRIP           8
@@ -39,7 +43,7 @@ static esp_err_t init_wifi(void)
 
 void send_key_released_report(void) {
     uint8_t key_report[6] = {0};
-    tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, 0, key_report);
+    tud_hid_n_keyboard_report(ITF_NUM_KEYBOARD, 0, 0, key_report);
 }
 
 
@@ -47,12 +51,15 @@ void send_cb(const uint8_t *mac_addr, esp_now_send_status_t status)
 {
     if(status == ESP_NOW_SEND_SUCCESS)
     {
-        ESP_LOGI(TAG, "ESP_NOW_SEND_SUCCESS");
+        kbd_latency_report_done();
+        DLOGI(TAG, "ESP_NOW_SEND_SUCCESS");
     }
     else
     {
-        ESP_LOGE(TAG, "ESP_NOW_SEND_FAIL");
+        kbd_latency_report_dropped();
+        DLOGE(TAG, "ESP_NOW_SEND_FAIL");
     }
+    macro_player_ready();
 }
 
 
@@ -62,7 +69,10 @@ void recv_cb(const esp_now_recv_info_t * esp_now_info, const uint8_t *data, int
     uint8_t converted_key = atoi((const char *)data);
     key[0] = converted_key;
 
-    tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, 0, key);
+    // The dongle forwards single keys, the boot keyboard interface carries them in either protocol
+    if (tud_hid_n_keyboard_report(ITF_NUM_KEYBOARD, 0, 0, key)) {
+        kbd_latency_report_enqueue();
+    }
 }
 
 
@@ -91,4 +101,5 @@ void esp_now_main(void)
     ESP_ERROR_CHECK(init_wifi());
     ESP_ERROR_CHECK(init_esp_now());
     ESP_ERROR_CHECK(register_peer(peer_mac));
+    deliver_wake_key();
 }
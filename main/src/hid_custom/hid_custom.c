@@ -1,3 +1,5 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "hid_dev.h"
@@ -9,19 +11,35 @@
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "ble_main.h"
+#include "bond_cache.h"
 #include "esp_gap_ble_api.h"
 #include "hid_custom.h"
 #include "descriptors.h"
 #include "tusb_main.h"
-
-#define TUD_CONSUMER_CONTROL    3
+#include "power_policy.h"
+#include "deep_sleep.h"
+#include "kbd_latency.h"
+#include "hid_report.h"
+#include "tap_hold.h"
+#include "leader.h"
+#include "mouse_keys.h"
+#include "steno.h"
+#include "steno_store.h"
+#include "macro_player.h"
+#include "macro_record.h"
+#include "macro_store.h"
+#include "keymap.h"
+#include "config_proto.h"
+#include "config_store.h"
+#include "layout.h"
+#include "lamp_array.h"
+#include "esp_timer.h"
+#include "defer_log.h"
 
 static uint16_t hid_conn_id = 0;
 
 bool use_fn = false;
 bool use_right_shift = false;
-esp_ble_bond_dev_t * dev_list_before_new_connection;
-int dev_num_before_new_connection;
 
 
 keyboard_btn_config_t cfg = {
@@ -34,69 +52,205 @@ keyboard_btn_config_t cfg = {
     .active_level = 1,
     .debounce_ticks = 2,
     .ticks_interval = 500,      // us
-    .enable_power_save = false, // enable power save
+    .enable_power_save = true,  // stop scanning and wait for a GPIO wakeup while no key is down
 };
 
 
 keyboard_btn_handle_t kbd_handle = NULL;
 
 
-// make function key at the bottom of F8 line (Current: HID_KEY_GUI_RIGHT)
-uint8_t keycodes[6][17] = {
-    {HID_KEY_ESCAPE,                HID_KEY_NONE,               HID_KEY_F1,                 HID_KEY_F2,     HID_KEY_F3,     HID_KEY_F4,      HID_KEY_F5,    HID_KEY_F6,     HID_KEY_F7,     HID_KEY_F8,                 HID_KEY_F9,                         HID_KEY_F10,            HID_KEY_F11,            HID_KEY_F12,                    HID_KEY_PRINT_SCREEN,   HID_KEY_SCROLL_LOCK,    HID_KEY_PAUSE},
-    {HID_KEY_GRAVE,                 HID_KEY_1,                  HID_KEY_2,                  HID_KEY_3,      HID_KEY_4,      HID_KEY_5,       HID_KEY_6,     HID_KEY_7,      HID_KEY_8,      HID_KEY_9,                  HID_KEY_0,                          HID_KEY_MINUS,          HID_KEY_EQUAL,          HID_KEY_BACKSPACE,              HID_KEY_INSERT,         HID_KEY_HOME,           HID_KEY_PAGE_UP},
-    {HID_KEY_TAB,                   HID_KEY_Q,                  HID_KEY_W,                  HID_KEY_E,      HID_KEY_R,      HID_KEY_T,       HID_KEY_Y,     HID_KEY_U,      HID_KEY_I,      HID_KEY_O,                  HID_KEY_P,                          HID_KEY_BRACKET_LEFT,   HID_KEY_BRACKET_RIGHT,  HID_KEY_BACKSLASH,              HID_KEY_DELETE,         HID_KEY_END,            HID_KEY_PAGE_DOWN},
-    {HID_KEY_CAPS_LOCK,             HID_KEY_A,                  HID_KEY_S,                  HID_KEY_D,      HID_KEY_F,      HID_KEY_G,       HID_KEY_H,     HID_KEY_J,      HID_KEY_K,      HID_KEY_L,                  HID_KEY_SEMICOLON,                  HID_KEY_APOSTROPHE,     HID_KEY_NONE,           HID_KEY_ENTER,                  HID_KEY_NONE,           HID_KEY_NONE,           HID_KEY_NONE},
-    {KEYBOARD_MODIFIER_LEFTSHIFT,   HID_KEY_Z,                  HID_KEY_X,                  HID_KEY_C,      HID_KEY_V,      HID_KEY_B,       HID_KEY_N,     HID_KEY_M,      HID_KEY_COMMA,  HID_KEY_PERIOD,             HID_KEY_SLASH,                      HID_KEY_NONE,           HID_KEY_NONE,           KEYBOARD_MODIFIER_RIGHTSHIFT,   HID_KEY_NONE,           HID_KEY_ARROW_UP,       HID_KEY_NONE},
-    {KEYBOARD_MODIFIER_LEFTCTRL,    KEYBOARD_MODIFIER_LEFTGUI,  KEYBOARD_MODIFIER_LEFTALT,  HID_KEY_NONE,   HID_KEY_NONE,   HID_KEY_NONE,    HID_KEY_SPACE, HID_KEY_NONE,   HID_KEY_NONE,   HID_KEY_NONE,               KEYBOARD_MODIFIER_RIGHTALT,         HID_KEY_NONE,    HID_KEY_APPLICATION,           KEYBOARD_MODIFIER_RIGHTCTRL,    HID_KEY_ARROW_LEFT,     HID_KEY_ARROW_DOWN,     HID_KEY_ARROW_RIGHT}
+#define KEY_FN_OUTPUT       5
+#define KEY_FN_INPUT        11
+
+// Dual-role keys, every other key is looked up in the keymap as it is pressed
+static const tap_hold_key_t tap_hold_keys[] = {
+    // Fn at the bottom of the F8 line: holds the Fn layer, decided by the next key so Fn + key needs no wait.
+    // Tapped, it is the leader key.
+    {.output_index = KEY_FN_OUTPUT, .input_index = KEY_FN_INPUT, .kind = TAP_HOLD_LAYER_TAP, .hold = KEYMAP_LAYER_FN,
+     .flags = TAP_HOLD_HOLD_ON_OTHER_KEY_PRESS},
 };
 
-uint8_t fn_keycodes[6][17] = {
-    {HID_KEY_ESCAPE,                HID_KEY_NONE,               HID_USAGE_CONSUMER_BRIGHTNESS_DECREMENT,    HID_USAGE_CONSUMER_BRIGHTNESS_INCREMENT,    HID_KEY_F3,     HID_KEY_F4,     HID_KEY_F5,     HID_KEY_F6,     HID_USAGE_CONSUMER_SCAN_PREVIOUS,   HID_CONSUMER_PAUSE,         HID_USAGE_CONSUMER_SCAN_NEXT,   HID_USAGE_CONSUMER_MUTE,    HID_USAGE_CONSUMER_VOLUME_DECREMENT,    HID_USAGE_CONSUMER_VOLUME_INCREMENT,    HID_KEY_PRINT_SCREEN,   HID_KEY_SCROLL_LOCK,    HID_KEY_PAUSE},
-    {HID_KEY_GRAVE,                 HID_KEY_1,                  HID_KEY_2,                                  HID_KEY_3,                                  HID_KEY_4,      HID_KEY_5,      HID_KEY_6,      HID_KEY_7,      HID_KEY_8,                          HID_KEY_9,                  HID_KEY_0,                      HID_KEY_MINUS,              HID_KEY_EQUAL,                          HID_KEY_BACKSPACE,                      HID_KEY_INSERT,         HID_KEY_HOME,           HID_KEY_PAGE_UP},
-    {HID_KEY_TAB,                   HID_KEY_Q,                  HID_KEY_W,                                  HID_KEY_E,                                  HID_KEY_R,      HID_KEY_T,      HID_KEY_Y,      HID_KEY_U,      HID_KEY_I,                          HID_KEY_O,                  HID_KEY_P,                      HID_KEY_BRACKET_LEFT,       HID_KEY_BRACKET_RIGHT,                  HID_KEY_BACKSLASH,                      HID_KEY_DELETE,         HID_KEY_END,            HID_KEY_PAGE_DOWN},
-    {HID_KEY_CAPS_LOCK,             HID_KEY_A,                  HID_KEY_S,                                  HID_KEY_D,                                  HID_KEY_F,      HID_KEY_G,      HID_KEY_H,      HID_KEY_J,      HID_KEY_K,                          HID_KEY_L,                  HID_KEY_SEMICOLON,              HID_KEY_APOSTROPHE,         HID_KEY_NONE,                           HID_KEY_ENTER,                          HID_KEY_NONE,           HID_KEY_NONE,           HID_KEY_NONE},
-    {KEYBOARD_MODIFIER_LEFTSHIFT,   HID_KEY_Z,                  HID_KEY_X,                                  HID_KEY_C,                                  HID_KEY_V,      HID_KEY_B,      HID_KEY_N,      HID_KEY_M,      HID_KEY_COMMA,                      HID_KEY_PERIOD,             HID_KEY_SLASH,                  HID_KEY_NONE,               HID_KEY_NONE,                           KEYBOARD_MODIFIER_RIGHTSHIFT,           HID_KEY_NONE,           HID_KEY_ARROW_UP,       HID_KEY_NONE},
-    {KEYBOARD_MODIFIER_LEFTCTRL,    KEYBOARD_MODIFIER_LEFTGUI,  KEYBOARD_MODIFIER_LEFTALT,                  HID_KEY_NONE,                               HID_KEY_NONE,   HID_KEY_NONE,   HID_KEY_SPACE,  HID_KEY_NONE,   HID_KEY_NONE,                       HID_KEY_NONE,               KEYBOARD_MODIFIER_RIGHTALT,     HID_KEY_NONE,               HID_KEY_APPLICATION,                    KEYBOARD_MODIFIER_RIGHTCTRL,            HID_KEY_ARROW_LEFT,     HID_KEY_ARROW_DOWN,     HID_KEY_ARROW_RIGHT}
+static tap_hold_t s_tap_hold;
+
+
+// The sequences are the profile's, see keyboard_profile_t
+static bool leader_swallowed[TAP_HOLD_POS_NUM];     // keys of a sequence, the host never saw them pressed
+static uint32_t leader_swallowed_num;
+static keyboard_btn_data_t leader_key_data[TAP_HOLD_POS_NUM];
+
+
+// Mouse keys, toggled with Fn + M: the arrows move the cursor, the keys above them click and scroll
+static const uint8_t mouse_keymap[KEYMAP_OUTPUT_NUM][KEYMAP_INPUT_NUM] = {
+    [1][15] = MOUSE_KEY_BUTTON_3,       // Home
+    [1][16] = MOUSE_KEY_WHEEL_UP,       // Page Up
+    [2][14] = MOUSE_KEY_BUTTON_1,       // Delete
+    [2][15] = MOUSE_KEY_BUTTON_2,       // End
+    [2][16] = MOUSE_KEY_WHEEL_DOWN,     // Page Down
+    [4][15] = MOUSE_KEY_UP,
+    [5][14] = MOUSE_KEY_LEFT,
+    [5][15] = MOUSE_KEY_DOWN,
+    [5][16] = MOUSE_KEY_RIGHT,
+};
+
+// Slow enough to hit a pixel at first, then full speed after 1.5 s
+static const mouse_keys_point_t mouse_move_points[] = {{0, 120}, {250, 120}, {1500, 1800}};
+static const mouse_keys_point_t mouse_wheel_points[] = {{0, 8}, {1000, 30}};
+static const mouse_keys_curve_t mouse_move_curve = {mouse_move_points, 3};
+static const mouse_keys_curve_t mouse_wheel_curve = {mouse_wheel_points, 2};
+
+#define MOUSE_BLE_CONF_TIMEOUT_US   50000   // a notification never confirmed does not stop the mouse
+
+static mouse_keys_t s_mouse;
+static bool use_mouse_keys = false;
+static keyboard_btn_data_t mouse_key_data[TAP_HOLD_POS_NUM];
+static volatile bool ble_mouse_ready = true;
+static int64_t ble_mouse_sent_us;
+
+// Steno mode, Fn + T cycles the keyboard, GeminiPR and TX Bolt over USB. The letter keys sit where the keys of a
+// steno machine do, the number row is the number bar.
+static const uint8_t steno_keymap[KEYMAP_OUTPUT_NUM][KEYMAP_INPUT_NUM] = {
+    [1][1] = STENO_KEY_N1, [1][2] = STENO_KEY_N2, [1][3] = STENO_KEY_N3, [1][4] = STENO_KEY_N4,
+    [1][5] = STENO_KEY_N5, [1][6] = STENO_KEY_N6, [1][7] = STENO_KEY_N7, [1][8] = STENO_KEY_N8,
+    [1][9] = STENO_KEY_N9, [1][10] = STENO_KEY_NA,
+    [2][1] = STENO_KEY_S1, [2][2] = STENO_KEY_TL, [2][3] = STENO_KEY_PL, [2][4] = STENO_KEY_HL,
+    [2][5] = STENO_KEY_ST1, [2][6] = STENO_KEY_ST3, [2][7] = STENO_KEY_FR, [2][8] = STENO_KEY_PR,
+    [2][9] = STENO_KEY_LR, [2][10] = STENO_KEY_TR, [2][11] = STENO_KEY_DR,
+    [3][1] = STENO_KEY_S2, [3][2] = STENO_KEY_KL, [3][3] = STENO_KEY_WL, [3][4] = STENO_KEY_RL,
+    [3][5] = STENO_KEY_ST2, [3][6] = STENO_KEY_ST4, [3][7] = STENO_KEY_RR, [3][8] = STENO_KEY_BR,
+    [3][9] = STENO_KEY_GR, [3][10] = STENO_KEY_SR, [3][11] = STENO_KEY_ZR,
+    [4][3] = STENO_KEY_A, [4][4] = STENO_KEY_O, [4][6] = STENO_KEY_E, [4][7] = STENO_KEY_U,
 };
 
-uint8_t current_keycodes[6][17];
+static steno_t s_steno;
+static steno_protocol_t s_steno_protocol = STENO_PROTOCOL_NONE;
+
+// Fn + R records the keys sent to the host, Fn + P replays them with their timing, Fn + O at link speed
+static macro_record_t s_record;
+// Only the scan task changes s_record, under this lock. The configuration channel reads it under the lock too.
+static portMUX_TYPE s_record_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_replay[MACRO_RECORD_BYTECODE_SIZE];
+
+
+// A profile of the layout (see layout.h) and what is built from it at boot. The keymap reads the mapped table in
+// place until the configuration channel commits an edit, then it reads its RAM copy.
+typedef struct {
+    const layout_profile_t *layout;
+    keymap_t keymap;
+    leader_seq_t leader_seqs[LAYOUT_LEADER_NUM];    // leader_init() keeps pointers into them
+    leader_t leader;
+} keyboard_profile_t;
+
+static keyboard_profile_t s_profiles[LAYOUT_PROFILE_NUM];
+// Switched by the scan task only, with one store. Any task may read it.
+static _Atomic(keyboard_profile_t *) s_profile;
+static atomic_int s_profile_pending = -1;           // committed through the configuration channel, for the scan
+
+// Table of the key event in progress, taken with keymap_read_begin()
+static const keymap_table_t *s_keymap_table;
+static const uint8_t (*current_keycodes)[KEYMAP_INPUT_NUM];
 
 void switch_keycodes(bool use_fn) {
-    if (use_fn) {
-        memcpy(current_keycodes, fn_keycodes, sizeof(fn_keycodes));
-    } else {
-        memcpy(current_keycodes, keycodes, sizeof(keycodes));
-    }
+    current_keycodes = s_keymap_table->layers[use_fn ? KEYMAP_LAYER_FN : KEYMAP_LAYER_BASE];
 }
 
 
-bool is_modifier (uint8_t keycode, uint8_t output_index, uint8_t input_index) {
-    bool normal_key_indexes = (
-        (output_index == 0 && input_index == 8)     // HID_KEY_F7
-        || (output_index == 1 && input_index == 3)  // HID_KEY_3
-        || (output_index == 2 && input_index == 3)  // HID_KEY_E
-        || (output_index == 3 && input_index == 1)  // HID_KEY_A
-        || (output_index == 4 && input_index == 7)  // HID_KEY_M
-    );
+uint8_t keyboard_base_keycode(uint8_t output_index, uint8_t input_index) {
+    return keymap_entry(&atomic_load(&s_profile)->keymap, KEYMAP_LAYER_BASE, output_index, input_index);
+}
 
-    for (
-        hid_keyboard_modifier_bm_t modifier = KEYBOARD_MODIFIER_LEFTCTRL;
-        modifier <= KEYBOARD_MODIFIER_RIGHTGUI;
-        modifier <<=1
-    ) {
-        if (keycode == modifier && !normal_key_indexes) {
-            return true;
-        }
+
+static leader_t *active_leader(void) {
+    return &atomic_load(&s_profile)->leader;
+}
+
+
+// Settings of the profile for the transport in use
+static uint8_t profile_transport_flags(const keyboard_profile_t *profile) {
+    uint32_t transport = current_mode - MODE_USB;
+    return transport < LAYOUT_TRANSPORT_NUM ? profile->layout->transport_flags[transport] : 0;
+}
+
+
+/**
+ * @brief   Make a profile the one the keys use
+ * @param   index: Profile of the layout
+ * @return  false when it already was
+ * @note    Scan task only. One pointer store and nothing copied: the key event in progress finishes on the table
+ *          it took, the next one reads the new profile.
+ * **/
+static bool profile_activate(uint8_t index) {
+    keyboard_profile_t *old = atomic_load(&s_profile);
+    keyboard_profile_t *profile = &s_profiles[index];
+    if (profile == old) {
+        return false;
     }
-    return false;
+    if (old != NULL) {
+        // A sequence typed on the old profile ends without its macro
+        leader_cancel(&old->leader);
+    }
+    atomic_store(&s_profile, profile);
+
+    use_mouse_keys = profile_transport_flags(profile) & LAYOUT_TRANSPORT_MOUSE_KEYS;
+    if (!use_mouse_keys) {
+        mouse_keys_set(&s_mouse, 0);
+    }
+    const layout_color_t *color = &profile->layout->color;
+    lamp_array_set_autonomous_color(color->red, color->green, color->blue);
+    DLOGI(__func__, "Profile %u", index);
+    return true;
+}
+
+
+// Raw HID configuration channel, requests come from the TinyUSB task or the Bluedroid task
+static config_t s_config;
+static macro_record_t s_config_record;
+static atomic_bool s_config_record_pending;     // s_config_record waits for the scan task to take it
+
+
+// Everything the keyboard may hold on the host, keys first, then consumer control
+static const uint8_t macro_release[] = {
+    MACRO_RELEASE_ALL(),
+    MACRO_CONSUMER(0),
+    MACRO_END(),
+};
+
+
+static void change_mode_restart(void) {
+    esp_restart();
 }
 
 
 void change_mode(connection_mode_t mode) {
     save_mode(mode);
-    current_mode = mode;
-    esp_restart();
+    // Release the mode keys on the old host first, the restart happens once the player sent the release
+    if (!macro_player_play(macro_release, change_mode_restart)) {
+        esp_restart();
+    }
+}
+
+
+/**
+ * @brief   Switch to the next steno protocol, USB changes its interfaces with the restart
+ * @note    Only in MODE_USB, the strokes have no way to the host over BLE or ESP-NOW
+ * **/
+static void steno_cycle(void) {
+    steno_protocol_t next = s_steno_protocol == STENO_PROTOCOL_TXBOLT ? STENO_PROTOCOL_NONE : s_steno_protocol + 1;
+    if (save_steno_protocol_to_nvs(next) != ESP_OK) {
+        return;
+    }
+    if (!macro_player_play(macro_release, change_mode_restart)) {
+        esp_restart();
+    }
+}
+
+
+static bool steno_active(void) {
+    return s_steno_protocol != STENO_PROTOCOL_NONE && current_mode == MODE_USB;
+}
+
+
+steno_protocol_t keyboard_steno_protocol(void) {
+    return s_steno_protocol;
 }
 
 
@@ -137,9 +291,7 @@ void connect_new_ble_with_saving(uint8_t keycode) {
     } else {
         return;
     }
-    dev_num_before_new_connection = esp_ble_get_bond_device_num();
-    dev_list_before_new_connection = (esp_ble_bond_dev_t *)malloc(sizeof(esp_ble_bond_dev_t) * dev_num_before_new_connection);
-    esp_ble_get_bond_device_list(&dev_num_before_new_connection, dev_list_before_new_connection);
+    bond_cache_take_snapshot();
     is_new_connection = true;
     disconnect_all_bonded_devices();
     show_bonded_devices();
@@ -147,7 +299,7 @@ void connect_new_ble_with_saving(uint8_t keycode) {
 }
 
 void show_bonded_device_count(void) {
-    int dev_num = esp_ble_get_bond_device_num();
+    int dev_num = bond_cache_bond_num();
     printf("Bonded devices number: %d\n", dev_num);
 }
 
@@ -162,7 +314,6 @@ void handle_connected_ble_device(uint8_t keycode) {
         delete_host_from_nvs(2);
         delete_host_from_nvs(3);
         remove_all_bonded_devices();
-        free(dev_list_before_new_connection);
         return;
     }
 
@@ -182,7 +333,7 @@ void handle_connected_ble_device(uint8_t keycode) {
 
     is_new_connection = false;          // With this, Cancel attempting to connect to a new device
     is_change_to_paired_device = true;
-    load_host_from_nvs(current_ble_idx, &host_to_be_connected);
+    bond_cache_get_host(current_ble_idx, &host_to_be_connected);
     if (memcmp(host_to_be_connected.bda, empty_host.bda, sizeof(esp_bd_addr_t)) == 0) {
         ESP_LOGI(__func__, "No device to connect");
         return;
@@ -193,17 +344,7 @@ void handle_connected_ble_device(uint8_t keycode) {
 }
 
 
-void toggle_use_fn() {
-    use_fn = !use_fn;
-    switch_keycodes(use_fn);
-}
-
-
 void init_special_keys() {
-    if (use_fn == true) {
-        toggle_use_fn();
-    }
-
     if (use_right_shift == true) {
         use_right_shift = false;
     }
@@ -211,29 +352,8 @@ void init_special_keys() {
 
 
 void send_release_report() {
-    uint8_t empty_key = 0;
-    uint8_t empty_key_array[6] = {0};
-    uint8_t espnow_release_key[8] = {0};
-
-    if (current_mode == MODE_USB)
-    {
-        tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, 0, empty_key_array);
-        vTaskDelay(20 / portTICK_PERIOD_MS);
-        tud_hid_report(TUD_CONSUMER_CONTROL, &empty_key, 2);
-    }
-    else if (current_mode == MODE_BLE)
-    {
-        esp_hidd_send_keyboard_value(hid_conn_id, 0, &empty_key, 1);
-        vTaskDelay(20 / portTICK_PERIOD_MS);
-        esp_hidd_send_consumer_value(hid_conn_id, empty_key, 1);
-    }
-    else if (current_mode == MODE_WIRELESS)
-    {
-        esp_now_send(peer_mac, espnow_release_key, 32);
-        vTaskDelay(20 / portTICK_PERIOD_MS);
-        espnow_release_key[1] = 1;
-        esp_now_send(peer_mac, espnow_release_key, 32);
-    }
+    // Paced by the transport completions in the player task, never delays the caller
+    macro_player_play(macro_release, NULL);
 }
 
 
@@ -255,65 +375,103 @@ void get_espnow_send_data(uint8_t keycode, uint8_t modifier, uint8_t *espnow_sen
 }
 
 
-void handle_pressed_key(keyboard_btn_report_t kbd_report, uint8_t *keycode, uint8_t *modifier) {
-    // handle keycode, modifier, use_fn, use_right_shift by pressed_key
-    uint8_t keycode_array[120] = {0};
-    uint8_t keynum = 0;
-    hid_nkey_report_t kbd_hid_report = {0};
+/**
+ * @brief   Send one macro report on the current transport
+ * @param   report: Keyboard or consumer report of the macro player
+ * @note    Runs in the macro player task. Every send here ends in a completion that calls macro_player_ready().
+ * **/
+static void macro_send(const macro_report_t *report) {
+    if (current_mode == MODE_USB)
+    {
+        tinyusb_hid_macro_interface(report->type == MACRO_REPORT_CONSUMER);
+        if (report->type == MACRO_REPORT_CONSUMER) {
+            tinyusb_hid_consumer_report(report->usage);
+            return;
+        }
+        hid_nkey_report_t hid_report = {.report_id = REPORT_ID_KEYBOARD};
+        hid_report.keyboard_report.modifier = report->modifier;
+        memcpy(hid_report.keyboard_report.keycode, report->keycode, sizeof(hid_report.keyboard_report.keycode));
+        if (tinyusb_hid_keyboard_nkro()) {
+            hid_report_convert(&hid_report, HID_REPORT_FORMAT_NKRO, &hid_report);
+        }
+        tinyusb_hid_keyboard_report(hid_report);
+    }
+    else if (current_mode == MODE_BLE)
+    {
+        esp_hidd_macro_report(report->type == MACRO_REPORT_CONSUMER);
+        if (report->type == MACRO_REPORT_CONSUMER) {
+            esp_hidd_send_consumer_value(hid_conn_id, report->usage, report->usage != 0);
+            return;
+        }
+        uint8_t keycode[MACRO_REPORT_KEYS];
+        memcpy(keycode, report->keycode, sizeof(keycode));
+        esp_hidd_send_keyboard_value(hid_conn_id, report->modifier, keycode, MACRO_REPORT_KEYS);
+    }
+    else if (current_mode == MODE_WIRELESS)
+    {
+        // The dongle takes one key per message, byte 1 set releases its consumer control
+        uint8_t espnow_send_data[8] = {0};
+        if (report->type == MACRO_REPORT_CONSUMER) {
+            espnow_send_data[1] = report->usage == 0;
+        } else {
+            get_espnow_send_data(report->keycode[0], report->modifier, espnow_send_data);
+            espnow_send_data[1] = 0;
+        }
+        if (esp_now_send(peer_mac, espnow_send_data, sizeof(espnow_send_data)) == ESP_OK) {
+            kbd_latency_report_enqueue();
+        }
+    }
+}
+
+
+void handle_pressed_key(keyboard_btn_report_t kbd_report, uint8_t hold_modifier, uint8_t *keycode, uint8_t *modifier) {
+    // handle use_right_shift first, use_fn is already set by the tap-hold engine
+    hid_nkey_report_t kbd_hid_report;
 
     for (int i = 0; i < kbd_report.key_pressed_num; i++) {
         uint32_t output_index = kbd_report.key_data[i].output_index;
         uint32_t input_index = kbd_report.key_data[i].input_index;
-        *keycode = current_keycodes[output_index][input_index];
-        
-        // modifier handling
-        if (is_modifier(*keycode, output_index, input_index)) {
-            *modifier |= *keycode;
-        }
-
-        // use_fn handling
-        if (output_index == 5 && input_index == 11) {
-            if (use_fn == false) {
-                toggle_use_fn();
-            }
-        }
 
         // use_right_shift handling
+        uint8_t pressed_keycode = current_keycodes[output_index][input_index];
         if (
-            is_modifier(*keycode, output_index, input_index)
-            && *keycode == KEYBOARD_MODIFIER_RIGHTSHIFT
+            is_modifier(pressed_keycode, output_index, input_index)
+            && pressed_keycode == KEYBOARD_MODIFIER_RIGHTSHIFT
         ) {
             use_right_shift = true;
         }
-
-        if (keycode != HID_KEY_NONE) {
-            keycode_array[keynum++] = *keycode;
-        }
     }
 
-    if (keynum <= 6) {
-        kbd_hid_report.report_id = REPORT_ID_KEYBOARD;
-        kbd_hid_report.keyboard_report.modifier = *modifier;
-        for (int i = 0; i < keynum; i++) {
-            kbd_hid_report.keyboard_report.keycode[i] = keycode_array[i];
-        }
-    } else {
-        kbd_hid_report.report_id = REPORT_ID_FULL_KEY_KEYBOARD;
-        kbd_hid_report.keyboard_full_key_report.modifier = *modifier;
-        for (int i = 0; i < keynum; i++) {
-            // USAGE ID for keyboard starts from 4
-            uint8_t key = keycode_array[i] - 3;
-            uint8_t byteIndex = (key - 1) / 8;
-            uint8_t bitIndex = (key - 1) % 8;
-            kbd_hid_report.keyboard_full_key_report.keycode[byteIndex] |= (1 << bitIndex);
-        }
+    hid_report_format_t format = HID_REPORT_FORMAT_BOOT;
+    if (current_mode == MODE_USB && tinyusb_hid_keyboard_nkro()) {
+        format = HID_REPORT_FORMAT_NKRO;
     }
+    *modifier |= hid_report_build(kbd_report.key_data, kbd_report.key_pressed_num, current_keycodes, format, &kbd_hid_report);
+    // Mod-tap keys decided as hold, the same byte in both layouts
+    *modifier |= hold_modifier;
+    kbd_hid_report.keyboard_report.modifier |= hold_modifier;
 
     if (current_mode == MODE_USB) {
         tinyusb_hid_keyboard_report(kbd_hid_report);
     }
 
+    // Fn chords are commands to the keyboard, only the text between them is recorded
+    if (s_record.recording && !use_fn) {
+        if (format == HID_REPORT_FORMAT_NKRO) {
+            hid_report_convert(&kbd_hid_report, HID_REPORT_FORMAT_BOOT, &kbd_hid_report);
+        }
+        uint32_t now_ms = esp_timer_get_time() / 1000;
+        taskENTER_CRITICAL(&s_record_lock);
+        macro_record_report(&s_record, kbd_hid_report.keyboard_report.modifier,
+                            kbd_hid_report.keyboard_report.keycode, now_ms);
+        taskEXIT_CRITICAL(&s_record_lock);
+    }
+
     // keycode handling
+    if (kbd_report.key_pressed_num == 0) {
+        // Last key released, there is no last pressed key to look up
+        return;
+    }
     uint32_t lpki = kbd_report.key_pressed_num - 1; // lpki stands for 'last pressed key index'
     uint32_t last_output_index = kbd_report.key_data[lpki].output_index;
     uint32_t last_input_index = kbd_report.key_data[lpki].input_index;
@@ -324,14 +482,115 @@ void handle_pressed_key(keyboard_btn_report_t kbd_report, uint8_t *keycode, uint
 }
 
 
-void keyboard_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_report_t kbd_report, void *user_data)
+/**
+ * @brief   Start or stop recording, the keys of the Fn chord are left out
+ * @param   kbd_report: Keys down as the chord was pressed
+ * **/
+static void toggle_recording(keyboard_btn_report_t kbd_report) {
+    if (s_record.recording) {
+        taskENTER_CRITICAL(&s_record_lock);
+        macro_record_stop(&s_record);
+        taskEXIT_CRITICAL(&s_record_lock);
+        DLOGI(__func__, "Recorded %lu events", s_record.event_num);
+        return;
+    }
+    if (macro_player_busy()) {
+        // The replay buffer may still be playing, a new recording would not change it but confuse the user
+        return;
+    }
+    hid_nkey_report_t kbd_hid_report;
+    uint8_t modifier = hid_report_build(kbd_report.key_data, kbd_report.key_pressed_num, current_keycodes,
+                                        HID_REPORT_FORMAT_BOOT, &kbd_hid_report);
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    taskENTER_CRITICAL(&s_record_lock);
+    macro_record_start(&s_record, modifier, kbd_hid_report.keyboard_report.keycode, now_ms);
+    taskEXIT_CRITICAL(&s_record_lock);
+}
+
+
+/**
+ * @brief   Play the recording through the macro player
+ * @param   timed: true for the recorded pauses, false for as fast as the link takes reports
+ * **/
+static void replay_recording(bool timed) {
+    // s_replay is read by the player task until the replay ends
+    if (s_record.recording || macro_player_busy()) {
+        return;
+    }
+    if (macro_record_compile(&s_record, timed, s_replay, sizeof(s_replay)) > 0) {
+        macro_player_play(s_replay, NULL);
+    }
+}
+
+
+#define KEYBOARD_SAVE_PROFILE           (1 << 0)
+#define KEYBOARD_SAVE_RECORDING         (1 << 1)
+#define KEYBOARD_SAVE_CONFIG            (1 << 2)
+#define KEYBOARD_SAVE_DELAY_MS          1000    // requests closer than this share one NVS write
+#define KEYBOARD_SAVE_TASK_CORE         1       // keyboard scan task runs on core 0 (cfg.core_id)
+#define KEYBOARD_SAVE_TASK_PRIORITY     1
+
+static TaskHandle_t s_save_task = NULL;
+static atomic_uint s_save_pending;              // KEYBOARD_SAVE_* bits for the save task
+static macro_record_t s_record_saved;           // copy of s_record the save task packs while the scan goes on
+
+static void keyboard_config_save(void);
+
+
+/**
+ * @brief   Write what the scan and the configuration channel asked for to NVS, off the scan and transport tasks.
+ *          A burst of profile switches ends in one write of the last profile.
+ * **/
+static void keyboard_save_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // The host waits for the answer to its commit, only the writes of the scan are batched
+        unsigned pending = atomic_fetch_and(&s_save_pending, ~KEYBOARD_SAVE_CONFIG);
+        if (pending & KEYBOARD_SAVE_CONFIG) {
+            keyboard_config_save();
+        }
+        if ((pending & ~KEYBOARD_SAVE_CONFIG) == 0) {
+            continue;
+        }
+        vTaskDelay(pdMS_TO_TICKS(KEYBOARD_SAVE_DELAY_MS));
+        // A commit made meanwhile notified the task, it is taken by the next round
+        pending = atomic_fetch_and(&s_save_pending, KEYBOARD_SAVE_CONFIG);
+
+        if (pending & KEYBOARD_SAVE_PROFILE) {
+            save_profile_to_nvs(atomic_load(&s_profile) - s_profiles);
+        }
+        if (pending & KEYBOARD_SAVE_RECORDING) {
+            taskENTER_CRITICAL(&s_record_lock);
+            s_record_saved = s_record;
+            taskEXIT_CRITICAL(&s_record_lock);
+            save_recording_to_nvs(&s_record_saved);
+        }
+    }
+}
+
+
+// Never blocks, the scan and transport tasks hand the write to keyboard_save_task()
+static void keyboard_save(unsigned what) {
+    atomic_fetch_or(&s_save_pending, what);
+    if (s_save_task != NULL) {
+        xTaskNotifyGive(s_save_task);
+    }
+}
+
+
+/**
+ * @brief   Send the keys the tap-hold engine let through
+ * @param   kbd_report: Keys to look up in current_keycodes
+ * @param   hold_modifier: Modifiers of mod-tap keys held down
+ * **/
+static void keyboard_apply(keyboard_btn_report_t kbd_report, uint8_t hold_modifier)
 {
     uint8_t keycode = 0;
     uint8_t modifier = 0;
 
     init_special_keys();
 
-    handle_pressed_key(kbd_report, &keycode, &modifier);
+    handle_pressed_key(kbd_report, hold_modifier, &keycode, &modifier);
 
     // if (kbd_report.key_change_num < 0) {
     //     send_release_report();
@@ -343,12 +602,38 @@ void keyboard_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_report_t kbd_rep
 
         if (use_fn) {
             change_mode_by_keycode(keycode);
+            if (keycode == HID_KEY_L) {
+                // Fn + L dumps the latency histograms to the console and starts a new window
+                kbd_latency_print();
+                kbd_latency_reset();
+            } else if (keycode == HID_KEY_R) {
+                toggle_recording(kbd_report);
+            } else if (keycode == HID_KEY_P || keycode == HID_KEY_O) {
+                replay_recording(keycode == HID_KEY_P);
+            } else if (keycode == HID_KEY_M) {
+                // The ESP-NOW dongle only takes keys, mouse keys work over USB and BLE
+                use_mouse_keys = !use_mouse_keys;
+                if (!use_mouse_keys) {
+                    mouse_keys_set(&s_mouse, 0);
+                }
+            } else if (keycode == HID_KEY_S && !s_record.recording) {
+                // Fn + S keeps the recording over a restart
+                keyboard_save(KEYBOARD_SAVE_RECORDING);
+            } else if (keycode == HID_KEY_T && current_mode == MODE_USB) {
+                steno_cycle();
+            } else if (keycode >= HID_KEY_F3 && keycode < HID_KEY_F3 + LAYOUT_PROFILE_NUM) {
+                // Fn + F3 ~ F6 switch the profile at once, the next start begins with it
+                uint8_t profile = keycode - HID_KEY_F3;
+                if (profile_activate(profile)) {
+                    keyboard_save(KEYBOARD_SAVE_PROFILE);
+                }
+            }
         }
 
         if (current_mode == MODE_USB)
         {
             if (use_fn) {
-                tud_hid_report(TUD_CONSUMER_CONTROL, &keycode, 2);
+                tinyusb_hid_consumer_report(keycode);
             }
         }
         else if (current_mode == MODE_BLE)
@@ -371,20 +656,489 @@ void keyboard_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_report_t kbd_rep
         {
             uint8_t espnow_send_data[8];
             get_espnow_send_data(keycode, modifier, espnow_send_data);
-            esp_now_send(peer_mac, espnow_send_data, 8);
+            if (esp_now_send(peer_mac, espnow_send_data, 8) == ESP_OK) {
+                kbd_latency_report_enqueue();
+            }
         }
+        deep_sleep_report_sent();
     }
 }
 
 
+/**
+ * @brief   Turn the keys into strokes, one packet on the CDC port per stroke and no HID report at all
+ * @param   kbd_report: Keys the tap-hold engine let through
+ * @note    Fn chords stay commands to the keyboard, they change the mode or leave steno mode
+ * **/
+static void steno_apply(keyboard_btn_report_t kbd_report) {
+    if (use_fn) {
+        // Keys held into the Fn chord are not a stroke
+        steno_init(&s_steno);
+        if (kbd_report.key_change_num > 0) {
+            const keyboard_btn_data_t *key = &kbd_report.key_data[kbd_report.key_pressed_num - 1];
+            uint8_t keycode = current_keycodes[key->output_index][key->input_index];
+            if (keycode == HID_KEY_T) {
+                steno_cycle();
+            } else {
+                change_mode_by_keycode(keycode);
+            }
+        }
+        return;
+    }
+
+    uint64_t held = 0;
+    for (uint32_t i = 0; i < kbd_report.key_pressed_num; i++) {
+        const keyboard_btn_data_t *key = &kbd_report.key_data[i];
+        held |= STENO_KEY_BIT(steno_keymap[key->output_index][key->input_index]);
+    }
+    // All keys up ends the chord
+    uint64_t stroke;
+    if (!steno_set(&s_steno, held, &stroke)) {
+        return;
+    }
+    uint8_t packet[STENO_PACKET_MAX];
+    size_t len = steno_pack(stroke, s_steno_protocol, packet);
+    if (len > 0) {
+        tinyusb_steno_write(packet, len);
+        deep_sleep_report_sent();
+    }
+}
+
+
+static void leader_play(const uint8_t *macro) {
+    if (macro != NULL) {
+        macro_player_play(macro, NULL);
+    }
+}
+
+
+/**
+ * @brief   Feed the leader engine and hide the keys of a sequence from the host
+ * @param   kbd_report: Keys the tap-hold engine let through, key_data is replaced when keys are hidden
+ * @return  true when the event belongs to a sequence and is not sent
+ * **/
+static bool leader_filter(keyboard_btn_report_t *kbd_report) {
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+
+    if (kbd_report->key_change_num > 0) {
+        const keyboard_btn_data_t *key = &kbd_report->key_data[kbd_report->key_pressed_num - 1];
+        uint32_t pos = key->output_index * KEYMAP_INPUT_NUM + key->input_index;
+        leader_t *leader = active_leader();
+        leader_play(leader_tick(leader, now_ms));
+
+        // Fn decided as a tap, where the profile has sequences on this transport
+        bool leader_pressed = key->output_index == KEY_FN_OUTPUT && key->input_index == KEY_FN_INPUT
+                              && (profile_transport_flags(atomic_load(&s_profile)) & LAYOUT_TRANSPORT_LEADER);
+        if (leader_pressed || leader_active(leader)) {
+            if (leader_pressed) {
+                leader_start(leader, now_ms);
+            } else {
+                uint8_t keycode = s_keymap_table->layers[KEYMAP_LAYER_BASE][key->output_index][key->input_index];
+                const uint8_t *macro = NULL;
+                // Modifiers neither continue nor break a sequence
+                if (!is_modifier(keycode, key->output_index, key->input_index)
+                    && leader_key(leader, keycode, now_ms, &macro) == LEADER_DONE) {
+                    leader_play(macro);
+                }
+            }
+            leader_swallowed[pos] = true;
+            leader_swallowed_num++;
+            return true;
+        }
+    }
+
+    if (kbd_report->key_change_num < 0 && kbd_report->key_release_num > 0) {
+        const keyboard_btn_data_t *key = kbd_report->key_release_data;
+        uint32_t pos = key->output_index * KEYMAP_INPUT_NUM + key->input_index;
+        if (leader_swallowed[pos]) {
+            leader_swallowed[pos] = false;
+            leader_swallowed_num--;
+            return true;
+        }
+    }
+
+    if (leader_swallowed_num > 0) {
+        uint32_t key_num = 0;
+        for (uint32_t i = 0; i < kbd_report->key_pressed_num; i++) {
+            const keyboard_btn_data_t *key = &kbd_report->key_data[i];
+            if (!leader_swallowed[key->output_index * KEYMAP_INPUT_NUM + key->input_index]) {
+                leader_key_data[key_num++] = *key;
+            }
+        }
+        kbd_report->key_data = leader_key_data;
+        kbd_report->key_pressed_num = key_num;
+    }
+    return false;
+}
+
+
+/**
+ * @brief   Drive mouse keys with the keys of the mouse layer and hide them from the host
+ * @param   kbd_report: Keys to send, key_data is replaced when mouse keys are down
+ * @return  true when the event was a mouse key and there is nothing to send
+ * **/
+static bool mouse_filter(keyboard_btn_report_t *kbd_report) {
+    if (!use_mouse_keys) {
+        return false;
+    }
+    const keyboard_btn_data_t *changed = NULL;
+    if (kbd_report->key_change_num > 0) {
+        changed = &kbd_report->key_data[kbd_report->key_pressed_num - 1];
+    } else if (kbd_report->key_change_num < 0 && kbd_report->key_release_num > 0) {
+        changed = kbd_report->key_release_data;
+    }
+    bool mouse_changed = changed != NULL && mouse_keymap[changed->output_index][changed->input_index] != MOUSE_KEY_NONE;
+
+    uint32_t held = 0;
+    uint32_t key_num = 0;
+    for (uint32_t i = 0; i < kbd_report->key_pressed_num; i++) {
+        const keyboard_btn_data_t *key = &kbd_report->key_data[i];
+        uint8_t action = mouse_keymap[key->output_index][key->input_index];
+        if (action != MOUSE_KEY_NONE) {
+            held |= MOUSE_KEY_BIT(action);
+        } else {
+            mouse_key_data[key_num++] = *key;
+        }
+    }
+    mouse_keys_set(&s_mouse, held);
+    kbd_report->key_data = mouse_key_data;
+    kbd_report->key_pressed_num = key_num;
+    return mouse_changed;
+}
+
+
+/**
+ * @brief   Hand the motion integrated so far to the transport once it can take a report
+ * @note    USB adds it to the report of the next frame, BLE sends one notification per connection event
+ * **/
+static void mouse_send(void) {
+    mouse_keys_report_t report;
+    if (current_mode == MODE_USB) {
+        if (mouse_keys_take(&s_mouse, &report)) {
+            tinyusb_hid_mouse_report(report.buttons, report.x, report.y, report.wheel);
+        }
+    } else if (current_mode == MODE_BLE) {
+        int64_t now_us = esp_timer_get_time();
+        if (!ble_mouse_ready && now_us - ble_mouse_sent_us < MOUSE_BLE_CONF_TIMEOUT_US) {
+            return;
+        }
+        if (mouse_keys_take(&s_mouse, &report)) {
+            ble_mouse_ready = false;
+            ble_mouse_sent_us = now_us;
+            esp_hidd_send_mouse_value(hid_conn_id, report.buttons, report.x, report.y, report.wheel);
+        }
+    }
+}
+
+
+void keyboard_mouse_ready(void) {
+    ble_mouse_ready = true;
+}
+
+
+/**
+ * @brief   Take the recording the configuration channel committed, the scan task owns s_record
+ * **/
+static void config_record_take(void) {
+    if (atomic_load(&s_config_record_pending)) {
+        taskENTER_CRITICAL(&s_record_lock);
+        s_record = s_config_record;
+        taskEXIT_CRITICAL(&s_record_lock);
+        atomic_store(&s_config_record_pending, false);
+    }
+}
+
+
+// Activates the profile committed through the configuration channel
+static void config_profile_take(void) {
+    int profile = atomic_exchange(&s_profile_pending, -1);
+    if (profile >= 0) {
+        profile_activate(profile);
+    }
+}
+
+
+static atomic_bool s_wake_key_requested;        // a transport is up, the scan task replays the wake key
+
+/**
+ * @brief   Replay the key that woke the keyboard as a tap once a transport asked for it, on the scan task
+ * @note    Nothing to replay if the scan already reported the key by itself
+ * **/
+static void wake_key_take(void) {
+    if (!atomic_exchange(&s_wake_key_requested, false)) {
+        return;
+    }
+    keyboard_btn_data_t wake_key;
+    if (!deep_sleep_take_wake_key(&wake_key)) {
+        return;
+    }
+
+    // The key was released before the scan started, replay it as a tap
+    keyboard_btn_report_t kbd_report = {
+        .key_change_num = 1,
+        .key_pressed_num = 1,
+        .key_release_num = 0,
+        .key_data = &wake_key,
+        .key_release_data = NULL,
+    };
+    config_record_take();
+    config_profile_take();
+    keymap_t *keymap = &atomic_load(&s_profile)->keymap;
+    s_keymap_table = keymap_read_begin(keymap);
+    switch_keycodes(use_fn);
+    keyboard_apply(kbd_report, 0);
+    keymap_read_end(keymap);
+    send_release_report();
+    init_special_keys();
+    power_policy_set_key_down(false);
+}
+
+
+static void keyboard_emit_keys(const tap_hold_output_t *output)
+{
+    use_fn = output->layer_mask & (1 << KEYMAP_LAYER_FN);
+    switch_keycodes(use_fn);
+    if (steno_active()) {
+        steno_apply(output->report);
+        return;
+    }
+    keyboard_btn_report_t kbd_report = output->report;
+    if (leader_filter(&kbd_report) || mouse_filter(&kbd_report)) {
+        return;
+    }
+    keyboard_apply(kbd_report, output->hold_modifier);
+}
+
+
+static void keyboard_emit(const tap_hold_output_t *output, void *user_data)
+{
+    config_record_take();
+    config_profile_take();
+    // One table for the whole event, a commit or a profile switch in between takes effect with the next one
+    keymap_t *keymap = &atomic_load(&s_profile)->keymap;
+    s_keymap_table = keymap_read_begin(keymap);
+    keyboard_emit_keys(output);
+    keymap_read_end(keymap);
+}
+
+
+void keyboard_cb(keyboard_btn_handle_t kbd_handle, keyboard_btn_report_t kbd_report, void *user_data)
+{
+    // Called on every scan tick, the tap-hold timers count them
+    if (kbd_report.key_change_num != 0 || kbd_report.key_release_num != 0) {
+        kbd_latency_callback_entry();
+        power_policy_set_key_down(kbd_report.key_pressed_num > 0);
+        deep_sleep_wake_key_seen(&kbd_report);
+    }
+    wake_key_take();
+    if (leader_active(active_leader())) {
+        leader_play(leader_tick(active_leader(), esp_timer_get_time() / 1000));
+    }
+    tap_hold_tick(&s_tap_hold, &kbd_report);
+    // Motion is integrated every scan, the transports take it at their own rate
+    if (use_mouse_keys || mouse_keys_busy(&s_mouse)) {
+        mouse_keys_tick(&s_mouse);
+        mouse_send();
+    }
+    // The button-up and the motion held back for the BLE notification only go out from this tick, and a
+    // sequence that is the prefix of a longer one only times out from it
+    keyboard_button_keep_awake(kbd_handle, mouse_keys_busy(&s_mouse) || leader_active(active_leader()));
+}
+
+
+void keyboard_keymap_init(uint32_t tick_us)
+{
+    const layout_image_t *layout = layout_get();
+    // Every trie is built now, a switch only changes the pointer
+    for (int p = 0; p < LAYOUT_PROFILE_NUM; p++) {
+        keyboard_profile_t *profile = &s_profiles[p];
+        profile->layout = &layout->profiles[p];
+        keymap_init_mapped(&profile->keymap, &profile->layout->keymap);
+        for (int i = 0; i < profile->layout->leader_num; i++) {
+            profile->leader_seqs[i] = (leader_seq_t) {
+                .keys = profile->layout->leaders[i].keys,
+                .key_num = profile->layout->leaders[i].key_num,
+                .macro = profile->layout->leaders[i].macro,
+            };
+        }
+        if (!leader_init(&profile->leader, profile->leader_seqs, profile->layout->leader_num)) {
+            ESP_LOGE(__func__, "Leader sequences of profile %d do not fit in %d nodes", p, LEADER_MAX_NODES);
+        }
+    }
+    tap_hold_init(&s_tap_hold, tap_hold_keys, sizeof(tap_hold_keys) / sizeof(tap_hold_keys[0]), tick_us,
+                  keyboard_emit, NULL);
+    memset(leader_swallowed, 0, sizeof(leader_swallowed));
+    leader_swallowed_num = 0;
+    mouse_keys_init(&s_mouse, &mouse_move_curve, &mouse_wheel_curve, tick_us);
+    steno_init(&s_steno);
+
+    atomic_store(&s_profile, NULL);
+    atomic_store(&s_profile_pending, -1);
+    profile_activate(0);
+    keymap_t *keymap = &atomic_load(&s_profile)->keymap;
+    s_keymap_table = keymap_read_begin(keymap);
+    keymap_read_end(keymap);
+    use_fn = false;
+    switch_keycodes(use_fn);
+}
+
+
+void deliver_wake_key(void) {
+    atomic_store(&s_wake_key_requested, true);
+    // Power save may have stopped the scan, the key would wait for the next press otherwise
+    if (kbd_handle) {
+        keyboard_button_wake(kbd_handle);
+    }
+}
+
+
+// Called by the channel on the TinyUSB or Bluedroid task, the lock keeps the scan from changing the ring meanwhile
+static size_t keyboard_macro_pack(uint8_t *blob, size_t size) {
+    taskENTER_CRITICAL(&s_record_lock);
+    size_t len = macro_record_pack(&s_record, blob, size);
+    taskEXIT_CRITICAL(&s_record_lock);
+    return len;
+}
+
+
+// Profile whose keymap the channel edits
+static uint8_t config_profile(const config_t *config) {
+    uint8_t profile = 0;
+    while (profile < LAYOUT_PROFILE_NUM - 1 && &s_profiles[profile].keymap != config->keymap) {
+        profile++;
+    }
+    return profile;
+}
+
+
+/**
+ * @brief   Check that staging can be taken now and hand the save to keyboard_save_task()
+ * @param   config: Channel with something dirty
+ * @return  CONFIG_PENDING, keyboard_config_save() answers the commit
+ * @note    Runs in the TinyUSB or Bluedroid task, NVS and the wait for the scan would hold up the key reports
+ * **/
+static config_status_t keyboard_config_commit(config_t *config) {
+    // A new recording would be dropped by the one being made, the last commit may not have been taken yet
+    taskENTER_CRITICAL(&s_record_lock);
+    bool recording = s_record.recording;
+    taskEXIT_CRITICAL(&s_record_lock);
+    if (recording || atomic_load(&s_config_record_pending)) {
+        return CONFIG_ERR_BUSY;
+    }
+    keyboard_save(KEYBOARD_SAVE_CONFIG);
+    return CONFIG_PENDING;
+}
+
+
+static void keyboard_config_send(const uint8_t *response, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (current_mode == MODE_USB) {
+        tinyusb_hid_vendor_report(response, len);
+    } else if (current_mode == MODE_BLE) {
+        esp_hidd_send_vendor_value(hid_conn_id, response, len);
+    }
+}
+
+
+/**
+ * @brief   Save staging with one NVS commit, hand it to the scan, then answer the commit
+ * @note    Runs in keyboard_save_task(). The steno protocol is read at boot, a new one takes effect at the next
+ *          restart. A new profile is activated by the scan with the next key event.
+ * **/
+static void keyboard_config_save(void) {
+    config_t *config = &s_config;
+    config_status_t status = CONFIG_OK;
+    uint8_t profile = config_profile(config);
+    if (config->macro_dirty && !macro_record_unpack(&s_config_record, config->macro, config->macro_len)) {
+        status = CONFIG_ERR_MACRO;
+    } else if (save_config_to_nvs(profile, config->keymap_dirty ? keymap_staging(config->keymap) : NULL,
+                                  config->macro_dirty ? config->macro : NULL, config->macro_len,
+                                  config->settings_dirty ? config->staged_settings : NULL) != ESP_OK) {
+        status = CONFIG_ERR_STORE;
+    } else {
+        if (config->keymap_dirty) {
+            keymap_swap(config->keymap);
+            // A key event that took the old table before the swap finishes with it
+            while (keymap_reading(config->keymap)) {
+                vTaskDelay(1);
+            }
+            keymap_sync(config->keymap);
+        }
+        if (config->macro_dirty) {
+            atomic_store(&s_config_record_pending, true);
+        }
+        if (config->settings_dirty && config->staged_settings[CONFIG_SETTING_PROFILE] != profile) {
+            atomic_store(&s_profile_pending, config->staged_settings[CONFIG_SETTING_PROFILE]);
+        }
+    }
+
+    uint8_t response[CONFIG_REPORT_LEN];
+    keyboard_config_send(response, config_commit_done(config, status, response));
+}
+
+
+void keyboard_config_rx(const uint8_t *data, uint16_t len) {
+    // Follow the keys to another profile, what was staged for the old one is dropped. Not while a commit of it
+    // is being saved, the request is answered busy.
+    keyboard_profile_t *profile = atomic_load(&s_profile);
+    if (s_config.keymap != &profile->keymap && !config_commit_pending(&s_config)) {
+        s_config.settings[CONFIG_SETTING_PROFILE] = profile - s_profiles;
+        config_select(&s_config, &profile->keymap, &profile->layout->keymap);
+    }
+
+    uint8_t response[CONFIG_REPORT_LEN];
+    keyboard_config_send(response, config_handle(&s_config, data, len, response));
+}
+
+
+/**
+ * @brief   Start the configuration channel on the keymaps saved by the last commits and the saved profile
+ * **/
+static void keyboard_config_init(void) {
+    for (int i = 0; i < LAYOUT_PROFILE_NUM; i++) {
+        keymap_t *keymap = &s_profiles[i].keymap;
+        if (load_keymap_from_nvs(i, keymap_staging(keymap)) == ESP_OK) {
+            // Nothing reads the keymap yet
+            keymap_swap(keymap);
+            keymap_sync(keymap);
+        }
+    }
+    // The scan is not running yet
+    profile_activate(load_profile_from_nvs());
+    keyboard_profile_t *profile = atomic_load(&s_profile);
+
+    const uint16_t settings[CONFIG_SETTING_NUM] = {
+        [CONFIG_SETTING_STENO_PROTOCOL] = s_steno_protocol,
+        [CONFIG_SETTING_PROFILE] = profile - s_profiles,
+    };
+    const uint16_t setting_max[CONFIG_SETTING_NUM] = {
+        [CONFIG_SETTING_STENO_PROTOCOL] = STENO_PROTOCOL_TXBOLT,
+        [CONFIG_SETTING_PROFILE] = LAYOUT_PROFILE_NUM - 1,
+    };
+    config_init(&s_config, &profile->keymap, &profile->layout->keymap, settings, setting_max, keyboard_macro_pack,
+                keyboard_config_commit);
+    tinyusb_hid_vendor_register_rx(keyboard_config_rx);
+}
+
+
 keyboard_btn_cb_config_t cb_cfg = {
-    .event = KBD_EVENT_PRESSED,
+    .event = KBD_EVENT_TICK,
     .callback = keyboard_cb,
 };
 
 
 void keyboard_task(void) {
-    switch_keycodes(use_fn);
+    macro_player_init(macro_send);
+    load_recording_from_nvs(&s_record);
+    // Before tusb_main(), which picks the USB interfaces by it
+    s_steno_protocol = load_steno_protocol_from_nvs();
+    keyboard_keymap_init(cfg.ticks_interval);
+    // Before the configuration channel, which hands its commits to it
+    xTaskCreatePinnedToCore(keyboard_save_task, "keyboard_save_task", 1024 * 3, NULL, KEYBOARD_SAVE_TASK_PRIORITY,
+                            &s_save_task, KEYBOARD_SAVE_TASK_CORE);
+    keyboard_config_init();
     keyboard_button_create(&cfg, &kbd_handle);
     keyboard_button_register_cb(kbd_handle, cb_cfg, NULL);
 }
\ No newline at end of file
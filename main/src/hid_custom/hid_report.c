@@ -0,0 +1,119 @@
+#include <string.h>
+#include "tinyusb.h"
+#include "descriptors.h"
+#include "hid_report.h"
+
+
+bool is_modifier (uint8_t keycode, uint8_t output_index, uint8_t input_index) {
+    bool normal_key_indexes = (
+        (output_index == 0 && input_index == 8)     // HID_KEY_F7
+        || (output_index == 1 && input_index == 3)  // HID_KEY_3
+        || (output_index == 2 && input_index == 3)  // HID_KEY_E
+        || (output_index == 3 && input_index == 1)  // HID_KEY_A
+        || (output_index == 4 && input_index == 7)  // HID_KEY_M
+    );
+
+    for (
+        hid_keyboard_modifier_bm_t modifier = KEYBOARD_MODIFIER_LEFTCTRL;
+        modifier <= KEYBOARD_MODIFIER_RIGHTGUI;
+        modifier <<=1
+    ) {
+        if (keycode == modifier && !normal_key_indexes) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+uint8_t hid_report_build(const keyboard_btn_data_t *key_data, uint32_t key_num,
+                         const uint8_t keymap[KEYMAP_OUTPUT_NUM][KEYMAP_INPUT_NUM], hid_report_format_t format,
+                         hid_nkey_report_t *report) {
+    uint8_t keys[KEYMAP_OUTPUT_NUM * KEYMAP_INPUT_NUM];
+    uint32_t keynum = 0;
+    uint8_t modifier = 0;
+
+    for (uint32_t i = 0; i < key_num; i++) {
+        uint32_t output_index = key_data[i].output_index;
+        uint32_t input_index = key_data[i].input_index;
+        if (output_index >= KEYMAP_OUTPUT_NUM || input_index >= KEYMAP_INPUT_NUM) {
+            continue;
+        }
+        uint8_t keycode = keymap[output_index][input_index];
+        if (is_modifier(keycode, output_index, input_index)) {
+            modifier |= keycode;
+        } else if (keycode != HID_KEY_NONE && keynum < sizeof(keys)) {
+            keys[keynum++] = keycode;
+        }
+    }
+
+    memset(report, 0, sizeof(*report));
+    if (format == HID_REPORT_FORMAT_BOOT) {
+        report->report_id = REPORT_ID_KEYBOARD;
+        report->keyboard_report.modifier = modifier;
+        if (keynum <= HID_REPORT_6KRO_KEYS) {
+            memcpy(report->keyboard_report.keycode, keys, keynum);
+        } else {
+            memset(report->keyboard_report.keycode, HID_REPORT_ERROR_ROLLOVER, HID_REPORT_6KRO_KEYS);
+        }
+    } else {
+        report->report_id = REPORT_ID_FULL_KEY_KEYBOARD;
+        report->keyboard_full_key_report.modifier = modifier;
+        for (uint32_t i = 0; i < keynum; i++) {
+            // Bit 0 is HID_KEY_A, usages below it or past the bitmap have no bit
+            uint32_t bit = (uint32_t)keys[i] - HID_REPORT_NKRO_FIRST;
+            if (bit < HID_REPORT_NKRO_BITS) {
+                report->keyboard_full_key_report.keycode[bit / 8] |= 1 << (bit % 8);
+            }
+        }
+    }
+    return modifier;
+}
+
+
+void hid_report_convert(const hid_nkey_report_t *from, hid_report_format_t format, hid_nkey_report_t *to) {
+    uint8_t keys[HID_REPORT_NKRO_BITS];
+    uint32_t keynum = 0;
+    uint8_t modifier = 0;
+
+    if (from->report_id == REPORT_ID_FULL_KEY_KEYBOARD) {
+        modifier = from->keyboard_full_key_report.modifier;
+        for (uint32_t bit = 0; bit < HID_REPORT_NKRO_BITS; bit++) {
+            if (from->keyboard_full_key_report.keycode[bit / 8] & (1 << (bit % 8))) {
+                keys[keynum++] = HID_REPORT_NKRO_FIRST + bit;
+            }
+        }
+    } else if (from->report_id == REPORT_ID_KEYBOARD) {
+        modifier = from->keyboard_report.modifier;
+        for (uint32_t i = 0; i < HID_REPORT_6KRO_KEYS; i++) {
+            uint8_t keycode = from->keyboard_report.keycode[i];
+            if (keycode == HID_REPORT_ERROR_ROLLOVER) {
+                keynum = 0;
+                break;
+            }
+            if (keycode != HID_KEY_NONE) {
+                keys[keynum++] = keycode;
+            }
+        }
+    }
+
+    memset(to, 0, sizeof(*to));
+    if (format == HID_REPORT_FORMAT_BOOT) {
+        to->report_id = REPORT_ID_KEYBOARD;
+        to->keyboard_report.modifier = modifier;
+        if (keynum <= HID_REPORT_6KRO_KEYS) {
+            memcpy(to->keyboard_report.keycode, keys, keynum);
+        } else {
+            memset(to->keyboard_report.keycode, HID_REPORT_ERROR_ROLLOVER, HID_REPORT_6KRO_KEYS);
+        }
+    } else {
+        to->report_id = REPORT_ID_FULL_KEY_KEYBOARD;
+        to->keyboard_full_key_report.modifier = modifier;
+        for (uint32_t i = 0; i < keynum; i++) {
+            uint32_t bit = (uint32_t)keys[i] - HID_REPORT_NKRO_FIRST;
+            if (bit < HID_REPORT_NKRO_BITS) {
+                to->keyboard_full_key_report.keycode[bit / 8] |= 1 << (bit % 8);
+            }
+        }
+    }
+}
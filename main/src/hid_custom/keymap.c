@@ -0,0 +1,57 @@
+#include <string.h>
+#include "keymap.h"
+
+
+void keymap_init(keymap_t *keymap, const keymap_table_t *table) {
+    keymap->tables[0] = *table;
+    keymap->tables[1] = *table;
+    atomic_store(&keymap->active, &keymap->tables[0]);
+    atomic_store(&keymap->reading, false);
+}
+
+
+void keymap_init_mapped(keymap_t *keymap, const keymap_table_t *table) {
+    // Neither buffer is active, keymap_staging() hands out tables[0] and the first swap moves off the mapping
+    keymap->tables[0] = *table;
+    atomic_store(&keymap->active, table);
+    atomic_store(&keymap->reading, false);
+}
+
+
+const keymap_table_t *keymap_read_begin(keymap_t *keymap) {
+    // Flag first, a writer that swaps after this load waits for keymap_read_end() before touching the old table
+    atomic_store(&keymap->reading, true);
+    return atomic_load(&keymap->active);
+}
+
+
+void keymap_read_end(keymap_t *keymap) {
+    atomic_store(&keymap->reading, false);
+}
+
+
+keymap_table_t *keymap_staging(keymap_t *keymap) {
+    const keymap_table_t *active = atomic_load(&keymap->active);
+    return active == &keymap->tables[0] ? &keymap->tables[1] : &keymap->tables[0];
+}
+
+
+void keymap_swap(keymap_t *keymap) {
+    atomic_store(&keymap->active, keymap_staging(keymap));
+}
+
+
+bool keymap_reading(keymap_t *keymap) {
+    return atomic_load(&keymap->reading);
+}
+
+
+void keymap_sync(keymap_t *keymap) {
+    memcpy(keymap_staging(keymap), atomic_load(&keymap->active), sizeof(keymap_table_t));
+}
+
+
+uint8_t keymap_entry(keymap_t *keymap, uint8_t layer, uint8_t output_index, uint8_t input_index) {
+    // A single byte load, keymap_sync() overwrites an old entry with the new one and nothing in between
+    return atomic_load(&keymap->active)->layers[layer][output_index][input_index];
+}
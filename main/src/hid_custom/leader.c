@@ -0,0 +1,176 @@
+#include <string.h>
+#include "leader.h"
+
+_Static_assert(LEADER_MAX_NODES < LEADER_NO_NODE, "nodes are indexed by uint8_t");
+
+
+/*********** Trie construction ***********/
+
+// Lexicographic, a prefix before the sequences it starts
+static int seq_compare(const leader_seq_t *a, const leader_seq_t *b) {
+    uint32_t len = a->key_num < b->key_num ? a->key_num : b->key_num;
+    int diff = memcmp(a->keys, b->keys, len);
+    if (diff != 0) {
+        return diff;
+    }
+    return (int)a->key_num - (int)b->key_num;
+}
+
+
+/**
+ * @brief   Add the children of node for the sorted sequences order[lo, hi), which share their first depth keys
+ * @return  false when the nodes run out
+ * **/
+static bool build(leader_t *leader, const leader_seq_t *seqs, const uint8_t *order, uint32_t lo, uint32_t hi,
+                  uint32_t depth, uint8_t node) {
+    // Sequences ending here sort first, a stable sort keeps the first of equal ones in front
+    while (lo < hi && seqs[order[lo]].key_num == depth) {
+        if (leader->nodes[node].macro == NULL) {
+            leader->nodes[node].macro = seqs[order[lo]].macro;
+        }
+        lo++;
+    }
+    if (lo == hi) {
+        return true;
+    }
+
+    uint32_t child_num = 1;
+    for (uint32_t i = lo + 1; i < hi; i++) {
+        child_num += seqs[order[i]].keys[depth] != seqs[order[i - 1]].keys[depth];
+    }
+    if (leader->node_num + child_num > LEADER_MAX_NODES) {
+        return false;
+    }
+    uint8_t first_child = leader->node_num;
+    leader->nodes[node].first_child = first_child;
+    leader->nodes[node].child_num = child_num;
+    leader->node_num += child_num;
+
+    uint8_t child = first_child;
+    uint32_t group = lo;
+    for (uint32_t i = lo + 1; i <= hi; i++) {
+        if (i < hi && seqs[order[i]].keys[depth] == seqs[order[group]].keys[depth]) {
+            continue;
+        }
+        leader->nodes[child] = (leader_node_t) {.keycode = seqs[order[group]].keys[depth]};
+        if (!build(leader, seqs, order, group, i, depth + 1, child)) {
+            return false;
+        }
+        child++;
+        group = i;
+    }
+    return true;
+}
+
+
+/*********** Matching ***********/
+
+static void finish(leader_t *leader) {
+    leader->current = LEADER_NO_NODE;
+}
+
+
+static uint8_t find_child(const leader_t *leader, uint8_t node, uint8_t keycode) {
+    uint32_t lo = leader->nodes[node].first_child;
+    uint32_t hi = lo + leader->nodes[node].child_num;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (leader->nodes[mid].keycode == keycode) {
+            return mid;
+        }
+        if (leader->nodes[mid].keycode < keycode) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return LEADER_NO_NODE;
+}
+
+
+static bool deadline_passed(uint32_t now_ms, uint32_t deadline_ms) {
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+
+/*********** API ***********/
+
+bool leader_init(leader_t *leader, const leader_seq_t *seqs, uint32_t seq_num) {
+    memset(leader, 0, sizeof(leader_t));
+    leader->current = LEADER_NO_NODE;
+    leader->node_num = 1;
+    // Every sequence takes a node at least
+    if (seq_num >= LEADER_MAX_NODES) {
+        return false;
+    }
+
+    uint8_t order[LEADER_MAX_NODES];
+    for (uint32_t i = 0; i < seq_num; i++) {
+        if (seqs[i].key_num == 0) {
+            return false;
+        }
+        // Insertion sort, stable and the table is small
+        uint32_t j = i;
+        while (j > 0 && seq_compare(&seqs[order[j - 1]], &seqs[i]) > 0) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    if (!build(leader, seqs, order, 0, seq_num, 0, 0)) {
+        memset(leader->nodes, 0, sizeof(leader->nodes));
+        leader->node_num = 1;
+        return false;
+    }
+    return true;
+}
+
+
+void leader_start(leader_t *leader, uint32_t now_ms) {
+    leader->current = 0;
+    leader->deadline_ms = now_ms + LEADER_TIMEOUT_MS;
+}
+
+
+bool leader_active(const leader_t *leader) {
+    return leader->current != LEADER_NO_NODE;
+}
+
+
+leader_result_t leader_key(leader_t *leader, uint8_t keycode, uint32_t now_ms, const uint8_t **macro) {
+    *macro = NULL;
+    if (!leader_active(leader)) {
+        return LEADER_IDLE;
+    }
+
+    uint8_t next = find_child(leader, leader->current, keycode);
+    if (next == LEADER_NO_NODE) {
+        // Not a sequence, the key is swallowed with the ones before it
+        finish(leader);
+        return LEADER_DONE;
+    }
+    if (leader->nodes[next].child_num == 0) {
+        *macro = leader->nodes[next].macro;
+        finish(leader);
+        return LEADER_DONE;
+    }
+    leader->current = next;
+    leader->deadline_ms = now_ms + LEADER_TIMEOUT_MS;
+    return LEADER_NEXT;
+}
+
+
+const uint8_t *leader_tick(leader_t *leader, uint32_t now_ms) {
+    if (!leader_active(leader) || !deadline_passed(now_ms, leader->deadline_ms)) {
+        return NULL;
+    }
+    const uint8_t *macro = leader->nodes[leader->current].macro;
+    finish(leader);
+    return macro;
+}
+
+
+void leader_cancel(leader_t *leader) {
+    finish(leader);
+}
@@ -0,0 +1,149 @@
+#include <string.h>
+#include "mouse_keys.h"
+
+#define MOUSE_KEYS_ONE          (1 << 16)       // one count in Q16.16
+#define MOUSE_KEYS_REPORT_MAX   127
+
+
+/*********** Fixed point ***********/
+
+static uint32_t curve_speed(const mouse_keys_curve_t *curve, uint32_t held_us) {
+    if (curve->point_num == 0) {
+        return 0;
+    }
+    const mouse_keys_point_t *p = curve->points;
+    uint32_t t_ms = held_us / 1000;
+    if (t_ms <= p[0].time_ms) {
+        return p[0].speed;
+    }
+    for (uint32_t i = 1; i < curve->point_num; i++) {
+        if (t_ms < p[i].time_ms) {
+            uint32_t span = p[i].time_ms - p[i - 1].time_ms;
+            int32_t rise = (int32_t)p[i].speed - (int32_t)p[i - 1].speed;
+            return p[i - 1].speed + rise * (int32_t)(t_ms - p[i - 1].time_ms) / (int32_t)span;
+        }
+    }
+    return p[curve->point_num - 1].speed;
+}
+
+
+// Q16.16 counts moved in one tick at the speed of the curve
+static int32_t curve_step(const mouse_keys_t *mk, const mouse_keys_curve_t *curve, uint32_t held_us) {
+    uint64_t step = (uint64_t)curve_speed(curve, held_us) * mk->tick_us * MOUSE_KEYS_ONE / 1000000;
+    return (int32_t)step;
+}
+
+
+static int32_t clamp_acc(int32_t acc) {
+    const int32_t limit = MOUSE_KEYS_ACC_LIMIT * MOUSE_KEYS_ONE;
+    return acc > limit ? limit : (acc < -limit ? -limit : acc);
+}
+
+
+// Whole counts of acc, towards zero, at most a report's worth
+static int8_t take_counts(int32_t *acc) {
+    int32_t counts = *acc / MOUSE_KEYS_ONE;
+    if (counts > MOUSE_KEYS_REPORT_MAX) {
+        counts = MOUSE_KEYS_REPORT_MAX;
+    } else if (counts < -MOUSE_KEYS_REPORT_MAX) {
+        counts = -MOUSE_KEYS_REPORT_MAX;
+    }
+    *acc -= counts * MOUSE_KEYS_ONE;
+    return counts;
+}
+
+
+static int held_dir(uint32_t held, mouse_key_t negative, mouse_key_t positive) {
+    return ((held & MOUSE_KEY_BIT(positive)) ? 1 : 0) - ((held & MOUSE_KEY_BIT(negative)) ? 1 : 0);
+}
+
+
+// The acceleration of a group runs from its first key until all of them are up
+static void group_update(mouse_keys_group_t *group, bool active) {
+    if (!active) {
+        group->held_us = 0;
+    }
+    group->active = active;
+}
+
+
+/*********** API ***********/
+
+void mouse_keys_init(mouse_keys_t *mk, const mouse_keys_curve_t *move_curve, const mouse_keys_curve_t *wheel_curve,
+                     uint32_t tick_us) {
+    memset(mk, 0, sizeof(mouse_keys_t));
+    mk->move_curve = *move_curve;
+    mk->wheel_curve = *wheel_curve;
+    if (mk->move_curve.point_num > MOUSE_KEYS_MAX_POINTS) {
+        mk->move_curve.point_num = MOUSE_KEYS_MAX_POINTS;
+    }
+    if (mk->wheel_curve.point_num > MOUSE_KEYS_MAX_POINTS) {
+        mk->wheel_curve.point_num = MOUSE_KEYS_MAX_POINTS;
+    }
+    mk->tick_us = tick_us;
+}
+
+
+void mouse_keys_set(mouse_keys_t *mk, uint32_t held) {
+    // Every direction pressed moves one count at once, so a tap always moves
+    uint32_t pressed = held & ~mk->held;
+    mk->held = held;
+    mk->buttons = ((held & MOUSE_KEY_BIT(MOUSE_KEY_BUTTON_1)) ? 0x01 : 0)
+                  | ((held & MOUSE_KEY_BIT(MOUSE_KEY_BUTTON_2)) ? 0x02 : 0)
+                  | ((held & MOUSE_KEY_BIT(MOUSE_KEY_BUTTON_3)) ? 0x04 : 0);
+
+    mk->acc_x = clamp_acc(mk->acc_x + held_dir(pressed, MOUSE_KEY_LEFT, MOUSE_KEY_RIGHT) * MOUSE_KEYS_ONE);
+    mk->acc_y = clamp_acc(mk->acc_y + held_dir(pressed, MOUSE_KEY_UP, MOUSE_KEY_DOWN) * MOUSE_KEYS_ONE);
+    mk->acc_wheel = clamp_acc(mk->acc_wheel + held_dir(pressed, MOUSE_KEY_WHEEL_DOWN, MOUSE_KEY_WHEEL_UP) * MOUSE_KEYS_ONE);
+
+    group_update(&mk->move, held_dir(held, MOUSE_KEY_LEFT, MOUSE_KEY_RIGHT) || held_dir(held, MOUSE_KEY_UP, MOUSE_KEY_DOWN));
+    group_update(&mk->wheel, held_dir(held, MOUSE_KEY_WHEEL_DOWN, MOUSE_KEY_WHEEL_UP));
+    // A fraction left over from the last stroke would nudge the next one
+    if (!mk->move.active) {
+        mk->acc_x -= mk->acc_x % MOUSE_KEYS_ONE;
+        mk->acc_y -= mk->acc_y % MOUSE_KEYS_ONE;
+    }
+    if (!mk->wheel.active) {
+        mk->acc_wheel -= mk->acc_wheel % MOUSE_KEYS_ONE;
+    }
+}
+
+
+void mouse_keys_tick(mouse_keys_t *mk) {
+    if (mk->move.active) {
+        int dx = held_dir(mk->held, MOUSE_KEY_LEFT, MOUSE_KEY_RIGHT);
+        int dy = held_dir(mk->held, MOUSE_KEY_UP, MOUSE_KEY_DOWN);
+        int32_t step = curve_step(mk, &mk->move_curve, mk->move.held_us);
+        if (dx && dy) {
+            step = step * MOUSE_KEYS_DIAGONAL_Q8 / 256;
+        }
+        mk->acc_x = clamp_acc(mk->acc_x + dx * step);
+        mk->acc_y = clamp_acc(mk->acc_y + dy * step);
+        mk->move.held_us += mk->tick_us;
+    }
+    if (mk->wheel.active) {
+        int dw = held_dir(mk->held, MOUSE_KEY_WHEEL_DOWN, MOUSE_KEY_WHEEL_UP);
+        mk->acc_wheel = clamp_acc(mk->acc_wheel + dw * curve_step(mk, &mk->wheel_curve, mk->wheel.held_us));
+        mk->wheel.held_us += mk->tick_us;
+    }
+}
+
+
+bool mouse_keys_take(mouse_keys_t *mk, mouse_keys_report_t *report) {
+    report->buttons = mk->buttons;
+    report->x = take_counts(&mk->acc_x);
+    report->y = take_counts(&mk->acc_y);
+    report->wheel = take_counts(&mk->acc_wheel);
+    if (report->x == 0 && report->y == 0 && report->wheel == 0 && mk->buttons == mk->sent_buttons) {
+        return false;
+    }
+    mk->sent_buttons = mk->buttons;
+    return true;
+}
+
+
+bool mouse_keys_busy(const mouse_keys_t *mk) {
+    return mk->held != 0 || mk->buttons != mk->sent_buttons
+           || mk->acc_x / MOUSE_KEYS_ONE != 0 || mk->acc_y / MOUSE_KEYS_ONE != 0
+           || mk->acc_wheel / MOUSE_KEYS_ONE != 0;
+}
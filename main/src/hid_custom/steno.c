@@ -0,0 +1,109 @@
+#include <string.h>
+#include "steno.h"
+
+#define GEMINI_KEYS_PER_BYTE    7
+#define GEMINI_FIRST_BYTE       0x80
+#define TXBOLT_GROUP_BITS       6
+#define TXBOLT_GROUPS           4
+
+_Static_assert(STENO_KEY_NUM - 1 == STENO_GEMINI_LEN * GEMINI_KEYS_PER_BYTE, "one GeminiPR bit per key");
+
+
+// Group and bit of the key, plus one so the keys TX Bolt does not have stay 0
+#define TXBOLT(group, bit)      ((group) * TXBOLT_GROUP_BITS + (bit) + 1)
+
+static const uint8_t txbolt_bits[STENO_KEY_NUM] = {
+    [STENO_KEY_S1] = TXBOLT(0, 0), [STENO_KEY_S2] = TXBOLT(0, 0),
+    [STENO_KEY_TL] = TXBOLT(0, 1), [STENO_KEY_KL] = TXBOLT(0, 2), [STENO_KEY_PL] = TXBOLT(0, 3),
+    [STENO_KEY_WL] = TXBOLT(0, 4), [STENO_KEY_HL] = TXBOLT(0, 5),
+
+    [STENO_KEY_RL] = TXBOLT(1, 0), [STENO_KEY_A] = TXBOLT(1, 1), [STENO_KEY_O] = TXBOLT(1, 2),
+    [STENO_KEY_ST1] = TXBOLT(1, 3), [STENO_KEY_ST2] = TXBOLT(1, 3),
+    [STENO_KEY_ST3] = TXBOLT(1, 3), [STENO_KEY_ST4] = TXBOLT(1, 3),
+    [STENO_KEY_E] = TXBOLT(1, 4), [STENO_KEY_U] = TXBOLT(1, 5),
+
+    [STENO_KEY_FR] = TXBOLT(2, 0), [STENO_KEY_RR] = TXBOLT(2, 1), [STENO_KEY_PR] = TXBOLT(2, 2),
+    [STENO_KEY_BR] = TXBOLT(2, 3), [STENO_KEY_LR] = TXBOLT(2, 4), [STENO_KEY_GR] = TXBOLT(2, 5),
+
+    [STENO_KEY_TR] = TXBOLT(3, 0), [STENO_KEY_SR] = TXBOLT(3, 1), [STENO_KEY_DR] = TXBOLT(3, 2),
+    [STENO_KEY_ZR] = TXBOLT(3, 3),
+    [STENO_KEY_N1] = TXBOLT(3, 4), [STENO_KEY_N2] = TXBOLT(3, 4), [STENO_KEY_N3] = TXBOLT(3, 4),
+    [STENO_KEY_N4] = TXBOLT(3, 4), [STENO_KEY_N5] = TXBOLT(3, 4), [STENO_KEY_N6] = TXBOLT(3, 4),
+    [STENO_KEY_N7] = TXBOLT(3, 4), [STENO_KEY_N8] = TXBOLT(3, 4), [STENO_KEY_N9] = TXBOLT(3, 4),
+    [STENO_KEY_NA] = TXBOLT(3, 4), [STENO_KEY_NB] = TXBOLT(3, 4), [STENO_KEY_NC] = TXBOLT(3, 4),
+};
+
+
+static size_t pack_gemini(uint64_t stroke, uint8_t *packet) {
+    memset(packet, 0, STENO_GEMINI_LEN);
+    packet[0] = GEMINI_FIRST_BYTE;
+    while (stroke) {
+        int key = __builtin_ctzll(stroke);
+        stroke &= stroke - 1;
+        int index = key - STENO_KEY_FN;
+        packet[index / GEMINI_KEYS_PER_BYTE] |= 0x40 >> (index % GEMINI_KEYS_PER_BYTE);
+    }
+    return STENO_GEMINI_LEN;
+}
+
+
+/**
+ * @brief   One byte per group with keys, the group number in the top two bits
+ * @note    The host ends a stroke at a group that does not follow the previous one or at the last group, a stroke
+ *          without the last group is closed by an empty byte of group 0
+ * **/
+static size_t pack_txbolt(uint64_t stroke, uint8_t *packet) {
+    uint8_t groups[TXBOLT_GROUPS] = {0};
+    while (stroke) {
+        int key = __builtin_ctzll(stroke);
+        stroke &= stroke - 1;
+        if (txbolt_bits[key]) {
+            uint8_t bit = txbolt_bits[key] - 1;
+            groups[bit / TXBOLT_GROUP_BITS] |= 1 << (bit % TXBOLT_GROUP_BITS);
+        }
+    }
+
+    size_t len = 0;
+    for (int group = 0; group < TXBOLT_GROUPS; group++) {
+        if (groups[group]) {
+            packet[len++] = (group << TXBOLT_GROUP_BITS) | groups[group];
+        }
+    }
+    if (len > 0 && !groups[TXBOLT_GROUPS - 1]) {
+        packet[len++] = 0;
+    }
+    return len;
+}
+
+
+void steno_init(steno_t *steno) {
+    memset(steno, 0, sizeof(steno_t));
+}
+
+
+bool steno_set(steno_t *steno, uint64_t held, uint64_t *stroke) {
+    held &= ~STENO_KEY_BIT(STENO_KEY_NONE);
+    steno->chord |= held;
+    if (held != 0 || steno->chord == 0) {
+        return false;
+    }
+    *stroke = steno->chord;
+    steno->chord = 0;
+    return true;
+}
+
+
+size_t steno_pack(uint64_t stroke, steno_protocol_t protocol, uint8_t *packet) {
+    stroke &= STENO_KEY_BIT(STENO_KEY_NUM) - 1 - STENO_KEY_BIT(STENO_KEY_NONE);
+    if (stroke == 0) {
+        return 0;
+    }
+    switch (protocol) {
+    case STENO_PROTOCOL_GEMINI:
+        return pack_gemini(stroke, packet);
+    case STENO_PROTOCOL_TXBOLT:
+        return pack_txbolt(stroke, packet);
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,39 @@
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "steno_store.h"
+
+static const char *TAG = "steno_store";
+
+
+esp_err_t save_steno_protocol_to_nvs(steno_protocol_t protocol) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_u8(nvs_handle, STENO_STORE_NVS_KEY, protocol);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "Saved steno protocol %d: %s", protocol, esp_err_to_name(err));
+    return err;
+}
+
+
+steno_protocol_t load_steno_protocol_from_nvs(void) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return STENO_PROTOCOL_NONE;
+    }
+
+    uint8_t protocol = STENO_PROTOCOL_NONE;
+    esp_err_t err = nvs_get_u8(nvs_handle, STENO_STORE_NVS_KEY, &protocol);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK || protocol > STENO_PROTOCOL_TXBOLT) {
+        return STENO_PROTOCOL_NONE;
+    }
+    return protocol;
+}
@@ -0,0 +1,326 @@
+#include <string.h>
+#include "tap_hold.h"
+
+#define TAP_HOLD_NO_TIMER   TAP_HOLD_MAX_KEYS
+
+_Static_assert((TAP_HOLD_WHEEL_SLOTS & (TAP_HOLD_WHEEL_SLOTS - 1)) == 0, "TAP_HOLD_WHEEL_SLOTS must be a power of two");
+_Static_assert(TAP_HOLD_MAX_KEYS < 128, "key_index and pending are int8_t");
+_Static_assert(TAP_HOLD_POS_NUM <= 256, "event positions are uint8_t");
+
+
+typedef enum {
+    TAP_HOLD_STATE_UP = 0,
+    TAP_HOLD_STATE_PENDING,
+    TAP_HOLD_STATE_TAP,         // down, its position is in the output
+    TAP_HOLD_STATE_HOLD,        // down, its modifier or layer is in the output
+} tap_hold_state_t;
+
+
+static inline uint8_t key_pos(uint8_t output_index, uint8_t input_index) {
+    return output_index * KEYMAP_INPUT_NUM + input_index;
+}
+
+
+// Wrap-safe tick >= deadline
+static inline bool tick_reached(uint32_t tick, uint32_t deadline) {
+    return (int32_t)(tick - deadline) >= 0;
+}
+
+
+/*********** Timer wheel ***********/
+
+static void timer_disarm(tap_hold_t *th, uint8_t idx) {
+    tap_hold_timer_t *timer = &th->timers[idx];
+    if (!timer->armed) {
+        return;
+    }
+    uint8_t *link = &th->wheel[timer->deadline & (TAP_HOLD_WHEEL_SLOTS - 1)];
+    while (*link != idx) {
+        link = &th->timers[*link].next;
+    }
+    *link = timer->next;
+    timer->armed = false;
+}
+
+
+static void timer_arm(tap_hold_t *th, uint8_t idx, uint32_t deadline) {
+    timer_disarm(th, idx);
+    tap_hold_timer_t *timer = &th->timers[idx];
+    uint8_t *slot = &th->wheel[deadline & (TAP_HOLD_WHEEL_SLOTS - 1)];
+    timer->armed = true;
+    timer->deadline = deadline;
+    timer->next = *slot;
+    *slot = idx;
+}
+
+
+/**
+ * @brief   Unlink the timers due on this tick
+ * @return  true when the timer of the pending key was one of them
+ * @note    A slot also holds timers of later rounds, at most TAP_HOLD_MAX_KEYS entries are walked per tick
+ * **/
+static bool timer_expire(tap_hold_t *th) {
+    bool pending_due = false;
+    uint8_t *link = &th->wheel[th->tick & (TAP_HOLD_WHEEL_SLOTS - 1)];
+    while (*link != TAP_HOLD_NO_TIMER) {
+        tap_hold_timer_t *timer = &th->timers[*link];
+        if (timer->deadline == th->tick) {
+            pending_due |= (*link == th->pending);
+            timer->armed = false;
+            *link = timer->next;
+        } else {
+            link = &timer->next;
+        }
+    }
+    return pending_due;
+}
+
+
+/*********** Output ***********/
+
+static void emit(tap_hold_t *th, int change) {
+    const tap_hold_output_t output = {
+        .report = {
+            .key_change_num = change,
+            .key_pressed_num = th->out_num,
+            .key_release_num = change < 0 ? 1 : 0,
+            .key_data = th->out,
+            .key_release_data = &th->released,
+        },
+        .hold_modifier = th->hold_modifier,
+        .layer_mask = th->layer_mask,
+    };
+    th->emit(&output, th->user_data);
+}
+
+
+static void out_add(tap_hold_t *th, uint8_t pos) {
+    th->out[th->out_num].output_index = pos / KEYMAP_INPUT_NUM;
+    th->out[th->out_num].input_index = pos % KEYMAP_INPUT_NUM;
+    th->out_num++;
+    emit(th, 1);
+}
+
+
+static void out_remove(tap_hold_t *th, uint8_t pos) {
+    for (uint32_t i = 0; i < th->out_num; i++) {
+        if (key_pos(th->out[i].output_index, th->out[i].input_index) == pos) {
+            th->released = th->out[i];
+            memmove(&th->out[i], &th->out[i + 1], (th->out_num - i - 1) * sizeof(keyboard_btn_data_t));
+            th->out_num--;
+            emit(th, -1);
+            return;
+        }
+    }
+}
+
+
+static void update_holds(tap_hold_t *th) {
+    th->hold_modifier = 0;
+    th->layer_mask = 0;
+    for (uint32_t i = 0; i < th->key_num; i++) {
+        if (th->state[i] != TAP_HOLD_STATE_HOLD) {
+            continue;
+        }
+        if (th->keys[i].kind == TAP_HOLD_MOD_TAP) {
+            th->hold_modifier |= th->keys[i].hold;
+        } else {
+            th->layer_mask |= 1 << (th->keys[i].hold & 7);
+        }
+    }
+}
+
+
+/*********** Decisions ***********/
+
+static void decide(tap_hold_t *th, bool hold) {
+    uint8_t idx = th->pending;
+    const tap_hold_key_t *key = &th->keys[idx];
+    timer_disarm(th, idx);
+    th->pending = -1;
+    th->scanned = 0;
+    if (hold) {
+        th->state[idx] = TAP_HOLD_STATE_HOLD;
+        update_holds(th);
+        // A modifier is a new key for the host, a layer only changes how later keys are looked up
+        emit(th, key->kind == TAP_HOLD_MOD_TAP ? 1 : 0);
+    } else {
+        th->state[idx] = TAP_HOLD_STATE_TAP;
+        out_add(th, key_pos(key->output_index, key->input_index));
+    }
+}
+
+
+// Apply one event while no decision is open
+static void process(tap_hold_t *th, const tap_hold_event_t *event) {
+    int8_t idx = th->key_index[event->pos];
+    if (event->pressed) {
+        if (idx >= 0) {
+            th->state[idx] = TAP_HOLD_STATE_PENDING;
+            th->pending = idx;
+            th->pending_deadline = event->tick + th->term_ticks[idx];
+            return;
+        }
+        out_add(th, event->pos);
+        return;
+    }
+
+    if (idx >= 0) {
+        tap_hold_state_t state = th->state[idx];
+        th->state[idx] = TAP_HOLD_STATE_UP;
+        if (state == TAP_HOLD_STATE_HOLD) {
+            update_holds(th);
+            th->released.output_index = th->keys[idx].output_index;
+            th->released.input_index = th->keys[idx].input_index;
+            emit(th, -1);
+            return;
+        }
+    }
+    out_remove(th, event->pos);
+}
+
+
+// Whether pos was pressed after the pending key, i.e. its press is among the held back events
+static bool pressed_after_pending(const tap_hold_t *th, uint8_t pos) {
+    for (uint32_t i = 0; i < th->scanned; i++) {
+        if (th->events[i].pos == pos && th->events[i].pressed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * @brief   Decide the pending key from the held back events, then apply them in order
+ * @note    Deciding replays the held back events from the start, a tap-hold key among them becomes the next
+ *          pending key and is checked against the events after it.
+ * **/
+static void drain(tap_hold_t *th) {
+    while (1) {
+        if (th->pending < 0) {
+            if (th->event_num == 0) {
+                return;
+            }
+            tap_hold_event_t event = th->events[0];
+            th->event_num--;
+            memmove(&th->events[0], &th->events[1], th->event_num * sizeof(tap_hold_event_t));
+            process(th, &event);
+            continue;
+        }
+
+        if (th->scanned == th->event_num) {
+            // A replayed key can be past its term already, its timer fired while it was held back
+            if (!tick_reached(th->tick, th->pending_deadline)) {
+                return;
+            }
+            decide(th, true);
+            continue;
+        }
+
+        const tap_hold_event_t *event = &th->events[th->scanned];
+        const tap_hold_key_t *key = &th->keys[th->pending];
+        if (tick_reached(event->tick, th->pending_deadline)) {
+            decide(th, true);
+        } else if (event->pos == key_pos(key->output_index, key->input_index)) {
+            decide(th, false);      // released inside the term
+        } else if (event->pressed && (key->flags & TAP_HOLD_HOLD_ON_OTHER_KEY_PRESS)) {
+            decide(th, true);
+        } else if (!event->pressed && (key->flags & TAP_HOLD_PERMISSIVE_HOLD)
+                   && pressed_after_pending(th, event->pos)) {
+            decide(th, true);
+        } else {
+            th->scanned++;
+        }
+    }
+}
+
+
+static void push(tap_hold_t *th, uint8_t pos, bool pressed) {
+    while (th->event_num == TAP_HOLD_MAX_EVENTS) {
+        // Out of room, a decision that waits this long is a hold
+        decide(th, true);
+        drain(th);
+    }
+    th->events[th->event_num++] = (tap_hold_event_t) {
+        .pos = pos,
+        .pressed = pressed,
+        .tick = th->tick,
+    };
+}
+
+
+/*********** API ***********/
+
+void tap_hold_init(tap_hold_t *th, const tap_hold_key_t *keys, uint32_t key_num, uint32_t tick_us,
+                   tap_hold_emit_t emit, void *user_data) {
+    memset(th, 0, sizeof(tap_hold_t));
+    memset(th->key_index, -1, sizeof(th->key_index));
+    memset(th->wheel, TAP_HOLD_NO_TIMER, sizeof(th->wheel));
+    if (tick_us == 0) {
+        tick_us = 1;
+    }
+    th->keys = keys;
+    th->key_num = key_num < TAP_HOLD_MAX_KEYS ? key_num : TAP_HOLD_MAX_KEYS;
+    for (uint32_t i = 0; i < th->key_num; i++) {
+        if (keys[i].output_index >= KEYMAP_OUTPUT_NUM || keys[i].input_index >= KEYMAP_INPUT_NUM) {
+            continue;
+        }
+        uint32_t term_us = (keys[i].tapping_term_ms ? keys[i].tapping_term_ms : TAP_HOLD_TAPPING_TERM_MS) * 1000;
+        th->term_ticks[i] = (term_us + tick_us - 1) / tick_us;
+        th->timers[i].next = TAP_HOLD_NO_TIMER;
+        th->key_index[key_pos(keys[i].output_index, keys[i].input_index)] = i;
+    }
+    th->pending = -1;
+    th->emit = emit;
+    th->user_data = user_data;
+}
+
+
+void tap_hold_tick(tap_hold_t *th, const keyboard_btn_report_t *report) {
+    th->tick++;
+
+    // Only the edges matter, an unchanged tick only advances the wheel
+    for (uint32_t i = 0; i < report->key_release_num; i++) {
+        const keyboard_btn_data_t *key = &report->key_release_data[i];
+        if (key->output_index >= KEYMAP_OUTPUT_NUM || key->input_index >= KEYMAP_INPUT_NUM) {
+            continue;
+        }
+        uint8_t pos = key_pos(key->output_index, key->input_index);
+        if (!th->down[pos]) {
+            continue;
+        }
+        th->down[pos] = false;
+        if (th->key_index[pos] >= 0) {
+            timer_disarm(th, th->key_index[pos]);
+        }
+        push(th, pos, false);
+    }
+    for (uint32_t i = 0; i < report->key_pressed_num; i++) {
+        const keyboard_btn_data_t *key = &report->key_data[i];
+        if (key->output_index >= KEYMAP_OUTPUT_NUM || key->input_index >= KEYMAP_INPUT_NUM) {
+            continue;
+        }
+        uint8_t pos = key_pos(key->output_index, key->input_index);
+        if (th->down[pos]) {
+            continue;
+        }
+        th->down[pos] = true;
+        int8_t idx = th->key_index[pos];
+        if (idx >= 0) {
+            timer_arm(th, idx, th->tick + th->term_ticks[idx]);
+        }
+        push(th, pos, true);
+    }
+    drain(th);
+
+    if (timer_expire(th)) {
+        decide(th, true);
+        drain(th);
+    }
+}
+
+
+bool tap_hold_pending(const tap_hold_t *th) {
+    return th->pending >= 0;
+}
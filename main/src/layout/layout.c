@@ -0,0 +1,40 @@
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "layout.h"
+
+static const char *TAG = "layout";
+
+static const layout_image_t *s_layout = &layout_default;
+
+
+void layout_init(void) {
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                (esp_partition_subtype_t)LAYOUT_PARTITION_SUBTYPE,
+                                                                LAYOUT_PARTITION_LABEL);
+    if (partition == NULL || partition->size < sizeof(layout_image_t)) {
+        ESP_LOGW(TAG, "No layout partition, built-in layout");
+        return;
+    }
+
+    const void *image;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, sizeof(layout_image_t), ESP_PARTITION_MMAP_DATA, &image, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Mapping the layout partition failed: %s, built-in layout", esp_err_to_name(err));
+        return;
+    }
+    if (!layout_image_check(image, sizeof(layout_image_t))) {
+        ESP_LOGW(TAG, "Layout partition holds no version %d image, built-in layout", LAYOUT_IMAGE_VERSION);
+        esp_partition_munmap(handle);
+        return;
+    }
+    // Never unmapped, the tables are read through the cache for the whole run
+    s_layout = image;
+    ESP_LOGI(TAG, "Layout mapped from 0x%lx", partition->address);
+}
+
+
+const layout_image_t *layout_get(void) {
+    return s_layout;
+}
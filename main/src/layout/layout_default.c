@@ -0,0 +1,125 @@
+#include "tinyusb.h"
+#include "hid_dev.h"
+#include "layout_image.h"
+#include "macro.h"
+
+#define LAMP_KEY(r, c)  {.row = (r), .col = (c)}
+
+#define LEADER(macro_, ...)                                             \
+    {                                                                   \
+        .key_num = sizeof((const uint8_t[]) {__VA_ARGS__}),             \
+        .keys = {__VA_ARGS__},                                          \
+        .macro = {macro_},                                              \
+    }
+
+#define MACRO_GIT_PUSH                                                                                      \
+    MACRO_TAP(HID_KEY_G), MACRO_TAP(HID_KEY_I), MACRO_TAP(HID_KEY_T), MACRO_TAP(HID_KEY_SPACE),             \
+    MACRO_TAP(HID_KEY_P), MACRO_TAP(HID_KEY_U), MACRO_TAP(HID_KEY_S), MACRO_TAP(HID_KEY_H),                 \
+    MACRO_END()
+
+#define MACRO_GIT_STATUS                                                                                    \
+    MACRO_TAP(HID_KEY_G), MACRO_TAP(HID_KEY_I), MACRO_TAP(HID_KEY_T), MACRO_TAP(HID_KEY_SPACE),             \
+    MACRO_TAP(HID_KEY_S), MACRO_TAP(HID_KEY_T), MACRO_TAP(HID_KEY_A), MACRO_TAP(HID_KEY_T), MACRO_TAP(HID_KEY_U), \
+    MACRO_TAP(HID_KEY_S),                                                                                   \
+    MACRO_END()
+
+
+// make function key at the bottom of F8 line (Current: HID_KEY_GUI_RIGHT)
+#define LAYER_BASE(left_gui) { \
+        {HID_KEY_ESCAPE,                HID_KEY_NONE,               HID_KEY_F1,                 HID_KEY_F2,     HID_KEY_F3,     HID_KEY_F4,      HID_KEY_F5,    HID_KEY_F6,     HID_KEY_F7,     HID_KEY_F8,                 HID_KEY_F9,                         HID_KEY_F10,            HID_KEY_F11,            HID_KEY_F12,                    HID_KEY_PRINT_SCREEN,   HID_KEY_SCROLL_LOCK,    HID_KEY_PAUSE}, \
+        {HID_KEY_GRAVE,                 HID_KEY_1,                  HID_KEY_2,                  HID_KEY_3,      HID_KEY_4,      HID_KEY_5,       HID_KEY_6,     HID_KEY_7,      HID_KEY_8,      HID_KEY_9,                  HID_KEY_0,                          HID_KEY_MINUS,          HID_KEY_EQUAL,          HID_KEY_BACKSPACE,              HID_KEY_INSERT,         HID_KEY_HOME,           HID_KEY_PAGE_UP}, \
+        {HID_KEY_TAB,                   HID_KEY_Q,                  HID_KEY_W,                  HID_KEY_E,      HID_KEY_R,      HID_KEY_T,       HID_KEY_Y,     HID_KEY_U,      HID_KEY_I,      HID_KEY_O,                  HID_KEY_P,                          HID_KEY_BRACKET_LEFT,   HID_KEY_BRACKET_RIGHT,  HID_KEY_BACKSLASH,              HID_KEY_DELETE,         HID_KEY_END,            HID_KEY_PAGE_DOWN}, \
+        {HID_KEY_CAPS_LOCK,             HID_KEY_A,                  HID_KEY_S,                  HID_KEY_D,      HID_KEY_F,      HID_KEY_G,       HID_KEY_H,     HID_KEY_J,      HID_KEY_K,      HID_KEY_L,                  HID_KEY_SEMICOLON,                  HID_KEY_APOSTROPHE,     HID_KEY_NONE,           HID_KEY_ENTER,                  HID_KEY_NONE,           HID_KEY_NONE,           HID_KEY_NONE}, \
+        {KEYBOARD_MODIFIER_LEFTSHIFT,   HID_KEY_Z,                  HID_KEY_X,                  HID_KEY_C,      HID_KEY_V,      HID_KEY_B,       HID_KEY_N,     HID_KEY_M,      HID_KEY_COMMA,  HID_KEY_PERIOD,             HID_KEY_SLASH,                      HID_KEY_NONE,           HID_KEY_NONE,           KEYBOARD_MODIFIER_RIGHTSHIFT,   HID_KEY_NONE,           HID_KEY_ARROW_UP,       HID_KEY_NONE}, \
+        {KEYBOARD_MODIFIER_LEFTCTRL,    (left_gui),                 KEYBOARD_MODIFIER_LEFTALT,  HID_KEY_NONE,   HID_KEY_NONE,   HID_KEY_NONE,    HID_KEY_SPACE, HID_KEY_NONE,   HID_KEY_NONE,   HID_KEY_NONE,               KEYBOARD_MODIFIER_RIGHTALT,         HID_KEY_NONE,    HID_KEY_APPLICATION,           KEYBOARD_MODIFIER_RIGHTCTRL,    HID_KEY_ARROW_LEFT,     HID_KEY_ARROW_DOWN,     HID_KEY_ARROW_RIGHT} \
+    }
+
+#define LAYER_FN { \
+        {HID_KEY_ESCAPE,                HID_KEY_NONE,               HID_USAGE_CONSUMER_BRIGHTNESS_DECREMENT,    HID_USAGE_CONSUMER_BRIGHTNESS_INCREMENT,    HID_KEY_F3,     HID_KEY_F4,     HID_KEY_F5,     HID_KEY_F6,     HID_USAGE_CONSUMER_SCAN_PREVIOUS,   HID_CONSUMER_PAUSE,         HID_USAGE_CONSUMER_SCAN_NEXT,   HID_USAGE_CONSUMER_MUTE,    HID_USAGE_CONSUMER_VOLUME_DECREMENT,    HID_USAGE_CONSUMER_VOLUME_INCREMENT,    HID_KEY_PRINT_SCREEN,   HID_KEY_SCROLL_LOCK,    HID_KEY_PAUSE}, \
+        {HID_KEY_GRAVE,                 HID_KEY_1,                  HID_KEY_2,                                  HID_KEY_3,                                  HID_KEY_4,      HID_KEY_5,      HID_KEY_6,      HID_KEY_7,      HID_KEY_8,                          HID_KEY_9,                  HID_KEY_0,                      HID_KEY_MINUS,              HID_KEY_EQUAL,                          HID_KEY_BACKSPACE,                      HID_KEY_INSERT,         HID_KEY_HOME,           HID_KEY_PAGE_UP}, \
+        {HID_KEY_TAB,                   HID_KEY_Q,                  HID_KEY_W,                                  HID_KEY_E,                                  HID_KEY_R,      HID_KEY_T,      HID_KEY_Y,      HID_KEY_U,      HID_KEY_I,                          HID_KEY_O,                  HID_KEY_P,                      HID_KEY_BRACKET_LEFT,       HID_KEY_BRACKET_RIGHT,                  HID_KEY_BACKSLASH,                      HID_KEY_DELETE,         HID_KEY_END,            HID_KEY_PAGE_DOWN}, \
+        {HID_KEY_CAPS_LOCK,             HID_KEY_A,                  HID_KEY_S,                                  HID_KEY_D,                                  HID_KEY_F,      HID_KEY_G,      HID_KEY_H,      HID_KEY_J,      HID_KEY_K,                          HID_KEY_L,                  HID_KEY_SEMICOLON,              HID_KEY_APOSTROPHE,         HID_KEY_NONE,                           HID_KEY_ENTER,                          HID_KEY_NONE,           HID_KEY_NONE,           HID_KEY_NONE}, \
+        {KEYBOARD_MODIFIER_LEFTSHIFT,   HID_KEY_Z,                  HID_KEY_X,                                  HID_KEY_C,                                  HID_KEY_V,      HID_KEY_B,      HID_KEY_N,      HID_KEY_M,      HID_KEY_COMMA,                      HID_KEY_PERIOD,             HID_KEY_SLASH,                  HID_KEY_NONE,               HID_KEY_NONE,                           KEYBOARD_MODIFIER_RIGHTSHIFT,           HID_KEY_NONE,           HID_KEY_ARROW_UP,       HID_KEY_NONE}, \
+        {KEYBOARD_MODIFIER_LEFTCTRL,    KEYBOARD_MODIFIER_LEFTGUI,  KEYBOARD_MODIFIER_LEFTALT,                  HID_KEY_NONE,                               HID_KEY_NONE,   HID_KEY_NONE,   HID_KEY_SPACE,  HID_KEY_NONE,   HID_KEY_NONE,                       HID_KEY_NONE,               KEYBOARD_MODIFIER_RIGHTALT,     HID_KEY_NONE,               HID_KEY_APPLICATION,                    KEYBOARD_MODIFIER_RIGHTCTRL,            HID_KEY_ARROW_LEFT,     HID_KEY_ARROW_DOWN,     HID_KEY_ARROW_RIGHT} \
+    }
+
+// Typed after a tap of Fn, in base layer keycodes
+#define LEADERS_GIT                                                     \
+    {                                                                   \
+        LEADER(MACRO_GIT_PUSH, HID_KEY_G, HID_KEY_P),                   \
+        LEADER(MACRO_GIT_STATUS, HID_KEY_G, HID_KEY_S),                 \
+    }
+
+#define TRANSPORT_ALL(flags)    {(flags), (flags), (flags)}
+
+
+// Source of the layout partition image: the build compiles this file on its own and cuts the section out of the
+// object (see main/CMakeLists.txt). The firmware links it too, as the layout of a blank partition.
+__attribute__((section(".rodata.layout_default")))
+const layout_image_t layout_default = {
+    .header = {
+        .magic = LAYOUT_IMAGE_MAGIC,
+        .version = LAYOUT_IMAGE_VERSION,
+        .header_size = sizeof(layout_header_t),
+        .image_size = sizeof(layout_image_t),
+        .layer_num = KEYMAP_LAYER_NUM,
+        .output_num = KEYMAP_OUTPUT_NUM,
+        .input_num = KEYMAP_INPUT_NUM,
+        .lamp_num = LAYOUT_LAMP_NUM,
+        .profile_num = LAYOUT_PROFILE_NUM,
+    },
+
+    // One lamp per key, in the order of the WS2812 chain
+    .lamps = {
+        LAMP_KEY(0, 0), LAMP_KEY(0, 2), LAMP_KEY(0, 3), LAMP_KEY(0, 4), LAMP_KEY(0, 5), LAMP_KEY(0, 6), LAMP_KEY(0, 7),
+        LAMP_KEY(0, 8), LAMP_KEY(0, 9), LAMP_KEY(0, 10), LAMP_KEY(0, 11), LAMP_KEY(0, 12), LAMP_KEY(0, 13),
+        LAMP_KEY(0, 14), LAMP_KEY(0, 15), LAMP_KEY(0, 16),
+        LAMP_KEY(1, 0), LAMP_KEY(1, 1), LAMP_KEY(1, 2), LAMP_KEY(1, 3), LAMP_KEY(1, 4), LAMP_KEY(1, 5), LAMP_KEY(1, 6),
+        LAMP_KEY(1, 7), LAMP_KEY(1, 8), LAMP_KEY(1, 9), LAMP_KEY(1, 10), LAMP_KEY(1, 11), LAMP_KEY(1, 12),
+        LAMP_KEY(1, 13), LAMP_KEY(1, 14), LAMP_KEY(1, 15), LAMP_KEY(1, 16),
+        LAMP_KEY(2, 0), LAMP_KEY(2, 1), LAMP_KEY(2, 2), LAMP_KEY(2, 3), LAMP_KEY(2, 4), LAMP_KEY(2, 5), LAMP_KEY(2, 6),
+        LAMP_KEY(2, 7), LAMP_KEY(2, 8), LAMP_KEY(2, 9), LAMP_KEY(2, 10), LAMP_KEY(2, 11), LAMP_KEY(2, 12),
+        LAMP_KEY(2, 13), LAMP_KEY(2, 14), LAMP_KEY(2, 15), LAMP_KEY(2, 16),
+        LAMP_KEY(3, 0), LAMP_KEY(3, 1), LAMP_KEY(3, 2), LAMP_KEY(3, 3), LAMP_KEY(3, 4), LAMP_KEY(3, 5), LAMP_KEY(3, 6),
+        LAMP_KEY(3, 7), LAMP_KEY(3, 8), LAMP_KEY(3, 9), LAMP_KEY(3, 10), LAMP_KEY(3, 11), LAMP_KEY(3, 13),
+        LAMP_KEY(4, 0), LAMP_KEY(4, 1), LAMP_KEY(4, 2), LAMP_KEY(4, 3), LAMP_KEY(4, 4), LAMP_KEY(4, 5), LAMP_KEY(4, 6),
+        LAMP_KEY(4, 7), LAMP_KEY(4, 8), LAMP_KEY(4, 9), LAMP_KEY(4, 10), LAMP_KEY(4, 13), LAMP_KEY(4, 15),
+        LAMP_KEY(5, 0), LAMP_KEY(5, 1), LAMP_KEY(5, 2), LAMP_KEY(5, 6), LAMP_KEY(5, 10), LAMP_KEY(5, 12),
+        LAMP_KEY(5, 13), LAMP_KEY(5, 14), LAMP_KEY(5, 15), LAMP_KEY(5, 16),
+    },
+
+    .profiles = {
+        // Fn + F3: typing, the dim white of LAMP_ARRAY_AUTONOMOUS_LEVEL
+        {
+            .keymap.layers = {LAYER_BASE(KEYBOARD_MODIFIER_LEFTGUI), LAYER_FN},
+            .color = {32, 32, 32},
+            .transport_flags = TRANSPORT_ALL(LAYOUT_TRANSPORT_LEADER),
+            .leader_num = 2,
+            .leaders = LEADERS_GIT,
+        },
+        // Fn + F4: games, no GUI key to leave the game by accident and Fn never waits for a sequence
+        {
+            .keymap.layers = {LAYER_BASE(HID_KEY_NONE), LAYER_FN},
+            .color = {48, 0, 0},
+            .transport_flags = TRANSPORT_ALL(0),
+        },
+        // Fn + F5: mouse keys on the arrows as soon as it is active, the ESP-NOW dongle only takes keys
+        {
+            .keymap.layers = {LAYER_BASE(KEYBOARD_MODIFIER_LEFTGUI), LAYER_FN},
+            .color = {0, 0, 48},
+            .transport_flags = {
+                [LAYOUT_TRANSPORT_USB] = LAYOUT_TRANSPORT_LEADER | LAYOUT_TRANSPORT_MOUSE_KEYS,
+                [LAYOUT_TRANSPORT_BLE] = LAYOUT_TRANSPORT_LEADER | LAYOUT_TRANSPORT_MOUSE_KEYS,
+                [LAYOUT_TRANSPORT_WIRELESS] = LAYOUT_TRANSPORT_LEADER,
+            },
+            .leader_num = 2,
+            .leaders = LEADERS_GIT,
+        },
+        // Fn + F6: starts as the typing keys, left for the configuration channel to edit
+        {
+            .keymap.layers = {LAYER_BASE(KEYBOARD_MODIFIER_LEFTGUI), LAYER_FN},
+            .color = {0, 32, 0},
+            .transport_flags = TRANSPORT_ALL(LAYOUT_TRANSPORT_LEADER),
+        },
+    },
+};
@@ -0,0 +1,49 @@
+#include "layout_image.h"
+#include "macro.h"
+
+
+static bool header_check(const layout_header_t *header) {
+    return header->magic == LAYOUT_IMAGE_MAGIC
+           && header->version == LAYOUT_IMAGE_VERSION
+           && header->header_size == sizeof(layout_header_t)
+           && header->image_size == sizeof(layout_image_t)
+           && header->layer_num == KEYMAP_LAYER_NUM
+           && header->output_num == KEYMAP_OUTPUT_NUM
+           && header->input_num == KEYMAP_INPUT_NUM
+           && header->lamp_num == LAYOUT_LAMP_NUM
+           && header->profile_num == LAYOUT_PROFILE_NUM;
+}
+
+
+// The player and the leader trie trust what they are given
+static bool profile_check(const layout_profile_t *profile) {
+    if (profile->leader_num > LAYOUT_LEADER_NUM) {
+        return false;
+    }
+    for (int i = 0; i < profile->leader_num; i++) {
+        const layout_leader_t *leader = &profile->leaders[i];
+        if (leader->key_num == 0 || leader->key_num > LAYOUT_LEADER_KEYS
+            || macro_length(leader->macro, sizeof(leader->macro)) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool layout_image_check(const layout_image_t *image, size_t size) {
+    if (size < sizeof(layout_image_t) || !header_check(&image->header)) {
+        return false;
+    }
+    for (int i = 0; i < LAYOUT_LAMP_NUM; i++) {
+        if (image->lamps[i].row >= KEYMAP_OUTPUT_NUM || image->lamps[i].col >= KEYMAP_INPUT_NUM) {
+            return false;
+        }
+    }
+    for (int i = 0; i < LAYOUT_PROFILE_NUM; i++) {
+        if (!profile_check(&image->profiles[i])) {
+            return false;
+        }
+    }
+    return true;
+}
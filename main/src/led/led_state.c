@@ -0,0 +1,104 @@
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#include "led_state.h"
+#include "change_mode_interrupt.h"
+
+
+typedef struct {
+    uint8_t bit;
+    int gpio;
+} led_indicator_t;
+
+static const led_indicator_t led_indicators[] = {
+    {LED_STATE_NUM_LOCK, LED_STATE_GPIO_NUM_LOCK},
+    {LED_STATE_CAPS_LOCK, LED_STATE_GPIO_CAPS_LOCK},
+    {LED_STATE_SCROLL_LOCK, LED_STATE_GPIO_SCROLL_LOCK},
+};
+
+#define LED_INDICATOR_NUM   (sizeof(led_indicators) / sizeof(led_indicators[0]))
+
+
+static portMUX_TYPE s_led_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_leds[MODE_WIRELESS + 1];     // indexed by connection_mode_t, each host keeps its own lock state
+static uint8_t s_shown = 0;
+static bool s_ready = false;
+
+
+/**
+ * @brief   Drive the pins of the indicators that changed
+ * @note    Must be called inside s_led_lock. gpio_set_level() is a register write, it is fine in a critical section.
+ * **/
+static void show(uint8_t leds) {
+    uint8_t changed = leds ^ s_shown;
+    if (!s_ready || changed == 0) {
+        return;
+    }
+    for (int i = 0; i < LED_INDICATOR_NUM; i++) {
+        if (changed & led_indicators[i].bit) {
+            bool on = leds & led_indicators[i].bit;
+            gpio_set_level(led_indicators[i].gpio, on ? LED_STATE_ACTIVE_LEVEL : !LED_STATE_ACTIVE_LEVEL);
+        }
+    }
+    s_shown = leds;
+}
+
+
+void led_state_init(void) {
+    uint64_t pin_mask = 0;
+    for (int i = 0; i < LED_INDICATOR_NUM; i++) {
+        pin_mask |= BIT64(led_indicators[i].gpio);
+        gpio_set_level(led_indicators[i].gpio, !LED_STATE_ACTIVE_LEVEL);
+    }
+    const gpio_config_t led_config = {
+        .pin_bit_mask = pin_mask,
+        .mode = GPIO_MODE_OUTPUT,
+        .intr_type = GPIO_INTR_DISABLE,
+        .pull_up_en = false,
+        .pull_down_en = false,
+    };
+    ESP_ERROR_CHECK(gpio_config(&led_config));
+
+    taskENTER_CRITICAL(&s_led_lock);
+    s_shown = 0;
+    s_ready = true;
+    taskEXIT_CRITICAL(&s_led_lock);
+}
+
+
+void led_state_set(connection_mode_t source, uint8_t leds) {
+    if (source > MODE_WIRELESS) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_led_lock);
+    s_leds[source] = leds;
+    if (source == current_mode) {
+        show(leds);
+    }
+    taskEXIT_CRITICAL(&s_led_lock);
+}
+
+
+uint8_t led_state_get(void) {
+    connection_mode_t mode = current_mode;
+    return mode <= MODE_WIRELESS ? s_leds[mode] : 0;
+}
+
+
+bool led_state_caps_lock(void) {
+    return led_state_get() & LED_STATE_CAPS_LOCK;
+}
+
+
+void led_state_apply_mode(connection_mode_t mode) {
+    taskENTER_CRITICAL(&s_led_lock);
+    show(mode <= MODE_WIRELESS ? s_leds[mode] : 0);
+    taskEXIT_CRITICAL(&s_led_lock);
+}
+
+
+void led_state_off(void) {
+    taskENTER_CRITICAL(&s_led_lock);
+    show(0);
+    taskEXIT_CRITICAL(&s_led_lock);
+}
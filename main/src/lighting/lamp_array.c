@@ -0,0 +1,428 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "driver/rmt_tx.h"
+
+#include "lamp_array.h"
+#include "descriptors.h"
+#include "hid_custom.h"
+#include "hid_report.h"
+#include "layout.h"
+
+static const char *TAG = "lamp_array";
+
+
+// One lamp per key, which key is in the layout (see layout_image.h). The lamp ID is the index in its lamp table.
+#define LAMP_COUNT      LAYOUT_LAMP_NUM
+#define LAMP_BYTES      3   // GRB on the wire
+
+
+/********* Report layouts, see TUD_HID_REPORT_DESC_LAMP_ARRAY ***************/
+
+typedef struct __attribute__((packed)) {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t intensity;
+} lamp_color_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t lamp_count;
+    uint32_t width_um;
+    uint32_t height_um;
+    uint32_t depth_um;
+    uint32_t kind;
+    uint32_t min_update_interval_us;
+} lamp_array_attributes_report_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t lamp_id;
+} lamp_attributes_request_report_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t lamp_id;
+    int32_t position_x_um;
+    int32_t position_y_um;
+    int32_t position_z_um;
+    int32_t update_latency_us;
+    int32_t lamp_purposes;
+    uint8_t red_level_count;
+    uint8_t green_level_count;
+    uint8_t blue_level_count;
+    uint8_t intensity_level_count;
+    uint8_t is_programmable;
+    uint8_t input_binding;
+} lamp_attributes_response_report_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t lamp_count;
+    uint8_t flags;
+    uint16_t lamp_ids[LAMP_MULTI_UPDATE_LAMP_COUNT];
+    lamp_color_t colors[LAMP_MULTI_UPDATE_LAMP_COUNT];
+} lamp_multi_update_report_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t flags;
+    uint16_t lamp_id_start;
+    uint16_t lamp_id_end;
+    lamp_color_t color;
+} lamp_range_update_report_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t autonomous_mode;
+} lamp_array_control_report_t;
+
+// Feature reports arrive through the control endpoint, into a buffer of CFG_TUD_HID_EP_BUFSIZE with the report ID
+_Static_assert(sizeof(lamp_multi_update_report_t) + 1 <= CFG_TUD_HID_EP_BUFSIZE, "LampMultiUpdateReport too long");
+
+
+/********* State ***************/
+
+static portMUX_TYPE s_lamp_lock = portMUX_INITIALIZER_UNLOCKED;
+static lamp_color_t s_frame[LAMP_COUNT];       // frame the host is building, only published on LAMP_UPDATE_FLAG_COMPLETE
+static lamp_color_t s_published[LAMP_COUNT];   // copy of the last complete frame, the only one the LED task reads
+static bool s_autonomous = true;
+static lamp_color_t s_autonomous_color = {LAMP_ARRAY_AUTONOMOUS_LEVEL, LAMP_ARRAY_AUTONOMOUS_LEVEL,
+                                          LAMP_ARRAY_AUTONOMOUS_LEVEL, 1};
+static uint16_t s_next_lamp_id = 0;
+
+// Ping-pong DMA buffers: the LED task encodes one while RMT still sends the other
+DMA_ATTR static uint8_t s_pixels[2][LAMP_COUNT * LAMP_BYTES];
+static uint8_t s_back = 0;
+
+static TaskHandle_t s_task_handle = NULL;
+static rmt_channel_handle_t s_channel = NULL;
+
+
+/********* WS2812 encoder ***************/
+
+typedef struct {
+    rmt_encoder_t base;
+    rmt_encoder_t *bytes_encoder;
+    rmt_encoder_t *copy_encoder;
+    int state;
+    rmt_symbol_word_t reset_code;
+} lamp_encoder_t;
+
+static lamp_encoder_t s_encoder;
+
+
+// Pixel bytes first, then the low period that latches the chain
+static size_t lamp_encoder_encode(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *data, size_t size,
+                                  rmt_encode_state_t *ret_state) {
+    lamp_encoder_t *lamp_encoder = __containerof(encoder, lamp_encoder_t, base);
+    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+    size_t encoded_symbols = 0;
+
+    if (lamp_encoder->state == 0) {
+        encoded_symbols += lamp_encoder->bytes_encoder->encode(lamp_encoder->bytes_encoder, channel, data, size, &session_state);
+        if (session_state & RMT_ENCODING_COMPLETE) {
+            lamp_encoder->state = 1;
+        }
+        if (session_state & RMT_ENCODING_MEM_FULL) {
+            *ret_state = RMT_ENCODING_MEM_FULL;
+            return encoded_symbols;
+        }
+    }
+    encoded_symbols += lamp_encoder->copy_encoder->encode(lamp_encoder->copy_encoder, channel, &lamp_encoder->reset_code,
+                                                          sizeof(lamp_encoder->reset_code), &session_state);
+    if (session_state & RMT_ENCODING_COMPLETE) {
+        lamp_encoder->state = 0;
+        state |= RMT_ENCODING_COMPLETE;
+    }
+    if (session_state & RMT_ENCODING_MEM_FULL) {
+        state |= RMT_ENCODING_MEM_FULL;
+    }
+    *ret_state = state;
+    return encoded_symbols;
+}
+
+
+static esp_err_t lamp_encoder_reset(rmt_encoder_t *encoder) {
+    lamp_encoder_t *lamp_encoder = __containerof(encoder, lamp_encoder_t, base);
+    rmt_encoder_reset(lamp_encoder->bytes_encoder);
+    rmt_encoder_reset(lamp_encoder->copy_encoder);
+    lamp_encoder->state = 0;
+    return ESP_OK;
+}
+
+
+static esp_err_t lamp_encoder_del(rmt_encoder_t *encoder) {
+    lamp_encoder_t *lamp_encoder = __containerof(encoder, lamp_encoder_t, base);
+    rmt_del_encoder(lamp_encoder->bytes_encoder);
+    rmt_del_encoder(lamp_encoder->copy_encoder);
+    return ESP_OK;
+}
+
+
+static esp_err_t lamp_encoder_init(void) {
+    const uint32_t ticks_per_us = LAMP_ARRAY_RMT_RESOLUTION_HZ / 1000000;
+    const rmt_bytes_encoder_config_t bytes_config = {
+        // T0H 0.3 us, T0L 0.9 us, T1H 0.9 us, T1L 0.3 us
+        .bit0 = {.level0 = 1, .duration0 = 3 * ticks_per_us / 10, .level1 = 0, .duration1 = 9 * ticks_per_us / 10},
+        .bit1 = {.level0 = 1, .duration0 = 9 * ticks_per_us / 10, .level1 = 0, .duration1 = 3 * ticks_per_us / 10},
+        .flags.msb_first = 1,
+    };
+    esp_err_t ret = rmt_new_bytes_encoder(&bytes_config, &s_encoder.bytes_encoder);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const rmt_copy_encoder_config_t copy_config = {};
+    ret = rmt_new_copy_encoder(&copy_config, &s_encoder.copy_encoder);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    uint32_t reset_ticks = ticks_per_us * LAMP_ARRAY_RESET_US / 2;
+    s_encoder.reset_code = (rmt_symbol_word_t) {
+        .level0 = 0, .duration0 = reset_ticks, .level1 = 0, .duration1 = reset_ticks,
+    };
+    s_encoder.base.encode = lamp_encoder_encode;
+    s_encoder.base.reset = lamp_encoder_reset;
+    s_encoder.base.del = lamp_encoder_del;
+    return ESP_OK;
+}
+
+
+/********* Frames ***************/
+
+/**
+ * @brief   Fill the whole frame with one color
+ * @note    Must be called inside s_lamp_lock
+ * **/
+static void frame_fill(lamp_color_t color) {
+    for (int i = 0; i < LAMP_COUNT; i++) {
+        s_frame[i] = color;
+    }
+}
+
+
+/**
+ * @brief   Copy the frame built so far to the one the LED task encodes, updates after it wait for the next one
+ * @note    Must be called inside s_lamp_lock, then frame_publish() outside of it
+ * **/
+static void frame_commit(void) {
+    memcpy(s_published, s_frame, sizeof(s_published));
+}
+
+
+static void frame_publish(void) {
+    if (s_task_handle != NULL) {
+        xTaskNotifyGive(s_task_handle);
+    }
+}
+
+
+static void lamp_array_task(void *arg) {
+    (void) arg;
+    const rmt_transmit_config_t tx_config = {
+        .loop_count = 0,
+    };
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Frames published while we were busy collapse into the latest one
+        uint8_t *pixels = s_pixels[s_back];
+        taskENTER_CRITICAL(&s_lamp_lock);
+        for (int i = 0; i < LAMP_COUNT; i++) {
+            // Intensity has a single level, 0 turns the lamp off
+            bool on = s_published[i].intensity != 0;
+            pixels[i * LAMP_BYTES] = on ? s_published[i].green : 0;
+            pixels[i * LAMP_BYTES + 1] = on ? s_published[i].red : 0;
+            pixels[i * LAMP_BYTES + 2] = on ? s_published[i].blue : 0;
+        }
+        taskEXIT_CRITICAL(&s_lamp_lock);
+
+        // The other buffer may still be on the wire, only this wait touches the scan-free core
+        rmt_tx_wait_all_done(s_channel, portMAX_DELAY);
+        if (rmt_transmit(s_channel, &s_encoder.base, pixels, LAMP_COUNT * LAMP_BYTES, &tx_config) == ESP_OK) {
+            s_back ^= 1;
+        }
+    }
+}
+
+
+void lamp_array_init(void) {
+    if (s_task_handle != NULL) {
+        return;
+    }
+
+    const rmt_tx_channel_config_t channel_config = {
+        .gpio_num = LAMP_ARRAY_GPIO,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = LAMP_ARRAY_RMT_RESOLUTION_HZ,
+        .mem_block_symbols = LAMP_ARRAY_RMT_DMA_SYMBOLS,
+        .trans_queue_depth = 2,
+        .flags.with_dma = true,
+    };
+    esp_err_t ret = rmt_new_tx_channel(&channel_config, &s_channel);
+    if (ret == ESP_OK) {
+        ret = lamp_encoder_init();
+    }
+    if (ret == ESP_OK) {
+        ret = rmt_enable(s_channel);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "RMT init failed: %s, lamps stay dark", esp_err_to_name(ret));
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_lamp_lock);
+    s_autonomous = true;
+    frame_fill(s_autonomous_color);
+    frame_commit();
+    taskEXIT_CRITICAL(&s_lamp_lock);
+
+    xTaskCreatePinnedToCore(lamp_array_task, "lamp_array_task", 3072, NULL, LAMP_ARRAY_TASK_PRIORITY, &s_task_handle,
+                            LAMP_ARRAY_TASK_CORE);
+    frame_publish();
+}
+
+
+void lamp_array_set_autonomous_color(uint8_t red, uint8_t green, uint8_t blue) {
+    taskENTER_CRITICAL(&s_lamp_lock);
+    s_autonomous_color = (lamp_color_t) {red, green, blue, 1};
+    bool autonomous = s_autonomous;
+    if (autonomous) {
+        frame_fill(s_autonomous_color);
+        frame_commit();
+    }
+    taskEXIT_CRITICAL(&s_lamp_lock);
+
+    if (autonomous) {
+        frame_publish();
+    }
+}
+
+
+/********* Reports ***************/
+
+static uint8_t lamp_input_binding(const layout_lamp_t *lamp) {
+    uint8_t keycode = keyboard_base_keycode(lamp->row, lamp->col);
+    if (is_modifier(keycode, lamp->row, lamp->col)) {
+        // The keymap stores modifiers as their bit in the modifier byte, usages 0xE0 ~ 0xE7
+        return HID_KEY_CONTROL_LEFT + __builtin_ctz(keycode);
+    }
+    return keycode;
+}
+
+
+uint16_t lamp_array_get_report(uint8_t report_id, uint8_t *buffer, uint16_t reqlen) {
+    if (report_id == REPORT_ID_LIGHTING_LAMP_ARRAY_ATTRIBUTES) {
+        const lamp_array_attributes_report_t report = {
+            .lamp_count = LAMP_COUNT,
+            .width_um = KEYMAP_INPUT_NUM * LAMP_ARRAY_KEY_PITCH_UM,
+            .height_um = KEYMAP_OUTPUT_NUM * LAMP_ARRAY_KEY_PITCH_UM,
+            .depth_um = LAMP_ARRAY_DEPTH_UM,
+            .kind = LAMP_ARRAY_KIND_KEYBOARD,
+            .min_update_interval_us = LAMP_ARRAY_MIN_UPDATE_INTERVAL_US,
+        };
+        if (reqlen < sizeof(report)) {
+            return 0;
+        }
+        memcpy(buffer, &report, sizeof(report));
+        return sizeof(report);
+    }
+
+    if (report_id == REPORT_ID_LIGHTING_LAMP_ATTRIBUTES_RESPONSE) {
+        taskENTER_CRITICAL(&s_lamp_lock);
+        uint16_t lamp_id = s_next_lamp_id;
+        s_next_lamp_id = (lamp_id + 1) % LAMP_COUNT;
+        taskEXIT_CRITICAL(&s_lamp_lock);
+
+        const layout_lamp_t *lamp = &layout_get()->lamps[lamp_id];
+        const lamp_attributes_response_report_t report = {
+            .lamp_id = lamp_id,
+            .position_x_um = lamp->col * LAMP_ARRAY_KEY_PITCH_UM + LAMP_ARRAY_KEY_PITCH_UM / 2,
+            .position_y_um = lamp->row * LAMP_ARRAY_KEY_PITCH_UM + LAMP_ARRAY_KEY_PITCH_UM / 2,
+            .position_z_um = 0,
+            .update_latency_us = LAMP_ARRAY_UPDATE_LATENCY_US,
+            .lamp_purposes = LAMP_PURPOSE_CONTROL,
+            .red_level_count = 0xff,
+            .green_level_count = 0xff,
+            .blue_level_count = 0xff,
+            .intensity_level_count = 1,
+            .is_programmable = 1,
+            .input_binding = lamp_input_binding(lamp),
+        };
+        if (reqlen < sizeof(report)) {
+            return 0;
+        }
+        memcpy(buffer, &report, sizeof(report));
+        return sizeof(report);
+    }
+
+    return 0;
+}
+
+
+void lamp_array_set_report(uint8_t report_id, const uint8_t *buffer, uint16_t len) {
+    bool complete = false;
+
+    taskENTER_CRITICAL(&s_lamp_lock);
+    switch (report_id) {
+    case REPORT_ID_LIGHTING_LAMP_ATTRIBUTES_REQUEST: {
+        lamp_attributes_request_report_t report;
+        if (len >= sizeof(report)) {
+            memcpy(&report, buffer, sizeof(report));
+            // An unknown lamp restarts the walk at the first one
+            s_next_lamp_id = report.lamp_id < LAMP_COUNT ? report.lamp_id : 0;
+        }
+        break;
+    }
+    case REPORT_ID_LIGHTING_LAMP_MULTI_UPDATE: {
+        lamp_multi_update_report_t report;
+        if (len < sizeof(report) || s_autonomous) {
+            break;
+        }
+        memcpy(&report, buffer, sizeof(report));
+        uint8_t count = report.lamp_count < LAMP_MULTI_UPDATE_LAMP_COUNT ? report.lamp_count : LAMP_MULTI_UPDATE_LAMP_COUNT;
+        for (int i = 0; i < count; i++) {
+            if (report.lamp_ids[i] < LAMP_COUNT) {
+                s_frame[report.lamp_ids[i]] = report.colors[i];
+            }
+        }
+        complete = report.flags & LAMP_UPDATE_FLAG_COMPLETE;
+        break;
+    }
+    case REPORT_ID_LIGHTING_LAMP_RANGE_UPDATE: {
+        lamp_range_update_report_t report;
+        if (len < sizeof(report) || s_autonomous) {
+            break;
+        }
+        memcpy(&report, buffer, sizeof(report));
+        if (report.lamp_id_start <= report.lamp_id_end && report.lamp_id_end < LAMP_COUNT) {
+            for (int i = report.lamp_id_start; i <= report.lamp_id_end; i++) {
+                s_frame[i] = report.color;
+            }
+        }
+        complete = report.flags & LAMP_UPDATE_FLAG_COMPLETE;
+        break;
+    }
+    case REPORT_ID_LIGHTING_LAMP_ARRAY_CONTROL: {
+        lamp_array_control_report_t report;
+        if (len < sizeof(report)) {
+            break;
+        }
+        memcpy(&report, buffer, sizeof(report));
+        s_autonomous = report.autonomous_mode != 0;
+        if (s_autonomous) {
+            frame_fill(s_autonomous_color);
+            complete = true;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    if (complete) {
+        frame_commit();
+    }
+    taskEXIT_CRITICAL(&s_lamp_lock);
+
+    if (complete) {
+        frame_publish();
+    }
+}
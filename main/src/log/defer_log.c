@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+#include "defer_log.h"
+
+static const char *TAG = "defer_log";
+
+
+typedef struct {
+    const char *tag;
+    const char *format;
+    uint32_t timestamp;                 // esp_log_timestamp() when the record was written
+    uint8_t level;
+    uint8_t arg_num;
+    uint32_t args[DEFER_LOG_MAX_ARGS];
+} defer_log_record_t;
+
+
+// Single producer (the owning core, interrupts masked) and single consumer (the flush task)
+typedef struct {
+    uint32_t head;                      // written by the owning core only
+    uint32_t tail;                      // written by the flush task only
+    uint32_t dropped;                   // written by the owning core only
+    defer_log_record_t records[DEFER_LOG_RING_LEN];
+} defer_log_ring_t;
+
+
+_Static_assert((DEFER_LOG_RING_LEN & (DEFER_LOG_RING_LEN - 1)) == 0, "DEFER_LOG_RING_LEN must be a power of two");
+
+static defer_log_ring_t s_rings[portNUM_PROCESSORS];
+static TaskHandle_t s_flush_task = NULL;
+
+
+void defer_log_write(esp_log_level_t level, const char *tag, const char *format, const uint32_t *args, uint32_t arg_num) {
+    if (arg_num > DEFER_LOG_MAX_ARGS) {
+        arg_num = DEFER_LOG_MAX_ARGS;
+    }
+    uint32_t timestamp = esp_log_timestamp();
+    bool was_empty = false;
+
+    // Masking the local interrupts keeps the task on this core and serializes the writers of this ring
+    UBaseType_t irq_state = portSET_INTERRUPT_MASK_FROM_ISR();
+    defer_log_ring_t *ring = &s_rings[esp_cpu_get_core_id()];
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= DEFER_LOG_RING_LEN) {
+        ring->dropped++;
+    } else {
+        defer_log_record_t *record = &ring->records[head & (DEFER_LOG_RING_LEN - 1)];
+        record->tag = tag;
+        record->format = format;
+        record->timestamp = timestamp;
+        record->level = level;
+        record->arg_num = arg_num;
+        memcpy(record->args, args, arg_num * sizeof(uint32_t));
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        was_empty = head == tail;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(irq_state);
+
+    // Only the first record of a burst wakes the flush task, it drains everything before blocking again
+    if (was_empty && s_flush_task != NULL) {
+        if (xPortInIsrContext()) {
+            BaseType_t higher_priority_task_woken = pdFALSE;
+            vTaskNotifyGiveFromISR(s_flush_task, &higher_priority_task_woken);
+            portYIELD_FROM_ISR(higher_priority_task_woken);
+        } else {
+            xTaskNotifyGive(s_flush_task);
+        }
+    }
+}
+
+
+uint32_t defer_log_dropped(void) {
+    uint32_t dropped = 0;
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        dropped += __atomic_load_n(&s_rings[i].dropped, __ATOMIC_RELAXED);
+    }
+    return dropped;
+}
+
+
+static char level_letter(esp_log_level_t level) {
+    switch (level) {
+        case ESP_LOG_ERROR:     return 'E';
+        case ESP_LOG_WARN:      return 'W';
+        case ESP_LOG_INFO:      return 'I';
+        case ESP_LOG_DEBUG:     return 'D';
+        default:                return 'V';
+    }
+}
+
+
+static void print_record(const defer_log_record_t *record) {
+    char line[DEFER_LOG_LINE_LEN];
+    const uint32_t *a = record->args;
+    // Unused trailing arguments are ignored by the format, all of them are 32-bit on this target
+    snprintf(line, sizeof(line), record->format, a[0], a[1], a[2], a[3], a[4], a[5]);
+    esp_log_write(record->level, record->tag, "%c (%lu) %s: %s\n",
+                  level_letter(record->level), record->timestamp, record->tag, line);
+}
+
+
+/**
+ * @brief   Print every record of a ring
+ * @return  true when at least one record was printed
+ * **/
+static bool drain_ring(defer_log_ring_t *ring) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == head) {
+        return false;
+    }
+    while (tail != head) {
+        // Copy out first, the slot may be reused as soon as tail moves past it
+        defer_log_record_t record = ring->records[tail & (DEFER_LOG_RING_LEN - 1)];
+        __atomic_store_n(&ring->tail, ++tail, __ATOMIC_RELEASE);
+        print_record(&record);
+    }
+    return true;
+}
+
+
+static void defer_log_task(void *arg) {
+    uint32_t reported_drops = 0;
+    while (1) {
+        bool printed = false;
+        do {
+            printed = false;
+            for (int i = 0; i < portNUM_PROCESSORS; i++) {
+                printed |= drain_ring(&s_rings[i]);
+            }
+        } while (printed);
+
+        uint32_t dropped = defer_log_dropped();
+        if (dropped != reported_drops) {
+            ESP_LOGW(TAG, "%lu records dropped, ring full", dropped - reported_drops);
+            reported_drops = dropped;
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+
+void defer_log_init(void) {
+    if (s_flush_task != NULL) {
+        return;
+    }
+    xTaskCreate(defer_log_task, "defer_log_task", DEFER_LOG_TASK_STACK, NULL, DEFER_LOG_TASK_PRIORITY, &s_flush_task);
+}
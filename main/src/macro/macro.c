@@ -0,0 +1,144 @@
+#include <string.h>
+#include "macro.h"
+
+#define MACRO_KEY_MODIFIER_FIRST    0xE0    // HID_KEY_CONTROL_LEFT
+#define MACRO_KEY_MODIFIER_LAST     0xE7    // HID_KEY_GUI_RIGHT
+
+
+static void key_down(macro_t *macro, uint8_t keycode) {
+    if (keycode >= MACRO_KEY_MODIFIER_FIRST && keycode <= MACRO_KEY_MODIFIER_LAST) {
+        macro->modifier |= 1 << (keycode - MACRO_KEY_MODIFIER_FIRST);
+        return;
+    }
+    int free_slot = -1;
+    for (int i = 0; i < MACRO_REPORT_KEYS; i++) {
+        if (macro->keycode[i] == keycode) {
+            return;
+        }
+        if (macro->keycode[i] == 0 && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    // A seventh key is dropped, like a boot keyboard would
+    if (free_slot >= 0) {
+        macro->keycode[free_slot] = keycode;
+    }
+}
+
+
+static void key_up(macro_t *macro, uint8_t keycode) {
+    if (keycode >= MACRO_KEY_MODIFIER_FIRST && keycode <= MACRO_KEY_MODIFIER_LAST) {
+        macro->modifier &= ~(1 << (keycode - MACRO_KEY_MODIFIER_FIRST));
+        return;
+    }
+    for (int i = 0; i < MACRO_REPORT_KEYS; i++) {
+        if (macro->keycode[i] == keycode) {
+            macro->keycode[i] = 0;
+        }
+    }
+}
+
+
+static void keyboard_report(const macro_t *macro, macro_report_t *report) {
+    report->type = MACRO_REPORT_KEYBOARD;
+    report->modifier = macro->modifier;
+    memcpy(report->keycode, macro->keycode, sizeof(report->keycode));
+    report->usage = 0;
+    report->wait_ms = 0;
+}
+
+
+void macro_start(macro_t *macro, const uint8_t *bytecode) {
+    memset(macro, 0, sizeof(macro_t));
+    macro->pc = bytecode;
+}
+
+
+bool macro_step(macro_t *macro, macro_report_t *report) {
+    if (macro->tap_release) {
+        key_up(macro, macro->tap_release);
+        macro->tap_release = 0;
+        keyboard_report(macro, report);
+        return true;
+    }
+
+    const uint8_t *pc = macro->pc;
+    switch (pc[0]) {
+        case MACRO_OP_DOWN:
+            key_down(macro, pc[1]);
+            macro->pc += 2;
+            break;
+        case MACRO_OP_UP:
+            key_up(macro, pc[1]);
+            macro->pc += 2;
+            break;
+        case MACRO_OP_TAP:
+            key_down(macro, pc[1]);
+            macro->tap_release = pc[1];
+            macro->pc += 2;
+            break;
+        case MACRO_OP_CONSUMER:
+            memset(report, 0, sizeof(macro_report_t));
+            report->type = MACRO_REPORT_CONSUMER;
+            report->usage = pc[1];
+            macro->pc += 2;
+            return true;
+        case MACRO_OP_WAIT:
+            memset(report, 0, sizeof(macro_report_t));
+            report->type = MACRO_REPORT_WAIT;
+            report->wait_ms = pc[1] | (pc[2] << 8);
+            macro->pc += 3;
+            return true;
+        case MACRO_OP_RELEASE_ALL:
+            macro->modifier = 0;
+            memset(macro->keycode, 0, sizeof(macro->keycode));
+            macro->pc += 1;
+            break;
+        default:
+            // MACRO_OP_END, or bytecode this firmware does not know
+            return false;
+    }
+    keyboard_report(macro, report);
+    return true;
+}
+
+
+bool macro_holds_keys(const macro_t *macro) {
+    if (macro->modifier) {
+        return true;
+    }
+    for (int i = 0; i < MACRO_REPORT_KEYS; i++) {
+        if (macro->keycode[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+size_t macro_length(const uint8_t *bytecode, size_t size) {
+    size_t pc = 0;
+    while (pc < size) {
+        size_t len;
+        switch (bytecode[pc]) {
+            case MACRO_OP_END:
+                return pc + 1;
+            case MACRO_OP_RELEASE_ALL:
+                len = 1;
+                break;
+            case MACRO_OP_DOWN:
+            case MACRO_OP_UP:
+            case MACRO_OP_TAP:
+            case MACRO_OP_CONSUMER:
+                len = 2;
+                break;
+            case MACRO_OP_WAIT:
+                len = 3;
+                break;
+            default:
+                return 0;
+        }
+        pc += len;
+    }
+    return 0;
+}
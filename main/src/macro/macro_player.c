@@ -0,0 +1,97 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "macro_player.h"
+
+
+typedef struct {
+    const uint8_t *bytecode;
+    macro_done_t done;
+} macro_request_t;
+
+
+static QueueHandle_t s_queue = NULL;
+static TaskHandle_t s_task_handle = NULL;
+static macro_send_t s_send = NULL;
+static volatile bool s_playing = false;
+
+
+/**
+ * @brief   Send a report, then sleep until the link confirms it
+ * @note    Only this task waits, the scan task and the transports never block on a macro
+ * **/
+static void send_paced(const macro_report_t *report) {
+    s_send(report);
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MACRO_PLAYER_READY_TIMEOUT_MS));
+}
+
+
+static void macro_player_task(void *arg) {
+    (void) arg;
+    macro_request_t request;
+    macro_t macro;
+    macro_report_t report;
+
+    while (1) {
+        xQueueReceive(s_queue, &request, portMAX_DELAY);
+        s_playing = true;
+        // Completions of reports sent before the macro must not pace it
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        macro_start(&macro, request.bytecode);
+        while (macro_step(&macro, &report)) {
+            if (report.type == MACRO_REPORT_WAIT) {
+                // Recorded timing, rounded down to the FreeRTOS tick
+                vTaskDelay(pdMS_TO_TICKS(report.wait_ms));
+                continue;
+            }
+            send_paced(&report);
+        }
+        if (macro_holds_keys(&macro)) {
+            // The macro ended with keys down, never leave them stuck on the host
+            report = (macro_report_t) {.type = MACRO_REPORT_KEYBOARD};
+            send_paced(&report);
+        }
+
+        if (request.done != NULL) {
+            request.done();
+        }
+        s_playing = false;
+    }
+}
+
+
+void macro_player_init(macro_send_t send) {
+    if (s_queue != NULL) {
+        return;
+    }
+    s_send = send;
+    s_queue = xQueueCreate(MACRO_PLAYER_QUEUE_LEN, sizeof(macro_request_t));
+    xTaskCreatePinnedToCore(macro_player_task, "macro_player_task", 2048, NULL, MACRO_PLAYER_TASK_PRIORITY,
+                            &s_task_handle, MACRO_PLAYER_TASK_CORE);
+}
+
+
+bool macro_player_play(const uint8_t *bytecode, macro_done_t done) {
+    if (s_queue == NULL || bytecode == NULL) {
+        return false;
+    }
+    const macro_request_t request = {
+        .bytecode = bytecode,
+        .done = done,
+    };
+    return xQueueSend(s_queue, &request, 0) == pdTRUE;
+}
+
+
+void macro_player_ready(void) {
+    if (s_task_handle != NULL && s_playing) {
+        xTaskNotifyGive(s_task_handle);
+    }
+}
+
+
+bool macro_player_busy(void) {
+    return s_playing || (s_queue != NULL && uxQueueMessagesWaiting(s_queue) > 0);
+}
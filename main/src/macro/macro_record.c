@@ -0,0 +1,170 @@
+#include <string.h>
+#include "macro_record.h"
+
+#define MACRO_RECORD_MODIFIER_FIRST     0xE0    // HID_KEY_CONTROL_LEFT
+#define MACRO_RECORD_ERROR_ROLLOVER     0x01
+#define MACRO_RECORD_WAIT_MAX_MS        0xFFFF
+
+
+/**
+ * @brief   Usage set of a boot report, modifier bits as their keyboard usages
+ * **/
+static bool usage_set(uint8_t modifier, const uint8_t *keycode, uint32_t set[MACRO_RECORD_USAGE_WORDS]) {
+    memset(set, 0, MACRO_RECORD_USAGE_WORDS * sizeof(uint32_t));
+    for (int i = 0; i < MACRO_REPORT_KEYS; i++) {
+        if (keycode[i] == MACRO_RECORD_ERROR_ROLLOVER) {
+            return false;
+        }
+        if (keycode[i]) {
+            set[keycode[i] / 32] |= 1u << (keycode[i] % 32);
+        }
+    }
+    set[MACRO_RECORD_MODIFIER_FIRST / 32] |= (uint32_t)modifier << (MACRO_RECORD_MODIFIER_FIRST % 32);
+    return true;
+}
+
+
+static void push_event(macro_record_t *record, uint8_t keycode, bool down, uint32_t now_ms) {
+    uint32_t wait_ms = now_ms - record->last_ms;
+    record->last_ms = now_ms;
+
+    uint32_t index = (record->head + record->event_num) % MACRO_RECORD_EVENTS;
+    if (record->event_num == MACRO_RECORD_EVENTS) {
+        // Full, the newest events win
+        record->head = (record->head + 1) % MACRO_RECORD_EVENTS;
+    } else {
+        record->event_num++;
+    }
+    record->events[index] = (macro_record_event_t) {
+        .wait_ms = wait_ms > MACRO_RECORD_WAIT_MAX_MS ? MACRO_RECORD_WAIT_MAX_MS : wait_ms,
+        .keycode = keycode,
+        .down = down,
+    };
+}
+
+
+static const macro_record_event_t *event_at(const macro_record_t *record, uint32_t i) {
+    return &record->events[(record->head + i) % MACRO_RECORD_EVENTS];
+}
+
+
+void macro_record_start(macro_record_t *record, uint8_t modifier, const uint8_t *keycode, uint32_t now_ms) {
+    memset(record, 0, sizeof(macro_record_t));
+    if (!usage_set(modifier, keycode, record->ignore)) {
+        memset(record->ignore, 0, sizeof(record->ignore));
+    }
+    record->recording = true;
+    record->last_ms = now_ms;
+}
+
+
+void macro_record_stop(macro_record_t *record) {
+    record->recording = false;
+}
+
+
+void macro_record_report(macro_record_t *record, uint8_t modifier, const uint8_t *keycode, uint32_t now_ms) {
+    if (!record->recording) {
+        return;
+    }
+    uint32_t now[MACRO_RECORD_USAGE_WORDS];
+    if (!usage_set(modifier, keycode, now)) {
+        return;
+    }
+
+    for (int w = 0; w < MACRO_RECORD_USAGE_WORDS; w++) {
+        // Keys of the starting command drop out of the ignore set once released
+        record->ignore[w] &= now[w];
+        now[w] &= ~record->ignore[w];
+
+        uint32_t changed = now[w] ^ record->held[w];
+        while (changed) {
+            int bit = __builtin_ctz(changed);
+            changed &= changed - 1;
+            push_event(record, w * 32 + bit, now[w] & (1u << bit), now_ms);
+        }
+        record->held[w] = now[w];
+    }
+}
+
+
+size_t macro_record_compile(const macro_record_t *record, bool timed, uint8_t *bytecode, size_t size) {
+    size_t len = 0;
+    for (uint32_t i = 0; i < record->event_num; i++) {
+        const macro_record_event_t *event = event_at(record, i);
+        if (len + 5 + 1 > size) {
+            return 0;
+        }
+        if (timed && i > 0 && event->wait_ms) {
+            const uint8_t wait[] = {MACRO_WAIT(event->wait_ms)};
+            memcpy(&bytecode[len], wait, sizeof(wait));
+            len += sizeof(wait);
+        }
+        bytecode[len++] = event->down ? MACRO_OP_DOWN : MACRO_OP_UP;
+        bytecode[len++] = event->keycode;
+    }
+    if (len + 1 > size) {
+        return 0;
+    }
+    bytecode[len++] = MACRO_OP_END;
+    return len;
+}
+
+
+size_t macro_record_pack(const macro_record_t *record, uint8_t *blob, size_t size) {
+    if (size < 1) {
+        return 0;
+    }
+    size_t len = 0;
+    blob[len++] = MACRO_RECORD_PACK_VERSION;
+    for (uint32_t i = 0; i < record->event_num; i++) {
+        const macro_record_event_t *event = event_at(record, i);
+        if (len + 4 > size) {
+            return 0;
+        }
+        uint32_t value = ((uint32_t)event->wait_ms << 1) | (event->down ? 1 : 0);
+        while (value >= 0x80) {
+            blob[len++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        blob[len++] = value;
+        blob[len++] = event->keycode;
+    }
+    return len;
+}
+
+
+bool macro_record_unpack(macro_record_t *record, const uint8_t *blob, size_t len) {
+    memset(record, 0, sizeof(macro_record_t));
+    if (len < 1 || blob[0] != MACRO_RECORD_PACK_VERSION) {
+        return false;
+    }
+
+    size_t pos = 1;
+    while (pos < len) {
+        if (record->event_num == MACRO_RECORD_EVENTS) {
+            record->event_num = 0;
+            return false;
+        }
+        uint32_t value = 0;
+        int shift = 0;
+        do {
+            if (pos >= len || shift > 14) {
+                record->event_num = 0;
+                return false;
+            }
+            value |= (uint32_t)(blob[pos] & 0x7F) << shift;
+            shift += 7;
+        } while (blob[pos++] & 0x80);
+        if (pos >= len) {
+            record->event_num = 0;
+            return false;
+        }
+        record->events[record->event_num++] = (macro_record_event_t) {
+            .wait_ms = value >> 1 > MACRO_RECORD_WAIT_MAX_MS ? MACRO_RECORD_WAIT_MAX_MS : value >> 1,
+            .keycode = blob[pos++],
+            .down = value & 1,
+        };
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+#include "macro_store.h"
+
+static const char *TAG = "macro_store";
+
+// The keyboard loads at boot and its save task saves, one buffer keeps the blob off their stacks
+static uint8_t s_blob[MACRO_RECORD_PACK_SIZE];
+
+
+esp_err_t save_recording_to_nvs(const macro_record_t *record) {
+    size_t len = macro_record_pack(record, s_blob, sizeof(s_blob));
+    if (len == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_blob(nvs_handle, MACRO_STORE_NVS_KEY, s_blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "Saved %lu events in %u bytes: %s", record->event_num, len, esp_err_to_name(err));
+    return err;
+}
+
+
+esp_err_t load_recording_from_nvs(macro_record_t *record) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    size_t len = sizeof(s_blob);
+    err = nvs_get_blob(nvs_handle, MACRO_STORE_NVS_KEY, s_blob, &len);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) return err;
+
+    if (!macro_record_unpack(record, s_blob, len)) {
+        ESP_LOGW(TAG, "Saved recording is unreadable, dropped");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    ESP_LOGI(TAG, "Loaded %lu events", record->event_num);
+    return ESP_OK;
+}
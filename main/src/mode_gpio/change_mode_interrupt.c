@@ -14,6 +14,10 @@
 #include "esp_task_wdt.h"
 #include "hid_custom.h"
 #include "tinyusb.h"
+#include "power_policy.h"
+#include "deep_sleep.h"
+#include "defer_log.h"
+#include "led_state.h"
 
 
 void IRAM_ATTR gpio_isr_handler(void* arg) {
@@ -54,6 +58,11 @@ void gpio_task(void* arg) {
     connection_mode_t saved_mode = (connection_mode_t) mode_value;
     bool while_break = false;
 
+    deep_sleep_rtc_state_t rtc_state;
+    if (deep_sleep_get_rtc_state(&rtc_state)) {
+        saved_mode = rtc_state.mode;
+    }
+
     if (saved_mode == 0) {
         saved_mode = MODE_BLE;
     }
@@ -64,9 +73,9 @@ void gpio_task(void* arg) {
     uint8_t count = 0;
     while (1) {
         if (saved_mode == MODE_USB && !tud_mounted()) {
-            ESP_LOGI(__func__, "USB not mounted");
+            DLOGI(__func__, "USB not mounted");
             if (count == 50) {
-                ESP_LOGI(__func__, "USB not mounted for 3 seconds");
+                DLOGI(__func__, "USB not mounted for 3 seconds");
                 tinyusb_driver_uninstall();
                 saved_mode = MODE_BLE;
                 continue;
@@ -74,7 +83,7 @@ void gpio_task(void* arg) {
             count ++;
         }
         if (current_mode != saved_mode) {
-            ESP_LOGI(__func__, "current_mode != saved_mode");
+            DLOGI(__func__, "current_mode != saved_mode");
             current_mode = saved_mode;
             switch (saved_mode) {
                 case MODE_USB:
@@ -96,6 +105,8 @@ void gpio_task(void* arg) {
             if (while_break) {
                 break;
             }
+            power_policy_apply_mode(current_mode);
+            led_state_apply_mode(current_mode);
         }
         vTaskDelay(100 / portTICK_PERIOD_MS);
 
@@ -118,15 +129,15 @@ void gpio_task(void* arg) {
                     *mode = MODE_WIRELESS;
                     break;
                 default:
-                    ESP_LOGE("GPIO_TASK", "Unhandled GPIO number received");
+                    DLOGE("GPIO_TASK", "Unhandled GPIO number received");
                     break;
             }
             if (*mode != current_mode) {
                 current_mode = *mode;
-                ESP_LOGI(__func__, "Changed mode is %d", current_mode);
+                DLOGI(__func__, "Changed mode is %d", current_mode);
                 if (current_mode == MODE_USB) {
                     // Do something when USB mode is selected
-                    ESP_LOGI(__func__, "hhh %d", current_mode);
+                    DLOGI(__func__, "hhh %d", current_mode);
                     tusb_main();
                     save_mode(MODE_USB);
                 } else if (current_mode == MODE_BLE) {
@@ -136,6 +147,8 @@ void gpio_task(void* arg) {
                     esp_now_main();
                     save_mode(MODE_WIRELESS);
                 }
+                power_policy_apply_mode(current_mode);
+                led_state_apply_mode(current_mode);
             }
         }
     }
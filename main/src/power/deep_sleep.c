@@ -0,0 +1,241 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "rom/ets_sys.h"
+
+#include "deep_sleep.h"
+#include "power_policy.h"
+#include "change_mode_interrupt.h"
+#include "ble_main.h"
+#include "hid_custom.h"
+#include "led_state.h"
+
+static const char *TAG = "deep_sleep";
+
+
+static RTC_DATA_ATTR deep_sleep_rtc_state_t s_rtc_state;
+
+static bool s_woke_from_deep_sleep = false;
+static bool s_wake_key_pending = false;
+static keyboard_btn_data_t s_wake_key;
+static bool s_resume_pending = false;
+
+// EXT1 sources, the columns on RTC GPIOs. Zero if no key can wake the keyboard.
+static uint64_t s_wake_mask = 0;
+
+
+/**
+ * @brief   Find the row of the key that woke the chip by scanning only the columns in the EXT1 status
+ * @param   wake_mask: GPIO mask returned by esp_sleep_get_ext1_wakeup_status()
+ * @return  true if the key is still held and its position was stored in s_wake_key
+ * **/
+static bool latch_wake_key(uint64_t wake_mask) {
+    const int idle_level = cfg.active_level ? 0 : 1;
+
+    for (int i = 0; i < cfg.output_gpio_num; i++) {
+        gpio_set_direction(cfg.output_gpios[i], GPIO_MODE_OUTPUT);
+        gpio_set_level(cfg.output_gpios[i], idle_level);
+    }
+
+    for (int i = 0; i < cfg.output_gpio_num; i++) {
+        gpio_set_level(cfg.output_gpios[i], cfg.active_level);
+        ets_delay_us(5);
+        for (int j = 0; j < cfg.input_gpio_num; j++) {
+            int gpio = cfg.input_gpios[j];
+            if (!(wake_mask & (1ULL << gpio))) {
+                continue;
+            }
+            if (gpio_get_level(gpio) == cfg.active_level) {
+                gpio_set_level(cfg.output_gpios[i], idle_level);
+                s_wake_key.output_index = i;
+                s_wake_key.input_index = j;
+                return true;
+            }
+        }
+        gpio_set_level(cfg.output_gpios[i], idle_level);
+    }
+    return false;
+}
+
+
+void deep_sleep_restore(void) {
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_EXT1) {
+        memset(&s_rtc_state, 0, sizeof(s_rtc_state));
+        return;
+    }
+
+    s_woke_from_deep_sleep = s_rtc_state.magic == DEEP_SLEEP_RTC_MAGIC;
+    s_resume_pending = true;
+
+    // Give the pins back to the digital GPIO matrix before scanning
+    for (int i = 0; i < cfg.output_gpio_num; i++) {
+        gpio_hold_dis(cfg.output_gpios[i]);
+    }
+    gpio_deep_sleep_hold_dis();
+    for (int j = 0; j < cfg.input_gpio_num; j++) {
+        if (rtc_gpio_is_valid_gpio(cfg.input_gpios[j])) {
+            rtc_gpio_deinit(cfg.input_gpios[j]);
+        }
+        gpio_set_direction(cfg.input_gpios[j], GPIO_MODE_INPUT);
+        gpio_set_pull_mode(cfg.input_gpios[j], cfg.active_level ? GPIO_PULLDOWN_ONLY : GPIO_PULLUP_ONLY);
+    }
+
+    uint64_t wake_mask = esp_sleep_get_ext1_wakeup_status();
+    s_wake_key_pending = latch_wake_key(wake_mask);
+    if (s_wake_key_pending) {
+        ESP_LOGI(TAG, "Woke by key (%d, %d)", s_wake_key.output_index, s_wake_key.input_index);
+    } else {
+        ESP_LOGW(TAG, "Woke by GPIO mask 0x%llx but the key was already released", wake_mask);
+    }
+}
+
+
+bool deep_sleep_get_rtc_state(deep_sleep_rtc_state_t *state) {
+    if (!s_woke_from_deep_sleep) {
+        return false;
+    }
+    *state = s_rtc_state;
+    return true;
+}
+
+
+bool deep_sleep_take_wake_key(keyboard_btn_data_t *key) {
+    if (!s_wake_key_pending) {
+        return false;
+    }
+    s_wake_key_pending = false;
+    *key = s_wake_key;
+    return true;
+}
+
+
+void deep_sleep_wake_key_seen(const keyboard_btn_report_t *kbd_report) {
+    if (!s_wake_key_pending) {
+        return;
+    }
+    for (int i = 0; i < kbd_report->key_pressed_num; i++) {
+        if (kbd_report->key_data[i].output_index == s_wake_key.output_index &&
+            kbd_report->key_data[i].input_index == s_wake_key.input_index) {
+            s_wake_key_pending = false;
+            return;
+        }
+    }
+}
+
+
+void deep_sleep_report_sent(void) {
+    if (!s_resume_pending) {
+        return;
+    }
+    s_resume_pending = false;
+    // esp_timer starts with the application, ROM and bootloader time is not included
+    ESP_LOGI(TAG, "Resume to first report: %lld ms after app start", esp_timer_get_time() / 1000);
+}
+
+
+void deep_sleep_check_idle(void) {
+    if (current_mode == MODE_USB || s_wake_mask == 0) {
+        return;
+    }
+
+    if (power_policy_get_battery_state() == POWER_BATTERY_CRITICAL) {
+        ESP_LOGW(TAG, "Battery critical, entering deep sleep");
+        deep_sleep_enter();
+        return;
+    }
+
+    if (power_policy_get_idle_us() >= (int64_t)DEEP_SLEEP_IDLE_MS * 1000) {
+        ESP_LOGI(TAG, "Idle for %d s, entering deep sleep", DEEP_SLEEP_IDLE_MS / 1000);
+        deep_sleep_enter();
+    }
+}
+
+
+static void deep_sleep_task(void *arg) {
+    while (1) {
+        vTaskDelay(DEEP_SLEEP_CHECK_PERIOD_MS / portTICK_PERIOD_MS);
+        deep_sleep_check_idle();
+    }
+}
+
+
+void deep_sleep_init(void) {
+    int unwakeable = 0;
+    for (int j = 0; j < cfg.input_gpio_num; j++) {
+        int gpio = cfg.input_gpios[j];
+        if (rtc_gpio_is_valid_gpio(gpio)) {
+            s_wake_mask |= 1ULL << gpio;
+        } else {
+            unwakeable++;
+        }
+    }
+    if (s_wake_mask == 0) {
+        ESP_LOGE(TAG, "No column is an RTC GPIO, deep sleep disabled");
+        return;
+    }
+    if (unwakeable) {
+        // EXT1 only reaches RTC GPIOs (0 ~ 21 on ESP32-S3)
+        ESP_LOGW(TAG, "%d columns are not RTC GPIOs, keys on them cannot wake the keyboard", unwakeable);
+    }
+
+    xTaskCreatePinnedToCore(deep_sleep_task, "deep_sleep_task", 1024 * 3, NULL, DEEP_SLEEP_TASK_PRIORITY, NULL, DEEP_SLEEP_TASK_CORE);
+}
+
+
+void deep_sleep_enter(void) {
+    if (s_wake_mask == 0) {
+        ESP_LOGE(TAG, "No column is an RTC GPIO, deep sleep skipped");
+        return;
+    }
+    const uint64_t wake_mask = s_wake_mask;
+
+    s_rtc_state.magic = DEEP_SLEEP_RTC_MAGIC;
+    s_rtc_state.mode = current_mode;
+    s_rtc_state.ble_idx = current_ble_idx;
+    memcpy(s_rtc_state.last_host, current_bda, sizeof(esp_bd_addr_t));
+
+    // Stop the scan task before taking over the rows
+    keyboard_button_delete(kbd_handle);
+    kbd_handle = NULL;
+
+    // gpio_deep_sleep_hold_en() latches every digital pad, the indicators included
+    led_state_off();
+
+    for (int i = 0; i < cfg.output_gpio_num; i++) {
+        int gpio = cfg.output_gpios[i];
+        gpio_reset_pin(gpio);
+        gpio_set_direction(gpio, GPIO_MODE_OUTPUT);
+        gpio_set_level(gpio, cfg.active_level);
+        gpio_hold_en(gpio);
+    }
+    gpio_deep_sleep_hold_en();
+
+    for (int j = 0; j < cfg.input_gpio_num; j++) {
+        int gpio = cfg.input_gpios[j];
+        if (!(wake_mask & (1ULL << gpio))) {
+            continue;
+        }
+        rtc_gpio_init(gpio);
+        rtc_gpio_set_direction(gpio, RTC_GPIO_MODE_INPUT_ONLY);
+        if (cfg.active_level) {
+            rtc_gpio_pulldown_en(gpio);
+            rtc_gpio_pullup_dis(gpio);
+        } else {
+            rtc_gpio_pullup_en(gpio);
+            rtc_gpio_pulldown_dis(gpio);
+        }
+    }
+
+    // The RTC pulls only work while the RTC peripheral domain is powered
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+    esp_sleep_enable_ext1_wakeup(wake_mask, cfg.active_level ? ESP_EXT1_WAKEUP_ANY_HIGH : ESP_EXT1_WAKEUP_ANY_LOW);
+
+    ESP_LOGI(TAG, "Entering deep sleep, wake mask 0x%llx", wake_mask);
+    esp_deep_sleep_start();
+}
@@ -0,0 +1,239 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+
+#include "power_policy.h"
+
+static const char *TAG = "power_policy";
+
+
+static uint8_t s_battery_level = 100;
+static power_battery_state_t s_battery_state = POWER_BATTERY_NORMAL;
+
+static connection_mode_t s_mode = MODE_BLE;
+static bool s_light_sleep = false;
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t s_key_lock = NULL;        // ESP_PM_CPU_FREQ_MAX
+static esp_pm_lock_handle_t s_report_lock = NULL;     // ESP_PM_NO_LIGHT_SLEEP
+#endif
+
+static portMUX_TYPE s_power_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_key_down = false;
+static uint32_t s_reports = 0;
+static int64_t s_last_activity_us = 0;
+
+static power_state_t s_state = POWER_STATE_IDLE;
+static int64_t s_state_since = 0;
+static int64_t s_residency_us[POWER_STATE_MAX];
+
+
+/**
+ * @brief   Account the time spent in the previous state and switch to the state derived from the locks
+ * @note    Must be called inside s_power_lock
+ * **/
+static void update_state(void) {
+    power_state_t state = POWER_STATE_IDLE;
+    if (s_key_down) {
+        state = POWER_STATE_ACTIVE;
+    } else if (s_reports > 0) {
+        state = POWER_STATE_REPORT;
+    }
+
+    if (state != s_state) {
+        int64_t now = esp_timer_get_time();
+        s_residency_us[s_state] += now - s_state_since;
+        s_state_since = now;
+        s_state = state;
+    }
+}
+
+
+static void configure_pm(void) {
+#if CONFIG_PM_ENABLE
+    if (s_key_lock == NULL) {
+        // Mode not applied yet, a battery sample must not enable light sleep on its own
+        return;
+    }
+
+    int max_freq = POWER_CPU_MAX_FREQ_MHZ;
+    if (s_battery_state != POWER_BATTERY_NORMAL && s_mode != MODE_USB) {
+        max_freq = POWER_CPU_LOW_BATTERY_FREQ_MHZ;
+    }
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = max_freq,
+        .min_freq_mhz = s_mode == MODE_USB ? max_freq : POWER_CPU_MIN_FREQ_MHZ,
+        .light_sleep_enable = s_mode == MODE_BLE,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return;
+    }
+    s_light_sleep = pm_config.light_sleep_enable;
+    ESP_LOGI(TAG, "CPU %d~%d MHz, light sleep %s", pm_config.min_freq_mhz, pm_config.max_freq_mhz,
+             s_light_sleep ? "on" : "off");
+#endif
+}
+
+
+void power_policy_apply_mode(connection_mode_t mode) {
+#if CONFIG_PM_ENABLE
+    if (s_key_lock == NULL) {
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "key_down", &s_key_lock);
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "report", &s_report_lock);
+        s_state_since = esp_timer_get_time();
+    }
+#endif
+    s_mode = mode;
+    configure_pm();
+}
+
+
+void power_policy_set_key_down(bool key_down) {
+    taskENTER_CRITICAL(&s_power_lock);
+    bool changed = key_down != s_key_down;
+    s_key_down = key_down;
+    s_last_activity_us = esp_timer_get_time();
+    update_state();
+    taskEXIT_CRITICAL(&s_power_lock);
+
+    if (!changed) {
+        return;
+    }
+#if CONFIG_PM_ENABLE
+    if (s_key_lock == NULL) {
+        return;
+    }
+    if (key_down) {
+        esp_pm_lock_acquire(s_key_lock);
+        esp_pm_lock_acquire(s_report_lock);
+    } else {
+        esp_pm_lock_release(s_report_lock);
+        esp_pm_lock_release(s_key_lock);
+    }
+#endif
+}
+
+
+void power_policy_report_begin(void) {
+    taskENTER_CRITICAL(&s_power_lock);
+    s_reports++;
+    update_state();
+    taskEXIT_CRITICAL(&s_power_lock);
+
+#if CONFIG_PM_ENABLE
+    if (s_report_lock) {
+        esp_pm_lock_acquire(s_report_lock);
+    }
+#endif
+}
+
+
+void power_policy_report_end(void) {
+    taskENTER_CRITICAL(&s_power_lock);
+    bool in_flight = s_reports > 0;
+    if (in_flight) {
+        s_reports--;
+        update_state();
+    }
+    taskEXIT_CRITICAL(&s_power_lock);
+
+#if CONFIG_PM_ENABLE
+    if (in_flight && s_report_lock) {
+        esp_pm_lock_release(s_report_lock);
+    }
+#endif
+}
+
+
+void power_policy_reports_clear(void) {
+    taskENTER_CRITICAL(&s_power_lock);
+    uint32_t reports = s_reports;
+    s_reports = 0;
+    update_state();
+    taskEXIT_CRITICAL(&s_power_lock);
+
+#if CONFIG_PM_ENABLE
+    for (uint32_t i = 0; i < reports && s_report_lock; i++) {
+        esp_pm_lock_release(s_report_lock);
+    }
+#endif
+}
+
+
+int64_t power_policy_get_idle_us(void) {
+    taskENTER_CRITICAL(&s_power_lock);
+    int64_t idle_us = s_key_down ? 0 : esp_timer_get_time() - s_last_activity_us;
+    taskEXIT_CRITICAL(&s_power_lock);
+    return idle_us;
+}
+
+
+void power_policy_log_estimate(void) {
+    int64_t residency_us[POWER_STATE_MAX];
+
+    taskENTER_CRITICAL(&s_power_lock);
+    int64_t now = esp_timer_get_time();
+    s_residency_us[s_state] += now - s_state_since;
+    s_state_since = now;
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        residency_us[i] = s_residency_us[i];
+        s_residency_us[i] = 0;
+    }
+    taskEXIT_CRITICAL(&s_power_lock);
+
+    const int64_t estimate_ua[POWER_STATE_MAX] = {
+        [POWER_STATE_ACTIVE] = POWER_ESTIMATE_ACTIVE_UA,
+        [POWER_STATE_REPORT] = POWER_ESTIMATE_REPORT_UA,
+        [POWER_STATE_IDLE] = s_light_sleep ? POWER_ESTIMATE_SLEEP_UA : POWER_ESTIMATE_IDLE_UA,
+    };
+
+    int64_t total_us = 0;
+    int64_t charge = 0;     // uA * us
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        total_us += residency_us[i];
+        charge += residency_us[i] * estimate_ua[i];
+    }
+    if (total_us == 0) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "active %lld ms (~%lld uA), report %lld ms (~%lld uA), idle %lld ms (~%lld uA), average ~%lld uA",
+             residency_us[POWER_STATE_ACTIVE] / 1000, estimate_ua[POWER_STATE_ACTIVE],
+             residency_us[POWER_STATE_REPORT] / 1000, estimate_ua[POWER_STATE_REPORT],
+             residency_us[POWER_STATE_IDLE] / 1000, estimate_ua[POWER_STATE_IDLE],
+             charge / total_us);
+}
+
+
+void power_policy_set_battery_level(uint8_t level) {
+    power_battery_state_t state = POWER_BATTERY_NORMAL;
+    if (level <= POWER_BATTERY_CRITICAL_PERCENT) {
+        state = POWER_BATTERY_CRITICAL;
+    } else if (level <= POWER_BATTERY_LOW_PERCENT) {
+        state = POWER_BATTERY_LOW;
+    }
+
+    s_battery_level = level;
+    if (state != s_battery_state) {
+        ESP_LOGI(TAG, "Battery state %d -> %d (%d%%)", s_battery_state, state, level);
+        bool was_normal = s_battery_state == POWER_BATTERY_NORMAL;
+        s_battery_state = state;
+        if (was_normal != (state == POWER_BATTERY_NORMAL)) {
+            configure_pm();
+        }
+    }
+}
+
+
+uint8_t power_policy_get_battery_level(void) {
+    return s_battery_level;
+}
+
+
+power_battery_state_t power_policy_get_battery_state(void) {
+    return s_battery_state;
+}
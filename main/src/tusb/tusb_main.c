@@ -5,6 +5,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -15,6 +17,16 @@
 #include "esp_now_main.h"
 #include "btn_progress.h"
 #include "descriptors.h"
+#include "kbd_latency.h"
+#include "hid_report.h"
+#include "led_state.h"
+#include "lamp_array.h"
+#include "tusb_main.h"
+#include "macro_player.h"
+#include "steno.h"
+#if CFG_TUD_CDC
+#include "tusb_cdc_acm.h"
+#endif
 
 #define APP_BUTTON (GPIO_NUM_0) // Use BOOT signal by default
 static const char *TAG = "example";
@@ -22,79 +34,222 @@ static const char *TAG = "example";
 
 /************* TinyUSB descriptors ****************/
 
-#define TUSB_DESC_TOTAL_LEN      (TUD_CONFIG_DESC_LEN + CFG_TUD_HID * TUD_HID_DESC_LEN)
-#define TUD_CONSUMER_CONTROL    3
+#define TUSB_DESC_TOTAL_LEN      (TUD_CONFIG_DESC_LEN + (CFG_TUD_HID - 1) * TUD_HID_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#define EPNUM_KEYBOARD          0x81
+#define EPNUM_NKRO              0x82
+#define EPNUM_CONSUMER          0x83
+#define EPNUM_VENDOR_IN         0x84
+#define EPNUM_VENDOR_OUT        0x04
+
+#define KEYBOARD_QUEUE_LEN      10
+#define CONSUMER_QUEUE_LEN      4
+#define VENDOR_QUEUE_LEN        4
+
+_Static_assert(CFG_TUD_HID == ITF_NUM_TOTAL, "CONFIG_TINYUSB_HID_COUNT must match the HID interfaces");
 
 typedef struct {
     TaskHandle_t task_handle;
-    QueueHandle_t hid_queue;
+    QueueHandle_t keyboard_queue;       // hid_nkey_report_t for ITF_NUM_KEYBOARD and ITF_NUM_NKRO
+    QueueHandle_t consumer_queue;       // uint16_t usage for ITF_NUM_CONSUMER
+    QueueHandle_t vendor_queue;         // TINYUSB_VENDOR_REPORT_LEN bytes for ITF_NUM_VENDOR
+    int16_t mouse_x;                    // Motion handed to us and not sent yet, the next report takes it
+    int16_t mouse_y;
+    int16_t mouse_wheel;
+    uint8_t mouse_buttons;
+    bool mouse_dirty;                   // buttons changed or motion left
+    hid_nkey_report_t keyboard_state;   // Last keyboard report handed to us, answers GET_REPORT
+    uint16_t consumer_state;            // Last consumer usage handed to us, answers GET_REPORT
 } tinyusb_hid_t;
 
 static tinyusb_hid_t *s_tinyusb_hid = NULL;
+// Outside s_tinyusb_hid, the keyboard task registers it before tusb_main() runs
+static tinyusb_vendor_rx_cb_t s_vendor_rx_cb = NULL;
+static portMUX_TYPE s_state_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_bool s_macro_consumer;    // the macro player last wrote to ITF_NUM_CONSUMER, else to the keyboard
 
 
 /**
- * @brief HID report descriptor
+ * @brief HID report descriptors
  *
- * In this example we implement Keyboard HID device,
+ * The keyboard interface is a boot keyboard for BIOS and other boot protocol hosts. A host in report protocol
+ * gets every key through the NKRO interface instead, so each keystroke produces one report on one endpoint.
+ * Consumer control and the vendor channel have interfaces of their own, so they never wait behind a key.
+ * The LampArray collection shares the consumer interface, it only uses feature reports over the control endpoint.
+ * The mouse shares it as well, the S3 has no IN endpoint left, and polls it every frame for mouse keys.
  */
-const uint8_t hid_report_descriptor[] = {
-    TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(HID_ITF_PROTOCOL_KEYBOARD)),
+const uint8_t hid_keyboard_report_descriptor[] = {
+    TUD_HID_REPORT_DESC_KEYBOARD(),
+};
+
+const uint8_t hid_nkro_report_descriptor[] = {
     TUD_HID_REPORT_DESC_FULL_KEY_KEYBOARD(HID_REPORT_ID(REPORT_ID_FULL_KEY_KEYBOARD)),
-    TUD_HID_REPORT_DESC_CONSUMER(HID_REPORT_ID(TUD_CONSUMER_CONTROL)),
+};
+
+const uint8_t hid_consumer_report_descriptor[] = {
+    TUD_HID_REPORT_DESC_CONSUMER(HID_REPORT_ID(REPORT_ID_CONSUMER)),
+    TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(REPORT_ID_MOUSE)),
+    TUD_HID_REPORT_DESC_LAMP_ARRAY(REPORT_ID_LIGHTING_LAMP_ARRAY_ATTRIBUTES),
+};
+
+const uint8_t hid_vendor_report_descriptor[] = {
+    TUD_HID_REPORT_DESC_GENERIC_INOUT(TINYUSB_VENDOR_REPORT_LEN),
 };
 
 
 /**
  * @brief String descriptor
  */
-const char* hid_string_descriptor[5] = {
+const char* hid_string_descriptor[8] = {
     // array of pointer to string descriptors
     (char[]){0x09, 0x04},  // 0: is supported language is English (0x0409)
     "TinyUSB",             // 1: Manufacturer
     "TinyUSB Device",      // 2: Product
     "123456",              // 3: Serials, should use chip ID
-    "Example HID interface",  // 4: HID
+    "Boot keyboard",       // 4: ITF_NUM_KEYBOARD
+    "NKRO keyboard",       // 5: ITF_NUM_NKRO
+    "Consumer control, mouse and lighting", // 6: ITF_NUM_CONSUMER
+    "Raw HID",             // 7: ITF_NUM_VENDOR
 };
 
 
 /**
  * @brief Configuration descriptor
  *
- * This is a simple configuration descriptor that defines 1 configuration and 1 HID interface
+ * One configuration with one HID interface and IN endpoint per report stream
  */
 static const uint8_t hid_configuration_descriptor[] = {
     // Configuration number, interface count, string index, total length, attribute, power in mA
-    TUD_CONFIG_DESCRIPTOR(1, 1, 0, TUSB_DESC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
     // Interface number, string index, boot protocol, report descriptor len, EP In address, size & polling interval
-    TUD_HID_DESCRIPTOR(0, 4, false, sizeof(hid_report_descriptor), 0x81, 16, 10),
+    TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 4, HID_ITF_PROTOCOL_KEYBOARD, sizeof(hid_keyboard_report_descriptor), EPNUM_KEYBOARD, 8, 1),
+    TUD_HID_DESCRIPTOR(ITF_NUM_NKRO, 5, HID_ITF_PROTOCOL_NONE, sizeof(hid_nkro_report_descriptor), EPNUM_NKRO, 32, 1),
+    TUD_HID_DESCRIPTOR(ITF_NUM_CONSUMER, 6, HID_ITF_PROTOCOL_NONE, sizeof(hid_consumer_report_descriptor), EPNUM_CONSUMER, 8, 1),
+
+    // Interface number, string index, protocol, report descriptor len, EP Out & In address, size & polling interval
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_VENDOR, 7, HID_ITF_PROTOCOL_NONE, sizeof(hid_vendor_report_descriptor), EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, TINYUSB_VENDOR_REPORT_LEN, 1),
 };
 
 
+/**
+ * @brief Steno mode descriptors
+ *
+ * Strokes go to the host as a serial stream on one CDC-ACM port and nothing else. CDC takes an interrupt IN and a
+ * bulk IN endpoint, the HID interfaces above use every IN endpoint the S3 has, so steno mode is a USB personality
+ * of its own chosen at boot. It has its own product ID, hosts bind drivers by VID/PID.
+ */
+#if CFG_TUD_CDC
+#define STENO_DESC_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN)
+#define STENO_ITF_NUM_CDC       0
+#define STENO_ITF_NUM_TOTAL     2       // communication and data interface
+#define EPNUM_STENO_NOTIF       0x81
+#define EPNUM_STENO_OUT         0x02
+#define EPNUM_STENO_IN          0x82
+
+#define STENO_USB_VID           0x303A  // Espressif
+#define STENO_USB_PID           0x4001  // esp_tinyusb's automatic PID of a device with one CDC port
+
+static const tusb_desc_device_t steno_device_descriptor = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = 0x0200,
+    // Interface association, as CDC requires
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = STENO_USB_VID,
+    .idProduct = STENO_USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = 0x01,
+    .iProduct = 0x02,
+    .iSerialNumber = 0x03,
+    .bNumConfigurations = 0x01,
+};
+
+const char* steno_string_descriptor[5] = {
+    (char[]){0x09, 0x04},  // 0: is supported language is English (0x0409)
+    "TinyUSB",             // 1: Manufacturer
+    "TinyUSB Steno",       // 2: Product
+    "123456",              // 3: Serials, should use chip ID
+    "Steno",               // 4: STENO_ITF_NUM_CDC
+};
+
+static const uint8_t steno_configuration_descriptor[] = {
+    // Configuration number, interface count, string index, total length, attribute, power in mA
+    TUD_CONFIG_DESCRIPTOR(1, STENO_ITF_NUM_TOTAL, 0, STENO_DESC_TOTAL_LEN, 0, 100),
+
+    // Interface number, string index, EP notification address and size, EP data address (out, in) and size
+    TUD_CDC_DESCRIPTOR(STENO_ITF_NUM_CDC, 4, EPNUM_STENO_NOTIF, 8, EPNUM_STENO_OUT, EPNUM_STENO_IN, 64),
+};
+#endif
+
+
 /********* TinyUSB HID callbacks ***************/
 
 // Invoked when received GET HID REPORT DESCRIPTOR request
 // Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 {
-    // We use only one interface and one HID report descriptor, so we can ignore parameter 'instance'
-    return hid_report_descriptor;
+    switch (instance) {
+    case ITF_NUM_NKRO:
+        return hid_nkro_report_descriptor;
+    case ITF_NUM_CONSUMER:
+        return hid_consumer_report_descriptor;
+    case ITF_NUM_VENDOR:
+        return hid_vendor_report_descriptor;
+    default:
+        return hid_keyboard_report_descriptor;
+    }
 }
 
 
 // Invoked when received GET_REPORT control request
 // Application must fill buffer report's content and return its length.
 // Return zero will cause the stack to STALL request
+// The stack has already written the report ID to the buffer when the host asked for one
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
 {
-    (void) instance;
-    (void) report_id;
-    (void) report_type;
-    (void) buffer;
-    (void) reqlen;
+    if (instance == ITF_NUM_CONSUMER && report_type == HID_REPORT_TYPE_FEATURE) {
+        return lamp_array_get_report(report_id, buffer, reqlen);
+    }
+    if (s_tinyusb_hid == NULL || report_type != HID_REPORT_TYPE_INPUT) {
+        return 0;
+    }
 
-    return 0;
+    hid_nkey_report_t report;
+    uint16_t usage;
+    taskENTER_CRITICAL(&s_state_lock);
+    report = s_tinyusb_hid->keyboard_state;
+    usage = s_tinyusb_hid->consumer_state;
+    taskEXIT_CRITICAL(&s_state_lock);
+
+    const void *data = NULL;
+    uint16_t len = 0;
+    switch (instance) {
+    case ITF_NUM_KEYBOARD:
+        // BIOS hosts poll GET_REPORT on the boot interface, answer in the boot format whatever the key state was built as
+        hid_report_convert(&report, HID_REPORT_FORMAT_BOOT, &report);
+        data = &report.keyboard_report;
+        len = sizeof(report.keyboard_report);
+        break;
+    case ITF_NUM_NKRO:
+        hid_report_convert(&report, HID_REPORT_FORMAT_NKRO, &report);
+        data = &report.keyboard_full_key_report;
+        len = sizeof(report.keyboard_full_key_report);
+        break;
+    case ITF_NUM_CONSUMER:
+        data = &usage;
+        len = sizeof(usage);
+        break;
+    default:
+        return 0;
+    }
+    if (len > reqlen) {
+        len = reqlen;
+    }
+    memcpy(buffer, data, len);
+    return len;
 }
 
 
@@ -102,6 +257,76 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize)
 {
+    (void) report_id;
+    // Both keyboard interfaces carry the LED output report, hosts send the lock state to every keyboard they see
+    if ((instance == ITF_NUM_KEYBOARD || instance == ITF_NUM_NKRO) && report_type == HID_REPORT_TYPE_OUTPUT && bufsize >= 1) {
+        led_state_set(MODE_USB, buffer[0]);
+        return;
+    }
+    if (instance == ITF_NUM_CONSUMER && report_type == HID_REPORT_TYPE_FEATURE) {
+        lamp_array_set_report(report_id, buffer, bufsize);
+        return;
+    }
+    if (instance == ITF_NUM_VENDOR && s_vendor_rx_cb != NULL) {
+        s_vendor_rx_cb(buffer, bufsize);
+    }
+}
+
+
+// Invoked when the device is unmounted, the lock state belongs to the host that went away
+void tud_umount_cb(void)
+{
+    led_state_set(MODE_USB, 0);
+}
+
+
+// Invoked when received SET_PROTOCOL request, the stack has already switched tud_hid_n_get_protocol()
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol)
+{
+    if (instance != ITF_NUM_KEYBOARD || s_tinyusb_hid == NULL) {
+        return;
+    }
+    ESP_LOGI(TAG, "Host switched to %s protocol", protocol == HID_PROTOCOL_BOOT ? "boot" : "report");
+
+    // Reports queued in the old format would go to the interface the host stopped reading
+    xQueueReset(s_tinyusb_hid->keyboard_queue);
+    kbd_latency_reports_clear();
+
+    hid_nkey_report_t state;
+    taskENTER_CRITICAL(&s_state_lock);
+    state = s_tinyusb_hid->keyboard_state;
+    taskEXIT_CRITICAL(&s_state_lock);
+
+    // Release everything on the interface left behind, then restate held keys on the new one
+    hid_nkey_report_t report;
+    hid_report_format_t format = protocol == HID_PROTOCOL_BOOT ? HID_REPORT_FORMAT_BOOT : HID_REPORT_FORMAT_NKRO;
+    hid_report_format_t old_format = format == HID_REPORT_FORMAT_BOOT ? HID_REPORT_FORMAT_NKRO : HID_REPORT_FORMAT_BOOT;
+    hid_report_build(NULL, 0, NULL, old_format, &report);
+    xQueueSend(s_tinyusb_hid->keyboard_queue, &report, 0);
+    hid_report_convert(&state, format, &report);
+    xQueueSend(s_tinyusb_hid->keyboard_queue, &report, 0);
+    xTaskNotifyGive(s_tinyusb_hid->task_handle);
+}
+
+
+// Invoked when a report was read by the host, report[0] is the report ID on interfaces that use one
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+    if (instance == ITF_NUM_KEYBOARD || instance == ITF_NUM_NKRO) {
+        kbd_latency_report_done();
+    }
+    // One macro report per polling frame, of the interface the player wrote to. Mouse and lighting reports
+    // share the consumer interface, only the consumer report ID counts there.
+    bool macro_done = atomic_load(&s_macro_consumer)
+                      ? instance == ITF_NUM_CONSUMER && len >= 1 && report[0] == REPORT_ID_CONSUMER
+                      : instance == ITF_NUM_KEYBOARD || instance == ITF_NUM_NKRO;
+    if (macro_done) {
+        macro_player_ready();
+    }
+    // The endpoint is free again, let the HID task send the next report of this interface
+    if (s_tinyusb_hid != NULL) {
+        xTaskNotifyGive(s_tinyusb_hid->task_handle);
+    }
 }
 
 
@@ -114,33 +339,175 @@ static void tusb_device_task(void *arg)
     }
 }
 
-void tinyusb_hid_keyboard_report(hid_nkey_report_t report)
+bool tinyusb_hid_keyboard_nkro(void)
 {
-    static bool use_full_key = false;
+    // Hosts that never send SET_PROTOCOL stay in report protocol and read the NKRO interface
+    return tud_hid_n_get_protocol(ITF_NUM_KEYBOARD) == HID_PROTOCOL_REPORT;
+}
+
+/**
+ * @brief Queue a report for the HID task, or wake the host instead while the bus is suspended
+ * @return true when the report was queued
+ */
+static bool tinyusb_hid_queue_report(QueueHandle_t queue, const void *report)
+{
+    if (s_tinyusb_hid == NULL) {
+        return false;
+    }
     // Remote wakeup
     if (tud_suspended()) {
         // Wake up host if we are in suspend mode
         // and REMOTE_WAKEUP feature is enabled by host
         tud_remote_wakeup();
+        return false;
+    }
+    if (xQueueSend(queue, report, 0) != pdTRUE) {
+        return false;
+    }
+    xTaskNotifyGive(s_tinyusb_hid->task_handle);
+    return true;
+}
+
+void tinyusb_hid_keyboard_report(hid_nkey_report_t report)
+{
+    if (report.report_id == REPORT_ID_CONSUMER) {
+        tinyusb_hid_consumer_report(report.consumer_report.keycode);
+        return;
+    }
+    if (s_tinyusb_hid == NULL) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_state_lock);
+    s_tinyusb_hid->keyboard_state = report;
+    taskEXIT_CRITICAL(&s_state_lock);
+    if (tinyusb_hid_queue_report(s_tinyusb_hid->keyboard_queue, &report)) {
+        kbd_latency_report_enqueue();
+    }
+}
+
+bool tinyusb_hid_consumer_report(uint16_t usage)
+{
+    if (s_tinyusb_hid == NULL) {
+        return false;
+    }
+    taskENTER_CRITICAL(&s_state_lock);
+    s_tinyusb_hid->consumer_state = usage;
+    taskEXIT_CRITICAL(&s_state_lock);
+    return tinyusb_hid_queue_report(s_tinyusb_hid->consumer_queue, &usage);
+}
+
+void tinyusb_hid_macro_interface(bool consumer)
+{
+    atomic_store(&s_macro_consumer, consumer);
+}
+
+static int16_t mouse_add(int16_t total, int8_t delta)
+{
+    int32_t sum = total + delta;
+    return sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : sum);
+}
+
+void tinyusb_hid_mouse_report(uint8_t buttons, int8_t x, int8_t y, int8_t wheel)
+{
+    if (s_tinyusb_hid == NULL) {
+        return;
+    }
+    if (tud_suspended()) {
+        tud_remote_wakeup();
+        return;
+    }
+    taskENTER_CRITICAL(&s_state_lock);
+    s_tinyusb_hid->mouse_x = mouse_add(s_tinyusb_hid->mouse_x, x);
+    s_tinyusb_hid->mouse_y = mouse_add(s_tinyusb_hid->mouse_y, y);
+    s_tinyusb_hid->mouse_wheel = mouse_add(s_tinyusb_hid->mouse_wheel, wheel);
+    s_tinyusb_hid->mouse_dirty |= buttons != s_tinyusb_hid->mouse_buttons || x || y || wheel;
+    s_tinyusb_hid->mouse_buttons = buttons;
+    taskEXIT_CRITICAL(&s_state_lock);
+    xTaskNotifyGive(s_tinyusb_hid->task_handle);
+}
+
+bool tinyusb_hid_vendor_report(const uint8_t *data, uint16_t len)
+{
+    uint8_t report[TINYUSB_VENDOR_REPORT_LEN] = {0};
+    if (s_tinyusb_hid == NULL || len > sizeof(report)) {
+        return false;
+    }
+    memcpy(report, data, len);
+    return tinyusb_hid_queue_report(s_tinyusb_hid->vendor_queue, report);
+}
+
+void tinyusb_hid_vendor_register_rx(tinyusb_vendor_rx_cb_t cb)
+{
+    s_vendor_rx_cb = cb;
+}
+
+/**
+ * @brief Send the oldest keyboard report if the endpoint it goes to is free
+ */
+static void tinyusb_hid_service_keyboard(void)
+{
+    hid_nkey_report_t report;
+    if (xQueuePeek(s_tinyusb_hid->keyboard_queue, &report, 0) != pdTRUE) {
+        return;
+    }
+    uint8_t instance = report.report_id == REPORT_ID_FULL_KEY_KEYBOARD ? ITF_NUM_NKRO : ITF_NUM_KEYBOARD;
+    if (!tud_hid_n_ready(instance)) {
+        // Still waiting for the host to read the previous report, the completion wakes us again
+        return;
+    }
+    xQueueReceive(s_tinyusb_hid->keyboard_queue, &report, 0);
+
+    bool sent = false;
+    if (instance == ITF_NUM_NKRO) {
+        sent = tud_hid_n_report(ITF_NUM_NKRO, REPORT_ID_FULL_KEY_KEYBOARD, &report.keyboard_full_key_report, sizeof(report.keyboard_full_key_report));
     } else {
-        switch (report.report_id) {
-        case REPORT_ID_FULL_KEY_KEYBOARD:
-            use_full_key = true;
-            break;
-        case REPORT_ID_KEYBOARD: {
-            if (use_full_key) {
-                hid_nkey_report_t _report = {0};
-                _report.report_id = REPORT_ID_FULL_KEY_KEYBOARD;
-                xQueueSend(s_tinyusb_hid->hid_queue, &_report, 0);
-                use_full_key = false;
-            }
-            break;
-        }
-        default:
-            break;
-        }
+        sent = tud_hid_n_report(ITF_NUM_KEYBOARD, 0, &report.keyboard_report, sizeof(report.keyboard_report));
+    }
+    if (!sent) {
+        kbd_latency_report_dropped();
+    }
+}
+
+static int8_t mouse_take(int16_t *total)
+{
+    int16_t counts = *total > 127 ? 127 : (*total < -127 ? -127 : *total);
+    *total -= counts;
+    return counts;
+}
 
-        xQueueSend(s_tinyusb_hid->hid_queue, &report, 0);
+static void tinyusb_hid_service_consumer(void)
+{
+    uint16_t usage;
+    if (!tud_hid_n_ready(ITF_NUM_CONSUMER)) {
+        return;
+    }
+    if (xQueueReceive(s_tinyusb_hid->consumer_queue, &usage, 0) == pdTRUE) {
+        tud_hid_n_report(ITF_NUM_CONSUMER, REPORT_ID_CONSUMER, &usage, sizeof(usage));
+        return;
+    }
+
+    // Whatever motion piled up since the last frame goes in one report, so no count is lost to the polling rate
+    hid_mouse_report_t report = {0};
+    taskENTER_CRITICAL(&s_state_lock);
+    bool dirty = s_tinyusb_hid->mouse_dirty;
+    if (dirty) {
+        report.buttons = s_tinyusb_hid->mouse_buttons;
+        report.x = mouse_take(&s_tinyusb_hid->mouse_x);
+        report.y = mouse_take(&s_tinyusb_hid->mouse_y);
+        report.wheel = mouse_take(&s_tinyusb_hid->mouse_wheel);
+        s_tinyusb_hid->mouse_dirty = s_tinyusb_hid->mouse_x || s_tinyusb_hid->mouse_y || s_tinyusb_hid->mouse_wheel;
+    }
+    taskEXIT_CRITICAL(&s_state_lock);
+    if (dirty) {
+        tud_hid_n_report(ITF_NUM_CONSUMER, REPORT_ID_MOUSE, &report, sizeof(report));
+    }
+}
+
+static void tinyusb_hid_service_vendor(void)
+{
+    uint8_t report[TINYUSB_VENDOR_REPORT_LEN];
+    if (tud_hid_n_ready(ITF_NUM_VENDOR) && xQueueReceive(s_tinyusb_hid->vendor_queue, report, 0) == pdTRUE) {
+        tud_hid_n_report(ITF_NUM_VENDOR, 0, report, sizeof(report));
     }
 }
 
@@ -148,37 +515,90 @@ void tinyusb_hid_keyboard_report(hid_nkey_report_t report)
 static void tinyusb_hid_task(void *arg)
 {
     (void) arg;
-    hid_nkey_report_t report;
     while (1) {
-        if (xQueueReceive(s_tinyusb_hid->hid_queue, &report, portMAX_DELAY)) {
-            // Remote wakeup
-            if (tud_suspended()) {
-                // Wake up host if we are in suspend mode
-                // and REMOTE_WAKEUP feature is enabled by host
+        // Woken by every queued report and every completion, each interface only waits for its own endpoint
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (tud_suspended()) {
+            // Reports queued before the suspend are stale by the time the host resumes
+            if (uxQueueMessagesWaiting(s_tinyusb_hid->keyboard_queue) > 0) {
                 tud_remote_wakeup();
-                xQueueReset(s_tinyusb_hid->hid_queue);
-            } else {
-                if (report.report_id == REPORT_ID_KEYBOARD) {
-                    tud_hid_n_report(0, REPORT_ID_KEYBOARD, &report.keyboard_report, sizeof(report.keyboard_report));
-                } else if (report.report_id == REPORT_ID_FULL_KEY_KEYBOARD) {
-                    tud_hid_n_report(0, REPORT_ID_FULL_KEY_KEYBOARD, &report.keyboard_full_key_report, sizeof(report.keyboard_full_key_report));
-                } else if (report.report_id == REPORT_ID_CONSUMER) {
-                    tud_hid_n_report(0, REPORT_ID_CONSUMER, &report.consumer_report, sizeof(report.consumer_report));
-                } else {
-                    // Unknown report
-                    continue;
-                }
-                // Wait until report is sent
-                if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10))) {
-                    ESP_LOGW(TAG, "Report not sent");
-                }
             }
+            xQueueReset(s_tinyusb_hid->keyboard_queue);
+            xQueueReset(s_tinyusb_hid->consumer_queue);
+            xQueueReset(s_tinyusb_hid->vendor_queue);
+            taskENTER_CRITICAL(&s_state_lock);
+            s_tinyusb_hid->mouse_x = s_tinyusb_hid->mouse_y = s_tinyusb_hid->mouse_wheel = 0;
+            s_tinyusb_hid->mouse_dirty = false;
+            taskEXIT_CRITICAL(&s_state_lock);
+            kbd_latency_reports_clear();
+            continue;
         }
+
+        tinyusb_hid_service_keyboard();
+        tinyusb_hid_service_consumer();
+        tinyusb_hid_service_vendor();
     }
 }
 
+bool tinyusb_steno_write(const uint8_t *data, size_t len)
+{
+#if CFG_TUD_CDC
+    if (!tusb_cdc_acm_initialized(TINYUSB_CDC_ACM_0)) {
+        return false;
+    }
+    // Nobody reads a port that is not open, old strokes would come out when it opens
+    if (!tud_cdc_n_connected(TINYUSB_CDC_ACM_0)) {
+        return false;
+    }
+    if (tinyusb_cdcacm_write_queue(TINYUSB_CDC_ACM_0, data, len) != len) {
+        return false;
+    }
+    // Never waits, the stroke goes out with the next IN token the host sends
+    tinyusb_cdcacm_write_flush(TINYUSB_CDC_ACM_0, 0);
+    return true;
+#else
+    (void) data;
+    (void) len;
+    return false;
+#endif
+}
+
+#if CFG_TUD_CDC
+/**
+ * @brief Install the CDC-only configuration of steno mode, no HID interface is exposed
+ */
+static void tusb_steno_main(void)
+{
+    ESP_LOGI(TAG, "USB initialization, steno");
+
+    const tinyusb_config_t tusb_cfg = {
+        .device_descriptor = &steno_device_descriptor,
+        .string_descriptor = steno_string_descriptor,
+        .string_descriptor_count = sizeof(steno_string_descriptor) / sizeof(steno_string_descriptor[0]),
+        .external_phy = false,
+        .configuration_descriptor = steno_configuration_descriptor,
+    };
+    ESP_ERROR_CHECK(tinyusb_driver_install(&tusb_cfg));
+
+    const tinyusb_config_cdcacm_t acm_cfg = {
+        .usb_dev = TINYUSB_USBDEV_0,
+        .cdc_port = TINYUSB_CDC_ACM_0,
+    };
+    ESP_ERROR_CHECK(tusb_cdc_acm_init(&acm_cfg));
+}
+#endif
+
 void tusb_main(void)
 {
+#if CFG_TUD_CDC
+    // s_tinyusb_hid stays NULL, every HID report call returns straight away
+    if (keyboard_steno_protocol() != STENO_PROTOCOL_NONE) {
+        tusb_steno_main();
+        return;
+    }
+#endif
+
     // Initialize button that will trigger HID reports
     const gpio_config_t boot_button_config = {
         .pin_bit_mask = BIT64(APP_BUTTON),
@@ -202,8 +622,11 @@ void tusb_main(void)
     s_tinyusb_hid = calloc(1, sizeof(tinyusb_hid_t));
 
     ESP_ERROR_CHECK(tinyusb_driver_install(&tusb_cfg));
+    lamp_array_init();
 
-    s_tinyusb_hid->hid_queue = xQueueCreate(10, sizeof(hid_nkey_report_t));   // Adjust queue length and item size as per your requirement
+    s_tinyusb_hid->keyboard_queue = xQueueCreate(KEYBOARD_QUEUE_LEN, sizeof(hid_nkey_report_t));
+    s_tinyusb_hid->consumer_queue = xQueueCreate(CONSUMER_QUEUE_LEN, sizeof(uint16_t));
+    s_tinyusb_hid->vendor_queue = xQueueCreate(VENDOR_QUEUE_LEN, TINYUSB_VENDOR_REPORT_LEN);
     xTaskCreate(tusb_device_task, "TinyUSB", 4096, NULL, 5, NULL);
     xTaskCreate(tinyusb_hid_task, "tinyusb_hid_task", 4096, NULL, 9, &s_tinyusb_hid->task_handle);
     xTaskNotifyGive(s_tinyusb_hid->task_handle);
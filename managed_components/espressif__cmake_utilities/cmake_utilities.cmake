@@ -1,7 +0,0 @@
-# Include all cmake modules
-
-include(gcc)
-include(gen_compressed_ota)
-include(gen_single_bin)
-include(package_manager)
-include(relinker)
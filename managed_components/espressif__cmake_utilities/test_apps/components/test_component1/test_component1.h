@@ -1,14 +0,0 @@
-#include <stdio.h>
-#pragma once
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-int test_component1_version_major();
-int test_component1_version_minor();
-int test_component1_version_patch();
-
-#ifdef __cplusplus
-}
-#endif